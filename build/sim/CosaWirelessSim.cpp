@@ -0,0 +1,311 @@
+/**
+ * @file CosaWirelessSim.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa Wireless simulation benchmark; throughput and delivery ratio
+ * of the wireless examples at scale on the simulated radio medium.
+ *
+ * 1. Ping-pong; pairs of CosaWirelessPing and CosaWirelessPong nodes
+ * in a cluster (all in range). The ping node sends a sequence number
+ * and waits for the reply, with retransmission after ARW ms.
+ * 2. Relay; a chain of CosaWirelessRelay nodes (Mesh) spaced so that
+ * only neighbours are in range. The first node sends a message to
+ * the last node every period.
+ *
+ * The node loops are those of the example sketches with the network
+ * and device address given per node.
+ *
+ * @section Usage
+ * CosaWirelessSim [-p pairs] [-r relays] [-t seconds] [-i period]
+ *   [-l loss] [-b bitrate] [-s seed] [-c]
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Medium.hh"
+#include "Mesh.hh"
+
+#include "Cosa/RTC.hh"
+
+#include <stdio.h>
+#include <getopt.h>
+
+// Network address
+#define NETWORK 0xC05A
+
+// Ping message type (port) and sequence number
+typedef int16_t ping_t;
+static const uint8_t PING_TYPE = 0x80;
+
+// Relay message type (port) and payload size
+static const uint8_t RELAY_TYPE = 0x81;
+#define PAYLOAD 30
+
+// Simulation configuration
+static uint8_t pairs = 8;
+static uint8_t relays = 6;
+static uint32_t seconds = 60;
+static uint16_t period = 1000;
+
+/**
+ * CosaWirelessPing; send sequence number and wait for reply. Count
+ * number of retransmissions.
+ */
+class Ping : public Medium::Node {
+public:
+  Ping(Medium* medium, Medium::Driver* rf, uint8_t pong) :
+    Medium::Node(medium),
+    m_rf(rf),
+    m_pong(pong),
+    m_nr(0),
+    m_trips(0),
+    m_sent(0),
+    m_arc(0)
+  {}
+
+  virtual void setup()
+  {
+    m_rf->begin();
+    delay(rand() % period);
+  }
+
+  virtual void loop()
+  {
+    // Auto retransmission wait (ms)
+    static const uint16_t ARW = 200;
+    uint8_t port;
+    uint8_t src;
+    uint32_t now = RTC::millis();
+    uint16_t rc = 0;
+    ping_t nr = m_nr;
+    while (1) {
+      m_rf->send(m_pong, PING_TYPE, &nr, sizeof(nr));
+      m_sent += 1;
+      int res = m_rf->recv(src, port, &nr, sizeof(nr), ARW);
+      if (res == (int) sizeof(nr) && src == m_pong) break;
+      rc += 1;
+    }
+    m_nr = nr;
+    m_trips += 1;
+    m_arc += rc;
+    m_rf->powerdown();
+    uint32_t ms = period - RTC::since(now);
+    if (ms > period) ms = period;
+    delay(ms);
+  }
+
+  Medium::Driver* m_rf;
+  uint8_t m_pong;
+  ping_t m_nr;
+  uint32_t m_trips;
+  uint32_t m_sent;
+  uint32_t m_arc;
+};
+
+/**
+ * CosaWirelessPong; reply with incremented sequence number.
+ */
+class Pong : public Medium::Node {
+public:
+  Pong(Medium* medium, Medium::Driver* rf) :
+    Medium::Node(medium),
+    m_rf(rf)
+  {}
+
+  virtual void setup()
+  {
+    m_rf->begin();
+  }
+
+  virtual void loop()
+  {
+    uint8_t port;
+    uint8_t src;
+    ping_t nr;
+    while (m_rf->recv(src, port, &nr, sizeof(nr)) != sizeof(nr)) yield();
+    if (port != PING_TYPE) return;
+    nr += 1;
+    m_rf->send(src, port, &nr, sizeof(nr));
+  }
+
+  Medium::Driver* m_rf;
+};
+
+/**
+ * CosaWirelessRelay; receive messages and handle forwarding and
+ * beacons while waiting. The source node sends a time stamped
+ * message to the sink every period. The sink counts received
+ * messages and the accumulated latency.
+ */
+class Relay : public Medium::Node {
+public:
+  Relay(Medium* medium, Medium::Driver* rf, uint8_t sink, bool is_source) :
+    Medium::Node(medium),
+    m_mesh(rf, PAYLOAD),
+    m_sink(sink),
+    m_is_source(is_source),
+    m_sent(0),
+    m_received(0),
+    m_latency(0)
+  {}
+
+  virtual void setup()
+  {
+    delay(rand() % Mesh::BEACON_PERIOD);
+    m_mesh.begin();
+  }
+
+  virtual void loop()
+  {
+    // Source; send time stamped message to the sink
+    uint32_t now = RTC::millis();
+    if (m_is_source) {
+      uint8_t msg[PAYLOAD - 8];
+      memset(msg, 0, sizeof(msg));
+      memcpy(msg, &now, sizeof(now));
+      if (m_mesh.send(m_sink, RELAY_TYPE, msg, sizeof(msg)) > 0)
+	m_sent += 1;
+    }
+
+    // Receive messages until the end of the period
+    uint32_t elapsed;
+    while ((elapsed = RTC::since(now)) < period) {
+      uint8_t msg[Mesh::PAYLOAD_MAX];
+      uint8_t src;
+      uint8_t port;
+      int count = m_mesh.recv(src, port, msg, sizeof(msg), period - elapsed);
+      if (count < (int) sizeof(uint32_t) || port != RELAY_TYPE) continue;
+      if (m_mesh.is_broadcast()) continue;
+      uint32_t stamp;
+      memcpy(&stamp, msg, sizeof(stamp));
+      m_latency += RTC::since(stamp);
+      m_received += 1;
+    }
+  }
+
+  Mesh m_mesh;
+  uint8_t m_sink;
+  bool m_is_source;
+  uint32_t m_sent;
+  uint32_t m_received;
+  uint32_t m_latency;
+};
+
+/**
+ * Print medium statistics.
+ * @param[in] medium radio medium.
+ */
+static void
+report(Medium& medium)
+{
+  printf("medium: transmissions=%u, deliveries=%u, collisions=%u, "
+	 "losses=%u, misses=%u, overruns=%u\n",
+	 medium.get_transmissions(), medium.get_deliveries(),
+	 medium.get_collisions(), medium.get_losses(),
+	 medium.get_misses(), medium.get_overruns());
+}
+
+int main(int argc, char* argv[])
+{
+  uint32_t bitrate = 250000L;
+  uint32_t seed = 1;
+  uint16_t loss = 0;
+  bool carrier_sense = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "p:r:t:i:l:b:s:c")) != -1) {
+    switch (opt) {
+    case 'p': pairs = atoi(optarg); break;
+    case 'r': relays = atoi(optarg); break;
+    case 't': seconds = atol(optarg); break;
+    case 'i': period = atoi(optarg); break;
+    case 'l': loss = atoi(optarg); break;
+    case 'b': bitrate = atol(optarg); break;
+    case 's': seed = atol(optarg); break;
+    case 'c': carrier_sense = true; break;
+    default:
+      fprintf(stderr, "usage: %s [-p pairs] [-r relays] [-t seconds] "
+	      "[-i period] [-l loss] [-b bitrate] [-s seed] [-c]\n",
+	      argv[0]);
+      return (1);
+    }
+  }
+  if (2 * pairs > Medium::DRIVER_MAX || relays > Medium::DRIVER_MAX) {
+    fprintf(stderr, "%s: max %d devices\n", argv[0], Medium::DRIVER_MAX);
+    return (1);
+  }
+  printf("CosaWirelessSim: bitrate=%u, loss=%u, period=%u, seconds=%u, "
+	 "seed=%u, carrier_sense=%d\n",
+	 bitrate, loss, period, seconds, seed, carrier_sense);
+
+  // Ping-pong pairs in a cluster; pseudo-random positions in 20x20 m
+  if (pairs > 0) {
+    Medium medium(bitrate, 0, seed);
+    medium.set_loss(loss);
+    medium.set_carrier_sense(carrier_sense);
+    Ping* ping[Medium::DRIVER_MAX / 2];
+    srand(seed);
+    for (uint8_t i = 0; i < pairs; i++) {
+      uint8_t addr = 2 * i + 1;
+      Medium::Driver* rf = new Medium::Driver(&medium, NETWORK, addr,
+					      rand() % 20, rand() % 20);
+      ping[i] = new Ping(&medium, rf, addr + 1);
+      rf = new Medium::Driver(&medium, NETWORK, addr + 1,
+			      rand() % 20, rand() % 20);
+      new Pong(&medium, rf);
+    }
+    medium.run(seconds * 1000L);
+    uint32_t nr = 0;
+    uint32_t sent = 0;
+    uint32_t arc = 0;
+    for (uint8_t i = 0; i < pairs; i++) {
+      nr += ping[i]->m_trips;
+      sent += ping[i]->m_sent;
+      arc += ping[i]->m_arc;
+    }
+    printf("ping-pong: pairs=%u, round-trips=%u, sent=%u, arc=%u, "
+	   "delivery=%u%%, throughput=%u bytes/s\n",
+	   pairs, nr, sent, arc, sent ? (nr * 100) / sent : 0,
+	   (uint32_t) ((nr * 2 * sizeof(ping_t)) / seconds));
+    report(medium);
+  }
+
+  // Relay chain; 35 m spacing, only neighbours are in range
+  if (relays > 1) {
+    Medium medium(bitrate, 0, seed);
+    medium.set_loss(loss);
+    medium.set_carrier_sense(carrier_sense);
+    Relay* relay[Medium::DRIVER_MAX];
+    for (uint8_t i = 0; i < relays; i++) {
+      Medium::Driver* rf = new Medium::Driver(&medium, NETWORK, i + 1,
+					      i * 35, 0);
+      relay[i] = new Relay(&medium, rf, relays, i == 0);
+    }
+    medium.run(seconds * 1000L);
+    Relay* source = relay[0];
+    Relay* sink = relay[relays - 1];
+    uint32_t forwarded = 0;
+    for (uint8_t i = 0; i < relays; i++)
+      forwarded += relay[i]->m_mesh.get_forwarded();
+    printf("relay: hops=%u, sent=%u, received=%u, forwarded=%u, "
+	   "delivery=%u%%, latency=%u ms\n",
+	   relays - 1, source->m_sent, sink->m_received, forwarded,
+	   source->m_sent ? (sink->m_received * 100) / source->m_sent : 0,
+	   sink->m_received ? sink->m_latency / sink->m_received : 0);
+    report(medium);
+  }
+  return (0);
+}
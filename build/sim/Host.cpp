@@ -0,0 +1,166 @@
+/**
+ * @file Host.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation run-time; replaces the core run-time (main.cpp,
+ * RTC.cpp) and the avr-libc extensions. The real-time clock is the
+ * simulated clock of the radio medium, and delay, sleep and yield
+ * suspend the running node (see Medium.hh).
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Types.h"
+#include "Cosa/RTC.hh"
+#include "Medium.hh"
+
+#include <stdio.h>
+
+// Registers referenced by the core headers
+volatile uint8_t SREG = 0;
+volatile uint8_t ADCSRA = 0;
+
+// Delay, sleep and yield functions; simulated by the scheduler
+void (*delay)(uint32_t ms) = Medium::delay;
+void (*sleep)(uint16_t s) = Medium::sleep;
+void (*yield)() = Medium::yield;
+
+// Real-time clock state; the clock is set by the scheduler
+bool RTC::s_initiated = false;
+volatile uint32_t RTC::s_uticks = 0UL;
+volatile uint16_t RTC::s_ticks = 0;
+volatile clock_t RTC::s_sec = 0L;
+volatile int16_t RTC::s_uerror = 0;
+RTC::InterruptHandler RTC::s_handler = NULL;
+void* RTC::s_env = NULL;
+
+bool
+RTC::begin()
+{
+  if (s_initiated) return (false);
+  s_initiated = true;
+  return (true);
+}
+
+bool
+RTC::end()
+{
+  s_initiated = false;
+  return (true);
+}
+
+uint16_t
+RTC::us_per_tick()
+{
+  return (1);
+}
+
+uint16_t
+RTC::us_per_timer_cycle()
+{
+  return (1);
+}
+
+uint32_t
+RTC::micros()
+{
+  return (s_uticks);
+}
+
+void
+RTC::delay(uint32_t ms)
+{
+  Medium::delay(ms);
+}
+
+int
+RTC::await(volatile bool &condvar, uint32_t ms)
+{
+  if (ms == 0) {
+    while (!condvar) yield();
+    return (0);
+  }
+
+  uint32_t start = millis();
+  while (!condvar && since(start) < ms) yield();
+  return (condvar ? 0 : ETIME);
+}
+
+/**
+ * Convert given unsigned value to string in given buffer with given
+ * radix (2..36). Return buffer.
+ * @param[in] value to convert.
+ * @param[in] buf buffer.
+ * @param[in] radix number base.
+ * @return buffer.
+ */
+static char*
+convert(unsigned long value, char* buf, int radix)
+{
+  char tmp[sizeof(value) * CHARBITS + 1];
+  char* tp = tmp;
+  do {
+    int digit = value % radix;
+    *tp++ = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= radix;
+  } while (value != 0);
+  char* bp = buf;
+  while (tp != tmp) *bp++ = *--tp;
+  *bp = 0;
+  return (buf);
+}
+
+char*
+ultoa(unsigned long value, char* buf, int radix)
+{
+  return (convert(value, buf, radix));
+}
+
+char*
+utoa(unsigned int value, char* buf, int radix)
+{
+  return (convert(value, buf, radix));
+}
+
+char*
+ltoa(long value, char* buf, int radix)
+{
+  if (value < 0 && radix == 10) {
+    *buf = '-';
+    convert(-value, buf + 1, radix);
+    return (buf);
+  }
+  return (convert(value, buf, radix));
+}
+
+char*
+itoa(int value, char* buf, int radix)
+{
+  if (value < 0 && radix == 10) {
+    *buf = '-';
+    convert(-value, buf + 1, radix);
+    return (buf);
+  }
+  return (convert((unsigned int) value, buf, radix));
+}
+
+char*
+dtostrf(double value, signed char width, unsigned char prec, char* buf)
+{
+  sprintf(buf, "%*.*f", width, prec, value);
+  return (buf);
+}
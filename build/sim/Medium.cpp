@@ -0,0 +1,394 @@
+/**
+ * @file Medium.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Medium.hh"
+#include "Cosa/RTC.hh"
+
+#include <math.h>
+
+Medium::Node* Medium::s_running = NULL;
+
+Medium::Medium(uint32_t bitrate, uint16_t latency, uint32_t seed) :
+  m_clock(0),
+  m_bitrate(bitrate),
+  m_latency(latency),
+  m_jitter(500),
+  m_loss(0),
+  m_exponent(30),
+  m_carrier_sense(false),
+  m_seed(seed != 0 ? seed : 1),
+  m_drivers(0),
+  m_nodes(0),
+  m_transmissions(0),
+  m_deliveries(0),
+  m_collisions(0),
+  m_losses(0),
+  m_misses(0),
+  m_overruns(0)
+{
+  memset(m_transmission, 0, sizeof(m_transmission));
+}
+
+uint16_t
+Medium::random(uint16_t range)
+{
+  // Xorshift pseudo-random number generator
+  m_seed ^= m_seed << 13;
+  m_seed ^= m_seed >> 17;
+  m_seed ^= m_seed << 5;
+  return (m_seed % range);
+}
+
+int
+Medium::rssi(const Driver* src, const Driver* dest) const
+{
+  // Log-distance path loss; distance less than one meter is one meter
+  double dx = src->m_x - dest->m_x;
+  double dy = src->m_y - dest->m_y;
+  double d = sqrt(dx * dx + dy * dy);
+  if (d < 1.0) d = 1.0;
+  double loss = PATH_LOSS_1M + m_exponent * log10(d);
+  return (src->m_power - (int) (loss + 0.5));
+}
+
+bool
+Medium::is_busy(const Driver* dev) const
+{
+  for (uint8_t i = 0; i < TRANSMISSION_MAX; i++) {
+    const transmission_t* tp = &m_transmission[i];
+    if (!tp->is_active || tp->end <= m_clock) continue;
+    if (tp->channel != dev->m_channel) continue;
+    if (rssi(m_driver[tp->src], dev) >= SENSITIVITY) return (true);
+  }
+  return (false);
+}
+
+int32_t
+Medium::transmit(Driver* dev, uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  // Allocate transmission slot
+  transmission_t* tp = NULL;
+  for (uint8_t i = 0; i < TRANSMISSION_MAX && tp == NULL; i++)
+    if (!m_transmission[i].is_active) tp = &m_transmission[i];
+  if (tp == NULL) return (ENOSPC);
+
+  // Gather the frame payload
+  uint8_t* dp = tp->payload;
+  for (const iovec_t* vp = vec; vp->buf != NULL; vp++) {
+    memcpy(dp, vp->buf, vp->size);
+    dp += vp->size;
+  }
+  tp->len = dp - tp->payload;
+  tp->is_active = true;
+  tp->src = dev->m_index;
+  tp->channel = dev->m_channel;
+  tp->network = dev->m_addr.network;
+  tp->dest = dest;
+  tp->port = port;
+  tp->start = m_clock;
+  tp->end = m_clock + airtime(tp->len);
+  tp->interferers = 0;
+
+  // Mark overlapping transmissions on the same channel
+  for (uint8_t i = 0; i < TRANSMISSION_MAX; i++) {
+    transmission_t* op = &m_transmission[i];
+    if (op == tp || !op->is_active || op->end <= tp->start) continue;
+    if (op->channel != tp->channel) continue;
+    op->interferers |= (1ULL << tp->src);
+    tp->interferers |= (1ULL << op->src);
+  }
+  m_transmissions += 1;
+  return (tp->end - tp->start);
+}
+
+void
+Medium::deliver(transmission_t* tp)
+{
+  Driver* src = m_driver[tp->src];
+  for (uint8_t i = 0; i < m_drivers; i++) {
+    // Check that the receiver is addressed and in range
+    Driver* dev = m_driver[i];
+    if (dev == src || dev->m_channel != tp->channel) continue;
+    if (dev->m_addr.network != tp->network) continue;
+    if (tp->dest != Wireless::Driver::BROADCAST
+	&& tp->dest != dev->m_addr.device)
+      continue;
+    int signal = rssi(src, dev);
+    if (signal < SENSITIVITY) continue;
+
+    // Check that the receiver was listening
+    if (!dev->m_is_on || (tp->interferers & (1ULL << i))) {
+      m_misses += 1;
+      continue;
+    }
+
+    // Check for collision; overlapping transmission heard by receiver
+    bool collision = false;
+    for (uint8_t j = 0; j < m_drivers && !collision; j++) {
+      if ((tp->interferers & (1ULL << j)) == 0) continue;
+      int noise = rssi(m_driver[j], dev);
+      collision = (noise >= SENSITIVITY) && (signal - noise < CAPTURE);
+    }
+    if (collision) {
+      m_collisions += 1;
+      continue;
+    }
+
+    // Check for loss; base loss rate and fading close to sensitivity
+    uint16_t margin = signal - SENSITIVITY;
+    uint16_t loss = m_loss;
+    if (margin < FADE_MARGIN)
+      loss += ((FADE_MARGIN - margin) * 1000) / FADE_MARGIN;
+    if (random(1000) < loss) {
+      m_losses += 1;
+      continue;
+    }
+
+    // Append frame to receive queue and wakeup waiting node
+    if (dev->m_count == Driver::QUEUE_MAX) {
+      m_overruns += 1;
+      continue;
+    }
+    Driver::frame_t* fp = &dev->m_queue[dev->m_put];
+    if (++dev->m_put == Driver::QUEUE_MAX) dev->m_put = 0;
+    dev->m_count += 1;
+    fp->src = src->m_addr.device;
+    fp->dest = tp->dest;
+    fp->port = tp->port;
+    fp->len = tp->len;
+    fp->rssi = signal;
+    memcpy(fp->payload, tp->payload, tp->len);
+    if (dev->m_waiting != NULL) dev->m_waiting->m_wakeup = m_clock;
+    m_deliveries += 1;
+  }
+  tp->is_active = false;
+}
+
+void
+Medium::set_clock(uint64_t us)
+{
+  m_clock = us;
+  RTC::micros(us);
+  RTC::time(us / 1000000UL);
+}
+
+void
+Medium::wait(uint64_t us)
+{
+  Node* node = s_running;
+  if (node == NULL) return;
+  if (us == 0) us = 1;
+  node->m_wakeup = (us == UINT64_MAX) ? UINT64_MAX : m_clock + us;
+  swapcontext(&node->m_context, &m_scheduler);
+}
+
+void
+Medium::run(uint32_t ms)
+{
+  uint64_t end = m_clock + ms * 1000ULL;
+  set_clock(m_clock);
+  while (1) {
+    // Find time of next event; delivery or node wakeup
+    uint64_t next = UINT64_MAX;
+    for (uint8_t i = 0; i < TRANSMISSION_MAX; i++) {
+      transmission_t* tp = &m_transmission[i];
+      if (tp->is_active && tp->end + m_latency < next)
+	next = tp->end + m_latency;
+    }
+    for (uint8_t i = 0; i < m_nodes; i++)
+      if (m_node[i]->m_wakeup < next) next = m_node[i]->m_wakeup;
+    if (next > end) break;
+    if (next > m_clock) set_clock(next);
+
+    // Deliver transmissions in order of end time
+    while (1) {
+      transmission_t* tp = NULL;
+      for (uint8_t i = 0; i < TRANSMISSION_MAX; i++) {
+	transmission_t* op = &m_transmission[i];
+	if (!op->is_active || op->end + m_latency > m_clock) continue;
+	if (tp == NULL || op->end < tp->end) tp = op;
+      }
+      if (tp == NULL) break;
+      deliver(tp);
+    }
+
+    // Resume nodes in order
+    for (uint8_t i = 0; i < m_nodes; i++) {
+      Node* node = m_node[i];
+      if (node->m_wakeup > m_clock) continue;
+      s_running = node;
+      swapcontext(&m_scheduler, &node->m_context);
+      s_running = NULL;
+    }
+  }
+  set_clock(end);
+}
+
+void
+Medium::delay(uint32_t ms)
+{
+  if (s_running == NULL) return;
+  s_running->m_medium->wait(ms * 1000ULL);
+}
+
+void
+Medium::sleep(uint16_t s)
+{
+  delay(s * 1000UL);
+}
+
+void
+Medium::yield()
+{
+  if (s_running == NULL) return;
+  s_running->m_medium->wait(YIELD_US);
+}
+
+Medium::Driver::Driver(Medium* medium, int16_t network, uint8_t device,
+		       int16_t x, int16_t y) :
+  Wireless::Driver(network, device),
+  m_medium(medium),
+  m_index(medium->m_drivers),
+  m_x(x),
+  m_y(y),
+  m_power(0),
+  m_is_on(false),
+  m_put(0),
+  m_get(0),
+  m_count(0),
+  m_waiting(NULL),
+  m_rssi(0),
+  m_lqi(0),
+  m_sent(0),
+  m_received(0)
+{
+  if (medium->m_drivers < DRIVER_MAX)
+    medium->m_driver[medium->m_drivers++] = this;
+}
+
+bool
+Medium::Driver::begin(const void* config)
+{
+  UNUSED(config);
+  powerup();
+  return (m_index < DRIVER_MAX);
+}
+
+bool
+Medium::Driver::end()
+{
+  powerdown();
+  return (true);
+}
+
+int
+Medium::Driver::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  if (UNLIKELY(vec == NULL)) return (EINVAL);
+  size_t len = iovec_size(vec);
+  if (UNLIKELY(len > PAYLOAD_MAX)) return (EMSGSIZE);
+  powerup();
+
+  // Transmitter start delay
+  uint16_t jitter = m_medium->random(m_medium->m_jitter + 1);
+  if (jitter != 0) m_medium->wait(jitter);
+
+  // Back off while the channel is busy (carrier sense)
+  if (m_medium->m_carrier_sense) {
+    uint32_t slot = m_medium->airtime(len);
+    for (uint8_t retry = 0; retry < 8 && m_medium->is_busy(this); retry++)
+      m_medium->wait(1 + m_medium->random(slot));
+  }
+
+  // Transmit frame and wait for the air time
+  int32_t us = m_medium->transmit(this, dest, port, vec);
+  if (us < 0) return (us);
+  m_medium->wait(us);
+  m_sent += 1;
+  return (len);
+}
+
+int
+Medium::Driver::send(uint8_t dest, uint8_t port, const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (send(dest, port, vec));
+}
+
+int
+Medium::Driver::recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		     uint32_t ms)
+{
+  // Wait for frame or timeout
+  powerup();
+  uint64_t end = m_medium->m_clock + ms * 1000ULL;
+  while (m_count == 0) {
+    if (s_running == NULL) return (ETIME);
+    if (ms != 0 && m_medium->m_clock >= end) return (ETIME);
+    m_waiting = s_running;
+    m_medium->wait(ms != 0 ? end - m_medium->m_clock : UINT64_MAX);
+    m_waiting = NULL;
+  }
+
+  // Dequeue frame; signal strength and link quality
+  frame_t* fp = &m_queue[m_get];
+  if (++m_get == QUEUE_MAX) m_get = 0;
+  m_count -= 1;
+  if (fp->len > len) return (EMSGSIZE);
+  src = fp->src;
+  port = fp->port;
+  m_dest = fp->dest;
+  m_rssi = fp->rssi;
+  uint16_t margin = fp->rssi - SENSITIVITY;
+  m_lqi = (margin > 63) ? 255 : margin * 4;
+  memcpy(buf, fp->payload, fp->len);
+  m_received += 1;
+  return (fp->len);
+}
+
+Medium::Node::Node(Medium* medium) :
+  m_medium(medium),
+  m_stack((uint8_t*) malloc(COSA_MEDIUM_STACK_MAX)),
+  m_wakeup(0)
+{
+  if (medium->m_nodes < NODE_MAX)
+    medium->m_node[medium->m_nodes++] = this;
+  getcontext(&m_context);
+  m_context.uc_stack.ss_sp = m_stack;
+  m_context.uc_stack.ss_size = COSA_MEDIUM_STACK_MAX;
+  m_context.uc_link = NULL;
+  makecontext(&m_context, start, 0);
+}
+
+Medium::Node::~Node()
+{
+  free(m_stack);
+}
+
+void
+Medium::Node::start()
+{
+  Node* node = s_running;
+  node->setup();
+  while (1) node->loop();
+}
@@ -0,0 +1,566 @@
+/**
+ * @file Medium.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_MEDIUM_HH
+#define COSA_SIM_MEDIUM_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+
+#include <ucontext.h>
+
+#ifndef COSA_MEDIUM_DRIVER_MAX
+#define COSA_MEDIUM_DRIVER_MAX 64
+#endif
+
+#ifndef COSA_MEDIUM_NODE_MAX
+#define COSA_MEDIUM_NODE_MAX 64
+#endif
+
+#ifndef COSA_MEDIUM_TRANSMISSION_MAX
+#define COSA_MEDIUM_TRANSMISSION_MAX 64
+#endif
+
+#ifndef COSA_MEDIUM_QUEUE_MAX
+#define COSA_MEDIUM_QUEUE_MAX 4
+#endif
+
+#ifndef COSA_MEDIUM_STACK_MAX
+#define COSA_MEDIUM_STACK_MAX 0x10000
+#endif
+
+/**
+ * Simulated radio medium for the host (build/sim). Radio devices
+ * (Medium::Driver) are placed in a plane and share the medium. The
+ * received signal strength is given by the output power level and a
+ * log-distance path loss model. Frames are lost at random (base loss
+ * rate and fading close to the receiver sensitivity) and on
+ * collisions; overlapping transmissions on the same channel destroy
+ * each other at a receiver unless the signal is CAPTURE dB stronger.
+ * The air time is given by the bitrate and the frame size.
+ *
+ * Nodes (Medium::Node) are simulated sketches; each node runs its
+ * setup() and loop() on its own stack. The scheduler is a discrete
+ * event simulation; the clock (RTC::micros) is advanced to the next
+ * event when all nodes are waiting (receive, delay, yield). The
+ * simulation is deterministic for a given seed.
+ */
+class Medium {
+public:
+  /** Max number of radio devices. */
+  static const uint8_t DRIVER_MAX = COSA_MEDIUM_DRIVER_MAX;
+  static_assert(DRIVER_MAX <= 64, "DRIVER_MAX should be max 64");
+
+  /** Max number of simulated nodes. */
+  static const uint8_t NODE_MAX = COSA_MEDIUM_NODE_MAX;
+
+  /** Max number of transmissions in the air. */
+  static const uint8_t TRANSMISSION_MAX = COSA_MEDIUM_TRANSMISSION_MAX;
+
+  /** Max size of frame payload. */
+  static const size_t PAYLOAD_MAX = 64;
+
+  /** Frame overhead; preamble, sync, header and check sum (bytes). */
+  static const uint8_t FRAME_OVERHEAD = 10;
+
+  /** Receiver sensitivity (dBm). */
+  static const int8_t SENSITIVITY = -95;
+
+  /** Fading margin above the sensitivity with extra loss (dB). */
+  static const uint8_t FADE_MARGIN = 10;
+
+  /** Signal strength above interference for capture (dB). */
+  static const uint8_t CAPTURE = 10;
+
+  /** Path loss at 1 meter (dB). */
+  static const uint8_t PATH_LOSS_1M = 40;
+
+  /** Simulated time of yield (us). */
+  static const uint16_t YIELD_US = 100;
+
+  /**
+   * Construct radio medium with given bitrate, latency and seed for
+   * the pseudo-random number generator.
+   * @param[in] bitrate bits per second (default 250 Kbps).
+   * @param[in] latency propagation and processing delay in micro-
+   *   seconds (default 0).
+   * @param[in] seed random seed (default 1).
+   */
+  Medium(uint32_t bitrate = 250000L, uint16_t latency = 0, uint32_t seed = 1);
+
+  /**
+   * Set base frame loss rate in per mille.
+   * @param[in] permille loss rate (0..1000).
+   */
+  void set_loss(uint16_t permille)
+  {
+    m_loss = permille;
+  }
+
+  /**
+   * Set path loss exponent in tenths; 20 for free space, 30..40 for
+   * indoor. Default 30.
+   * @param[in] exponent path loss exponent times ten.
+   */
+  void set_path_loss(uint8_t exponent)
+  {
+    m_exponent = exponent;
+  }
+
+  /**
+   * Set max transmitter start delay in micro-seconds; radio wakeup
+   * and frame transfer to the device. The delay is pseudo-random
+   * (0..us) and breaks lock-step retransmissions. Default 500 us.
+   * @param[in] us max start delay.
+   */
+  void set_jitter(uint16_t us)
+  {
+    m_jitter = us;
+  }
+
+  /**
+   * Enable or disable carrier sense; transmitters back off while the
+   * channel is busy. Default disabled.
+   * @param[in] flag carrier sense.
+   */
+  void set_carrier_sense(bool flag)
+  {
+    m_carrier_sense = flag;
+  }
+
+  /**
+   * Return air time for frame with given payload size in micro-
+   * seconds.
+   * @param[in] len payload size.
+   * @return micro-seconds.
+   */
+  uint32_t airtime(size_t len) const
+  {
+    return (((len + FRAME_OVERHEAD) * CHARBITS * 1000000ULL) / m_bitrate);
+  }
+
+  /**
+   * Run the simulation for the given number of milli-seconds.
+   * @param[in] ms simulated time.
+   */
+  void run(uint32_t ms);
+
+  /**
+   * Return simulated time in micro-seconds since start.
+   * @return micro-seconds.
+   */
+  uint64_t clock() const
+  {
+    return (m_clock);
+  }
+
+  /** Statistics; number of transmissions. */
+  uint32_t get_transmissions() const { return (m_transmissions); }
+
+  /** Statistics; number of frames delivered to receivers. */
+  uint32_t get_deliveries() const { return (m_deliveries); }
+
+  /** Statistics; number of frames lost in collisions. */
+  uint32_t get_collisions() const { return (m_collisions); }
+
+  /** Statistics; number of frames lost at random or on fading. */
+  uint32_t get_losses() const { return (m_losses); }
+
+  /** Statistics; number of frames missed by powered down receivers. */
+  uint32_t get_misses() const { return (m_misses); }
+
+  /** Statistics; number of frames dropped on full receive queue. */
+  uint32_t get_overruns() const { return (m_overruns); }
+
+  /**
+   * Simulated delay of running node; the host delay function.
+   * @param[in] ms milli-seconds.
+   */
+  static void delay(uint32_t ms);
+
+  /**
+   * Simulated sleep of running node; the host sleep function.
+   * @param[in] s seconds.
+   */
+  static void sleep(uint16_t s);
+
+  /**
+   * Yield running node; the host yield function. Advances the clock
+   * YIELD_US for the node so that busy-wait loops progress.
+   */
+  static void yield();
+
+  /**
+   * Simulated radio device on the medium.
+   */
+  class Driver;
+
+  /**
+   * Simulated sketch; setup() and loop() on a node stack.
+   */
+  class Node;
+
+protected:
+  /** Transmission in the air. */
+  struct transmission_t {
+    bool is_active;		//!< Transmission slot in use.
+    uint8_t src;		//!< Transmitting device index.
+    uint8_t channel;		//!< Channel.
+    int16_t network;		//!< Network address.
+    uint8_t dest;		//!< Destination device address.
+    uint8_t port;		//!< Port.
+    uint8_t len;		//!< Payload size.
+    uint64_t start;		//!< Start of transmission.
+    uint64_t end;		//!< End of transmission.
+    uint64_t interferers;	//!< Overlapping transmitter set.
+    uint8_t payload[PAYLOAD_MAX]; //!< Payload.
+  };
+
+  /** Simulated clock (us). */
+  uint64_t m_clock;
+
+  /** Bitrate (bps). */
+  uint32_t m_bitrate;
+
+  /** Latency (us). */
+  uint16_t m_latency;
+
+  /** Max transmitter start delay (us). */
+  uint16_t m_jitter;
+
+  /** Base loss rate (per mille). */
+  uint16_t m_loss;
+
+  /** Path loss exponent (times ten). */
+  uint8_t m_exponent;
+
+  /** Carrier sense enabled. */
+  bool m_carrier_sense;
+
+  /** Pseudo-random number generator state. */
+  uint32_t m_seed;
+
+  /** Radio devices. */
+  Driver* m_driver[DRIVER_MAX];
+  uint8_t m_drivers;
+
+  /** Nodes. */
+  Node* m_node[NODE_MAX];
+  uint8_t m_nodes;
+
+  /** Transmissions in the air. */
+  transmission_t m_transmission[TRANSMISSION_MAX];
+
+  /** Statistics. */
+  uint32_t m_transmissions;
+  uint32_t m_deliveries;
+  uint32_t m_collisions;
+  uint32_t m_losses;
+  uint32_t m_misses;
+  uint32_t m_overruns;
+
+  /** Scheduler context. */
+  ucontext_t m_scheduler;
+
+  /** Running node or NULL(0). */
+  static Node* s_running;
+
+  /**
+   * Return pseudo-random number in the range 0..range-1.
+   * @param[in] range of number.
+   * @return number.
+   */
+  uint16_t random(uint16_t range);
+
+  /**
+   * Return signal strength (dBm) at given receiver from given
+   * transmitter.
+   * @param[in] src transmitting device.
+   * @param[in] dest receiving device.
+   * @return dBm.
+   */
+  int rssi(const Driver* src, const Driver* dest) const;
+
+  /**
+   * Return true(1) if the channel is busy at the given device
+   * otherwise false(0).
+   * @param[in] dev radio device.
+   * @return bool.
+   */
+  bool is_busy(const Driver* dev) const;
+
+  /**
+   * Start transmission of given frame from given device. Returns the
+   * air time in micro-seconds or negative error code; ENOSPC if there
+   * are too many transmissions in the air.
+   * @param[in] dev transmitting device.
+   * @param[in] dest destination device address.
+   * @param[in] port device port.
+   * @param[in] vec null terminated io vector.
+   * @return micro-seconds or negative error code.
+   */
+  int32_t transmit(Driver* dev, uint8_t dest, uint8_t port,
+		   const iovec_t* vec);
+
+  /**
+   * Deliver given transmission to receivers in range; check for
+   * collisions, loss and powered down receivers.
+   * @param[in] tp transmission.
+   */
+  void deliver(transmission_t* tp);
+
+  /**
+   * Wait given number of micro-seconds or until woken by a received
+   * frame. The running node is suspended and the scheduler resumed.
+   * @param[in] us micro-seconds (UINT64_MAX for wakeup only).
+   */
+  void wait(uint64_t us);
+
+  /**
+   * Set simulated clock; RTC time and micro-seconds.
+   * @param[in] us simulated time in micro-seconds.
+   */
+  void set_clock(uint64_t us);
+
+  friend class Driver;
+  friend class Node;
+};
+
+class Medium::Driver : public Wireless::Driver {
+public:
+  /**
+   * Construct simulated radio device on given medium with given
+   * network and device address, and position (meters).
+   * @param[in] medium radio medium.
+   * @param[in] network address.
+   * @param[in] device address.
+   * @param[in] x position (default 0).
+   * @param[in] y position (default 0).
+   */
+  Driver(Medium* medium, int16_t network, uint8_t device,
+	 int16_t x = 0, int16_t y = 0);
+
+  /**
+   * Set device position (meters).
+   * @param[in] x position.
+   * @param[in] y position.
+   */
+  void set_position(int16_t x, int16_t y)
+  {
+    m_x = x;
+    m_y = y;
+  }
+
+  /** Statistics; number of sent frames. */
+  uint32_t get_sent() const { return (m_sent); }
+
+  /** Statistics; number of received frames. */
+  uint32_t get_received() const { return (m_received); }
+
+  /**
+   * @override Wireless::Driver
+   * Start the device driver. Return true(1) if successful otherwise
+   * false(0).
+   * @param[in] config configuration vector (default NULL)
+   * @return bool.
+   */
+  virtual bool begin(const void* config = NULL);
+
+  /**
+   * @override Wireless::Driver
+   * Shutdown the device driver. Return true(1) if successful
+   * otherwise false(0).
+   * @return bool.
+   */
+  virtual bool end();
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power up mode; frames are received.
+   */
+  virtual void powerup()
+  {
+    m_is_on = true;
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power down mode; frames are missed.
+   */
+  virtual void powerdown()
+  {
+    m_is_on = false;
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if a message is available otherwise false(0).
+   * @return bool.
+   */
+  virtual bool available()
+  {
+    return (m_count != 0);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given null terminated io vector. The running
+   * node is suspended for the air time. Returns number of bytes sent
+   * or negative error code; EMSGSIZE if the message exceeds
+   * PAYLOAD_MAX.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given buffer, with given number of bytes. See
+   * send() with io vector above.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * @override Wireless::Driver
+   * Receive message and store into given buffer with given maximum
+   * length. The running node is suspended until a frame is received
+   * or the time out period. Returns the number of received bytes or
+   * negative error code; ETIME on timeout, EMSGSIZE if the message
+   * does not fit the buffer.
+   * @param[out] src source network address.
+   * @param[out] port device port (or message type).
+   * @param[in] buf buffer to store incoming message.
+   * @param[in] len maximum number of bytes to receive.
+   * @param[in] ms maximum time out period (Default blocking(0L)).
+   * @return number of bytes received or negative error code.
+   */
+  virtual int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		   uint32_t ms = 0L);
+
+  /**
+   * @override Wireless::Driver
+   * Set output power level in dBm.
+   * @param[in] dBm.
+   */
+  virtual void set_output_power_level(int8_t dBm)
+  {
+    m_power = dBm;
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return input power level (dBm) of latest received message.
+   */
+  virtual int get_input_power_level()
+  {
+    return (m_rssi);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return link quality indicator (0..255) of latest received
+   * message; signal margin above the sensitivity.
+   */
+  virtual int get_link_quality_indicator()
+  {
+    return (m_lqi);
+  }
+
+protected:
+  /** Received frame. */
+  struct frame_t {
+    uint8_t src;		//!< Source device address.
+    uint8_t dest;		//!< Destination device address.
+    uint8_t port;		//!< Port.
+    uint8_t len;		//!< Payload size.
+    int8_t rssi;		//!< Signal strength (dBm).
+    uint8_t payload[PAYLOAD_MAX]; //!< Payload.
+  };
+
+  /** Max number of received frames in queue. */
+  static const uint8_t QUEUE_MAX = COSA_MEDIUM_QUEUE_MAX;
+
+  Medium* m_medium;		//!< Radio medium.
+  uint8_t m_index;		//!< Device index on medium.
+  int16_t m_x;			//!< Position (meters).
+  int16_t m_y;			//!< Position (meters).
+  int8_t m_power;		//!< Output power level (dBm).
+  bool m_is_on;			//!< Receiver powered up.
+  frame_t m_queue[QUEUE_MAX];	//!< Receive queue.
+  uint8_t m_put;		//!< Receive queue put index.
+  uint8_t m_get;		//!< Receive queue get index.
+  uint8_t m_count;		//!< Number of frames in queue.
+  Node* m_waiting;		//!< Node waiting for frame.
+  int8_t m_rssi;		//!< Latest signal strength.
+  uint8_t m_lqi;		//!< Latest link quality indicator.
+  uint32_t m_sent;		//!< Number of sent frames.
+  uint32_t m_received;		//!< Number of received frames.
+
+  friend class Medium;
+};
+
+class Medium::Node {
+public:
+  /**
+   * Construct node on given medium. The node is started when the
+   * simulation is run.
+   * @param[in] medium radio medium.
+   */
+  Node(Medium* medium);
+
+  /**
+   * Release the node stack.
+   */
+  virtual ~Node();
+
+  /**
+   * @override Medium::Node
+   * Node setup; called once when the node is started. Default void.
+   */
+  virtual void setup() {}
+
+  /**
+   * @override Medium::Node
+   * Node loop; called repeatedly.
+   */
+  virtual void loop() = 0;
+
+protected:
+  Medium* m_medium;		//!< Radio medium.
+  ucontext_t m_context;		//!< Node context.
+  uint8_t* m_stack;		//!< Node stack.
+  uint64_t m_wakeup;		//!< Wakeup time (us).
+
+  /**
+   * Node start function; setup() and loop() forever.
+   */
+  static void start();
+
+  friend class Medium;
+};
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @file Cosa.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation customization of Cosa; declares the avr-libc
+ * number conversion functions which are not in the host standard
+ * library (see Host.cpp).
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_H
+#define COSA_H
+
+char* itoa(int value, char* buf, int radix);
+char* ltoa(long value, char* buf, int radix);
+char* utoa(unsigned int value, char* buf, int radix);
+char* ultoa(unsigned long value, char* buf, int radix);
+char* dtostrf(double value, signed char width, unsigned char prec, char* buf);
+
+#endif
@@ -0,0 +1,96 @@
+/**
+ * @file Cosa/Board/Host/Sim.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_BOARD_HOST_SIM_HH
+#define COSA_BOARD_HOST_SIM_HH
+
+/**
+ * Compiler warning on unused varable.
+ */
+#if !defined(UNUSED)
+#define UNUSED(x) (void) (x)
+#endif
+
+/**
+ * Cosa pin symbol definitions for the host simulation (build/sim).
+ * The host has no pins; the symbols are defined so that device
+ * driver declarations compile. Only hardware independent code, such
+ * as the wireless protocols over the simulated radio medium, may be
+ * used.
+ */
+class Board {
+private:
+  /**
+   * Do not allow instances. This is a static singleton; name space.
+   */
+  Board() {}
+
+public:
+  /**
+   * Initiate board ports. Default void.
+   */
+  static void init() {}
+
+  /**
+   * Digital pin symbols
+   */
+  enum DigitalPin {
+    D0 = 0,
+    D1,
+    D2,
+    D3,
+    D4,
+    D5,
+    D6,
+    D7,
+    D8,
+    D9,
+    D10,
+    D11,
+    D12,
+    D13,
+    LED = D13
+  } __attribute__((packed));
+
+  /**
+   * Analog pin symbols
+   */
+  enum AnalogPin {
+    A0 = 0
+  } __attribute__((packed));
+
+  /**
+   * PWM pin symbols
+   */
+  enum PWMPin {
+    PWM0 = 0
+  } __attribute__((packed));
+
+  /**
+   * Size of pin maps.
+   */
+  enum {
+    ANALOG_PIN_MAX = 1,
+    DIGITAL_PIN_MAX = 14,
+    PWM_PIN_MAX = 1
+  };
+};
+
+#endif
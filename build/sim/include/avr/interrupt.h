@@ -0,0 +1,31 @@
+/**
+ * @file avr/interrupt.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation replacement of the AVR interrupt control. The
+ * simulation is single threaded; interrupt control is void.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_AVR_INTERRUPT_H
+#define COSA_SIM_AVR_INTERRUPT_H
+
+inline void sei() {}
+inline void cli() {}
+
+#endif
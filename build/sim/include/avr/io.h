@@ -0,0 +1,38 @@
+/**
+ * @file avr/io.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation replacement of the AVR register definitions. There
+ * are no peripherals on the host; only the registers referenced by
+ * inline functions in the core headers are defined (see Host.cpp).
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_AVR_IO_H
+#define COSA_SIM_AVR_IO_H
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t ADCSRA;
+
+#define ADEN 7
+
+#endif
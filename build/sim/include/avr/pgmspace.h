@@ -0,0 +1,104 @@
+/**
+ * @file avr/pgmspace.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation replacement of the AVR program memory access. There
+ * is a single address space on the host; program memory functions
+ * are mapped to the standard library.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_AVR_PGMSPACE_H
+#define COSA_SIM_AVR_PGMSPACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) ((const char*) (s))
+
+#define pgm_read_byte(addr) (*(const uint8_t*) (addr))
+#define pgm_read_word(addr) (*(const uint16_t*) (addr))
+#define pgm_read_dword(addr) (*(const uint32_t*) (addr))
+#define pgm_read_float(addr) (*(const float*) (addr))
+#define pgm_read_ptr(addr) (*(void* const*) (addr))
+
+inline void* memcpy_P(void* dest, const void* src, size_t n)
+{
+  return (memcpy(dest, src, n));
+}
+
+inline int memcmp_P(const void* s1, const void* s2, size_t n)
+{
+  return (memcmp(s1, s2, n));
+}
+
+inline char* strcat_P(char* s1, const char* s2)
+{
+  return (strcat(s1, s2));
+}
+
+inline const char* strchr_P(const char* s, int c)
+{
+  return (strchr(s, c));
+}
+
+inline const char* strchrnul_P(const char* s, int c)
+{
+  return (strchrnul(s, c));
+}
+
+inline int strcmp_P(const char* s1, const char* s2)
+{
+  return (strcmp(s1, s2));
+}
+
+inline char* strcpy_P(char* s1, const char* s2)
+{
+  return (strcpy(s1, s2));
+}
+
+inline int strcasecmp_P(const char* s1, const char* s2)
+{
+  return (strcasecmp(s1, s2));
+}
+
+inline char* strcasestr_P(const char* s1, const char* s2)
+{
+  return ((char*) strcasestr(s1, s2));
+}
+
+inline size_t strlen_P(const char* s)
+{
+  return (strlen(s));
+}
+
+inline int strncmp_P(const char* s1, const char* s2, size_t n)
+{
+  return (strncmp(s1, s2, n));
+}
+
+inline char* strncpy_P(char* s1, const char* s2, size_t n)
+{
+  return (strncpy(s1, s2, n));
+}
+
+#endif
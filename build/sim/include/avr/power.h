@@ -0,0 +1,37 @@
+/**
+ * @file avr/power.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation replacement of the AVR power reduction. Only the
+ * modules that the core headers require are defined.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_AVR_POWER_H
+#define COSA_SIM_AVR_POWER_H
+
+#define power_all_enable()
+#define power_all_disable()
+#define power_adc_enable()
+#define power_adc_disable()
+#define power_timer0_enable()
+#define power_timer0_disable()
+#define power_timer1_enable()
+#define power_timer1_disable()
+
+#endif
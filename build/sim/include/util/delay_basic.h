@@ -0,0 +1,31 @@
+/**
+ * @file util/delay_basic.h
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Host simulation replacement of the AVR busy-wait loops. Busy-wait
+ * is void; delays are simulated by the scheduler (see Medium.hh).
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_SIM_UTIL_DELAY_BASIC_H
+#define COSA_SIM_UTIL_DELAY_BASIC_H
+
+#define _delay_loop_1(count)
+#define _delay_loop_2(count)
+
+#endif
@@ -29,7 +29,9 @@
  * Cosa Activity Handler; the activity run function is called when the
  * activity start time is reached. The function is called with a given
  * run period through the activity duration. The activity is rescheduled
- * with a period.
+ * with a period. The activity is scheduled with an Alarm and is
+ * driven by the Alarm::Scheduler or, with an external real-time
+ * clock, by Alarm::await() which powers down between the runs.
  *
  * @sections Examples
  * 1. Starting at 10:00 schedule the activity every hour. Run every
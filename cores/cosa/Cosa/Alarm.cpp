@@ -26,10 +26,10 @@ uint32_t Alarm::s_ticks;
 Head Alarm::s_queue;
 
 void
-Alarm::tick()
+Alarm::tick(clock_t now)
 {
   Alarm* alarm;
-  s_ticks += 1;
+  s_ticks = now;
 
   // Check for alarms that should be run
   while ((alarm = (Alarm*) s_queue.get_succ()) != (Alarm*) &s_queue) {
@@ -58,6 +58,58 @@ Alarm::enable()
   alarm->attach(this);
 }
 
+bool
+Alarm::get_next(clock_t& when)
+{
+  Alarm* alarm = (Alarm*) s_queue.get_succ();
+  if (alarm == (Alarm*) &s_queue) return (false);
+  when = alarm->m_when;
+  return (true);
+}
+
+int
+Alarm::await(Clock& clock, uint8_t mode)
+{
+  clock_t now;
+  clock_t when;
+
+  // Synchronize with the clock and run expired alarm handlers
+  if (!clock.get_time(now)) return (EIO);
+  tick(now);
+
+  // Hand the next alarm to the clock. Check that the alarm time was
+  // not passed while setting the alarm; it would not trigger. Clear
+  // the clock alarm when there are no alarms; the triggered state of
+  // the last alarm would otherwise prevent sleep
+  if (get_next(when)) {
+    if (!clock.set_alarm(when)) return (EIO);
+    if (!clock.get_time(now)) return (EIO);
+    if ((int32_t) (when - now) <= 0) {
+      tick(now);
+      return (0);
+    }
+  }
+  else if (!clock.clear_alarm()) return (EIO);
+
+  // Power down until the alarm, or any other, interrupt. Interrupts
+  // are enabled by the instruction before sleep so that an alarm
+  // interrupt after the check will wake up the processor
+  cli();
+  if (!clock.is_triggered()) {
+    set_sleep_mode(mode);
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+  }
+  sei();
+
+  // Catch up with the clock; run all the alarms that have expired
+  if (!clock.get_time(now)) return (EIO);
+  tick(now);
+  return (0);
+}
+
 void
 Alarm::Scheduler::run()
 {
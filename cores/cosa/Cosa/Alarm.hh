@@ -29,7 +29,9 @@
 /**
  * Cosa Alarm handler; Allows one-shot or periodic activities to be
  * schedule with a seconds level resolution. Requires Watchdog with
- * timeout events and RTC for more accurate time-keeping.
+ * timeout events and RTC for more accurate time-keeping, or an
+ * external real-time clock with alarm interrupt (Alarm::Clock) and
+ * Alarm::await() to power down between alarms.
  */
 class Alarm : private Link {
 public:
@@ -72,7 +74,26 @@ public:
    * called by a RTC callback. The default scheduler is based on the
    * Watchdog and Periodic timeout events.
    */
-  static void tick();
+  static void tick()
+  {
+    tick(s_ticks + 1);
+  }
+
+  /**
+   * Set alarm manager ticks (seconds) counter to the given time and
+   * execute all alarm handlers that have expired in one step. Used
+   * to catch up after the processor has been powered down.
+   * @param[in] now current time in seconds.
+   */
+  static void tick(clock_t now);
+
+  /**
+   * Get the time of the next alarm in the schedule. Return true(1)
+   * if an alarm is scheduled otherwise false(0).
+   * @param[out] when time of next alarm in seconds.
+   * @return boolean.
+   */
+  static bool get_next(clock_t& when);
 
   /**
    * Set alarm handler next timeout to the given number of seconds
@@ -183,6 +204,77 @@ public:
     uint32_t m_seconds;
   };
 
+  /**
+   * External real-time clock with alarm interrupt; DS3231, MCP7940N,
+   * etc. The clock is the time base of the alarm manager and the
+   * alarm interrupt wakes the processor from power down at the next
+   * alarm. See Alarm::await().
+   */
+  class Clock {
+  public:
+    /**
+     * @override Alarm::Clock
+     * Read current time in seconds from the clock. Return true(1) if
+     * successful otherwise false(0).
+     * @param[out] now current time in seconds.
+     * @return boolean.
+     */
+    virtual bool get_time(clock_t& now) = 0;
+
+    /**
+     * @override Alarm::Clock
+     * Set the clock alarm to the given time, clear any pending alarm
+     * and enable the alarm interrupt. Return true(1) if successful
+     * otherwise false(0).
+     * @param[in] when alarm time in seconds.
+     * @return boolean.
+     */
+    virtual bool set_alarm(clock_t when) = 0;
+
+    /**
+     * @override Alarm::Clock
+     * Disable the clock alarm and interrupt, and clear any pending
+     * alarm. Called when there are no scheduled alarms. Return true(1)
+     * if successful otherwise false(0).
+     * @return boolean.
+     */
+    virtual bool clear_alarm() = 0;
+
+    /**
+     * @override Alarm::Clock
+     * Return true(1) if the alarm interrupt has been received since
+     * the alarm was set otherwise false(0). Called with interrupts
+     * disabled.
+     * @return boolean.
+     */
+    virtual bool is_triggered() = 0;
+  };
+
+  /**
+   * Synchronize the alarm manager time with the given clock and run
+   * expired alarm handlers. Hand the next alarm to the clock and put
+   * the processor in the given sleep mode until the alarm, or any
+   * other, interrupt. The clock alarm is cleared when there are no
+   * scheduled alarms. Catch up with the clock and run the expired
+   * alarm handlers on wake up. Return zero if successful otherwise
+   * negative error code(EIO) if the clock could not be accessed.
+   * Watchdog and Alarm::Scheduler should not be used as the
+   * Watchdog would wake up the processor every timeout.
+   * @code
+   *   DS3231 rtc;
+   *   DS3231::AlarmClock clock(&rtc);
+   *   ...
+   *   void loop()
+   *   {
+   *     Alarm::await(clock);
+   *   }
+   * @endcode
+   * @param[in] clock external real-time clock.
+   * @param[in] mode sleep mode (Default SLEEP_MODE_PWR_DOWN).
+   * @return zero or negative error code.
+   */
+  static int await(Clock& clock, uint8_t mode = SLEEP_MODE_PWR_DOWN);
+
 private:
   static clock_t s_ticks;	//!< Current time in seconds.
   static Head s_queue;		//!< Alarm handler queue.
@@ -108,6 +108,10 @@
 #elif defined(WICKEDDEVICE_WILDFIRE)
 #include "Cosa/Board/WickedDevice/WildFire.hh"
 
+// Host simulation (build/sim)
+#elif defined(COSA_SIM)
+#include "Cosa/Board/Host/Sim.hh"
+
 #else
 #error "Cosa/Board.hh: board not supported"
 #endif
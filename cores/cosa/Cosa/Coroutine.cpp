@@ -0,0 +1,94 @@
+/**
+ * @file Cosa/Coroutine.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Coroutine.hh"
+
+bool
+Coroutine::begin()
+{
+  if ((m_state != INITIATED) && (m_state != TERMINATED)) return (false);
+  m_ip = 0;
+  await(Event::RUN_TYPE);
+  if (Event::push(Event::RUN_TYPE, this)) return (true);
+  m_state = TERMINATED;
+  return (false);
+}
+
+void
+Coroutine::await(uint8_t type, uint16_t ms)
+{
+  // A zero timeout period is a yield; resumed by an event to itself.
+  // Wait for the next tick if the event queue is full
+  if ((type == Event::TIMEOUT_TYPE) && (ms == 0)) {
+    m_await = Event::RUN_TYPE;
+    m_state = AWAITING;
+    if (Event::push(Event::RUN_TYPE, this)) return;
+    ms = 1;
+  }
+  m_await = type;
+  if (ms == 0) {
+    m_state = AWAITING;
+    return;
+  }
+  m_state = TIMING;
+  m_expires = Watchdog::millis() + ms;
+
+  // Fall back to the rounded period if there are no free deadlines;
+  // early timeouts are filtered by the deadline check in on_event()
+  if (Watchdog::schedule(this, m_expires) < 0) Watchdog::attach(this, ms);
+}
+
+void
+Coroutine::cancel()
+{
+  if (m_state == TIMING) Watchdog::cancel(this);
+  if ((m_state == TIMING) || (m_state == POLLING)) detach();
+}
+
+void
+Coroutine::on_event(uint8_t type, uint16_t value)
+{
+  // Filter events; awaited event, timeout or condition check
+  switch (m_state) {
+  case TIMING:
+    if (type == Event::TIMEOUT_TYPE) {
+      // Ignore timeout of a previous await (already in event queue)
+      if ((int32_t) (Watchdog::millis() - m_expires) < 0) return;
+      break;
+    }
+    // Fall through
+  case AWAITING:
+    if ((m_await != Event::NULL_TYPE) && (type != m_await)) return;
+    break;
+  case POLLING:
+    if (type != Event::TIMEOUT_TYPE) return;
+    break;
+  default:
+    return;
+  }
+
+  // Resume the coroutine body with the event
+  cancel();
+  m_type = type;
+  m_value = value;
+  m_state = RUNNING;
+  run();
+  if (m_state == RUNNING) m_state = TERMINATED;
+}
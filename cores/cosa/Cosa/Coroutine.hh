@@ -0,0 +1,293 @@
+/**
+ * @file Cosa/Coroutine.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_COROUTINE_HH
+#define COSA_COROUTINE_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Event.hh"
+#include "Cosa/Linkage.hh"
+#include "Cosa/Watchdog.hh"
+
+/**
+ * Cosa stackless coroutines; an event handler with a resumable body
+ * function, run(). The coroutine is suspended on await and resumed
+ * by the event dispatch (Event::service() or the event loop) when
+ * the awaited event, timeout or condition occurs. There is no stack
+ * per coroutine; variables that should be kept over an await must be
+ * member variables of the sub-class, i.e., the coroutine frame. The
+ * size of a coroutine is 17 bytes (virtual table pointer, Link,
+ * continuation, state, awaited event, resume event and deadline).
+ *
+ * Awaitables are:
+ * 1. Events; COROUTINE_AWAIT_EVENT(type, ms) with optional timeout.
+ * Asynchronous device drivers push completion events to the
+ * coroutine when it is given as the event target; TWI (begin(dev,
+ * this), READ_COMPLETED_TYPE and WRITE_COMPLETED_TYPE), sockets
+ * (set_event_handler(this), RECEIVE_COMPLETED_TYPE, etc), pins and
+ * other coroutines (Event::push()).
+ * 2. Timeouts; COROUTINE_DELAY(ms). The deadline is exact to the
+ * watchdog tick (Watchdog::schedule()).
+ * 3. Conditions; COROUTINE_AWAIT(condition). The condition is
+ * checked on each watchdog tick, e.g., Queue availability or socket
+ * without interrupt pin.
+ *
+ * @section Limitations
+ * The coroutine macro set should only be used within the run()
+ * function. Events that are not awaited are ignored. The number of
+ * concurrent timeouts is limited by COSA_WATCHDOG_DEADLINE_MAX.
+ * Conditions require the watchdog handler push_timeout_events().
+ *
+ * @section Acknowledgements
+ * Inspired by C++20 coroutines and the Cosa ProtoThread.
+ */
+class Coroutine : public Link {
+public:
+  /**
+   * Coroutine states.
+   */
+  enum {
+    INITIATED = 0,		//!< Constructor.
+    AWAITING,			//!< Waiting for event.
+    TIMING,			//!< Waiting for event or timeout.
+    POLLING,			//!< Waiting for condition.
+    RUNNING,			//!< Resumed and running.
+    TERMINATED = 0xff		//!< Ended.
+  } __attribute__((packed));
+
+  /**
+   * Construct coroutine, initiate state and continuation. Does not
+   * start the coroutine. This is done with begin().
+   */
+  Coroutine() :
+    Link(),
+    m_ip(0),
+    m_state(INITIATED),
+    m_await(Event::NULL_TYPE),
+    m_type(Event::NULL_TYPE),
+    m_value(0),
+    m_expires(0)
+  {}
+
+  /**
+   * Start the coroutine. The body is run from the beginning by the
+   * event dispatch. A terminated coroutine may be restarted. Returns
+   * false if running or the event could not be pushed.
+   * @return bool.
+   */
+  bool begin();
+
+  /**
+   * End the coroutine; cancel timeout and condition check. Use
+   * COROUTINE_END() in the body.
+   */
+  void end()
+  {
+    cancel();
+    m_state = TERMINATED;
+  }
+
+  /**
+   * Get current coroutine state.
+   * @return state.
+   */
+  uint8_t get_state() const
+  {
+    return (m_state);
+  }
+
+  /**
+   * Get type of the event that resumed the coroutine.
+   * @return event type.
+   */
+  uint8_t get_type() const
+  {
+    return (m_type);
+  }
+
+  /**
+   * Get value of the event that resumed the coroutine.
+   * @return event value.
+   */
+  uint16_t get_value() const
+  {
+    return (m_value);
+  }
+
+  /**
+   * Get value of the event that resumed the coroutine as a pointer
+   * of given type.
+   * @return pointer.
+   */
+  template<typename T>
+  T* get_env() const
+  {
+    return ((T*) m_value);
+  }
+
+  /**
+   * Check if the coroutine was resumed by timeout.
+   * @return bool.
+   */
+  bool is_timeout() const
+  {
+    return (m_type == Event::TIMEOUT_TYPE);
+  }
+
+  /**
+   * @override Coroutine
+   * Coroutine body. Must be overridden. Use the coroutine macro set
+   * in the following format:
+   * {
+   *   COROUTINE_BEGIN();
+   *   while (1) {
+   *     ...
+   *     COROUTINE_AWAIT_EVENT(Event::READ_COMPLETED_TYPE, 100);
+   *     if (is_timeout()) ...
+   *     ...
+   *   }
+   *   COROUTINE_END();
+   * }
+   * Additional macros are COROUTINE_YIELD(), COROUTINE_AWAIT() and
+   * COROUTINE_DELAY().
+   */
+  virtual void run() = 0;
+
+protected:
+  void* m_ip;
+  uint8_t m_state;
+  uint8_t m_await;
+  uint8_t m_type;
+  uint16_t m_value;
+  uint32_t m_expires;
+
+  /**
+   * Suspend until an event of the given type (Event::NULL_TYPE for
+   * any event), or timeout if the given period is non-zero. A timeout
+   * await with zero period yields. Used by the coroutine macro set.
+   * @param[in] type of event to await.
+   * @param[in] ms timeout period (default no timeout).
+   */
+  void await(uint8_t type, uint16_t ms = 0);
+
+  /**
+   * Suspend until the next watchdog tick to recheck a condition. Used
+   * by the coroutine macro set.
+   */
+  void poll()
+  {
+    m_state = POLLING;
+    Watchdog::attach(this, Watchdog::ms_per_tick());
+  }
+
+  /**
+   * Cancel timeout and condition check.
+   */
+  void cancel();
+
+  /**
+   * @override Event::Handler
+   * Filter events; resume the coroutine body on the awaited event,
+   * timeout or condition check.
+   * @param[in] type the type of event.
+   * @param[in] value the event value.
+   */
+  virtual void on_event(uint8_t type, uint16_t value);
+};
+
+/**
+ * First statement in the coroutine body, run(). Last statement
+ * should be COROUTINE_END();
+ */
+#define COROUTINE_BEGIN()				\
+  if (m_ip != 0) goto *m_ip
+
+/**
+ * Yield to other event handlers. The coroutine is resumed by an
+ * event to itself.
+ */
+#define COROUTINE_YIELD()				\
+  do {							\
+    __label__ next;					\
+    m_ip = &&next;					\
+    await(Event::RUN_TYPE);				\
+    Event::push(Event::RUN_TYPE, this);			\
+    return;						\
+  next: ;						\
+  } while (0)
+
+/**
+ * Suspend until an event of the given type, or timeout if the given
+ * period (milli-seconds) is non-zero. Use is_timeout() to check for
+ * timeout and get_value() or get_env() for the event value.
+ * @param[in] type of event to await (Event::NULL_TYPE for any).
+ * @param[in] ms timeout period (zero for no timeout).
+ */
+#define COROUTINE_AWAIT_EVENT(type,ms)			\
+  do {							\
+    __label__ next;					\
+    m_ip = &&next;					\
+    await(type, ms);					\
+    return;						\
+  next: ;						\
+  } while (0)
+
+/**
+ * Check if the given condition is true(1). If not the coroutine is
+ * suspended and the condition is rechecked on the next watchdog
+ * tick.
+ * @param[in] condition to evaluate.
+ */
+#define COROUTINE_AWAIT(condition)			\
+  do {							\
+    __label__ next;					\
+  next:							\
+    if (!(condition)) {					\
+      m_ip = &&next;					\
+      poll();						\
+      return;						\
+    }							\
+  } while (0)
+
+/**
+ * Delay the coroutine for the given ms time period. A zero period
+ * yields to other event handlers.
+ * @param[in] ms milli-seconds to delay.
+ */
+#define COROUTINE_DELAY(ms)				\
+  do {							\
+    __label__ next;					\
+    m_ip = &&next;					\
+    await(Event::TIMEOUT_TYPE, ms);			\
+    return;						\
+  next: ;						\
+  } while (0)
+
+/**
+ * Mark the coroutine as TERMINATED. Should be the last statement in
+ * the coroutine body.
+ */
+#define COROUTINE_END()					\
+  do {							\
+    Coroutine::end();					\
+    return;						\
+  } while (0)
+
+#endif
@@ -140,13 +140,19 @@ public:
 
   /**
    * Set timer for time out events and possible state transitions.
+   * The timeout period is rounded to a power of two watchdog ticks
+   * unless exact; then the timeout is on the first tick at or after
+   * the given period (Watchdog::schedule()). Falls back to the
+   * rounded period if there are no free deadlines.
    * @param[in] ms timeout period.
+   * @param[in] exact timeout period (default false).
    */
-  void set_timer(uint16_t ms)
+  void set_timer(uint16_t ms, bool exact = false)
     __attribute__((always_inline))
   {
     m_period = TIMEOUT_REQUEST;
-    Watchdog::attach(this, ms);
+    if (!exact || (Watchdog::schedule(this, Watchdog::millis() + ms) < 0))
+      Watchdog::attach(this, ms);
   }
 
   /**
@@ -157,6 +163,7 @@ public:
     __attribute__((always_inline))
   {
     if (m_period == 0) return;
+    if (m_period == TIMEOUT_REQUEST) Watchdog::cancel(this);
     detach();
     m_period = 0;
   }
@@ -0,0 +1,143 @@
+/**
+ * @file Cosa/HSM.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/HSM.hh"
+
+void
+HSM::get(uint8_t state, state_t& decl) const
+{
+  const state_t* states;
+  memcpy_P(&states, &m_table->states, sizeof(states));
+  memcpy_P(&decl, &states[state], sizeof(decl));
+}
+
+bool
+HSM::is_in_state(uint8_t state) const
+{
+  uint8_t current = m_state;
+  while (current != NONE) {
+    if (current == state) return (true);
+    state_t decl;
+    get(current, decl);
+    current = decl.parent;
+  }
+  return (false);
+}
+
+void
+HSM::enter(uint8_t from, uint8_t to)
+{
+  if (to == from) return;
+  state_t decl;
+  get(to, decl);
+  enter(from, decl.parent);
+  m_state = to;
+  if (decl.entry != NULL) decl.entry(this);
+}
+
+bool
+HSM::begin()
+{
+  if (m_state != NONE) return (false);
+
+  // Enter the initial state and its initial sub-states
+  uint8_t state = 0;
+  state_t decl;
+  do {
+    enter(m_state, state);
+    get(state, decl);
+    state = decl.init;
+  } while (state != NONE);
+  return (true);
+}
+
+void
+HSM::end()
+{
+  // Exit the current state and all its super-states
+  cancel_timer();
+  while (m_state != NONE) {
+    state_t decl;
+    get(m_state, decl);
+    if (decl.exit != NULL) decl.exit(this);
+    m_state = decl.parent;
+  }
+}
+
+void
+HSM::on_event(uint8_t type, uint16_t value)
+{
+  if (m_state == NONE) return;
+
+  // Map event type to event index
+  table_t table;
+  memcpy_P(&table, m_table, sizeof(table));
+  uint8_t event;
+  if (type == Event::TIMEOUT_TYPE) {
+    // Ignore timeout of a previous timer (already in event queue)
+    if (!m_timer) return;
+    if ((int32_t) (Watchdog::millis() - m_expires) < 0) return;
+    cancel_timer();
+    event = table.timeout;
+  }
+  else event = type - Event::USER_TYPE;
+  if (event >= table.event_max) return;
+
+  // Lookup transition for the current state
+  uint8_t ix = pgm_read_byte(&table.lookup[m_state * table.event_max + event]);
+  if (ix == NONE) return;
+  transition_t transition;
+  memcpy_P(&transition, &table.transitions[ix], sizeof(transition));
+  m_param = value;
+
+  // Internal transition; action only
+  if (transition.target == NONE) {
+    if (transition.action != NULL) transition.action(this);
+    return;
+  }
+
+  // Find the closest super-state of the target that is the current
+  // state or a super-state of the current state
+  state_t decl;
+  get(transition.target, decl);
+  uint8_t top = decl.parent;
+  while ((top != NONE) && !is_in_state(top)) {
+    get(top, decl);
+    top = decl.parent;
+  }
+
+  // Exit the current states up to the common super-state
+  cancel_timer();
+  while (m_state != top) {
+    get(m_state, decl);
+    if (decl.exit != NULL) decl.exit(this);
+    m_state = decl.parent;
+  }
+
+  // Transition action and enter the target state and its initial
+  // sub-states
+  if (transition.action != NULL) transition.action(this);
+  uint8_t state = transition.target;
+  do {
+    enter(m_state, state);
+    get(state, decl);
+    state = decl.init;
+  } while (state != NONE);
+}
@@ -0,0 +1,426 @@
+/**
+ * @file Cosa/HSM.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_HSM_HH
+#define COSA_HSM_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Event.hh"
+#include "Cosa/Linkage.hh"
+#include "Cosa/Watchdog.hh"
+
+/**
+ * Hierarchical State Machine support class. The machine is declared
+ * as tables of states and transitions (constexpr) in a definition
+ * class. The tables are copied to program memory at compile time
+ * together with a transition lookup table where each state also has
+ * the transitions of its super-states. The transition for an event
+ * is found in constant time. Events are processed one at a time to
+ * completion; events sent in actions are queued. Timeout events are
+ * requested with set_timer() as for the FSM class.
+ *
+ * A definition class has the following members:
+ * @code
+ * struct Connection {
+ *   enum { DISCONNECTED, CONNECTED, IDLE, BUSY, STATE_MAX };
+ *   enum { CONNECT, DISCONNECT, REQUEST, TIMEOUT, EVENT_MAX };
+ *   static constexpr HSM::state_t states[STATE_MAX] = {
+ *     // parent, initial sub-state, entry and exit action
+ *     { HSM::NONE, HSM::NONE, NULL, NULL },
+ *     { HSM::NONE, IDLE, on_connect, on_disconnect },
+ *     { CONNECTED, HSM::NONE, NULL, NULL },
+ *     { CONNECTED, HSM::NONE, on_busy, NULL }
+ *   };
+ *   static constexpr HSM::transition_t transitions[] = {
+ *     // source, event, target and action
+ *     { DISCONNECTED, CONNECT, CONNECTED, NULL },
+ *     { CONNECTED, DISCONNECT, DISCONNECTED, NULL },
+ *     { IDLE, REQUEST, BUSY, NULL },
+ *     { BUSY, TIMEOUT, IDLE, on_done },
+ *     { BUSY, REQUEST, HSM::NONE, on_queue }
+ *   };
+ * };
+ * HSM connection(HSM::Table<Connection>::get());
+ * @endcode
+ * The first state is the initial state. A transition from a super-
+ * state applies to all its sub-states. A transition without target
+ * state is internal; only the action is called. Otherwise the states
+ * are exited up to the common super-state of the current and the
+ * target state (a transition to the current state or a super-state is
+ * external; the state is exited and entered), then the transition
+ * action is called, and the states are entered down to the target
+ * state and its initial sub-states. Event TIMEOUT is the index of
+ * the timeout event (EVENT_MAX if not used). Pending timeouts are
+ * cancelled on state change.
+ *
+ * @section Limitations
+ * Max 254 states and transitions (NONE is 255). The lookup table is
+ * STATE_MAX * EVENT_MAX bytes of program memory.
+ *
+ * @section Acknowledgements
+ * The design of HSM is inspired by UML-2 State Machines and QP by
+ * Miro Samek.
+ */
+class HSM : public Link {
+public:
+  /**
+   * State and transition action function prototype.
+   * @param[in] hsm hierarchical state machine.
+   */
+  typedef void (*Action)(HSM* hsm);
+
+  /** No state or transition. */
+  static const uint8_t NONE = 0xff;
+
+  /**
+   * State declaration; super-state, initial sub-state (NONE for leaf
+   * states), entry and exit action (or NULL).
+   */
+  struct state_t {
+    uint8_t parent;
+    uint8_t init;
+    Action entry;
+    Action exit;
+  };
+
+  /**
+   * Transition declaration; source state, event, target state (NONE
+   * for internal transition) and action (or NULL).
+   */
+  struct transition_t {
+    uint8_t source;
+    uint8_t event;
+    uint8_t target;
+    Action action;
+  };
+
+  /**
+   * Machine tables in program memory.
+   */
+  struct table_t {
+    const state_t* states;
+    const transition_t* transitions;
+    const uint8_t* lookup;
+    uint8_t event_max;
+    uint8_t timeout;
+  };
+
+  /**
+   * Compile time index sequence. Generated by splitting and
+   * concatenating so that the template instantiation depth is
+   * logarithmic in the length.
+   */
+  template<uint16_t... I> struct Indices {};
+  template<typename A, typename B> struct Concat;
+  template<uint16_t... I, uint16_t... J>
+  struct Concat<Indices<I...>, Indices<J...> > {
+    typedef Indices<I..., (sizeof...(I) + J)...> type;
+  };
+  template<uint16_t N, uint8_t K = (N < 2 ? N : 2)>
+  struct Sequence :
+    Concat<typename Sequence<N / 2>::type,
+	   typename Sequence<N - N / 2>::type> {};
+  template<uint16_t N>
+  struct Sequence<N, 0> { typedef Indices<> type; };
+  template<uint16_t N>
+  struct Sequence<N, 1> { typedef Indices<0> type; };
+
+  /**
+   * Number of transitions in given machine definition.
+   */
+  template<typename M>
+  struct Transitions {
+    static const uint16_t MAX = sizeof(M::transitions) / sizeof(transition_t);
+  };
+
+  /**
+   * Return index of the transition from the given state on the given
+   * event, or NONE. Evaluated at compile time.
+   * @param[in] state source state.
+   * @param[in] event index.
+   * @param[in] ix transition index to start search.
+   * @return transition index or NONE.
+   */
+  template<typename M>
+  static constexpr uint8_t find(uint8_t state, uint8_t event, uint16_t ix = 0)
+  {
+    return (ix == Transitions<M>::MAX ? NONE :
+	    ((M::transitions[ix].source == state) &&
+	     (M::transitions[ix].event == event)) ? (uint8_t) ix :
+	    find<M>(state, event, ix + 1));
+  }
+
+  /**
+   * Return index of the transition for the given state or the
+   * closest super-state on the given event, or NONE. Evaluated at
+   * compile time.
+   * @param[in] state current state.
+   * @param[in] event index.
+   * @return transition index or NONE.
+   */
+  template<typename M>
+  static constexpr uint8_t lookup(uint8_t state, uint8_t event)
+  {
+    return (state == NONE ? NONE :
+	    find<M>(state, event) != NONE ? find<M>(state, event) :
+	    lookup<M>(M::states[state].parent, event));
+  }
+
+  /**
+   * Return true if the super-state and initial sub-state indices of
+   * the given state and the following states are valid; the initial
+   * sub-state must be a child of the state. Evaluated at compile time.
+   * @param[in] state index to start check.
+   * @return bool.
+   */
+  template<typename M>
+  static constexpr bool is_valid_state(uint16_t state = 0)
+  {
+    return (state == M::STATE_MAX ? true :
+	    ((M::states[state].parent == NONE) ||
+	     (M::states[state].parent < M::STATE_MAX)) &&
+	    ((M::states[state].init == NONE) ||
+	     ((M::states[state].init < M::STATE_MAX) &&
+	      (M::states[M::states[state].init].parent == state))) &&
+	    is_valid_state<M>(state + 1));
+  }
+
+  /**
+   * Return true if the source and target state indices of the given
+   * transition and the following transitions are valid. Evaluated at
+   * compile time.
+   * @param[in] ix transition index to start check.
+   * @return bool.
+   */
+  template<typename M>
+  static constexpr bool is_valid_transition(uint16_t ix = 0)
+  {
+    return (ix == Transitions<M>::MAX ? true :
+	    (M::transitions[ix].source < M::STATE_MAX) &&
+	    ((M::transitions[ix].target == NONE) ||
+	     (M::transitions[ix].target < M::STATE_MAX)) &&
+	    is_valid_transition<M>(ix + 1));
+  }
+
+  /**
+   * Return true if the state and transition tables of the given
+   * machine definition are valid. Evaluated at compile time.
+   * @return bool.
+   */
+  template<typename M>
+  static constexpr bool is_valid()
+  {
+    return (is_valid_state<M>() && is_valid_transition<M>());
+  }
+
+  /**
+   * Machine tables in program memory for the given definition class.
+   * Generated at compile time. The tables are checked.
+   */
+  template<typename M,
+	   typename S = typename Sequence<M::STATE_MAX>::type,
+	   typename T = typename Sequence<Transitions<M>::MAX>::type,
+	   typename L = typename Sequence<M::STATE_MAX * M::EVENT_MAX>::type>
+  class Table;
+
+  template<typename M, uint16_t... S, uint16_t... T, uint16_t... L>
+  class Table<M, Indices<S...>, Indices<T...>, Indices<L...> > {
+  public:
+    /**
+     * Return machine tables in program memory.
+     * @return table.
+     */
+    static const table_t* get()
+    {
+      return (&table);
+    }
+
+  private:
+    static_assert(M::STATE_MAX < NONE, "HSM: too many states");
+    static_assert(Transitions<M>::MAX < NONE, "HSM: too many transitions");
+    static_assert(is_valid<M>(), "HSM: invalid state or transition table");
+    static const state_t states[sizeof...(S)];
+    static const transition_t transitions[sizeof...(T)];
+    static const uint8_t lookup[sizeof...(L)];
+    static const table_t table;
+  };
+
+  /**
+   * Construct hierarchical state machine with given tables in
+   * program memory.
+   * @param[in] table machine tables (Table<M>::get()).
+   */
+  HSM(const table_t* table) :
+    Link(),
+    m_table(table),
+    m_state(NONE),
+    m_timer(false),
+    m_expires(0),
+    m_param(0)
+  {}
+
+  /**
+   * Get current (leaf) state.
+   * @return state.
+   */
+  uint8_t get_state() const
+  {
+    return (m_state);
+  }
+
+  /**
+   * Check if the given state is the current state or a super-state
+   * of the current state.
+   * @param[in] state to check.
+   * @return bool.
+   */
+  bool is_in_state(uint8_t state) const;
+
+  /**
+   * Get event parameter.
+   * @return event parameter.
+   */
+  uint16_t get_param() const
+  {
+    return (m_param);
+  }
+
+  /**
+   * Send an event to the state machine.
+   * @param[in] event index.
+   * @param[in] value the event value.
+   */
+  void send(uint8_t event, uint16_t value = 0)
+    __attribute__((always_inline))
+  {
+    Event::push(Event::USER_TYPE + event, this, value);
+  }
+
+  /**
+   * Start the state machine; enter the initial state and its initial
+   * sub-states.
+   * @return bool.
+   */
+  bool begin();
+
+  /**
+   * Stop the state machine; exit the current states.
+   */
+  void end();
+
+  /**
+   * Set timer for a timeout event (on the first watchdog tick at or
+   * after the given period). Falls back to the rounded period if
+   * there are no free deadlines.
+   * @param[in] ms timeout period.
+   */
+  void set_timer(uint16_t ms)
+  {
+    m_timer = true;
+    m_expires = Watchdog::millis() + ms;
+    if (Watchdog::schedule(this, m_expires) < 0)
+      Watchdog::attach(this, ms);
+  }
+
+  /**
+   * Cancel timer request. This is performed on state change.
+   */
+  void cancel_timer()
+  {
+    if (!m_timer) return;
+    Watchdog::cancel(this);
+    detach();
+    m_timer = false;
+  }
+
+protected:
+  const table_t* m_table;
+  uint8_t m_state;
+  bool m_timer;
+  uint32_t m_expires;
+  uint16_t m_param;
+
+  /**
+   * Get state declaration from program memory.
+   * @param[in] state index.
+   * @param[out] decl state declaration.
+   */
+  void get(uint8_t state, state_t& decl) const;
+
+  /**
+   * Enter states from the given super-state (exclusive) down to the
+   * given state.
+   * @param[in] from super-state (or NONE).
+   * @param[in] to state.
+   */
+  void enter(uint8_t from, uint8_t to);
+
+  /**
+   * @override Event::Handler
+   * Map the event to the event index, lookup and run transition.
+   * @param[in] type the type of event.
+   * @param[in] value the event value.
+   */
+  virtual void on_event(uint8_t type, uint16_t value);
+};
+
+template<typename M, uint16_t... S, uint16_t... T, uint16_t... L>
+const HSM::state_t
+HSM::Table<M, HSM::Indices<S...>, HSM::Indices<T...>, HSM::Indices<L...> >::
+states[sizeof...(S)] __PROGMEM = {
+  {
+    M::states[S].parent,
+    M::states[S].init,
+    M::states[S].entry,
+    M::states[S].exit
+  }...
+};
+
+template<typename M, uint16_t... S, uint16_t... T, uint16_t... L>
+const HSM::transition_t
+HSM::Table<M, HSM::Indices<S...>, HSM::Indices<T...>, HSM::Indices<L...> >::
+transitions[sizeof...(T)] __PROGMEM = {
+  {
+    M::transitions[T].source,
+    M::transitions[T].event,
+    M::transitions[T].target,
+    M::transitions[T].action
+  }...
+};
+
+template<typename M, uint16_t... S, uint16_t... T, uint16_t... L>
+const uint8_t
+HSM::Table<M, HSM::Indices<S...>, HSM::Indices<T...>, HSM::Indices<L...> >::
+lookup[sizeof...(L)] __PROGMEM = {
+  HSM::lookup<M>(L / M::EVENT_MAX, L % M::EVENT_MAX)...
+};
+
+template<typename M, uint16_t... S, uint16_t... T, uint16_t... L>
+const HSM::table_t
+HSM::Table<M, HSM::Indices<S...>, HSM::Indices<T...>, HSM::Indices<L...> >::
+table __PROGMEM = {
+  states,
+  transitions,
+  lookup,
+  M::EVENT_MAX,
+  M::TIMEOUT
+};
+
+#endif
@@ -167,8 +167,10 @@ INET::Server::begin(Socket* sock)
   // Sanity check parameter
   if (sock == NULL) return (false);
 
-  // Bind to io-stream
+  // Bind to io-stream and check for readiness events
   m_ios.set_device(sock);
+  m_event_driven = sock->set_event_handler(this);
+  m_ready = false;
 
   // Set socket to listen mode
   return (sock->listen() == 0);
@@ -187,7 +189,7 @@ INET::Server::run(uint32_t ms)
   if (!m_connected) {
     while (((res = sock->accept()) != 0) &&
 	   ((ms == 0L) || (Watchdog::since(start) < ms)))
-      yield();
+      await(start, ms);
     if (res != 0) return (ETIME);
     // Check if application accepts the connection
     if (!on_accept(m_ios)) goto error;
@@ -202,7 +204,7 @@ INET::Server::run(uint32_t ms)
   // Client has been accepted; check for incoming requests
   while (((res = sock->available()) == 0) &&
 	 ((ms == 0L) || (Watchdog::since(start) < ms)))
-    yield();
+    await(start, ms);
   // If a message is available call application request handling
   if (res > 0) {
     on_request(m_ios);
@@ -227,7 +229,31 @@ INET::Server::end()
   if (sock == NULL) return (false);
 
   // Close the socket and mark as disconnected
+  sock->set_event_handler(NULL);
   sock->close();
   m_connected = false;
+  m_event_driven = false;
   return (true);
 }
+
+void
+INET::Server::await(uint32_t start, uint32_t ms)
+{
+  // Polling socket; sleep until next interrupt
+  if (!m_event_driven) {
+    yield();
+    return;
+  }
+
+  // Dispatch events until socket is ready or timeout
+  while (!m_ready) {
+    uint32_t period = 0L;
+    if (ms != 0L) {
+      uint32_t elapsed = Watchdog::since(start);
+      if (elapsed >= ms) return;
+      period = ms - elapsed;
+    }
+    Event::service(period);
+  }
+  m_ready = false;
+}
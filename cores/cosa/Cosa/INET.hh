@@ -23,6 +23,7 @@
 
 #include "Cosa/Types.h"
 #include "Cosa/IOStream.hh"
+#include "Cosa/Event.hh"
 
 /**
  * Communication domain.
@@ -173,9 +174,12 @@ public:
   /**
    * Server request handler. Should be sub-classed and the virtual
    * member function on_request() should be implemented to receive
-   * client requests and send responses.
+   * client requests and send responses. The server is event-driven
+   * when the socket delivers readiness events
+   * (Socket::set_event_handler()); run() will then dispatch events
+   * and sleep instead of polling the socket.
    */
-  class Server {
+  class Server : public Event::Handler {
   public:
     /**
      * Default server constructor. Must call begin() to initiate with
@@ -185,9 +189,20 @@ public:
      */
     Server(IOStream& ios) :
       m_ios(ios),
-      m_connected(false)
+      m_connected(false),
+      m_event_driven(false),
+      m_ready(false)
     {}
 
+    /**
+     * Return true(1) if the server is event-driven otherwise false(0).
+     * @return bool.
+     */
+    bool is_event_driven() const
+    {
+      return (m_event_driven);
+    }
+
     /**
      * Get server socket.
      * @return socket.
@@ -270,12 +285,41 @@ public:
      */
     virtual void on_disconnect() {}
 
+    /**
+     * @override Event::Handler
+     * Socket readiness event; connect, disconnect, receive or timeout.
+     * Mark the server as ready to check the socket.
+     * @param[in] type the type of event.
+     * @param[in] value the event value.
+     */
+    virtual void on_event(uint8_t type, uint16_t value)
+    {
+      UNUSED(type);
+      UNUSED(value);
+      m_ready = true;
+    }
+
   protected:
     /** Associated io-stream */
     IOStream& m_ios;
 
     /** State variable; listening/disconnect(false), connected(true). */
     bool m_connected;
+
+    /** Socket delivers readiness events. */
+    bool m_event_driven;
+
+    /** Socket readiness event received. */
+    bool m_ready;
+
+    /**
+     * Wait for socket readiness; dispatch events until a socket event
+     * or the given timeout period from start has elapsed. Yield when
+     * the socket is not event-driven.
+     * @param[in] start time (milli-seconds).
+     * @param[in] ms timeout period (milli-seconds, zero for blocking).
+     */
+    void await(uint32_t start, uint32_t ms);
   };
 };
 
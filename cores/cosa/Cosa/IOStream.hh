@@ -403,7 +403,7 @@ public:
   void print(const void *ptr, size_t size,
 	     Base base = dec, uint8_t max = 16)
   {
-    print((uint32_t) ptr, ptr, size, base, max);
+    print((uint32_t) (uintptr_t) ptr, ptr, size, base, max);
   }
 
   /**
@@ -412,7 +412,7 @@ public:
    */
   void print(void *ptr)
   {
-    print((unsigned int) ptr, hex);
+    print((unsigned int) (uintptr_t) ptr, hex);
   }
 
   /**
@@ -422,7 +422,7 @@ public:
    */
   void print(const void *ptr)
   {
-    print((unsigned int) ptr, hex);
+    print((unsigned int) (uintptr_t) ptr, hex);
   }
 
   /**
@@ -0,0 +1,367 @@
+/**
+ * @file Cosa/IOStream/Driver/RWIO.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/IOStream/Driver/RWIO.hh"
+#include "Cosa/RTC.hh"
+
+RWIO::RWIO(Wireless::Driver* dev, uint8_t dest, uint8_t port, uint8_t window) :
+  IOStream::Device(),
+  m_dev(dev),
+  m_dest(dest),
+  m_port(port),
+  m_window(window == 0 ? 1 : (window < WINDOW_MAX ? window : WINDOW_MAX)),
+  m_peer_window(1),
+  m_epoch(0),
+  m_synced(false),
+  m_tx_base(0),
+  m_tx_next(0),
+  m_tx_ix(0),
+  m_rx_next(0),
+  m_rx_mask(0),
+  m_rx_epoch(0),
+  m_rx_syn(false),
+  m_ibuf(),
+  m_timer(this),
+  m_expired(false),
+  m_srtt(0),
+  m_rttvar(0),
+  m_rto(RTO_INIT),
+  m_timeouts(0),
+  m_retrans(0),
+  m_drops(0)
+{
+}
+
+void
+RWIO::begin()
+{
+  m_timer.stop();
+  m_expired = false;
+  m_epoch = (m_epoch + 0x10) & EPOCH_MASK;
+  m_synced = false;
+  m_peer_window = 1;
+  m_tx_base = 0;
+  m_tx_next = 0;
+  m_tx_ix = 0;
+  m_rx_next = 0;
+  m_rx_mask = 0;
+  m_rx_syn = false;
+  m_ibuf.empty();
+  m_srtt = 0;
+  m_rttvar = 0;
+  m_rto = RTO_INIT;
+  m_timeouts = 0;
+}
+
+void
+RWIO::run()
+{
+  // Handle frames from the peer
+  uint8_t frame[PAYLOAD_MAX];
+  uint8_t src;
+  uint8_t port;
+  int res;
+  while ((res = m_dev->recv(src, port, frame, sizeof(frame), POLL_MS)) >= 0) {
+    if ((src != m_dest) || (port != m_port)) continue;
+    if ((size_t) res < sizeof(header_t)) continue;
+    uint8_t type = frame[0] & TYPE_MASK;
+    if (type == DATA_TYPE)
+      on_data(frame, res);
+    else if ((type == ACK_TYPE) && ((size_t) res == sizeof(ack_t)))
+      on_ack((const ack_t*) frame);
+  }
+
+  // Deliver frames waiting for room in the input buffer
+  if (m_rx_mask & 1) {
+    uint8_t next = m_rx_next;
+    deliver();
+    if (next != m_rx_next) acknowledge();
+  }
+
+  // Check for retransmission timeout
+  if (!m_expired) return;
+  m_expired = false;
+  if (in_transit() == 0) return;
+  if (++m_timeouts > RETRY_MAX) {
+    drop();
+    return;
+  }
+
+  // Back off and retransmit frames not acknowledged
+  m_rto = (m_rto < RTO_MAX / 2) ? m_rto * 2 : RTO_MAX;
+  for (uint8_t seq = m_tx_base; seq != m_tx_next; seq++) {
+    tx_slot_t* slot = &m_tx[seq & WINDOW_MASK];
+    if (slot->flags & SACKED) continue;
+    slot->flags |= RETRANSMITTED;
+    transmit(seq);
+    m_retrans += 1;
+  }
+  restart();
+}
+
+int
+RWIO::available()
+{
+  run();
+  return (m_ibuf.available());
+}
+
+int
+RWIO::room()
+{
+  return (DATA_MAX - m_tx_ix);
+}
+
+int
+RWIO::putchar(char c)
+{
+  // Wait for the output frame slot to be acknowledged
+  while (in_transit() == WINDOW_MAX) run();
+
+  // Append to output frame and send when full or end of line
+  m_tx[m_tx_next & WINDOW_MASK].data[m_tx_ix++] = c;
+  if ((m_tx_ix == DATA_MAX) || (c == '\n')) send();
+  return (c & 0xff);
+}
+
+int
+RWIO::peekchar()
+{
+  if (m_ibuf.is_empty()) run();
+  return (m_ibuf.peekchar());
+}
+
+int
+RWIO::peekchar(char c)
+{
+  if (m_ibuf.is_empty()) run();
+  return (m_ibuf.peekchar(c));
+}
+
+int
+RWIO::getchar()
+{
+  if (m_ibuf.is_empty()) run();
+  return (m_ibuf.getchar());
+}
+
+int
+RWIO::flush()
+{
+  uint16_t drops = m_drops;
+  send();
+  while (in_transit() != 0) run();
+  return (m_drops == drops ? 0 : IOStream::EOF);
+}
+
+void
+RWIO::empty()
+{
+  m_ibuf.empty();
+}
+
+void
+RWIO::send()
+{
+  if (m_tx_ix == 0) return;
+
+  // Wait for room in the send window. Allow a single frame to probe
+  // a peer without receive window
+  while (1) {
+    uint8_t transit = in_transit();
+    if (transit == 0) break;
+    if ((transit < m_window) && (transit < m_peer_window)) break;
+    run();
+  }
+
+  // Transmit the output frame and start the timer if first in transit
+  tx_slot_t* slot = &m_tx[m_tx_next & WINDOW_MASK];
+  slot->len = m_tx_ix;
+  slot->flags = 0;
+  m_tx_ix = 0;
+  transmit(m_tx_next++);
+  if (in_transit() == 1) restart();
+}
+
+void
+RWIO::transmit(uint8_t seq)
+{
+  tx_slot_t* slot = &m_tx[seq & WINDOW_MASK];
+  header_t header;
+  header.type = DATA_TYPE | m_epoch | (m_synced ? 0 : SYN_FLAG);
+  header.seq = seq;
+  iovec_t vec[3];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &header, sizeof(header));
+  iovec_arg(vp, slot->data, slot->len);
+  iovec_end(vp);
+  slot->sent = RTC::millis();
+  m_dev->send(m_dest, m_port, vec);
+}
+
+void
+RWIO::on_ack(const ack_t* ack)
+{
+  // Check that the acknowledgement is within the send window
+  uint8_t transit = in_transit();
+  uint8_t acked = ack->next - m_tx_base;
+  if (acked > transit) return;
+  m_peer_window = ack->window;
+
+  // Advance the window. Sample round trip time from the latest frame
+  // if it was not retransmitted (Karn's algorithm)
+  if (acked != 0) {
+    tx_slot_t* slot = &m_tx[(ack->next - 1) & WINDOW_MASK];
+    if ((slot->flags & RETRANSMITTED) == 0)
+      update((uint16_t) RTC::millis() - slot->sent);
+    m_tx_base = ack->next;
+    m_timeouts = 0;
+    m_synced = true;
+    transit -= acked;
+  }
+
+  // Mark frames received out of order. Retransmit missing frames
+  // before the latest received once (fast retransmit)
+  uint8_t sack = ack->sack;
+  uint8_t last = 0;
+  for (uint8_t i = 0; (i < transit) && (sack != 0); i++, sack >>= 1) {
+    if ((sack & 1) == 0) continue;
+    m_tx[(m_tx_base + i) & WINDOW_MASK].flags |= SACKED;
+    last = i;
+  }
+  for (uint8_t i = 0; i < last; i++) {
+    uint8_t seq = m_tx_base + i;
+    tx_slot_t* slot = &m_tx[seq & WINDOW_MASK];
+    if (slot->flags & (SACKED | RETRANSMITTED)) continue;
+    slot->flags |= RETRANSMITTED;
+    transmit(seq);
+    m_retrans += 1;
+  }
+
+  // Restart the retransmission timer when the window advanced
+  if (acked != 0) restart();
+}
+
+void
+RWIO::on_data(const uint8_t* frame, uint8_t len)
+{
+  const header_t* header = (const header_t*) frame;
+  uint8_t epoch = header->type & EPOCH_MASK;
+
+  // Restart sequence numbering when the peer synchronizes
+  if (header->type & SYN_FLAG) {
+    if (!m_rx_syn || (epoch != m_rx_epoch)) {
+      m_rx_next = 0;
+      m_rx_mask = 0;
+      m_rx_epoch = epoch;
+      m_rx_syn = true;
+    }
+  }
+  else m_rx_syn = false;
+
+  // Store frame within the receive window and deliver in order
+  uint8_t offset = header->seq - m_rx_next;
+  if (offset < WINDOW_MAX) {
+    uint8_t bit = _BV(offset);
+    if ((m_rx_mask & bit) == 0) {
+      rx_slot_t* slot = &m_rx[header->seq & WINDOW_MASK];
+      slot->len = len - sizeof(header_t);
+      memcpy(slot->data, frame + sizeof(header_t), slot->len);
+      m_rx_mask |= bit;
+    }
+    deliver();
+  }
+
+  // Acknowledge all data frames; also duplicates
+  acknowledge();
+}
+
+void
+RWIO::deliver()
+{
+  while (m_rx_mask & 1) {
+    rx_slot_t* slot = &m_rx[m_rx_next & WINDOW_MASK];
+    if (m_ibuf.room() < slot->len) return;
+    m_ibuf.write(slot->data, slot->len);
+    m_rx_next += 1;
+    m_rx_mask >>= 1;
+  }
+}
+
+void
+RWIO::acknowledge()
+{
+  ack_t ack;
+  uint8_t window = m_ibuf.room() / DATA_MAX;
+  ack.type = ACK_TYPE;
+  ack.next = m_rx_next;
+  ack.sack = m_rx_mask;
+  ack.window = window < WINDOW_MAX ? window : WINDOW_MAX;
+  m_dev->send(m_dest, m_port, &ack, sizeof(ack));
+}
+
+void
+RWIO::update(uint16_t rtt)
+{
+  // Jacobson/Karels; scaled smoothed round trip time (x8) and
+  // variation (x4)
+  if (rtt > RTO_MAX) rtt = RTO_MAX;
+  if (m_srtt == 0) {
+    m_srtt = rtt << 3;
+    m_rttvar = rtt << 1;
+  }
+  else {
+    int16_t delta = rtt - (m_srtt >> 3);
+    m_srtt += delta;
+    if (delta < 0) delta = -delta;
+    m_rttvar += delta - (m_rttvar >> 2);
+  }
+  uint16_t rto = (m_srtt >> 3) + m_rttvar;
+  if (rto < RTO_MIN) rto = RTO_MIN;
+  else if (rto > RTO_MAX) rto = RTO_MAX;
+  m_rto = rto;
+}
+
+void
+RWIO::drop()
+{
+  // Drop frames in transit. Move the output frame to the first slot
+  // and synchronize with the peer again
+  m_drops += in_transit();
+  tx_slot_t* slot = &m_tx[m_tx_next & WINDOW_MASK];
+  if (slot != m_tx) memcpy(m_tx[0].data, slot->data, m_tx_ix);
+  m_tx_base = 0;
+  m_tx_next = 0;
+  m_epoch = (m_epoch + 0x10) & EPOCH_MASK;
+  m_synced = false;
+  m_timeouts = 0;
+  m_rto = RTO_INIT;
+  m_timer.stop();
+}
+
+void
+RWIO::restart()
+{
+  m_timer.stop();
+  m_expired = false;
+  if (in_transit() == 0) return;
+  m_timer.expire_after(m_rto * 1000UL);
+  m_timer.start();
+}
@@ -0,0 +1,369 @@
+/**
+ * @file Cosa/IOStream/Driver/RWIO.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_IOSTREAM_DRIVER_RWIO_HH
+#define COSA_IOSTREAM_DRIVER_RWIO_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/IOStream.hh"
+#include "Cosa/IOBuffer.hh"
+#include "Cosa/Timer.hh"
+#include "Cosa/Wireless.hh"
+
+#ifndef COSA_RWIO_WINDOW_MAX
+#define COSA_RWIO_WINDOW_MAX 4
+#endif
+
+#ifndef COSA_RWIO_BUFFER_MAX
+#define COSA_RWIO_BUFFER_MAX 64
+#endif
+
+/**
+ * Reliable IOStream driver for Wireless Interface. Bidirectional byte
+ * stream between two devices with in-order delivery. Output is
+ * buffered into sequence numbered frames. Up to window size frames
+ * may be in transit. The receiver acknowledges with the next expected
+ * sequence number (cumulative), a bit-set of frames received out of
+ * order (selective) and the number of frames it has room for (flow
+ * control). The retransmission timeout is calculated from the round
+ * trip time (Jacobson/Karels) and the retransmission timer is a Timer.
+ * The Timer handler must be started with Timer::begin().
+ *
+ * Received frames are only processed when the stream is serviced;
+ * run() should be called regularly. It is also called by available(),
+ * getchar(), putchar() and flush() while waiting. All frames on the
+ * radio that are not from the peer on the stream port are discarded.
+ *
+ * @section Limitations
+ * The window size must be a power of two and max 8 frames.
+ */
+class RWIO : public IOStream::Device {
+public:
+  /** Max size of payload. */
+  static const uint8_t PAYLOAD_MAX = 30;
+
+  /** Max size of window (frames). */
+  static const uint8_t WINDOW_MAX = COSA_RWIO_WINDOW_MAX;
+  static_assert((WINDOW_MAX <= 8) && !(WINDOW_MAX & (WINDOW_MAX - 1)),
+		"WINDOW_MAX should be power of 2 and max 8");
+
+  /** Initial retransmission timeout (milli-seconds). */
+  static const uint16_t RTO_INIT = 250;
+
+  /** Min retransmission timeout (milli-seconds). */
+  static const uint16_t RTO_MIN = 20;
+
+  /** Max retransmission timeout (milli-seconds). */
+  static const uint16_t RTO_MAX = 4000;
+
+  /** Max number of consecutive timeouts before frames are dropped. */
+  static const uint8_t RETRY_MAX = 8;
+
+  /**
+   * Construct Reliable Wireless Interface Stream for given device
+   * driver, peer device address and port.
+   * @param[in] dev wireless device driver.
+   * @param[in] dest peer device address.
+   * @param[in] port message type (Default 0x00).
+   * @param[in] window send window size (Default WINDOW_MAX).
+   */
+  RWIO(Wireless::Driver* dev, uint8_t dest, uint8_t port = 0x00,
+       uint8_t window = WINDOW_MAX);
+
+  /**
+   * Start the stream; reset stream state and synchronize with the
+   * peer. The wireless device driver should be started before.
+   */
+  void begin();
+
+  /**
+   * Service the stream; receive and handle frames from the peer and
+   * retransmit frames on timeout.
+   */
+  void run();
+
+  /**
+   * Return current retransmission timeout (milli-seconds).
+   * @return milli-seconds.
+   */
+  uint16_t get_rto() const
+  {
+    return (m_rto);
+  }
+
+  /**
+   * Return smoothed round trip time (milli-seconds).
+   * @return milli-seconds.
+   */
+  uint16_t get_srtt() const
+  {
+    return (m_srtt >> 3);
+  }
+
+  /**
+   * Return number of retransmitted frames.
+   * @return count.
+   */
+  uint16_t get_retransmits() const
+  {
+    return (m_retrans);
+  }
+
+  /**
+   * Return number of dropped frames; not acknowledged after max
+   * number of retransmissions.
+   * @return count.
+   */
+  uint16_t get_drops() const
+  {
+    return (m_drops);
+  }
+
+  /**
+   * @override IOStream::Device
+   * Number of bytes available in input buffer.
+   * @return bytes.
+   */
+  virtual int available();
+
+  /**
+   * @override IOStream::Device
+   * Number of bytes room in output frame.
+   * @return bytes.
+   */
+  virtual int room();
+
+  /**
+   * @override IOStream::Device
+   * Write character to output frame. Send if full or new-line
+   * character. Wait for room in the send window. Returns character if
+   * successful otherwise EOF(-1).
+   * @param[in] c character to write.
+   * @return character written or EOF(-1).
+   */
+  virtual int putchar(char c);
+
+  /**
+   * @override IOStream::Device
+   * Peek next character from input buffer.
+   * @return character or EOF(-1).
+   */
+  virtual int peekchar();
+
+  /**
+   * @override IOStream::Device
+   * Peek for given character in input buffer.
+   * @param[in] c character to peek for.
+   * @return available or EOF(-1).
+   */
+  virtual int peekchar(char c);
+
+  /**
+   * @override IOStream::Device
+   * Read character from input buffer.
+   * @return character or EOF(-1).
+   */
+  virtual int getchar();
+
+  /**
+   * @override IOStream::Device
+   * Send buffered output and wait until all frames have been
+   * acknowledged. Returns zero(0) or EOF(-1) if frames were dropped.
+   * @return zero(0) or negative error code.
+   */
+  virtual int flush();
+
+  /**
+   * @override IOStream::Device
+   * Empty input buffer.
+   */
+  virtual void empty();
+
+protected:
+  /**
+   * Frame type (bits 0..3), synchronization epoch (bits 4..6) and
+   * flag (bit 7). Data frames are sent with the synchronization flag
+   * until acknowledged after start or dropped frames. The sequence
+   * number is then restarted from zero.
+   */
+  enum {
+    DATA_TYPE = 0x01,		//!< Data frame.
+    ACK_TYPE = 0x02,		//!< Acknowledgement frame.
+    TYPE_MASK = 0x0f,		//!< Frame type mask.
+    EPOCH_MASK = 0x70,		//!< Synchronization epoch mask.
+    SYN_FLAG = 0x80		//!< Synchronize sequence number.
+  } __attribute__((packed));
+
+  /** Data frame header. */
+  struct header_t {
+    uint8_t type;		//!< Frame type, epoch and flag.
+    uint8_t seq;		//!< Sequence number.
+  };
+
+  /** Acknowledgement frame. */
+  struct ack_t {
+    uint8_t type;		//!< Frame type.
+    uint8_t next;		//!< Next expected sequence number.
+    uint8_t sack;		//!< Frames received out of order (next + i).
+    uint8_t window;		//!< Receiver window (frames).
+  };
+
+  /** Max size of data in frame. */
+  static const uint8_t DATA_MAX = PAYLOAD_MAX - sizeof(header_t);
+
+  /** Receive poll timeout (milli-seconds). */
+  static const uint32_t POLL_MS = 1L;
+
+  /** Window slot index mask. */
+  static const uint8_t WINDOW_MASK = WINDOW_MAX - 1;
+
+  /** Send slot state flags. */
+  enum {
+    SACKED = 0x01,		//!< Selectively acknowledged.
+    RETRANSMITTED = 0x02	//!< Retransmitted; no round trip sample.
+  } __attribute__((packed));
+
+  /** Send window slot. */
+  struct tx_slot_t {
+    uint8_t len;		//!< Data length.
+    uint8_t flags;		//!< Slot state flags.
+    uint16_t sent;		//!< Transmit time (milli-seconds).
+    uint8_t data[DATA_MAX];	//!< Frame data.
+  };
+
+  /** Receive window slot; frames received out of order. */
+  struct rx_slot_t {
+    uint8_t len;		//!< Data length.
+    uint8_t data[DATA_MAX];	//!< Frame data.
+  };
+
+  /** Retransmission timer; signal timeout to the stream. */
+  class Retransmitter : public Timer {
+  public:
+    Retransmitter(RWIO* io) : Timer(), m_io(io) {}
+
+    /**
+     * @override Timer
+     * Signal retransmission timeout. Called from interrupt service
+     * routine.
+     */
+    virtual void on_expired()
+    {
+      m_io->m_expired = true;
+    }
+
+  private:
+    RWIO* m_io;			//!< Stream.
+  };
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  uint8_t m_dest;		//!< Peer device address.
+  uint8_t m_port;		//!< Stream port.
+  uint8_t m_window;		//!< Send window size (frames).
+  uint8_t m_peer_window;	//!< Peer receive window (frames).
+  uint8_t m_epoch;		//!< Synchronization epoch.
+  bool m_synced;		//!< Sequence number acknowledged by peer.
+
+  tx_slot_t m_tx[WINDOW_MAX];	//!< Send window.
+  uint8_t m_tx_base;		//!< Oldest unacknowledged sequence number.
+  uint8_t m_tx_next;		//!< Sequence number of output frame.
+  uint8_t m_tx_ix;		//!< Output frame length.
+
+  rx_slot_t m_rx[WINDOW_MAX];	//!< Receive window.
+  uint8_t m_rx_next;		//!< Next expected sequence number.
+  uint8_t m_rx_mask;		//!< Received frames (m_rx_next + i).
+  uint8_t m_rx_epoch;		//!< Peer synchronization epoch.
+  bool m_rx_syn;		//!< Synchronizing; only flagged frames received.
+  IOBuffer<COSA_RWIO_BUFFER_MAX> m_ibuf; //!< Input buffer.
+
+  Retransmitter m_timer;	//!< Retransmission timer.
+  volatile bool m_expired;	//!< Retransmission timeout signaled.
+  uint16_t m_srtt;		//!< Smoothed round trip time (x8).
+  uint16_t m_rttvar;		//!< Round trip time variation (x4).
+  uint16_t m_rto;		//!< Retransmission timeout.
+  uint8_t m_timeouts;		//!< Consecutive timeouts.
+  uint16_t m_retrans;		//!< Number of retransmitted frames.
+  uint16_t m_drops;		//!< Number of dropped frames.
+
+  /**
+   * Return number of frames in transit.
+   * @return frames.
+   */
+  uint8_t in_transit() const
+  {
+    return (m_tx_next - m_tx_base);
+  }
+
+  /**
+   * Send output frame when the send window allows. Wait for room.
+   */
+  void send();
+
+  /**
+   * Transmit frame with given sequence number.
+   * @param[in] seq sequence number.
+   */
+  void transmit(uint8_t seq);
+
+  /**
+   * Handle acknowledgement frame.
+   * @param[in] ack acknowledgement.
+   */
+  void on_ack(const ack_t* ack);
+
+  /**
+   * Handle data frame with given length.
+   * @param[in] frame data frame.
+   * @param[in] len frame length.
+   */
+  void on_data(const uint8_t* frame, uint8_t len);
+
+  /**
+   * Deliver received frames in order to the input buffer while
+   * there is room.
+   */
+  void deliver();
+
+  /**
+   * Send acknowledgement with receive state.
+   */
+  void acknowledge();
+
+  /**
+   * Update round trip time estimate with given sample and calculate
+   * retransmission timeout.
+   * @param[in] rtt round trip time sample (milli-seconds).
+   */
+  void update(uint16_t rtt);
+
+  /**
+   * Drop frames in transit and restart sequence numbering. Called
+   * after max number of consecutive timeouts.
+   */
+  void drop();
+
+  /**
+   * Restart retransmission timer if frames are in transit otherwise
+   * stop.
+   */
+  void restart();
+};
+
+#endif
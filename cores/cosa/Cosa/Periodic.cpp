@@ -0,0 +1,40 @@
+/**
+ * @file Cosa/Periodic.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Periodic.hh"
+
+void
+Periodic::reschedule()
+{
+  // Update max lateness of this run
+  uint32_t now = Watchdog::millis();
+  uint32_t late = now - m_expires;
+  if (late > UINT16_MAX) late = UINT16_MAX;
+  if (late > m_lateness) m_lateness = late;
+
+  // Next deadline is relative to the previous; skip passed periods
+  m_expires += m_period;
+  while ((m_period != 0) && ((int32_t) (now - m_expires) >= 0)) {
+    m_expires += m_period;
+    m_overruns += 1;
+  }
+  if (Watchdog::schedule(this, m_expires) == 0) detach();
+  else Watchdog::attach(this, m_period);
+}
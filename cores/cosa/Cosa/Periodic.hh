@@ -34,6 +34,15 @@
  * Avoid setting period to the same value in the run method as this
  * will force the function to be executed twice in the same time frame.
  *
+ * @section Exact Period
+ * By default the period is rounded to a power of two watchdog ticks
+ * (e.g. 100 ms is 128 ms). With exact period the handler keeps the
+ * absolute deadline of the next run and reschedules with the previous
+ * deadline plus the period (Watchdog::schedule()). The run is at the
+ * first tick at or after the deadline; lateness is less than a tick
+ * plus the event dispatch delay and does not accumulate. Periods
+ * that are missed completely are skipped and counted as overruns.
+ *
  * @section See Also
  * For details on time period handling see Watchdog.hh. This execution
  * pattern is also available in the FSM (Finite State Machine) class.
@@ -43,8 +52,17 @@ public:
   /**
    * Construct a periodic function handler.
    * @param[in] ms period of timeout.
+   * @param[in] exact period (default false).
    */
-  Periodic(uint16_t ms) : Link(), m_period(ms) {}
+  Periodic(uint16_t ms, bool exact = false) :
+    Link(),
+    m_period(ms),
+    m_exact(exact),
+    m_running(false),
+    m_expires(0),
+    m_lateness(0),
+    m_overruns(0)
+  {}
 
   /**
    * Set timeout period.
@@ -56,23 +74,49 @@ public:
   }
 
   /**
-   * Start the periodic function.
+   * Start the periodic function. With exact period the first run is
+   * one period from now. Falls back to the rounded period if there
+   * are no free deadlines.
    */
   void begin()
-    __attribute__((always_inline))
   {
+    m_running = true;
+    if (m_exact) {
+      m_expires = Watchdog::millis() + m_period;
+      if (Watchdog::schedule(this, m_expires) == 0) return;
+    }
     Watchdog::attach(this, m_period);
   }
 
   /**
-   * Stop the periodic function.
+   * Stop the periodic function. Timeout events already in the event
+   * queue are ignored.
    */
   void end()
-    __attribute__((always_inline))
   {
+    m_running = false;
+    if (m_exact) Watchdog::cancel(this);
     detach();
   }
 
+  /**
+   * Get max lateness of run (milli-seconds). Exact period only.
+   * @return lateness.
+   */
+  uint16_t get_lateness() const
+  {
+    return (m_lateness);
+  }
+
+  /**
+   * Get number of skipped periods. Exact period only.
+   * @return overruns.
+   */
+  uint16_t get_overruns() const
+  {
+    return (m_overruns);
+  }
+
   /**
    * @override Periodic
    * The default null function.
@@ -83,18 +127,32 @@ private:
   /**
    * @override Event::Handler
    * Periodic event handler; dispatch the run() function on
-   * timeout events.
+   * timeout events. With exact period the next deadline is scheduled
+   * before the run() function so that it may call end().
    * @param[in] type the type of event.
    * @param[in] value the event value.
    */
   virtual void on_event(uint8_t type, uint16_t value)
   {
     UNUSED(value);
-    if (type != Event::TIMEOUT_TYPE) return;
+    if ((type != Event::TIMEOUT_TYPE) || !m_running) return;
+    if (m_exact) reschedule();
     run();
   }
 
+  /**
+   * Update lateness statistics and schedule the next deadline. Skip
+   * periods that have already passed. Falls back to the rounded period
+   * if there are no free deadlines.
+   */
+  void reschedule();
+
   uint16_t m_period;
+  bool m_exact;
+  bool m_running;
+  uint32_t m_expires;
+  uint16_t m_lateness;
+  uint16_t m_overruns;
 };
 
 /**
@@ -43,6 +43,16 @@ public:
     return (res);
   }
 
+  /**
+   * Get the default sleep mode.
+   * @return mode.
+   */
+  static uint8_t get()
+    __attribute__((always_inline))
+  {
+    return (s_mode);
+  }
+
   /**
    * Put the processor in the given sleep mode and wait for
    * an interrupt to wake up.
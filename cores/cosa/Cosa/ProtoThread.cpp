@@ -22,12 +22,14 @@
 #include "Cosa/Watchdog.hh"
 
 Head ProtoThread::runq;
+uint32_t ProtoThread::s_dispatched = 0L;
 
 void
 ProtoThread::on_event(uint8_t type, uint16_t value)
 {
-  if (m_state == WAITING) detach();
+  if (m_state == WAITING) cancel_timer();
   m_state = (type == Event::TIMEOUT_TYPE) ? TIMEOUT : RUNNING;
+  s_dispatched += 1;
   run(type, value);
   if (m_state == RUNNING) {
     m_state = READY;
@@ -54,6 +56,7 @@ ProtoThread::dispatch(bool flag)
     Linkage* succ = link->get_succ();
     ProtoThread* thread = (ProtoThread*) link;
     thread->m_state = RUNNING;
+    s_dispatched += 1;
     thread->run();
     if (thread->m_state == RUNNING) {
       thread->m_state = READY;
@@ -81,3 +84,14 @@ ProtoThread::schedule(ProtoThread* thread)
   thread->m_state = READY;
   runq.attach(thread);
 }
+
+void
+ProtoThread::Signal::notify()
+{
+  // Move all waiting threads to the run queue
+  synchronized {
+    Linkage* link;
+    while ((link = get_succ()) != this)
+      schedule((ProtoThread*) link);
+  }
+}
@@ -34,6 +34,13 @@
  * 9 bytes (3 bytes for state and continuation, 4 bytes for Link and
  * 2 bytes for virtual table pointer).
  *
+ * Threads that wait for a condition with PROTO_THREAD_AWAIT() stay
+ * in the run queue and re-evaluate the condition on every dispatch.
+ * Threads that wait with PROTO_THREAD_AWAIT_SIGNAL() are moved from
+ * the run queue to the signal and are not dispatched until the
+ * signal is notified; by an interrupt handler, another thread, an
+ * event or a watchdog timeout.
+ *
  * @section Limitations
  * The thread macro set should only be used within the ProtoThread::run()
  * function.
@@ -62,10 +69,45 @@ public:
     WAITING,			//!< In timer queue.
     TIMEOUT,			//!< Timeout received and running.
     RUNNING,			//!< Dispatched and running.
-    SLEEPING,			//!< Detached. Need wakeup call.
+    SLEEPING,			//!< Detached or signal wait. Need wakeup call.
     TERMINATED = 0xff,		//!< Removed from all queues.
   } __attribute__((packed));
 
+  /**
+   * Signal for threads waiting for a condition. Threads wait with
+   * PROTO_THREAD_AWAIT_SIGNAL() and are moved back to the run queue
+   * when notified. Signals may be notified from interrupt handlers
+   * or by pushing an event to the signal.
+   */
+  class Signal : public Head {
+  public:
+    /**
+     * Construct signal with empty wait queue.
+     */
+    Signal() : Head() {}
+
+    /**
+     * Move all waiting threads to the run queue. The threads will
+     * re-evaluate their wait condition. May be called from interrupt
+     * handlers.
+     */
+    void notify();
+
+  private:
+    /**
+     * @override Event::Handler
+     * Notify waiting threads on any event.
+     * @param[in] type the type of event.
+     * @param[in] value the event value.
+     */
+    virtual void on_event(uint8_t type, uint16_t value)
+    {
+      UNUSED(type);
+      UNUSED(value);
+      notify();
+    }
+  };
+
   /**
    * Construct thread, initiate state and continuation. Does not
    * schedule the thread. This is done with begin().
@@ -94,6 +136,7 @@ public:
    */
   void end()
   {
+    if (m_state == WAITING) cancel_timer();
     m_state = TERMINATED;
     detach();
   }
@@ -110,12 +153,21 @@ public:
   /**
    * Set timer and enqueue thread to receive timeout event.
    * If the timer expires the thread is put in TIMEOUT state.
+   * The timeout period is rounded to a power of two watchdog ticks
+   * unless exact; then the timeout is on the first tick at or after
+   * the given period (Watchdog::schedule()). Falls back to the
+   * rounded period if there are no free deadlines.
    * @param[in] ms timeout period.
+   * @param[in] exact timeout period (default false).
    */
-  void set_timer(uint16_t ms)
+  void set_timer(uint16_t ms, bool exact = false)
     __attribute__((always_inline))
   {
     m_state = WAITING;
+    if (exact) {
+      detach();
+      if (Watchdog::schedule(this, Watchdog::millis() + ms) == 0) return;
+    }
     Watchdog::attach(this, ms);
   }
 
@@ -125,6 +177,7 @@ public:
   void cancel_timer()
     __attribute__((always_inline))
   {
+    Watchdog::cancel(this);
     detach();
   }
 
@@ -152,7 +205,8 @@ public:
    *   PROTO_THREAD_END();
    * }
    * Additional macros are PROTO_THREAD_YIELD(), PROTO_THREAD_SLEEP(),
-   * PROTO_THREAD_WAKE(), and PROTO_THREAD_DELAY().
+   * PROTO_THREAD_WAKE(), PROTO_THREAD_AWAIT_SIGNAL(), and
+   * PROTO_THREAD_DELAY().
    * @param[in] type the type of event.
    * @param[in] value the event value.
    */
@@ -175,8 +229,19 @@ public:
    */
   static void schedule(ProtoThread* thread);
 
+  /**
+   * Get number of thread run function calls; by dispatch() and on
+   * events.
+   * @return number of calls.
+   */
+  static uint32_t get_dispatched()
+  {
+    return (s_dispatched);
+  }
+
 protected:
   static Head runq;
+  static uint32_t s_dispatched;
   uint8_t m_state;
   void* m_ip;
 
@@ -227,7 +292,7 @@ protected:
 #define PROTO_THREAD_WAKE(thread)			\
   do {							\
     if (thread->m_state == SLEEPING)			\
-      Thread::schedule(thread);				\
+      ProtoThread::schedule(thread);			\
   } while (0)
 
 /**
@@ -246,6 +311,32 @@ protected:
     }							\
   } while (0)
 
+/**
+ * Check if the given condition is true(1). If not the thread is
+ * moved from the run queue to the given signal and will not be
+ * dispatched until the signal is notified. The condition is rechecked
+ * when the thread is activated again. The condition is also checked
+ * after the thread is added to the signal so that a notify between
+ * the check and the wait is not lost.
+ * @param[in] signal to wait on.
+ * @param[in] condition to evaluate.
+ */
+#define PROTO_THREAD_AWAIT_SIGNAL(signal,condition)	\
+  do {							\
+    __label__ next;					\
+  next:							\
+    if (!(condition)) {					\
+      m_state = SLEEPING;				\
+      (signal).attach(this);				\
+      if (!(condition)) {				\
+	m_ip = &&next;					\
+	return;						\
+      }							\
+      ProtoThread::schedule(this);			\
+      m_state = RUNNING;				\
+    }							\
+  } while (0)
+
 /**
  * Delay the thread for the given ms time period. This is a short form
  * for set_timer() and THREAD_AWAIT(timer_expired());
@@ -103,6 +103,18 @@ RTC::micros()
   return (res);
 }
 
+void
+RTC::adjust(uint32_t ms)
+{
+  uint32_t us = ms * 1000L;
+  synchronized {
+    s_uticks += us;
+    uint32_t ticks = s_ticks + (us / US_PER_TICK);
+    s_sec += ticks / TICKS_PER_SEC;
+    s_ticks = ticks % TICKS_PER_SEC;
+  }
+}
+
 void
 RTC::delay(uint32_t ms)
 {
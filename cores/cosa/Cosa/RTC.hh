@@ -49,6 +49,23 @@ public:
    */
   static bool end();
 
+  /**
+   * Get initiated state.
+   * @return bool.
+   */
+  static bool is_initiated()
+  {
+    return (s_initiated);
+  }
+
+  /**
+   * Advance the clock with the given number of milli-seconds. Used
+   * to compensate for time in sleep modes that stop the timer (see
+   * Watchdog::idle()).
+   * @param[in] ms milli-seconds.
+   */
+  static void adjust(uint32_t ms);
+
   /**
    * Get number of micro-seconds per tick.
    * @return micro-seconds.
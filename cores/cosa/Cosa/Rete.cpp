@@ -0,0 +1,253 @@
+/**
+ * @file Cosa/Rete.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Rete.hh"
+
+/**
+ * Convert given value with given size to integer. Return true(1) if
+ * the value is numeric (1, 2 or 4 bytes) otherwise false(0).
+ * @param[in] buf value buffer.
+ * @param[in] size number of bytes in value.
+ * @param[out] value integer value.
+ * @return bool.
+ */
+static bool
+to_int(const uint8_t* buf, size_t size, int32_t& value)
+{
+  switch (size) {
+  case sizeof(int8_t):
+    value = (int8_t) buf[0];
+    return (true);
+  case sizeof(int16_t):
+    {
+      int16_t v;
+      memcpy(&v, buf, sizeof(v));
+      value = v;
+    }
+    return (true);
+  case sizeof(int32_t):
+    memcpy(&value, buf, sizeof(value));
+    return (true);
+  }
+  return (false);
+}
+
+int
+Rete::Device::update(const uint8_t* path, size_t len)
+{
+  if (len > Registry::PATH_MAX) return (EINVAL);
+
+  // Mark the item if already in the batch table
+  for (uint8_t i = 0; i < m_entries; i++) {
+    entry_t* ep = &m_entry[i];
+    if (ep->len == len && !memcmp(ep->path, path, len)) {
+      ep->is_updated = true;
+      return (0);
+    }
+  }
+
+  // Add the item. Start a new key batch so that the receivers get
+  // the key value
+  Registry::blob_P blob = Registry::to_blob(m_reg->lookup(path, len));
+  if (blob == NULL) return (ENOENT);
+  if (m_entries == BATCH_MAX) return (ENOSPC);
+  entry_t* ep = &m_entry[m_entries++];
+  ep->blob = blob;
+  memcpy(ep->path, path, len);
+  ep->len = len;
+  ep->is_updated = true;
+  ep->key = 0;
+  m_batches = 0;
+  return (0);
+}
+
+int
+Rete::Device::flush(uint16_t product)
+{
+  // Check for key batch; all items with full value
+  bool is_key = (m_batches == 0);
+  if (++m_batches == KEY_PERIOD) m_batches = 0;
+  if (is_key) m_generation += 1;
+
+  // Pack updated items into batch messages
+  uint8_t msg[PAYLOAD_MAX];
+  batch_t* header = (batch_t*) msg;
+  header->product = product;
+  header->generation = m_generation;
+  header->flags = (is_key ? KEY_FLAG : 0);
+  size_t pos = sizeof(batch_t);
+  int res = 0;
+  for (uint8_t i = 0; i < m_entries; i++) {
+    entry_t* ep = &m_entry[i];
+    if (!is_key && !ep->is_updated) continue;
+
+    // Read the value. Delta encode numeric values against the key
+    uint8_t value[PAYLOAD_MAX];
+    int size = m_reg->get_value(ep->blob, value, sizeof(value));
+    if (size < 0) continue;
+    int32_t current;
+    bool is_numeric = to_int(value, size, current);
+    int32_t delta = current - ep->key;
+    uint8_t encoding = FULL_VALUE;
+    size_t count = 1 + size;
+    if (is_numeric && !is_key) {
+      if (delta >= INT8_MIN && delta <= INT8_MAX) {
+	encoding = DELTA8;
+	count = sizeof(int8_t);
+      }
+      else if (delta >= INT16_MIN && delta <= INT16_MAX) {
+	encoding = DELTA16;
+	count = sizeof(int16_t);
+      }
+    }
+
+    // Send the batch if the item does not fit. Skip items that are
+    // larger than the payload; the update and key are kept
+    count += 1 + ep->len;
+    if (sizeof(batch_t) + count > PAYLOAD_MAX) continue;
+    if (pos + count > PAYLOAD_MAX) {
+      int err = m_dev->broadcast(PUBLISH_BATCH, msg, pos);
+      if (err < 0) return (err);
+      pos = sizeof(batch_t);
+      res += 1;
+    }
+    if (is_numeric && is_key) ep->key = current;
+    ep->is_updated = false;
+
+    // Append item header, path and value
+    msg[pos++] = (encoding << 4) | ep->len;
+    memcpy(&msg[pos], ep->path, ep->len);
+    pos += ep->len;
+    if (encoding == FULL_VALUE) {
+      msg[pos++] = size;
+      memcpy(&msg[pos], value, size);
+      pos += size;
+    }
+    else if (encoding == DELTA8) {
+      msg[pos++] = delta;
+    }
+    else {
+      int16_t d = delta;
+      memcpy(&msg[pos], &d, sizeof(d));
+      pos += sizeof(d);
+    }
+  }
+
+  // Send the last batch
+  if (pos > sizeof(batch_t)) {
+    int err = m_dev->broadcast(PUBLISH_BATCH, msg, pos);
+    if (err < 0) return (err);
+    res += 1;
+  }
+  return (res);
+}
+
+Rete::Manager::snapshot_t*
+Rete::Manager::lookup(uint8_t src, const uint8_t* path, uint8_t len)
+{
+  for (uint8_t i = 0; i < SNAPSHOT_MAX; i++) {
+    snapshot_t* sp = &m_snapshot[i];
+    if (sp->size != 0
+	&& sp->src == src
+	&& sp->len == len
+	&& !memcmp(sp->path, path, len))
+      return (sp);
+  }
+  return (NULL);
+}
+
+int
+Rete::Manager::decode(uint8_t src, const void* buf, size_t len)
+{
+  if (len < sizeof(batch_t)) return (EINVAL);
+  batch_t header;
+  memcpy(&header, buf, sizeof(header));
+  bool is_key = (header.flags & KEY_FLAG) != 0;
+  const uint8_t* bp = (const uint8_t*) buf + sizeof(header);
+  const uint8_t* end = (const uint8_t*) buf + len;
+  int res = 0;
+  while (bp < end) {
+    // Decode item header and path
+    uint8_t encoding = *bp >> 4;
+    uint8_t count = *bp++ & 0x0f;
+    if (count > Registry::PATH_MAX || bp + count > end) return (EINVAL);
+    const uint8_t* path = bp;
+    bp += count;
+
+    // Decode full value. Update the snapshot in a key batch
+    uint8_t value[sizeof(int32_t)];
+    const void* vp;
+    size_t size;
+    if (encoding == FULL_VALUE) {
+      if (bp >= end) return (EINVAL);
+      size = *bp++;
+      if (bp + size > end) return (EINVAL);
+      vp = bp;
+      bp += size;
+      int32_t key;
+      if (is_key && to_int((const uint8_t*) vp, size, key)) {
+	snapshot_t* sp = lookup(src, path, count);
+	if (sp == NULL) {
+	  for (uint8_t i = 0; i < SNAPSHOT_MAX && sp == NULL; i++)
+	    if (m_snapshot[i].size == 0) sp = &m_snapshot[i];
+	  if (sp == NULL) {
+	    sp = &m_snapshot[m_next];
+	    if (++m_next == SNAPSHOT_MAX) m_next = 0;
+	  }
+	  sp->src = src;
+	  sp->len = count;
+	  memcpy(sp->path, path, count);
+	}
+	sp->generation = header.generation;
+	sp->size = size;
+	sp->key = key;
+      }
+    }
+
+    // Decode delta value. Skip if there is no snapshot from the key
+    // batch of this generation
+    else {
+      int32_t delta;
+      if (encoding == DELTA8) {
+	if (bp + sizeof(int8_t) > end) return (EINVAL);
+	delta = (int8_t) *bp++;
+      }
+      else if (encoding == DELTA16) {
+	if (bp + sizeof(int16_t) > end) return (EINVAL);
+	int16_t d;
+	memcpy(&d, bp, sizeof(d));
+	bp += sizeof(d);
+	delta = d;
+      }
+      else return (EINVAL);
+      snapshot_t* sp = lookup(src, path, count);
+      if (sp == NULL || sp->generation != header.generation) continue;
+      int32_t current = sp->key + delta;
+      memcpy(value, &current, sp->size);
+      vp = value;
+      size = sp->size;
+    }
+
+    // Deliver the item value
+    on_publish(src, header.product, path, count, vp, size);
+    res += 1;
+  }
+  return (res);
+}
@@ -26,6 +26,18 @@
 #include "Cosa/Wireless.hh"
 #include "Cosa/Registry.hh"
 
+#ifndef COSA_RETE_BATCH_MAX
+#define COSA_RETE_BATCH_MAX 8
+#endif
+
+#ifndef COSA_RETE_SNAPSHOT_MAX
+#define COSA_RETE_SNAPSHOT_MAX 16
+#endif
+
+#ifndef COSA_RETE_PAYLOAD_MAX
+#define COSA_RETE_PAYLOAD_MAX 30
+#endif
+
 /**
  * Cosa Small Network Management and Data Distribution Protocol.
  * Maps application data with a registry and makes it available
@@ -37,6 +49,13 @@
  * version of DDS with only a publish message to broadcast registry
  * updates.
  *
+ * Registry updates may be batched; updated items are collected and
+ * published together in as few messages as possible. Numeric values
+ * (1, 2 or 4 bytes) are delta encoded against a key snapshot. All
+ * items are sent with full values every KEY_PERIOD batches (key
+ * batch). A receiver only applies deltas to a snapshot from the same
+ * key batch; a lost message does not corrupt later values.
+ *
  * @section References
  * 1. OMG Data Distribution Service Portal, http://portals.omg.org/dds/
  * 2. Simple Network Management Protocol,
@@ -44,6 +63,18 @@
  */
 class Rete {
 public:
+  /** Max number of items in batch table (Device). */
+  static const uint8_t BATCH_MAX = COSA_RETE_BATCH_MAX;
+
+  /** Max number of items in snapshot table (Manager). */
+  static const uint8_t SNAPSHOT_MAX = COSA_RETE_SNAPSHOT_MAX;
+
+  /** Max size of batch message payload. */
+  static const uint8_t PAYLOAD_MAX = COSA_RETE_PAYLOAD_MAX;
+
+  /** Number of batches per key batch. */
+  static const uint8_t KEY_PERIOD = 8;
+
   /**
    * A Rete::Device is the base-class of wireless sensor nodes. The
    * default behaviour is a periodic function that will handle power
@@ -60,7 +91,10 @@ public:
       Periodic(ms),
       m_dev(dev),
       m_reg(reg),
-      m_tid(0)
+      m_tid(0),
+      m_entries(0),
+      m_batches(0),
+      m_generation(0)
     {}
 
     /**
@@ -86,6 +120,28 @@ public:
       return (res > 0 ? m_tid++ : res);
     }
 
+    /**
+     * Mark the registry item with the given path as updated. The item
+     * value is published with the next flush(). Return zero(0) or
+     * negative error code; ENOENT if the path is not a binary object,
+     * ENOSPC if the batch table is full.
+     * @param[in] path in registry.
+     * @param[in] len length of path.
+     * @return zero or negative error code.
+     */
+    int update(const uint8_t* path, size_t len);
+
+    /**
+     * Publish the updated registry items in batch messages. Items are
+     * packed into as few messages as possible. Numeric values are
+     * delta encoded. All items are published with full value in a key
+     * batch every KEY_PERIOD call. Return number of messages sent or
+     * negative error code.
+     * @param[in] product identity.
+     * @return number of messages or negative error code.
+     */
+    int flush(uint16_t product);
+
     /**
      * @override Periodic
      * The Rete device periodic function; on wakeup data is measured
@@ -103,6 +159,27 @@ public:
 
     /** Next transaction identity (15b, positive number only). */
     int16_t m_tid;
+
+    /** Batch table entry; updated registry item and key value. */
+    struct entry_t {
+      Registry::blob_P blob;	//!< Registry item.
+      uint8_t path[Registry::PATH_MAX]; //!< Path in registry.
+      uint8_t len;		//!< Length of path.
+      bool is_updated;		//!< Updated since latest flush.
+      int32_t key;		//!< Value in latest key batch.
+    };
+
+    /** Batch table. */
+    entry_t m_entry[BATCH_MAX];
+
+    /** Number of entries in batch table. */
+    uint8_t m_entries;
+
+    /** Number of flushed batches. */
+    uint8_t m_batches;
+
+    /** Key batch generation. */
+    uint8_t m_generation;
   };
 
   class Manager {
@@ -113,8 +190,11 @@ public:
      */
     Manager(Wireless::Driver* dev) :
       m_dev(dev),
-      m_tid(0)
-    {}
+      m_tid(0),
+      m_next(0)
+    {
+      memset(m_snapshot, 0, sizeof(m_snapshot));
+    }
 
     /**
      * Send a registry get value request to given destination device and
@@ -190,14 +270,78 @@ public:
      */
     int listen(uint16_t ms);
 
+    /**
+     * Decode batch publish message (PUBLISH_BATCH) from given source
+     * device with given payload and length. Delta encoded values are
+     * applied to the snapshot from the same key batch; values without
+     * snapshot are skipped. The member function on_publish() is called
+     * for each item value. Return number of decoded items or negative
+     * error code; EINVAL if the message is not well formed.
+     * @param[in] src source device.
+     * @param[in] buf message payload.
+     * @param[in] len length of payload.
+     * @return number of items or negative error code.
+     */
+    int decode(uint8_t src, const void* buf, size_t len);
+
+    /**
+     * @override Rete::Manager
+     * Called by decode() for each published registry item value.
+     * Default is null function.
+     * @param[in] src source device.
+     * @param[in] product identity.
+     * @param[in] path in registry.
+     * @param[in] len length of path.
+     * @param[in] value buffer with item value.
+     * @param[in] size number of bytes in value.
+     */
+    virtual void on_publish(uint8_t src, uint16_t product,
+			    const uint8_t* path, size_t len,
+			    const void* value, size_t size)
+    {
+      UNUSED(src);
+      UNUSED(product);
+      UNUSED(path);
+      UNUSED(len);
+      UNUSED(value);
+      UNUSED(size);
+    }
+
   protected:
     /** Wireless device. */
     Wireless::Driver* m_dev;
 
     /** Next transaction identity (15b, positive number only). */
     int16_t m_tid;
+
+    /** Snapshot table entry; key value of numeric registry item. */
+    struct snapshot_t {
+      uint8_t src;		//!< Source device.
+      uint8_t generation;	//!< Key batch generation.
+      uint8_t size;		//!< Value size, zero if free entry.
+      uint8_t len;		//!< Length of path.
+      uint8_t path[Registry::PATH_MAX]; //!< Path in registry.
+      int32_t key;		//!< Value in key batch.
+    };
+
+    /** Snapshot table. */
+    snapshot_t m_snapshot[SNAPSHOT_MAX];
+
+    /** Next snapshot entry to replace when table is full. */
+    uint8_t m_next;
+
+    /**
+     * Lookup snapshot entry for given source device and path. Return
+     * pointer to entry or NULL.
+     * @param[in] src source device.
+     * @param[in] path in registry.
+     * @param[in] len length of path.
+     * @return entry or NULL.
+     */
+    snapshot_t* lookup(uint8_t src, const uint8_t* path, uint8_t len);
   };
 
+
 protected:
   /**
    * Message types.
@@ -211,6 +355,28 @@ protected:
     PUT_RESPONSE,		//!< - response with status.
     APPLY_REQUEST,		//!< Apply registry action request.
     APPLY_RESPONSE,		//!< - reponse with result.
+    PUBLISH_BATCH		//!< Publish batch of registry updates.
+  } __attribute__((packed));
+
+  /** Batch message header. */
+  struct batch_t {
+    uint16_t product;		//!< Product identity.
+    uint8_t generation;		//!< Key batch generation.
+    uint8_t flags;		//!< Message flags (KEY_FLAG).
+  };
+
+  /** Batch message flag; key batch with full values. */
+  static const uint8_t KEY_FLAG = 0x01;
+
+  /**
+   * Batch item value encoding; high nibble of the item header. The
+   * low nibble is the path length. The path follows the header. Full
+   * values are prefixed with the size.
+   */
+  enum {
+    FULL_VALUE = 0,		//!< Size and value.
+    DELTA8 = 1,			//!< Delta value (int8_t).
+    DELTA16 = 2			//!< Delta value (int16_t).
   } __attribute__((packed));
 };
 
@@ -24,6 +24,7 @@
 #include "Cosa/Types.h"
 #include "Cosa/INET.hh"
 #include "Cosa/IOStream.hh"
+#include "Cosa/Event.hh"
 
 /**
  * Abstract Interface for Internet Sockets.
@@ -271,6 +272,22 @@ public:
    */
   virtual int recv(void* buf, size_t len, uint8_t src[4], uint16_t& port) = 0;
 
+  /**
+   * @override Socket
+   * Set handler for socket readiness events (CONNECT_TYPE,
+   * DISCONNECT_TYPE, RECEIVE_COMPLETED_TYPE, SEND_COMPLETED_TYPE and
+   * TIMEOUT_TYPE). Returns true(1) if the socket will deliver events
+   * to the handler otherwise false(0) and the socket must be polled.
+   * Default is polling only.
+   * @param[in] handler event handler (NULL to detach).
+   * @return bool.
+   */
+  virtual bool set_event_handler(Event::Handler* handler)
+  {
+    UNUSED(handler);
+    return (false);
+  }
+
 protected:
   /** Source address; MAC, IP and port. */
   INET::addr_t m_src;
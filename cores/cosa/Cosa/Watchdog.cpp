@@ -29,6 +29,7 @@ void* Watchdog::s_env = NULL;
 volatile uint32_t Watchdog::s_ticks = 0L;
 uint8_t Watchdog::s_prescale;
 bool Watchdog::s_initiated = false;
+volatile uint16_t Watchdog::s_step = 1;
 
 uint8_t
 Watchdog::as_prescale(uint16_t ms)
@@ -47,6 +48,21 @@ Watchdog::begin(uint16_t ms,
   // Map milli-seconds to watchdog prescale values
   uint8_t prescale = as_prescale(ms);
 
+  // Update the watchdog registers
+  setup(prescale);
+  s_step = 1;
+
+  // Register the interrupt handler
+  s_handler = handler;
+  s_env = env;
+  s_prescale = prescale;
+  s_initiated = true;
+  ::delay = Watchdog::delay;
+}
+
+void
+Watchdog::setup(uint8_t prescale)
+{
   // Create new watchdog configuration
   uint8_t config = _BV(WDIE) | (prescale & 0x07);
   if (prescale > 0x07) config |= _BV(WDP3);
@@ -58,13 +74,6 @@ Watchdog::begin(uint16_t ms,
     WDTCSR = _BV(WDCE) | _BV(WDE);
     WDTCSR = config;
   }
-
-  // Register the interrupt handler
-  s_handler = handler;
-  s_env = env;
-  s_prescale = prescale;
-  s_initiated = true;
-  ::delay = Watchdog::delay;
 }
 
 void
@@ -84,6 +93,14 @@ Watchdog::delay(uint32_t ms)
 
 ISR(WDT_vect)
 {
+  // Check for end of tickless idle period; restore tick period
+  uint16_t step = Watchdog::s_step;
+  if (UNLIKELY(step != 1)) {
+    Watchdog::s_ticks += step;
+    Watchdog::s_step = 1;
+    Watchdog::setup(Watchdog::s_prescale);
+    return;
+  }
   Watchdog::s_ticks += 1;
   Watchdog::InterruptHandler handler = Watchdog::s_handler;
   if (handler == NULL) return;
@@ -27,9 +27,35 @@
 #include "Cosa/Event.hh"
 #include "Cosa/Linkage.hh"
 
+/**
+ * Max tickless idle period (milli-seconds). A wakeup by another
+ * interrupt source ends the idle period and the part of the period
+ * is not added to the clock. The max period is a trade-off between
+ * number of wakeups and clock lag after such wakeups.
+ */
+#ifndef COSA_WATCHDOG_IDLE_MAX
+#define COSA_WATCHDOG_IDLE_MAX 1024
+#endif
+
+/**
+ * Max number of scheduled deadlines; exact timeout events, see
+ * Watchdog::schedule().
+ */
+#ifndef COSA_WATCHDOG_DEADLINE_MAX
+#define COSA_WATCHDOG_DEADLINE_MAX 8
+#endif
+
 /**
  * The AVR Watchdog is used as a low power timer for periodical
- * events and delay.
+ * events and delay. Tickless idle, idle(), powers down until the
+ * next timeout event without waking up on every tick.
+ *
+ * Timeout events are either periodic with the period rounded to
+ * a power of two ticks, attach(), or at an absolute deadline,
+ * schedule(). Deadlines are kept in a binary heap and the event is
+ * pushed on the first tick at or after the deadline. A periodic
+ * target that reschedules with the previous deadline plus the period
+ * will not drift.
  */
 class Watchdog {
 public:
@@ -105,6 +131,25 @@ public:
    */
   static void attach(Link* target, uint16_t ms);
 
+  /**
+   * Schedule target to receive a timeout event at the given deadline
+   * (Watchdog clock, millis()). A target has at most one deadline;
+   * the deadline of an already scheduled target is updated. Requires
+   * interrupt handler push_timeout_events(). Returns zero or negative
+   * error code (ENOSPC) if there are already max number of deadlines,
+   * COSA_WATCHDOG_DEADLINE_MAX.
+   * @param[in] target timeout target.
+   * @param[in] expires deadline in milli-seconds.
+   * @return zero or negative error code.
+   */
+  static int schedule(Link* target, uint32_t expires);
+
+  /**
+   * Cancel scheduled deadline for given target, if any.
+   * @param[in] target timeout target.
+   */
+  static void cancel(Link* target);
+
   /**
    * Start watchdog with given period (milli-seconds) and sleep mode.
    * The timeout period is mapped to 16 milli-seconds and double
@@ -123,6 +168,21 @@ public:
    */
   static void delay(uint32_t ms);
 
+  /**
+   * Tickless idle; sleep until the next timeout event or the given
+   * number of milli-seconds, which ever comes first. Ticks without
+   * timeout events are skipped with longer watchdog periods (max
+   * COSA_WATCHDOG_IDLE_MAX ms) and added to the clock when the
+   * periods end. The RTC is compensated for the ticks when the sleep
+   * mode stops the RTC timer. The sleep is a single tick when the RTC
+   * timer is running in idle mode. Requires interrupt handler
+   * push_timeout_events() or none; with other handlers the sleep is
+   * a single tick. Returns number of wakeups.
+   * @param[in] ms max sleep period in milli-seconds (default forever).
+   * @return number of wakeups.
+   */
+  static uint8_t idle(uint32_t ms = UINT32_MAX);
+
   /**
    * Wait for the next watchdog timeout.
    */
@@ -150,12 +210,14 @@ public:
   static void end()
   {
     wdt_disable();
+    s_step = 1;
     s_initiated = false;
   }
 
   /**
    * Default interrupt handler for timeout queues; push timeout events
-   * to all attached event handlers.
+   * to all attached event handlers and to scheduled targets with
+   * expired deadlines.
    * @param[in] env interrupt handler environment.
    */
   static void push_timeout_events(void* env);
@@ -184,11 +246,28 @@ private:
   static const uint8_t TIMEQ_MAX = 10;
   static Head s_timeq[TIMEQ_MAX];
 
+  // Watchdog deadlines; binary heap ordered by expire time.
+  struct deadline_t {
+    uint32_t expires;
+    Link* target;
+  };
+  static deadline_t s_deadline[COSA_WATCHDOG_DEADLINE_MAX];
+  static volatile uint8_t s_deadlines;
+
   // Watchdog ticks, prescale and mode.
   static volatile uint32_t s_ticks;
   static uint8_t s_prescale;
   static bool s_initiated;
 
+  // Number of ticks per watchdog timeout; greater than one in idle.
+  static volatile uint16_t s_step;
+
+  /**
+   * Set watchdog timeout period with given prescale.
+   * @param[in] prescale watchdog prescale.
+   */
+  static void setup(uint8_t prescale);
+
   /**
    * Calculate watchdog prescale given timeout period (in milli-seconds).
    * @param[in] ms timeout period.
@@ -196,6 +275,15 @@ private:
    */
   static uint8_t as_prescale(uint16_t ms);
 
+  /**
+   * Place the given deadline in the heap starting at the given free
+   * position; sift up or down. Should be called with interrupts
+   * disabled.
+   * @param[in] ix free position in heap.
+   * @param[in] deadline to place.
+   */
+  static void place(uint8_t ix, deadline_t deadline);
+
   /** Interrupt Service Routine. */
   friend void WDT_vect(void);
 };
@@ -0,0 +1,117 @@
+/**
+ * @file Cosa/Watchdog_idle.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Watchdog.hh"
+#include "Cosa/Power.hh"
+#include "Cosa/RTC.hh"
+
+uint8_t
+Watchdog::idle(uint32_t ms)
+{
+  // Check that the watchdog is running and not in an idle period
+  if (!s_initiated || s_step != 1) {
+    Power::sleep();
+    return (1);
+  }
+
+  // Number of ticks to the max sleep period (at least one tick)
+  uint16_t ms_per_tick = Watchdog::ms_per_tick();
+  uint32_t ticks = (ms / ms_per_tick) + ((ms % ms_per_tick) != 0);
+  if (ticks == 0) ticks = 1;
+
+  // Number of ticks to the next timeout event. A time queue level
+  // is pushed when the ticks counter plus one is a multiple of the
+  // level period. The first non-empty level has the earliest event.
+  // The first deadline is pushed on the first tick at or after it
+  uint32_t start;
+  int32_t diff = 0;
+  bool scheduled;
+  synchronized {
+    start = s_ticks;
+    scheduled = (s_deadlines != 0);
+    if (scheduled) diff = s_deadline[0].expires - start * ms_per_tick;
+  }
+  if (s_handler == push_timeout_events) {
+    if (scheduled) {
+      uint32_t next = 1;
+      if (diff > 0) next = (diff + ms_per_tick - 1) / ms_per_tick;
+      if (next < ticks) ticks = next;
+    }
+    for (uint8_t i = s_prescale; i < TIMEQ_MAX; i++) {
+      if (s_timeq[i].is_empty()) continue;
+      uint32_t period = 1UL << (i - s_prescale);
+      uint32_t next = ((start + 1) / period + 1) * period - 1;
+      if (next - start < ticks) ticks = next - start;
+      break;
+    }
+  }
+  else if (s_handler != NULL) {
+    ticks = 1;
+  }
+
+  // The RTC timer interrupt wakes up every milli-second in idle mode;
+  // a longer watchdog period would always be ended early
+  if (RTC::is_initiated() && (Power::get() == SLEEP_MODE_IDLE)) ticks = 1;
+
+  // Skip ticks without timeout events with longer watchdog periods.
+  // Stop on wakeup by other interrupt sources and restore the tick
+  // period so that millis() continues to advance. There is no running
+  // timer to measure the time slept; the watchdog counter cannot be
+  // read. The part of the period is not added so that timeouts are
+  // never early
+  uint8_t max = as_prescale(COSA_WATCHDOG_IDLE_MAX) - s_prescale;
+  uint8_t wakeups = 0;
+  uint32_t skip = ticks - 1;
+  bool early = false;
+  while (skip > 1) {
+    uint8_t level = 0;
+    while ((level < max) && ((2UL << level) <= skip)) level++;
+    if (level == 0) break;
+    synchronized {
+      s_step = (1 << level);
+      setup(s_prescale + level);
+    }
+    Power::sleep();
+    wakeups += 1;
+    synchronized {
+      early = (s_step != 1);
+      if (early) {
+	s_step = 1;
+	setup(s_prescale);
+      }
+    }
+    if (early) break;
+    skip -= (1 << level);
+  }
+
+  // Sleep until the next tick and timeout events
+  if (!early) {
+    Power::sleep();
+    wakeups += 1;
+  }
+
+  // Compensate the RTC when the sleep mode stops the timer
+  if (RTC::is_initiated() && (Power::get() != SLEEP_MODE_IDLE)) {
+    uint32_t now;
+    synchronized now = s_ticks;
+    RTC::adjust((now - start) * ms_per_tick);
+  }
+  return (wakeups);
+}
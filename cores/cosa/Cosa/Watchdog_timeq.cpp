@@ -21,6 +21,21 @@
 #include "Cosa/Watchdog.hh"
 
 Head Watchdog::s_timeq[Watchdog::TIMEQ_MAX];
+Watchdog::deadline_t Watchdog::s_deadline[COSA_WATCHDOG_DEADLINE_MAX];
+volatile uint8_t Watchdog::s_deadlines = 0;
+
+/**
+ * Return true if the first time stamp is before the second. Handles
+ * wrap-around of the millisecond clock.
+ * @param[in] first time stamp.
+ * @param[in] second time stamp.
+ * @return bool.
+ */
+static inline bool
+is_before(uint32_t first, uint32_t second)
+{
+  return ((int32_t) (first - second) < 0);
+}
 
 void
 Watchdog::attach(Link* target, uint16_t ms)
@@ -32,6 +47,65 @@ Watchdog::attach(Link* target, uint16_t ms)
   s_timeq[level].attach(target);
 }
 
+int
+Watchdog::schedule(Link* target, uint32_t expires)
+{
+  deadline_t deadline;
+  deadline.expires = expires;
+  deadline.target = target;
+  synchronized {
+    // Update the deadline if the target is already scheduled
+    uint8_t ix = 0;
+    while ((ix < s_deadlines) && (s_deadline[ix].target != target)) ix++;
+    if (ix == s_deadlines) {
+      if (UNLIKELY(s_deadlines == COSA_WATCHDOG_DEADLINE_MAX))
+	synchronized_return (ENOSPC);
+      s_deadlines += 1;
+    }
+    place(ix, deadline);
+  }
+  return (0);
+}
+
+void
+Watchdog::cancel(Link* target)
+{
+  synchronized {
+    for (uint8_t ix = 0; ix < s_deadlines; ix++) {
+      if (s_deadline[ix].target != target) continue;
+      // Fill the position with the last deadline
+      uint8_t last = s_deadlines - 1;
+      s_deadlines = last;
+      if (ix != last) place(ix, s_deadline[last]);
+      break;
+    }
+  }
+}
+
+void
+Watchdog::place(uint8_t ix, deadline_t deadline)
+{
+  // Sift up while the deadline is before the parent
+  while (ix > 0) {
+    uint8_t parent = (ix - 1) / 2;
+    if (!is_before(deadline.expires, s_deadline[parent].expires)) break;
+    s_deadline[ix] = s_deadline[parent];
+    ix = parent;
+  }
+
+  // Sift down while a child is before the deadline
+  uint8_t child;
+  while ((child = 2 * ix + 1) < s_deadlines) {
+    if ((child + 1 < s_deadlines)
+	&& is_before(s_deadline[child + 1].expires, s_deadline[child].expires))
+      child += 1;
+    if (!is_before(s_deadline[child].expires, deadline.expires)) break;
+    s_deadline[ix] = s_deadline[child];
+    ix = child;
+  }
+  s_deadline[ix] = deadline;
+}
+
 void
 Watchdog::push_timeout_events(void* env)
 {
@@ -40,5 +114,16 @@ Watchdog::push_timeout_events(void* env)
   for (uint8_t i = s_prescale; i < TIMEQ_MAX; i++, changed >>= 1)
     if ((changed & 1) && !s_timeq[i].is_empty())
       Event::push(Event::TIMEOUT_TYPE, &s_timeq[i], i);
+
+  // Push timeout events for expired deadlines in order. Retry on
+  // the next tick if the event queue is full
+  if (s_deadlines == 0) return;
+  uint32_t now = millis();
+  while ((s_deadlines != 0) && !is_before(now, s_deadline[0].expires)) {
+    if (!Event::push(Event::TIMEOUT_TYPE, s_deadline[0].target)) return;
+    uint8_t last = s_deadlines - 1;
+    s_deadlines = last;
+    if (last != 0) place(0, s_deadline[last]);
+  }
 }
 
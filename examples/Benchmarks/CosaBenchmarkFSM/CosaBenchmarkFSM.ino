@@ -22,7 +22,9 @@
  * for each received event sends an event to a connected machine.
  * The measurement contains the pushing of the event onto the event
  * queue, pulling and dispatch of the event to the receiving state
- * machine.
+ * machine. The same benchmark is run with the hierarchical state
+ * machine (HSM) with two sub-states and a transition between the
+ * sub-states (exit, action and entry) for each event.
  *
  * @section Circuit
  * This example requires no special circuit. Uses serial output,
@@ -32,12 +34,16 @@
  */
 
 #include "Cosa/FSM.hh"
+#include "Cosa/HSM.hh"
 #include "Cosa/Memory.h"
 #include "Cosa/RTC.hh"
 #include "Cosa/Watchdog.hh"
 #include "Cosa/Trace.hh"
 #include "Cosa/IOStream/Driver/UART.hh"
 
+// Benchmark mode; the state machines only echo in their mode
+enum { FSM_MODE, HSM_MODE } mode = FSM_MODE;
+
 /**
  * Simple echo state machine with a single state.
  */
@@ -65,7 +71,7 @@ public:
   {
     UNUSED(type);
     Echo* echo = (Echo*) fsm;
-    echo->m_port->send(Event::USER_TYPE);
+    if (mode == FSM_MODE) echo->m_port->send(Event::USER_TYPE);
     return (true);
   }
 
@@ -74,9 +80,62 @@ private:
   FSM* m_port;
 };
 
+/**
+ * Echo hierarchical state machine; the echo state has two sub-states
+ * and the event is sent in the transition between the sub-states.
+ */
+class HSMEcho : public HSM {
+public:
+  /**
+   * The transition action; send a reply.
+   */
+  static void echo(HSM* hsm)
+  {
+    HSMEcho* echo = (HSMEcho*) hsm;
+    if (mode == HSM_MODE) echo->m_port->send(Definition::ECHO_EVENT);
+  }
+
+  /**
+   * Echo machine definition.
+   */
+  struct Definition {
+    enum { ECHO, PING, PONG, STATE_MAX };
+    enum { ECHO_EVENT, TIMEOUT, EVENT_MAX };
+    static constexpr HSM::state_t states[STATE_MAX] = {
+      { HSM::NONE, PING, NULL, NULL },
+      { ECHO, HSM::NONE, NULL, NULL },
+      { ECHO, HSM::NONE, NULL, NULL }
+    };
+    static constexpr HSM::transition_t transitions[] = {
+      { PING, ECHO_EVENT, PONG, echo },
+      { PONG, ECHO_EVENT, PING, echo }
+    };
+  };
+
+  /**
+   * Construct the echo state machine.
+   */
+  HSMEcho() : HSM(HSM::Table<Definition>::get()), m_port(0) {}
+
+  /**
+   * Bind receiving hsm to port.
+   * @param[in] hsm state machine to receive the event.
+   */
+  void bind(HSMEcho* hsm)
+  {
+    m_port = hsm;
+  }
+
+private:
+  /** Port (pointer) to receiving state-machine */
+  HSMEcho* m_port;
+};
+
 // The ping-pong state machines
 Echo ping;
 Echo pong;
+HSMEcho hping;
+HSMEcho hpong;
 
 void setup()
 {
@@ -92,6 +151,8 @@ void setup()
   TRACE(sizeof(Link));
   TRACE(sizeof(FSM));
   TRACE(sizeof(Echo));
+  TRACE(sizeof(HSM));
+  TRACE(sizeof(HSMEcho));
 
   // Give some more startup info
   TRACE(F_CPU);
@@ -104,19 +165,38 @@ void setup()
   // Bind the state machines to each other
   ping.bind(&pong);
   pong.bind(&ping);
-
-  // Send a first event to start the benchmark
-  ping.send(Event::USER_TYPE);
+  hping.bind(&hpong);
+  hpong.bind(&hping);
+  hping.begin();
+  hpong.begin();
 }
 
 void loop()
 {
+  Event event;
+
+  // Send a first event to start the benchmark
+  mode = FSM_MODE;
+  ping.send(Event::USER_TYPE);
+
   // Dispatch events and measure time per dispatch
-  MEASURE("event dispatch: ", 1000) {
-    Event event;
+  MEASURE("FSM event dispatch: ", 1000) {
+    Event::queue.await(&event);
+    event.dispatch();
+  }
+
+  // Stop the FSM ping-pong and run the HSM benchmark
+  mode = HSM_MODE;
+  Event::queue.await(&event);
+  event.dispatch();
+  hping.send(HSMEcho::Definition::ECHO_EVENT);
+  MEASURE("HSM event dispatch: ", 1000) {
     Event::queue.await(&event);
     event.dispatch();
   }
+  mode = FSM_MODE;
+  Event::queue.await(&event);
+  event.dispatch();
 
   // Run the loop a limited number of times
   static uint8_t count = 0;
@@ -17,7 +17,9 @@
  *
  * @section Description
  * Cosa ProtoThread Benchmark; number of micro-seconds for a thread
- * dispatch and enqueuing in watchdog timer queue.
+ * dispatch and enqueuing in watchdog timer queue. Number of thread
+ * dispatches per second with waiting threads; polling with
+ * PROTO_THREAD_AWAIT() compared to PROTO_THREAD_AWAIT_SIGNAL().
  *
  * @section Circuit
  * This example requires no special circuit. Uses serial output.
@@ -66,6 +68,68 @@ Counter cnt1(32);
 Counter cnt2(128);
 Counter cnt3(512);
 
+// Tick counter and signal. Waiter threads poll or wait for signal
+ProtoThread::Signal tick;
+volatile uint16_t ticks = 0;
+bool use_signal = false;
+
+// Ticker thread; increment tick counter and notify waiting threads
+class Ticker : public ProtoThread {
+public:
+  Ticker(uint16_t delay) :
+    ProtoThread(),
+    m_delay(delay)
+  {}
+
+  virtual void run(uint8_t type, uint16_t value)
+  {
+    UNUSED(type);
+    UNUSED(value);
+    PROTO_THREAD_BEGIN();
+    while (1) {
+      PROTO_THREAD_DELAY(m_delay);
+      ticks += 1;
+      tick.notify();
+    }
+    PROTO_THREAD_END();
+  }
+
+private:
+  uint16_t m_delay;
+};
+
+// Waiter thread class; wait for the next tick
+class Waiter : public ProtoThread {
+public:
+  Waiter() :
+    ProtoThread(),
+    m_ticks(0)
+  {}
+
+  virtual void run(uint8_t type, uint16_t value)
+  {
+    UNUSED(type);
+    UNUSED(value);
+    PROTO_THREAD_BEGIN();
+    while (1) {
+      if (use_signal)
+	PROTO_THREAD_AWAIT_SIGNAL(tick, ticks != m_ticks);
+      else
+	PROTO_THREAD_AWAIT(ticks != m_ticks);
+      m_ticks = ticks;
+    }
+    PROTO_THREAD_END();
+  }
+
+private:
+  uint16_t m_ticks;
+};
+
+// Ticker and waiting threads
+Ticker ticker(64);
+const uint8_t WAITER_MAX = 30;
+Waiter waiter[WAITER_MAX];
+
 void setup()
 {
   // Start the UART and trace output stream
@@ -86,6 +150,10 @@ void setup()
   cnt1.begin();
   cnt2.begin();
   cnt3.begin();
+
+  // Start the ticker and waiting threads
+  ticker.begin();
+  for (uint8_t i = 0; i < WAITER_MAX; i++) waiter[i].begin();
 }
 
 void loop()
@@ -100,6 +168,19 @@ void loop()
     event.dispatch();
   }
 
+  // Count thread dispatches and ticks during one second; waiting
+  // threads poll or wait for signal
+  uint32_t dispatched = ProtoThread::get_dispatched();
+  uint16_t start = ticks;
+  uint32_t now = RTC::millis();
+  while (RTC::since(now) < 1000) ProtoThread::dispatch();
+  dispatched = ProtoThread::get_dispatched() - dispatched;
+  trace << (use_signal ? PSTR("signal:") : PSTR("polling:"))
+	<< PSTR("ticks=") << ticks - start
+	<< PSTR(",dispatched=") << dispatched
+	<< endl;
+  use_signal = !use_signal;
+
   // Run the loop a limited number of times
   static uint8_t count = 0;
   count += 1;
@@ -0,0 +1,169 @@
+/**
+ * @file CosaBenchmarkVWI.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa VWI Benchmark; number of clock cycles for the VWI interrupt
+ * handler with run-time (VWI) and compile-time (StaticVWI) codec.
+ * The handler is called directly (the timer interrupt is disabled)
+ * and measured for receiver sampling, symbol decoding and
+ * transmitter bits. The measurement includes the loop overhead.
+ * The StaticVWI interrupt service routine (STATIC_VWI_ISR) calls the
+ * handler in the same way, without the virtual codec calls.
+ *
+ * The handler runs at SAMPLES_PER_BIT(8) times the bit rate. The max
+ * bit rate is limited by the handler cycles; the estimate below
+ * assumes that the handler may use at most half of the processor.
+ *
+ * @section Circuit
+ * This example requires no special circuit. Uses serial output,
+ * and pins D7-D8 (not connected).
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <VWI.h>
+#include <ManchesterCodec.h>
+
+#include "Cosa/RTC.hh"
+#include "Cosa/Memory.h"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// Select codec for the benchmark
+#define CODEC ManchesterCodec
+CODEC codec;
+
+// Network configuration
+#define NETWORK 0xC05A
+#define DEVICE 0x01
+#define SPEED 4000
+
+// Virtual Wire Interface with run-time and compile-time codec
+VWI vwi(NETWORK, DEVICE, SPEED, Board::D7, Board::D8, &codec);
+StaticVWI<CODEC> svwi(NETWORK, DEVICE, SPEED, Board::D7, Board::D8, &codec);
+STATIC_VWI_ISR(svwi);
+
+// Number of calls per measurement
+static const uint16_t COUNT = 1000;
+
+/**
+ * Print given number of micro-seconds for given number of calls as
+ * clock cycles per call and estimated max bit rate.
+ * @param[in] msg measurement name in program memory.
+ * @param[in] us micro-seconds.
+ * @param[in] count number of calls.
+ */
+static void
+report(str_P msg, uint32_t us, uint16_t count)
+{
+  uint32_t cycles = (us * I_CPU) / count;
+  trace << msg << cycles << PSTR(" cycles");
+  if (cycles != 0) trace << PSTR(", max ") << (F_CPU / 2) / (cycles * 8) << PSTR(" bps");
+  trace << endl;
+}
+
+/**
+ * Measure receiver sampling; the Phase Locked Loop with the
+ * receiver pin idle.
+ * @param[in] RF device driver class (VWI or StaticVWI).
+ * @param[in] msg measurement name in program memory.
+ * @param[in] rf device driver.
+ */
+template<class RF>
+static void
+receiver(str_P msg, RF& rf)
+{
+  rf.powerup();
+  TIMSK1 &= ~_BV(OCIE1A);
+  uint32_t start = RTC::micros();
+  for (uint16_t i = 0; i < COUNT; i++) rf.on_interrupt();
+  uint32_t us = RTC::since(start);
+  rf.powerdown();
+  report(msg, us, COUNT);
+}
+
+/**
+ * Measure transmitter; send a message and call the interrupt handler
+ * until the message has been sent.
+ * @param[in] RF device driver class (VWI or StaticVWI).
+ * @param[in] msg measurement name in program memory.
+ * @param[in] rf device driver.
+ */
+template<class RF>
+static void
+transmitter(str_P msg, RF& rf)
+{
+  static const char payload[] = "Cosa VWI benchmark";
+  rf.send(0x02, 0x00, payload, sizeof(payload));
+  TIMSK1 &= ~_BV(OCIE1A);
+  uint16_t count = 0;
+  uint32_t start = RTC::micros();
+  do {
+    rf.on_interrupt();
+    count += 1;
+  } while (count < UINT16_MAX && rf.is_transmitting());
+  uint32_t us = RTC::since(start);
+  report(msg, us, count);
+}
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaBenchmarkVWI: started"));
+
+  // Check amount of free memory and size of instances
+  TRACE(free_memory());
+  TRACE(sizeof(VWI));
+  TRACE(sizeof(StaticVWI<CODEC>));
+
+  // Give some more startup info
+  TRACE(F_CPU);
+  TRACE(I_CPU);
+
+  // Start the timers
+  Watchdog::begin();
+  RTC::begin();
+}
+
+void loop()
+{
+  // Symbol decoding; virtual member function or inline
+  VWI::Codec* cp = &codec;
+  volatile uint16_t bits = 0x5555;
+  volatile uint8_t data;
+  uint32_t start = RTC::micros();
+  for (uint16_t i = 0; i < COUNT; i++) data = cp->decode8(bits);
+  report(PSTR("VWI decode8: "), RTC::since(start), COUNT);
+  start = RTC::micros();
+  for (uint16_t i = 0; i < COUNT; i++) {
+    uint16_t symbols = bits;
+    data = (codec.CODEC::decode4(symbols) << 4)
+      | codec.CODEC::decode4(symbols >> CODEC::BITS);
+  }
+  report(PSTR("StaticVWI decode8: "), RTC::since(start), COUNT);
+  UNUSED(data);
+
+  // Receiver sampling and transmitter bits
+  receiver(PSTR("VWI receiver: "), vwi);
+  receiver(PSTR("StaticVWI receiver: "), svwi);
+  transmitter(PSTR("VWI transmitter: "), vwi);
+  transmitter(PSTR("StaticVWI transmitter: "), svwi);
+  trace << endl;
+
+  sleep(5);
+}
@@ -0,0 +1,142 @@
+/**
+ * @file CosaCoroutine.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa Coroutine demonstration; a blinker with exact delay, a
+ * producer that sends sample events and enqueues samples, and a
+ * consumer that awaits the sample events with timeout and the queue
+ * availability. All coroutines are driven by the event dispatch.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/Coroutine.hh"
+#include "Cosa/OutputPin.hh"
+#include "Cosa/Queue.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// Sample event type and queue
+static const uint8_t SAMPLE_TYPE = Event::USER_TYPE;
+Queue<uint16_t, 8> queue;
+
+class Blinker : public Coroutine {
+public:
+  Blinker(Board::DigitalPin pin, uint16_t ms) :
+    Coroutine(),
+    m_pin(pin),
+    m_ms(ms)
+  {}
+
+  virtual void run()
+  {
+    COROUTINE_BEGIN();
+    while (1) {
+      m_pin.toggle();
+      COROUTINE_DELAY(m_ms);
+    }
+    COROUTINE_END();
+  }
+
+private:
+  OutputPin m_pin;
+  uint16_t m_ms;
+};
+
+class Consumer : public Coroutine {
+public:
+  Consumer() :
+    Coroutine(),
+    m_sum(0)
+  {}
+
+  virtual void run()
+  {
+    COROUTINE_BEGIN();
+    while (1) {
+      // Await sample events; the producer stops every fourth second
+      COROUTINE_AWAIT_EVENT(SAMPLE_TYPE, 1500);
+      if (is_timeout()) {
+	trace << Watchdog::millis() << PSTR(":timeout") << endl;
+	continue;
+      }
+      m_sum += get_value();
+
+      // Await the batch of samples in the queue
+      COROUTINE_AWAIT(queue.available() == 4);
+      while (queue.dequeue(&m_sample)) m_sum += m_sample;
+      trace << Watchdog::millis() << PSTR(":sum=") << m_sum << endl;
+      m_sum = 0;
+    }
+    COROUTINE_END();
+  }
+
+private:
+  uint16_t m_sample;
+  uint16_t m_sum;
+};
+
+class Producer : public Coroutine {
+public:
+  Producer(Consumer* consumer) :
+    Coroutine(),
+    m_consumer(consumer),
+    m_nr(0)
+  {}
+
+  virtual void run()
+  {
+    COROUTINE_BEGIN();
+    while (1) {
+      COROUTINE_DELAY(1000);
+      m_nr += 1;
+      if ((m_nr & 3) == 0) continue;
+      Event::push(SAMPLE_TYPE, m_consumer, m_nr);
+      for (m_ix = 0; m_ix < 4; m_ix++) {
+	COROUTINE_DELAY(32);
+	queue.enqueue(&m_nr);
+      }
+    }
+    COROUTINE_END();
+  }
+
+private:
+  Consumer* m_consumer;
+  uint16_t m_nr;
+  uint8_t m_ix;
+};
+
+Blinker blinker(Board::LED, 512);
+Consumer consumer;
+Producer producer(&consumer);
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaCoroutine: started"));
+  TRACE(sizeof(Coroutine));
+  Watchdog::begin(16, Watchdog::push_timeout_events);
+  blinker.begin();
+  consumer.begin();
+  producer.begin();
+}
+
+void loop()
+{
+  Event::service();
+}
@@ -33,6 +33,12 @@
  * 1. Powered via FTDI USB/TTY adapter 5 V, 18 uA
  * 2. Powered with LiPo 3,7 V, 16 uA
  *
+ * Blink while the button is pressed; watchdog wakeups per 512 ms
+ * blink period (wakeup count is stored in wakeups):
+ * 1. Watchdog delay, 16 ms ticks: 32 wakeups.
+ * 2. Tickless idle (USE_TICKLESS_IDLE), periodic timeout event: 6
+ *    wakeups (16, 8, 4 and 2 tick periods, and two single ticks).
+ *
  * This file is part of the Arduino Che Cosa project.
  */
 
@@ -40,15 +46,32 @@
 #include "Cosa/OutputPin.hh"
 #include "Cosa/Power.hh"
 #include "Cosa/ExternalInterrupt.hh"
+#include "Cosa/Periodic.hh"
 #include "Cosa/Watchdog.hh"
 
 #define USE_DISABLE_MODULES
 #define USE_DISABLE_PINS
 #define USE_EVENT_AWAIT
 #define USE_WATCHDOG_DELAY
+// #define USE_TICKLESS_IDLE
 
 OutputPin led(Board::LED);
 
+// Number of watchdog wakeups while blinking
+uint32_t wakeups = 0L;
+
+#if defined(USE_TICKLESS_IDLE)
+class Blinker : public Periodic {
+public:
+  Blinker(OutputPin* led, uint16_t ms) : Periodic(ms), m_led(led) {}
+  virtual void run() { m_led->toggle(); }
+private:
+  OutputPin* m_led;
+};
+
+Blinker blinker(&led, 512);
+#endif
+
 class Button : public ExternalInterrupt {
   OutputPin* m_led;
 public:
@@ -105,15 +128,29 @@ void loop()
   Power::sleep();
 #endif
 
-#ifdef USE_WATCHDOG_DELAY
+#if defined(USE_TICKLESS_IDLE)
+  // Periodic blink; sleep until the next timeout event
+  Watchdog::begin(16, Watchdog::push_timeout_events);
+  blinker.begin();
+  while (wakeup.is_low()) {
+    Event event;
+    while (Event::queue.dequeue(&event)) event.dispatch();
+    wakeups += Watchdog::idle();
+  }
+  blinker.end();
+  led.off();
+  Watchdog::end();
+#elif defined(USE_WATCHDOG_DELAY)
   // 1,5 mA, 64 ms blink
   Watchdog::begin();
   delay = Watchdog::delay;
+  uint32_t start = Watchdog::ticks();
   while (wakeup.is_low()) {
     led.toggle();
     // Watchdog::delay(64);
     delay(64);
   }
+  wakeups += Watchdog::ticks() - start;
   led.off();
   Watchdog::end();
 #else
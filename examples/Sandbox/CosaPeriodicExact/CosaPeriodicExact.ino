@@ -0,0 +1,101 @@
+/**
+ * @file CosaPeriodicExact.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Exact period periodic functions; sample an analog pin every 100 ms
+ * and report every second. The report contains number of samples
+ * (should be 10 per second), max lateness (ms) and overruns of
+ * both the sampler and the reporter. Compare with exact period false;
+ * the sampler period is then 128 ms.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/AnalogPin.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/Periodic.hh"
+
+// Exact period or power of two watchdog ticks
+#define EXACT true
+
+class Sampler : public Periodic {
+public:
+  Sampler(Board::AnalogPin pin, uint16_t ms) :
+    Periodic(ms, EXACT),
+    m_pin(pin),
+    m_samples(0),
+    m_sum(0)
+  {}
+
+  virtual void run()
+  {
+    m_sum += m_pin.sample();
+    m_samples += 1;
+  }
+
+  AnalogPin m_pin;
+  uint16_t m_samples;
+  uint32_t m_sum;
+};
+
+class Reporter : public Periodic {
+public:
+  Reporter(Sampler* sampler, uint16_t ms) :
+    Periodic(ms, EXACT),
+    m_sampler(sampler)
+  {}
+
+  virtual void run()
+  {
+    uint16_t samples = m_sampler->m_samples;
+    uint32_t sum = m_sampler->m_sum;
+    m_sampler->m_samples = 0;
+    m_sampler->m_sum = 0;
+    trace << Watchdog::millis()
+	  << PSTR(":samples=") << samples
+	  << PSTR(",average=") << (samples ? sum / samples : 0)
+	  << PSTR(",lateness=") << m_sampler->get_lateness()
+	  << '/' << get_lateness()
+	  << PSTR(",overruns=") << m_sampler->get_overruns()
+	  << '/' << get_overruns()
+	  << endl;
+  }
+
+private:
+  Sampler* m_sampler;
+};
+
+Sampler sampler(Board::A0, 100);
+Reporter reporter(&sampler, 1000);
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaPeriodicExact: started"));
+  Watchdog::begin(16, Watchdog::push_timeout_events);
+  sampler.begin();
+  reporter.begin();
+}
+
+void loop()
+{
+  Event event;
+  Event::queue.await(&event);
+  event.dispatch();
+}
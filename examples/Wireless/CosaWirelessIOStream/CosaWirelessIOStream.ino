@@ -16,7 +16,8 @@
  * Lesser General Public License for more details.
  *
  * @section Description
- * Wireless IOStream demo.
+ * Wireless IOStream demo. Define RELIABLE to use the reliable stream
+ * driver (RWIO); the receiver should then be CosaWirelessRWIO.
  *
  * @section Circuit
  * See Wireless drivers for circuit connections.
@@ -29,7 +30,12 @@
 #include "Cosa/RTC.hh"
 #include "Cosa/Watchdog.hh"
 #include "Cosa/Trace.hh"
+#include "Cosa/Timer.hh"
 #include "Cosa/IOStream/Driver/WIO.hh"
+#include "Cosa/IOStream/Driver/RWIO.hh"
+
+// Select unreliable (WIO) or reliable (RWIO) stream
+// #define RELIABLE
 
 // Configuration; network and device addresses
 #define NETWORK 0xC05A
@@ -72,7 +78,11 @@ VWI rf(NETWORK, DEVICE, SPEED, Board::D7, Board::D8, &codec);
 static const uint8_t IOSTREAM_TYPE = 0x00;
 #define DEST 0x01
 
+#if defined(RELIABLE)
+RWIO wio(&rf, DEST, IOSTREAM_TYPE);
+#else
 WIO wio(&rf, DEST, IOSTREAM_TYPE);
+#endif
 
 void setup()
 {
@@ -80,6 +90,10 @@ void setup()
   Watchdog::begin();
   RTC::begin();
   rf.begin();
+#if defined(RELIABLE)
+  Timer::begin();
+  wio.begin();
+#endif
   trace << PSTR("\fWIO: connected") << flush;
   sleep(2);
 }
@@ -139,4 +153,14 @@ void loop()
   trace << flush;
   sleep(2);
 #endif
+
+#if defined(RELIABLE)
+  trace << clear;
+  trace << PSTR("RT: ") << wio.get_srtt();
+  trace << PSTR(",") << wio.get_rto() << endl;
+  trace << PSTR("ER: ") << wio.get_retransmits();
+  trace << PSTR(",") << wio.get_drops();
+  trace << flush;
+  sleep(2);
+#endif
 }
@@ -0,0 +1,80 @@
+/**
+ * @file CosaWirelessRWIO.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Wireless reliable stream demo; print the stream from
+ * CosaWirelessIOStream (with RELIABLE defined) to the UART. Lines
+ * from the UART are sent back on the stream.
+ *
+ * @section Circuit
+ * See Wireless drivers for circuit connections.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Cosa/RTC.hh"
+#include "Cosa/Timer.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/IOStream/Driver/RWIO.hh"
+
+// Configuration; network and device addresses
+#define NETWORK 0xC05A
+#define DEVICE 0x01
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+
+// Stream peer; CosaWirelessIOStream
+static const uint8_t IOSTREAM_TYPE = 0x00;
+#if defined(BOARD_ATTINY)
+#define PEER 0x40
+#else
+#define PEER 0x41
+#endif
+
+RWIO rwio(&rf, PEER, IOSTREAM_TYPE);
+
+void setup()
+{
+  uart.begin(9600);
+  Watchdog::begin();
+  RTC::begin();
+  Timer::begin();
+  rf.begin();
+  rwio.begin();
+}
+
+void loop()
+{
+  // Print received characters
+  int c;
+  while ((c = rwio.getchar()) != IOStream::EOF) uart.putchar(c);
+
+  // Send line from the UART to the peer
+  while ((c = uart.getchar()) != IOStream::EOF) {
+    rwio.putchar(c);
+    if (c == '\n') rwio.flush();
+  }
+}
@@ -16,8 +16,10 @@
  * Lesser General Public License for more details.
  *
  * @section Description
- * Cosa Wireless interface demo; relay messages from CosaWirelessSender
- * and forward to CosaWirelessReceiver.
+ * Cosa Wireless interface demo; mesh router. Forward routed messages
+ * (Mesh) hop by hop between nodes and periodically print the neighbor
+ * and route table. Messages from nodes that do not use Mesh, such as
+ * CosaWirelessSender, are routed to CosaWirelessReceiver (DEST).
  *
  * @section Circuit
  * See Wireless drivers for circuit connections.
@@ -25,8 +27,9 @@
  * This file is part of the Arduino Che Cosa project.
  */
 
+#include <Mesh.h>
+
 #include "Cosa/Trace.hh"
-#include "Cosa/OWI/Driver/DS18B20.hh"
 #include "Cosa/IOStream/Driver/UART.hh"
 #include "Cosa/Watchdog.hh"
 #include "Cosa/RTC.hh"
@@ -66,46 +69,50 @@ VWI rf(NETWORK, DEVICE, SPEED, Board::D1, Board::D0, &codec);
 VWI rf(NETWORK, DEVICE, SPEED, Board::D7, Board::D8, &codec);
 #endif
 
+// Mesh router; device payload size should be the same on all nodes
+#define PAYLOAD 30
+Mesh mesh(&rf, PAYLOAD);
+
 void setup()
 {
   uart.begin(9600);
   trace.begin(&uart, PSTR("CosaWirelessRelay: started"));
   Watchdog::begin();
   RTC::begin();
-  rf.begin();
+  ASSERT(mesh.begin());
 }
 
 void loop()
 {
-  // Receive a message
+  // Receive a message; forwarding and beacons are handled while waiting
   const uint32_t TIMEOUT = 5000;
-  const uint8_t MSG_MAX = rf.PAYLOAD_MAX;
-  uint8_t msg[MSG_MAX];
+  uint8_t msg[Mesh::PAYLOAD_MAX];
   uint8_t src;
   uint8_t port;
-  int count = rf.recv(src, port, msg, sizeof(msg), TIMEOUT);
+  int count = mesh.recv(src, port, msg, sizeof(msg), TIMEOUT);
 
-  // Print the message header
-  if (count >= 0 && !rf.is_broadcast()) {
+  // Print the message header and route to the receiver
+  if (count >= 0 && !mesh.is_broadcast()) {
     trace << PSTR("src=") << hex << src
 	  << PSTR(",port=") << hex << port
-	  << PSTR(",dest=") << hex << rf.get_device_address()
+	  << PSTR(",dest=") << hex << mesh.get_device_address()
 	  << PSTR(",len=") << count
-#if defined(COSA_WIRELESS_DRIVER_CC1101_HH)
-	  << PSTR(",rssi=") << rf.get_input_power_level()
-	  << PSTR(",lqi=") << rf.get_link_quality_indicator()
-#endif
+	  << PSTR(",rssi=") << mesh.get_input_power_level()
+	  << PSTR(",lqi=") << mesh.get_link_quality_indicator()
 	  << endl;
-    rf.send(DEST, port, msg, count);
+    mesh.send(DEST, port, msg, count);
   }
 
-  // Check error codes
-  else if (count == -1) {
-    trace << PSTR("error:illegal frame size(-1)") << endl;
-  }
-  else if (count == -2) {
-    trace << PSTR("error:timeout(-2)") << endl;
+  // Print routing state on timeout
+  else if (count == ETIME) {
+    trace << PSTR("forwarded=") << mesh.get_forwarded()
+	  << PSTR(",drops=") << mesh.get_drops()
+	  << PSTR(",duplicates=") << mesh.get_duplicates()
+	  << endl;
+    trace << mesh << endl;
   }
+
+  // Check error codes
   else if (count < 0) {
     trace << PSTR("error(") << count << PSTR(")") << endl;
   }
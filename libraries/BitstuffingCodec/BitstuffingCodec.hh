@@ -29,12 +29,18 @@
  */
 class BitstuffingCodec : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 5;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0x34a;
+
   /**
    * Construct fixed bitstuffing codec with given bits per symbol,
    * start symbol, and preamble size.
    */
   BitstuffingCodec() :
-    VWI::Codec(5, 0x34a, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
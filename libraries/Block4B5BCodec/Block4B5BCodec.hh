@@ -29,12 +29,18 @@
  */
 class Block4B5BCodec : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 5;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0x238;
+
   /**
    * Construct block 4b5b codec with given bits per symbol,
    * start symbol, and preamble size.
    */
   Block4B5BCodec() :
-    VWI::Codec(5, 0x238, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
@@ -37,7 +37,7 @@ DS3231::write(void* regs, uint8_t size, uint8_t pos)
   twi.begin(this);
   int count = twi.write(pos, regs, size);
   twi.end();
-  return (count);
+  return (count < 0 ? count : count - 1);
 }
 
 bool
@@ -77,6 +77,76 @@ DS3231::get_temperature()
   return (swap(temp) >> 6);
 }
 
+bool
+DS3231::AlarmClock::get_time(clock_t& now)
+{
+  time_t time;
+  if (!m_rtc->get_time(time)) return (false);
+  time.to_binary();
+  now = time;
+  return (true);
+}
+
+bool
+DS3231::AlarmClock::set_alarm(clock_t when)
+{
+  // Set alarm1 to match date and time
+  time_t time(when);
+  time.to_bcd();
+  alarm1_t alarm;
+  alarm.seconds = time.seconds;
+  alarm.minutes = time.minutes;
+  alarm.hours = time.hours;
+  alarm.date = time.date;
+  if (!m_rtc->set_alarm1(alarm, alarm1_t::WHEN_DATE_TIME_MATCH))
+    return (false);
+
+  // Enable alarm1 interrupt output
+  uint8_t pos = offsetof(timekeeper_t, control);
+  control_t control;
+  if (m_rtc->read(&control, sizeof(control), pos) != sizeof(control))
+    return (false);
+  control.intcn = 1;
+  control.a1ie = 1;
+  if (m_rtc->write(&control, sizeof(control), pos) != sizeof(control))
+    return (false);
+
+  // Clear alarm1 flag; release the interrupt output and enable handler
+  pos = offsetof(timekeeper_t, status);
+  status_t status;
+  if (m_rtc->read(&status, sizeof(status), pos) != sizeof(status))
+    return (false);
+  status.a1f = 0;
+  if (m_rtc->write(&status, sizeof(status), pos) != sizeof(status))
+    return (false);
+  m_alarm_irq.m_triggered = false;
+  m_alarm_irq.enable();
+  return (true);
+}
+
+bool
+DS3231::AlarmClock::clear_alarm()
+{
+  // Disable handler and alarm1 interrupt output
+  m_alarm_irq.disable();
+  m_alarm_irq.m_triggered = false;
+  uint8_t pos = offsetof(timekeeper_t, control);
+  control_t control;
+  if (m_rtc->read(&control, sizeof(control), pos) != sizeof(control))
+    return (false);
+  control.a1ie = 0;
+  if (m_rtc->write(&control, sizeof(control), pos) != sizeof(control))
+    return (false);
+
+  // Clear alarm1 flag
+  pos = offsetof(timekeeper_t, status);
+  status_t status;
+  if (m_rtc->read(&status, sizeof(status), pos) != sizeof(status))
+    return (false);
+  status.a1f = 0;
+  return (m_rtc->write(&status, sizeof(status), pos) == sizeof(status));
+}
+
 IOStream& operator<<(IOStream& outs, DS3231::alarm1_t& t)
 {
   outs << bcd << t.date << ' '
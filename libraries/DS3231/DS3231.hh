@@ -24,6 +24,8 @@
 #include "Cosa/TWI.hh"
 #include "Cosa/Time.hh"
 #include "Cosa/IOStream.hh"
+#include "Cosa/Alarm.hh"
+#include "Cosa/ExternalInterrupt.hh"
 
 /**
  * Driver for the DS3231, Extremely Accurate I2C-Integrated
@@ -42,6 +44,9 @@
  * (GND)---------------6-|VCC         |
  *                       +------------+
  * @endcode
+ * The SQW pin is the alarm interrupt output (active low) and should
+ * be connected to an external interrupt pin (EXT0/D2) when using
+ * DS3231::AlarmClock.
  *
  * @section References
  * 1. Maxim Integrated product description;
@@ -280,6 +285,97 @@ public:
    */
   int16_t get_temperature();
 
+  /**
+   * Alarm manager clock; the alarm manager time base is the
+   * real-time clock and the next alarm is set with alarm1. The alarm
+   * interrupt (SQW) wakes the processor from power down.
+   * @code
+   *   DS3231 rtc;
+   *   DS3231::AlarmClock clock(&rtc);
+   *   ...
+   *   Alarm::await(clock);
+   * @endcode
+   */
+  class AlarmClock : public Alarm::Clock {
+  public:
+    /**
+     * Construct alarm clock for given real-time clock and alarm
+     * interrupt pin.
+     * @param[in] rtc real-time clock.
+     * @param[in] pin alarm interrupt pin (Default EXT0).
+     */
+    AlarmClock(DS3231* rtc, Board::ExternalInterruptPin pin = Board::EXT0) :
+      m_rtc(rtc),
+      m_alarm_irq(pin)
+    {}
+
+    /**
+     * @override Alarm::Clock
+     * Read current time in seconds from the real-time clock. Return
+     * true(1) if successful otherwise false(0).
+     * @param[out] now current time in seconds.
+     * @return boolean.
+     */
+    virtual bool get_time(clock_t& now);
+
+    /**
+     * @override Alarm::Clock
+     * Set alarm1 to the given time (date and time match) and enable
+     * the alarm interrupt. Return true(1) if successful otherwise
+     * false(0).
+     * @param[in] when alarm time in seconds.
+     * @return boolean.
+     */
+    virtual bool set_alarm(clock_t when);
+
+    /**
+     * @override Alarm::Clock
+     * Disable alarm1 and the alarm interrupt, and clear the triggered
+     * state. Return true(1) if successful otherwise false(0).
+     * @return boolean.
+     */
+    virtual bool clear_alarm();
+
+    /**
+     * @override Alarm::Clock
+     * Return true(1) if the alarm interrupt has been received
+     * otherwise false(0).
+     * @return boolean.
+     */
+    virtual bool is_triggered()
+    {
+      return (m_alarm_irq.m_triggered);
+    }
+
+  protected:
+    /**
+     * Alarm Interrupt Handler. The interrupt is low level so that it
+     * may wake the processor from power down. The handler is disabled
+     * on interrupt as the level is held until the alarm flag is
+     * cleared.
+     */
+    class AlarmInterrupt : public ExternalInterrupt {
+    public:
+      AlarmInterrupt(Board::ExternalInterruptPin pin) :
+	ExternalInterrupt(pin, ExternalInterrupt::ON_LOW_LEVEL_MODE, true),
+	m_triggered(false)
+      {}
+      virtual void on_interrupt(uint16_t arg = 0)
+      {
+	UNUSED(arg);
+	disable();
+	m_triggered = true;
+      }
+      volatile bool m_triggered;
+    };
+
+    /** Real-time clock. */
+    DS3231* m_rtc;
+
+    /** Alarm Interrupt Pin. */
+    AlarmInterrupt m_alarm_irq;
+  };
+
 private:
   /**
    * Read alarm setting, time and mask, from real-time clock. Return
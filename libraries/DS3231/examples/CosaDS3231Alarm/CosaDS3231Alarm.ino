@@ -0,0 +1,112 @@
+/**
+ * @file CosaDS3231Alarm.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2013-2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa demonstration of alarm handling with the DS3231 as time base
+ * and wakeup source. The processor is powered down between alarms;
+ * the next alarm is set in the DS3231 and the alarm interrupt (SQW)
+ * wakes the processor. The Watchdog and RTC are not used.
+ *
+ * @section Circuit
+ * The Mini RTC pro module with pull-up resistors (4K7) for TWI signals.
+ * @code
+ *                        Mini RTC pro
+ *                       +------------+
+ *                     1-|32KHz       |
+ * (D2/EXT0)-----------2-|SQW         |
+ * (A5/SCL)------------3-|SCL         |
+ * (A4/SDA)------------4-|SDA         |
+ * (GND)---------------5-|GND         |
+ * (GND)---------------6-|VCC         |
+ *                       +------------+
+ * @endcode
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <DS3231.h>
+
+#include "Cosa/Alarm.hh"
+#include "Cosa/Activity.hh"
+#include "Cosa/Power.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// The real-time device and alarm manager clock
+DS3231 rtc;
+DS3231::AlarmClock clock(&rtc);
+
+class TraceAlarm : public Alarm {
+public:
+  TraceAlarm(uint8_t id, uint16_t period) : Alarm(period), m_id(id) {}
+  virtual void run()
+  {
+    time_t now(time());
+    trace << now << PSTR(":alarm:id=") << m_id << endl;
+  }
+private:
+  uint8_t m_id;
+};
+
+class TraceActivity : public Activity {
+public:
+  TraceActivity() : Activity() {}
+  virtual void run()
+  {
+    time_t now(time());
+    trace << now << PSTR(":activity:cycle=") << get_cycles() << endl;
+  }
+};
+
+// Alarm every minute and activity every 5 minutes
+TraceAlarm every_minute(1, 60);
+TraceActivity activity;
+
+void setup()
+{
+  // Start trace output stream on the serial port
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaDS3231Alarm: started"));
+
+  // Synchronize the alarm manager with the real-time clock
+  clock_t now;
+  if (!clock.get_time(now)) {
+    trace << PSTR("rtc:error") << endl;
+    return;
+  }
+  Alarm::set_time(now);
+  trace << time_t(now) << PSTR(":started") << endl;
+
+  // Set next alarm and activity; run every 10 seconds for 30 seconds
+  every_minute.next_alarm(60);
+  every_minute.enable();
+  activity.set_time(now + 10, 30, 5);
+  activity.set_run_period(10);
+  activity.enable();
+}
+
+void loop()
+{
+  // Complete output before power down
+  uart.flush();
+
+  // Power down until the next alarm; alarm handlers are run on wakeup
+  if (Alarm::await(clock) < 0) {
+    trace << PSTR("rtc:error") << endl;
+    sleep(5);
+  }
+}
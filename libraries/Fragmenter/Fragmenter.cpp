@@ -0,0 +1,220 @@
+/**
+ * @file Fragmenter.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Fragmenter.hh"
+#include "Cosa/RTC.hh"
+
+/**
+ * Copy given number of bytes from given offset in io vector to given
+ * buffer. Returns number of bytes copied.
+ * @param[in] vec null terminated io vector.
+ * @param[in] offset in io vector.
+ * @param[in] dest destination buffer.
+ * @param[in] size number of bytes.
+ * @return number of bytes copied.
+ */
+static size_t
+iovec_copy(const iovec_t* vec, size_t offset, uint8_t* dest, size_t size)
+{
+  size_t res = 0;
+  for (const iovec_t* vp = vec; vp->buf != NULL && size != 0; vp++) {
+    if (offset >= vp->size) {
+      offset -= vp->size;
+      continue;
+    }
+    size_t n = vp->size - offset;
+    if (n > size) n = size;
+    memcpy(dest, (const uint8_t*) vp->buf + offset, n);
+    dest += n;
+    res += n;
+    size -= n;
+    offset = 0;
+  }
+  return (res);
+}
+
+int
+Fragmenter::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  // Check if the message fits the device payload
+  if (UNLIKELY(vec == NULL)) return (EINVAL);
+  size_t len = iovec_size(vec);
+  if (len <= m_payload_max) return (m_dev->send(dest, port, vec));
+  if (UNLIKELY(len > MSG_MAX)) return (EMSGSIZE);
+  uint8_t size = fragment_max();
+  uint8_t count = (len + size - 1) / size;
+  if (UNLIKELY(count > FRAGMENT_MAX)) return (EMSGSIZE);
+
+  // Send fragments that have not been acknowledged. Request
+  // acknowledgement with the last fragment in each round
+  uint8_t frame[PAYLOAD_MAX];
+  header_t* header = (header_t*) frame;
+  uint32_t missing = fragments(count);
+  header->port = port;
+  header->seq = ++m_tx_seq;
+  header->count = count;
+  for (uint8_t retry = 0; retry <= RETRY_MAX; retry++) {
+    uint8_t last = count;
+    while (!(missing & (1UL << --last)));
+    for (uint8_t index = 0; index <= last; index++) {
+      if ((missing & (1UL << index)) == 0) continue;
+      size_t n = iovec_copy(vec, index * size, frame + sizeof(header_t), size);
+      header->index = index;
+      if (index == last && dest != BROADCAST) header->index |= ACK_REQUEST;
+      int res = m_dev->send(dest, FRAGMENT_PORT, frame, sizeof(header_t) + n);
+      if (res < 0) return (res);
+      if (retry != 0) m_retrans += 1;
+    }
+    if (dest == BROADCAST) return (len);
+    missing &= ~await(dest, header->seq);
+    if (missing == 0) return (len);
+  }
+  m_drops += 1;
+  return (EIO);
+}
+
+int
+Fragmenter::send(uint8_t dest, uint8_t port, const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (send(dest, port, vec));
+}
+
+int
+Fragmenter::recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		 uint32_t ms)
+{
+  uint8_t frame[PAYLOAD_MAX];
+  uint32_t start = RTC::millis();
+  while (1) {
+    // Calculate remaining time; zero for blocking
+    uint32_t timeout = 0L;
+    if (ms != 0) {
+      uint32_t elapsed = RTC::since(start);
+      if (elapsed >= ms) return (ETIME);
+      timeout = ms - elapsed;
+    }
+
+    // Receive next frame. Pass through messages on other ports
+    int res = m_dev->recv(src, port, frame, sizeof(frame), timeout);
+    if (res < 0) return (res);
+    if (port == ACK_PORT) continue;
+    if (port != FRAGMENT_PORT) {
+      if ((size_t) res > len) return (EMSGSIZE);
+      memcpy(buf, frame, res);
+      return (res);
+    }
+
+    // Reassemble fragments and return message when completed
+    size_t count = reassemble(src, frame, res);
+    if (count == 0) continue;
+    port = m_port;
+    if (count > len) return (EMSGSIZE);
+    memcpy(buf, m_buf, count);
+    return (count);
+  }
+}
+
+uint32_t
+Fragmenter::await(uint8_t dest, uint8_t seq)
+{
+  uint32_t start = RTC::millis();
+  uint32_t elapsed;
+  while ((elapsed = RTC::since(start)) < ACK_TIMEOUT) {
+    ack_t ack;
+    uint8_t src;
+    uint8_t port;
+    int res = m_dev->recv(src, port, &ack, sizeof(ack), ACK_TIMEOUT - elapsed);
+    if (res != sizeof(ack)) continue;
+    if ((port == ACK_PORT) && (src == dest) && (ack.seq == seq))
+      return (ack.mask);
+  }
+  return (0);
+}
+
+void
+Fragmenter::acknowledge(uint8_t dest)
+{
+  ack_t ack;
+  ack.seq = m_rx_seq;
+  ack.mask = m_mask;
+  m_dev->send(dest, ACK_PORT, &ack, sizeof(ack));
+}
+
+size_t
+Fragmenter::reassemble(uint8_t src, const uint8_t* frame, size_t len)
+{
+  // Check fragment header
+  if (UNLIKELY(len < sizeof(header_t))) return (0);
+  const header_t* header = (const header_t*) frame;
+  bool request = (header->index & ACK_REQUEST) && !m_dev->is_broadcast();
+  uint8_t index = header->index & ~ACK_REQUEST;
+  uint8_t count = header->count;
+  uint8_t size = fragment_max();
+  len -= sizeof(header_t);
+  if (UNLIKELY((count == 0)
+	       || (count > FRAGMENT_MAX)
+	       || (index >= count)
+	       || (len > size)
+	       || ((size_t) index * size + len > MSG_MAX)))
+    return (0);
+
+  // Check for duplicate of completed message; acknowledge again
+  bool same = (m_state != FREE_STATE)
+    && (src == m_src)
+    && (header->seq == m_rx_seq)
+    && (RTC::since(m_start) < REASSEMBLY_TIMEOUT);
+  if (m_state == COMPLETED_STATE && same) {
+    if (request) acknowledge(src);
+    return (0);
+  }
+
+  // Start reassembly of new message; drop any incomplete message
+  if (!same) {
+    if (m_state == ASSEMBLING_STATE) m_drops += 1;
+    m_state = ASSEMBLING_STATE;
+    m_src = src;
+    m_rx_seq = header->seq;
+    m_port = header->port;
+    m_count = count;
+    m_mask = 0;
+    m_length = 0;
+    m_start = RTC::millis();
+  }
+  else if (UNLIKELY(count != m_count)) return (0);
+
+  // Copy fragment data and mark as received. The last fragment
+  // gives the message length
+  memcpy(m_buf + index * size, frame + sizeof(header_t), len);
+  m_mask |= (1UL << index);
+  if (index == count - 1) m_length = (size_t) index * size + len;
+
+  // Check if the message is complete
+  if (m_mask != fragments(count)) {
+    if (request) acknowledge(src);
+    return (0);
+  }
+  m_state = COMPLETED_STATE;
+  if (!m_dev->is_broadcast()) acknowledge(src);
+  return (m_length);
+}
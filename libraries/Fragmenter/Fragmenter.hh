@@ -0,0 +1,342 @@
+/**
+ * @file Fragmenter.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_FRAGMENTER_HH
+#define COSA_FRAGMENTER_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+
+#ifndef COSA_FRAGMENTER_MSG_MAX
+#define COSA_FRAGMENTER_MSG_MAX 128
+#endif
+
+/**
+ * Fragmentation and reassembly of messages larger than the payload
+ * of a Wireless device driver. The Fragmenter is itself a Wireless
+ * device driver and may be used wherever a driver is expected.
+ * Messages that fit the payload of the device are sent as is on the
+ * given port. Larger messages are split into fragments and sent on
+ * the system port FRAGMENT_PORT. Unicast messages are acknowledged
+ * with a bit-set of the received fragments and only the missing
+ * fragments are retransmitted. Broadcast messages are not
+ * acknowledged.
+ *
+ * @section Limitations
+ * Max COSA_FRAGMENTER_MSG_MAX bytes per message and max 32 fragments.
+ * A single message is reassembled at a time; a fragment from another
+ * source or sequence restarts reassembly. Other messages received
+ * while waiting for an acknowledgement are discarded. Both ends must
+ * use the same payload size.
+ */
+class Fragmenter : public Wireless::Driver {
+public:
+  /** Max size of message (reassembly buffer size). */
+  static const size_t MSG_MAX = COSA_FRAGMENTER_MSG_MAX;
+
+  /** Max size of device payload (frame buffer size). */
+  static const size_t PAYLOAD_MAX = 64;
+
+  /** Max number of fragments per message. */
+  static const uint8_t FRAGMENT_MAX = 32;
+
+  /** System port for fragments. */
+  static const uint8_t FRAGMENT_PORT = 0xf0;
+
+  /** System port for fragment acknowledgements. */
+  static const uint8_t ACK_PORT = 0xf1;
+
+  /** Acknowledgement timeout (milli-seconds). */
+  static const uint16_t ACK_TIMEOUT = 64;
+
+  /** Reassembly timeout (milli-seconds). */
+  static const uint16_t REASSEMBLY_TIMEOUT = 1000;
+
+  /** Max number of retransmissions. */
+  static const uint8_t RETRY_MAX = 4;
+
+  /**
+   * Construct fragmenter for given wireless device driver with given
+   * device payload size. The network and device address is taken
+   * from the device driver.
+   * @param[in] dev wireless device driver.
+   * @param[in] payload_max device payload size (max PAYLOAD_MAX).
+   */
+  Fragmenter(Wireless::Driver* dev, size_t payload_max) :
+    Wireless::Driver(dev->get_network_address(), dev->get_device_address()),
+    m_dev(dev),
+    m_payload_max(payload_max < PAYLOAD_MAX ? payload_max : PAYLOAD_MAX),
+    m_tx_seq(0),
+    m_state(FREE_STATE),
+    m_retrans(0),
+    m_drops(0)
+  {}
+
+  /**
+   * Return number of retransmitted fragments.
+   * @return count.
+   */
+  uint16_t get_retransmits() const
+  {
+    return (m_retrans);
+  }
+
+  /**
+   * Return number of dropped messages; failed to send or incomplete
+   * reassembly.
+   * @return count.
+   */
+  uint16_t get_drops() const
+  {
+    return (m_drops);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Start the device driver. Return true(1) if successful otherwise
+   * false(0).
+   * @param[in] config configuration vector (default NULL)
+   * @return bool.
+   */
+  virtual bool begin(const void* config = NULL)
+  {
+    m_state = FREE_STATE;
+    return (m_dev->begin(config));
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Shutdown the device driver. Return true(1) if successful
+   * otherwise false(0).
+   * @return bool.
+   */
+  virtual bool end()
+  {
+    return (m_dev->end());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power up mode.
+   */
+  virtual void powerup()
+  {
+    m_dev->powerup();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power down mode.
+   */
+  virtual void powerdown()
+  {
+    m_dev->powerdown();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in wakeup on radio mode.
+   */
+  virtual void wakeup_on_radio()
+  {
+    m_dev->wakeup_on_radio();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if a message is available otherwise false(0).
+   * @return bool.
+   */
+  virtual bool available()
+  {
+    return (m_dev->available());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given null terminated io vector. Messages larger
+   * than the device payload are fragmented. Unicast messages are
+   * retransmitted until all fragments are acknowledged. Returns
+   * number of bytes sent or negative error code; EMSGSIZE if the
+   * message is too large, EIO if not acknowledged.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given buffer, with given number of bytes. See
+   * send() with io vector above.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * @override Wireless::Driver
+   * Receive message and store into given buffer with given maximum
+   * length. Fragments are reassembled and acknowledged; the message
+   * is returned when complete. The source network address is
+   * returned in the parameter src. Returns the number of received
+   * bytes or negative error code; ETIME on timeout, EMSGSIZE if the
+   * buffer is too small.
+   * @param[out] src source network address.
+   * @param[out] port device port (or message type).
+   * @param[in] buf buffer to store incoming message.
+   * @param[in] len maximum number of bytes to receive.
+   * @param[in] ms maximum time out period (Default blocking(0L)).
+   * @return number of bytes received or negative error code.
+   */
+  virtual int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		   uint32_t ms = 0L);
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if the latest received message was a broadcast
+   * otherwise false(0).
+   */
+  virtual bool is_broadcast()
+  {
+    return (m_dev->is_broadcast());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set output power level in dBm.
+   * @param[in] dBm.
+   */
+  virtual void set_output_power_level(int8_t dBm)
+  {
+    m_dev->set_output_power_level(dBm);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return estimated input power level (dBm).
+   */
+  virtual int get_input_power_level()
+  {
+    return (m_dev->get_input_power_level());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return link quality indicator.
+   */
+  virtual int get_link_quality_indicator()
+  {
+    return (m_dev->get_link_quality_indicator());
+  }
+
+protected:
+  /** Fragment header. */
+  struct header_t {
+    uint8_t port;		//!< Message port.
+    uint8_t seq;		//!< Message sequence number.
+    uint8_t index;		//!< Fragment index and acknowledge request.
+    uint8_t count;		//!< Number of fragments.
+  };
+
+  /** Acknowledge request flag in fragment index. */
+  static const uint8_t ACK_REQUEST = 0x80;
+
+  /** Acknowledgement; message sequence number and received fragments. */
+  struct ack_t {
+    uint8_t seq;		//!< Message sequence number.
+    uint32_t mask;		//!< Received fragments bit-set.
+  };
+
+  /** Reassembly state. */
+  enum {
+    FREE_STATE,
+    ASSEMBLING_STATE,
+    COMPLETED_STATE
+  } __attribute__((packed));
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  uint8_t m_payload_max;	//!< Device payload size.
+  uint8_t m_tx_seq;		//!< Transmit message sequence number.
+  uint8_t m_state;		//!< Reassembly state.
+  uint8_t m_src;		//!< Reassembly source address.
+  uint8_t m_rx_seq;		//!< Reassembly message sequence number.
+  uint8_t m_port;		//!< Reassembly message port.
+  uint8_t m_count;		//!< Reassembly number of fragments.
+  uint32_t m_mask;		//!< Received fragments bit-set.
+  size_t m_length;		//!< Reassembled message length.
+  uint32_t m_start;		//!< Reassembly start time (milli-seconds).
+  uint16_t m_retrans;		//!< Number of retransmitted fragments.
+  uint16_t m_drops;		//!< Number of dropped messages.
+  uint8_t m_buf[MSG_MAX];	//!< Reassembly buffer.
+
+  /**
+   * Return number of data bytes per fragment.
+   * @return bytes.
+   */
+  uint8_t fragment_max() const
+  {
+    return (m_payload_max - sizeof(header_t));
+  }
+
+  /**
+   * Return bit-set with given number of fragments.
+   * @param[in] count number of fragments.
+   * @return bit-set.
+   */
+  static uint32_t fragments(uint8_t count)
+  {
+    return (count < 32 ? (1UL << count) - 1 : 0xffffffffUL);
+  }
+
+  /**
+   * Wait for acknowledgement of message with given sequence number
+   * from given device. Returns bit-set of received fragments, zero
+   * on timeout.
+   * @param[in] dest device address.
+   * @param[in] seq message sequence number.
+   * @return bit-set.
+   */
+  uint32_t await(uint8_t dest, uint8_t seq);
+
+  /**
+   * Send acknowledgement to given device with current reassembly
+   * state.
+   * @param[in] dest device address.
+   */
+  void acknowledge(uint8_t dest);
+
+  /**
+   * Handle fragment with given header and data from given device.
+   * Returns message length when the message is complete otherwise
+   * zero.
+   * @param[in] src source device address.
+   * @param[in] frame fragment header and data.
+   * @param[in] len fragment length.
+   * @return message length or zero.
+   */
+  size_t reassemble(uint8_t src, const uint8_t* frame, size_t len);
+};
+
+#endif
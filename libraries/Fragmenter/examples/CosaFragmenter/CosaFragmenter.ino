@@ -0,0 +1,115 @@
+/**
+ * @file CosaFragmenter.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa Fragmenter demo; send messages larger than the device payload
+ * and trace retransmission statistics. Build one node with SENDER
+ * defined and one without.
+ *
+ * @section Circuit
+ * See Wireless drivers for circuit connections.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <Fragmenter.h>
+
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+
+// Configuration; network and device addresses. Sender or receiver
+#define NETWORK 0xC05A
+#define SENDER
+#if defined(SENDER)
+#define DEVICE 0x10
+#else
+#define DEVICE 0x01
+#endif
+#define DEST 0x01
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE);
+Fragmenter frag(&rf, NRF24L01P::PAYLOAD_MAX);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+// Fragmenter frag(&rf, RFM69::PAYLOAD_MAX);
+
+// Message; sequence number and payload
+static const uint8_t PAYLOAD_MAX = 96;
+struct msg_t {
+  uint16_t nr;
+  uint8_t payload[PAYLOAD_MAX];
+};
+static const uint8_t PAYLOAD_TYPE = 0x02;
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaFragmenter: started"));
+  Watchdog::begin();
+  RTC::begin();
+  ASSERT(frag.begin());
+}
+
+#if defined(SENDER)
+void loop()
+{
+  static msg_t msg = { 0, { 0 } };
+
+  // Send message and trace result and statistics
+  uint32_t start = RTC::millis();
+  int res = frag.send(DEST, PAYLOAD_TYPE, &msg, sizeof(msg));
+  uint32_t ms = RTC::since(start);
+  trace << PSTR("nr=") << msg.nr
+	<< PSTR(",res=") << res
+	<< PSTR(",ms=") << ms
+	<< PSTR(",retransmits=") << frag.get_retransmits()
+	<< PSTR(",drops=") << frag.get_drops()
+	<< endl;
+
+  // Update message and wait before the next
+  msg.nr += 1;
+  for (uint8_t i = 0; i < PAYLOAD_MAX; i++) msg.payload[i] = msg.nr + i;
+  sleep(1);
+}
+#else
+void loop()
+{
+  msg_t msg;
+  uint8_t src;
+  uint8_t port;
+
+  // Receive message and verify payload
+  int res = frag.recv(src, port, &msg, sizeof(msg));
+  if (res != sizeof(msg) || port != PAYLOAD_TYPE) return;
+  uint8_t errors = 0;
+  for (uint8_t i = 0; i < PAYLOAD_MAX; i++)
+    if (msg.nr != 0 && msg.payload[i] != (uint8_t) (msg.nr + i)) errors++;
+  trace << PSTR("src=") << hex << src
+	<< PSTR(",nr=") << msg.nr
+	<< PSTR(",errors=") << errors
+	<< PSTR(",drops=") << frag.get_drops()
+	<< endl;
+}
+#endif
@@ -37,12 +37,18 @@
  */
 class HammingCodec_7_4 : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 7;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0x12d5;
+
   /**
    * Construct Hamming(7,4) codec with given bits per symbol, start
    * symbol, and preamble size.
    */
   HammingCodec_7_4() :
-    VWI::Codec(7, 0x12d5, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
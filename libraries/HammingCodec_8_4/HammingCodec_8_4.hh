@@ -37,12 +37,18 @@
  */
 class HammingCodec_8_4 : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 8;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0x5a55;
+
   /**
    * Construct Hamming(8,4) codec with given bits per symbol, start
    * symbol, and preamble size.
    */
   HammingCodec_8_4() :
-    VWI::Codec(8, 0x5a55, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
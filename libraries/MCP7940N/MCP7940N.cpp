@@ -21,7 +21,7 @@
 #include "MCP7940N.hh"
 
 MCP7940N::AlarmInterrupt::AlarmInterrupt(Board::ExternalInterruptPin pin) :
-  ExternalInterrupt(pin, ExternalInterrupt::ON_RISING_MODE),
+  ExternalInterrupt(pin, ExternalInterrupt::ON_LOW_LEVEL_MODE, true),
   m_triggered(false)
 {
 }
@@ -30,6 +30,7 @@ void
 MCP7940N::AlarmInterrupt::on_interrupt(uint16_t arg)
 {
   UNUSED(arg);
+  disable();
   m_triggered = true;
 }
 
@@ -102,7 +103,7 @@ MCP7940N::set_alarm(uint8_t nr, time_t& alarm, uint8_t when)
 
   // Create configuration and write alarm information
   alarm_t::config_t config(alarm.day);
-  config.polarity = 1;
+  config.polarity = 0;
   config.when = when;
   alarm.day = config.as_uint8;
   if (write(&alarm, sizeof(alarm_t), pos) != sizeof(alarm_t)) return (false);
@@ -116,6 +117,7 @@ MCP7940N::set_alarm(uint8_t nr, time_t& alarm, uint8_t when)
   else if (nr == 1)
     cntrl.alm1en = 1;
   if (write(&cntrl, sizeof(cntrl), pos) != sizeof(cntrl)) return (false);
+  m_alarm_irq.m_triggered = false;
   m_alarm_irq.enable();
   return (true);
 }
@@ -130,15 +132,26 @@ MCP7940N::pending_alarm()
   if (!m_alarm_irq.m_triggered) return (0);
   m_alarm_irq.m_triggered = false;
 
-  // Read alarm 0 configuration. Check if alarm is triggered
+  // Read alarm 0 configuration. Check if alarm is triggered and clear
   pos = offsetof(rtcc_t,alarm0.day);
   if (read(&config, sizeof(config), pos) != sizeof(config)) return (0);
-  if (config.triggered) res |= 0x01;
+  if (config.triggered) {
+    config.triggered = 0;
+    if (write(&config, sizeof(config), pos) != sizeof(config)) return (0);
+    res |= 0x01;
+  }
 
-  // Read alarm 1 configuration. Check if alarm is triggered
+  // Read alarm 1 configuration. Check if alarm is triggered and clear
   pos = offsetof(rtcc_t,alarm1.day);
   if (read(&config, sizeof(config), pos) != sizeof(config)) return (0);
-  if (config.triggered) res |= 0x02;
+  if (config.triggered) {
+    config.triggered = 0;
+    if (write(&config, sizeof(config), pos) != sizeof(config)) return (0);
+    res |= 0x02;
+  }
+
+  // Alarm output is released; enable the interrupt handler again
+  if (res != 0) m_alarm_irq.enable();
   return (res);
 }
 
@@ -161,6 +174,44 @@ MCP7940N::clear_alarm(uint8_t nr)
   return (true);
 }
 
+bool
+MCP7940N::AlarmClock::get_time(clock_t& now)
+{
+  time_t time;
+  if (!m_rtc->get_time(time)) return (false);
+  time.to_binary();
+  now = time;
+  return (true);
+}
+
+bool
+MCP7940N::AlarmClock::set_alarm(clock_t when)
+{
+  // The time match includes the weekday; step the current weekday of
+  // the clock with the number of days to the alarm
+  time_t now;
+  if (!m_rtc->get_time(now)) return (false);
+  now.to_binary();
+  time_t time(when);
+  if ((now.day >= 1) && (now.day <= DAYS_PER_WEEK)) {
+    clock_t today = ((clock_t) now) / SECONDS_PER_DAY;
+    uint16_t days = (when / SECONDS_PER_DAY) - today;
+    time.day = ((now.day - 1 + days) % DAYS_PER_WEEK) + 1;
+  }
+  time.to_bcd();
+  return (m_rtc->set_alarm(0, time, WHEN_TIME_MATCH));
+}
+
+bool
+MCP7940N::AlarmClock::clear_alarm()
+{
+  // Disable alarm0 and handler; the alarm flag is cleared by set_alarm()
+  if (!m_rtc->clear_alarm(0)) return (false);
+  m_rtc->m_alarm_irq.disable();
+  m_rtc->m_alarm_irq.m_triggered = false;
+  return (true);
+}
+
 IOStream& operator<<(IOStream& outs, MCP7940N::alarm_t& t)
 {
   outs << bcd << t.month << '-'
@@ -25,11 +25,21 @@
 #include "Cosa/Time.hh"
 #include "Cosa/IOStream.hh"
 #include "Cosa/ExternalInterrupt.hh"
+#include "Cosa/Alarm.hh"
 
 /**
  * Driver for the MCP7940N, Low-Cost I2C Real-Time Clock/Calendar (RTCC)
  * with SRAM and Battery Switchover.
  *
+ * @section Alarm Interrupt
+ * The alarm output (MFP) is active low and the alarm interrupt is low
+ * level for all alarms so that an alarm may wake the processor from
+ * power down. Previous versions used active high output and rising
+ * edge interrupt; circuits that depend on the output polarity must be
+ * updated. The interrupt handler is disabled on the alarm and enabled
+ * again by set_alarm() or pending_alarm(), which clears the alarm and
+ * releases the output.
+ *
  * @section References
  * 1. Microchip MCP7940N data sheet;
  * http://ww1.microchip.com/downloads/en/DeviceDoc/20005010F.pdf
@@ -236,7 +246,8 @@ public:
 
   /**
    * Set given real-time clock alarm with the given time and
-   * configuration. Return true(1) if successful otherwise false(0).
+   * configuration. The alarm output is active low. Return true(1) if
+   * successful otherwise false(0).
    * @param[in] nr alarm number (0..1).
    * @param[in] alarm time structure to set.
    * @param[in] when alarm should trigger.
@@ -265,11 +276,80 @@ public:
   /**
    * Check any pending alarms (signalled on interrupt pin). Returns
    * alarm pending (0 for no alarms, 1 for alarm0, 2 for alarm1 and 3
-   * for both)
+   * for both). The pending alarms are cleared and the alarm interrupt
+   * handler enabled again.
    * @return alarm triggered or zero for no alarms pending.
    */
   uint8_t pending_alarm();
 
+  /**
+   * Alarm manager clock; the alarm manager time base is the
+   * real-time clock and the next alarm is set with alarm0. The alarm
+   * interrupt (MFP) wakes the processor from power down. The alarm
+   * time match includes the weekday; the alarm weekday is calculated
+   * from the current weekday of the clock so that the clock may be
+   * set with any weekday numbering.
+   * @code
+   *   MCP7940N rtc;
+   *   MCP7940N::AlarmClock clock(&rtc);
+   *   ...
+   *   Alarm::await(clock);
+   * @endcode
+   */
+  class AlarmClock : public Alarm::Clock {
+  public:
+    /**
+     * Construct alarm clock for given real-time clock.
+     * @param[in] rtc real-time clock.
+     */
+    AlarmClock(MCP7940N* rtc) :
+      m_rtc(rtc)
+    {}
+
+    /**
+     * @override Alarm::Clock
+     * Read current time in seconds from the real-time clock. Return
+     * true(1) if successful otherwise false(0).
+     * @param[out] now current time in seconds.
+     * @return boolean.
+     */
+    virtual bool get_time(clock_t& now);
+
+    /**
+     * @override Alarm::Clock
+     * Set alarm0 to the given time (full time match) and enable the
+     * alarm interrupt. The weekday of the alarm is the clock weekday
+     * plus the number of days to the alarm. Return true(1) if
+     * successful otherwise false(0).
+     * @param[in] when alarm time in seconds.
+     * @return boolean.
+     */
+    virtual bool set_alarm(clock_t when);
+
+    /**
+     * @override Alarm::Clock
+     * Disable alarm0 and the alarm interrupt, and clear the triggered
+     * state. Return true(1) if successful otherwise false(0).
+     * @return boolean.
+     */
+    virtual bool clear_alarm();
+
+    /**
+     * @override Alarm::Clock
+     * Return true(1) if the alarm interrupt has been received
+     * otherwise false(0).
+     * @return boolean.
+     */
+    virtual bool is_triggered()
+    {
+      return (m_rtc->m_alarm_irq.m_triggered);
+    }
+
+  protected:
+    /** Real-time clock. */
+    MCP7940N* m_rtc;
+  };
+
 protected:
   /**
    * Read register block with the given size into the buffer from the
@@ -292,7 +372,10 @@ protected:
   int write(void* regs, uint8_t size, uint8_t pos = 0);
 
   /**
-   * Alarm Interrupt Handler.
+   * Alarm Interrupt Handler. The alarm output (MFP) is active low and
+   * the interrupt is low level so that it may wake the processor from
+   * power down. The handler is disabled on interrupt as the level is
+   * held until the alarm is cleared.
    */
   class AlarmInterrupt : public ExternalInterrupt {
   public:
@@ -300,7 +383,7 @@ protected:
     virtual void on_interrupt(uint16_t arg = 0);
   protected:
     friend class MCP7940N;
-    bool m_triggered;
+    volatile bool m_triggered;
   };
 
   /** Alarm Interrupt Pin */
@@ -198,68 +198,375 @@ MQTT::Client::publish(str_P topic, const void* buf, size_t count,
 		      bool progmem)
 
 {
-  uint16_t length = strlen_P(topic) + sizeof(uint16_t);
-  uint16_t id = 0;
+  // Fire and forget; write message; command, length, topic, payload
+  if (qos == FIRE_AND_FORGET) {
+    uint16_t length = strlen_P(topic) + sizeof(uint16_t) + count;
+    write(PUBLISH | (retain & RETAIN), length);
+    puts(topic);
+    if (progmem) write_P(buf, count); else write(buf, count);
+    int res = flush();
+    if (res < 0) return (-1);
+    return (0);
+  }
 
-  // Check if message identity is required
-  if (qos > FIRE_AND_FORGET) {
-    length += sizeof(uint16_t);
-    id = hton((int16_t) m_mid++);
-    if (m_mid == 0) m_mid = 1;
+  // Wait for a free slot in the window; service incoming messages
+  uint32_t start = Watchdog::millis();
+  while (m_inflight >= m_window) {
+    if (Watchdog::since(start) >= RETRY_TIMEOUT) return (ETIME);
+    service(RETRY_TIMEOUT);
   }
-  length += count;
 
-  // Write message; command, length, topic, {id}, payload
-  write(PUBLISH | (qos << MESSAGE_QOS_POS) | (retain & RETAIN), length);
-  puts(topic);
-  if (qos > FIRE_AND_FORGET) write(&id, sizeof(id));
-  if (progmem) write_P(buf, count); else write(buf, count);
+  // Allocate message in flight with next message identity
+  inflight_t* msg = m_msg;
+  while (msg->id != 0) msg++;
+  m_published = m_mid;
+  msg->id = hton((int16_t) m_mid++);
+  if (m_mid == 0) m_mid = 1;
+  msg->cmd = (qos == ACKNOWLEDGED_DELIVERY ? PUBACK : PUBREC);
+  msg->flags = (qos << MESSAGE_QOS_POS) | (retain & RETAIN);
+  if (progmem) msg->flags |= PROGMEM_FLAG;
+  msg->retry = 0;
+  msg->topic = topic;
+  msg->buf = buf;
+  msg->count = count;
+  m_inflight += 1;
+
+  // Write message. Acknowledgement is handled by service
+  int res = transmit(msg);
+  if (res < 0) {
+    msg->id = 0;
+    m_inflight -= 1;
+  }
+  return (res);
+}
+
+int
+MQTT::Client::transmit(inflight_t* msg)
+{
+  // Write message; command, length, topic, id, payload
+  uint16_t length = strlen_P(msg->topic) + sizeof(uint16_t);
+  length += sizeof(msg->id) + msg->count;
+  uint8_t cmd = PUBLISH | (msg->flags & (MESSAGE_QOS_MASK | RETAIN));
+  if (msg->retry != 0) cmd |= DUP;
+  write(cmd, length);
+  puts(msg->topic);
+  write(&msg->id, sizeof(msg->id));
+  if (msg->flags & PROGMEM_FLAG)
+    write_P(msg->buf, msg->count);
+  else
+    write(msg->buf, msg->count);
+  msg->start = Watchdog::millis();
   int res = flush();
   if (res < 0) return (-1);
+  return (0);
+}
+
+void
+MQTT::Client::retransmit()
+{
+  if (m_inflight == 0) return;
+  for (uint8_t i = 0; i < INFLIGHT_MAX; i++) {
+    inflight_t* msg = &m_msg[i];
+    if (msg->id == 0) continue;
+    if (Watchdog::since(msg->start) < RETRY_TIMEOUT) continue;
+
+    // Drop message after max number of retransmissions
+    if (msg->retry == RETRY_MAX) {
+      uint16_t mid = ntoh(msg->id);
+      msg->id = 0;
+      m_inflight -= 1;
+      on_delivery(mid, ETIME);
+      continue;
+    }
+
+    // Retransmit release (assured delivery part 2) or message
+    msg->retry += 1;
+    if (msg->cmd == PUBCOMP) {
+      acknowledge(PUBREL, msg->id);
+      msg->start = Watchdog::millis();
+    }
+    else transmit(msg);
+  }
+}
 
-  // Wait for response. Depends on requested quality of service
+int
+MQTT::Client::acknowledge(uint8_t cmd, uint16_t id)
+{
   struct {
     uint8_t cmd;
     uint8_t length;
     uint16_t id;
   } response;
+  response.cmd = cmd;
+  response.length = sizeof(response.id);
+  response.id = id;
+  write(&response, sizeof(response));
+  int res = flush();
+  if (res < 0) return (-1);
+  return (0);
+}
+
+int
+MQTT::Client::read(uint8_t& cmd, uint16_t& length, uint32_t ms)
+{
+  // Read command and remaining length (max two bytes)
+  uint8_t header[2];
+  int res = read(header, sizeof(header), ms);
+  if (res != sizeof(header)) return (res < 0 ? res : -2);
+  cmd = header[0];
+  length = header[1];
+  if (length & 0x80) {
+    uint8_t msb;
+    res = read(&msb, sizeof(msb));
+    if (res != sizeof(msb)) return (-2);
+    length = (length & 0x7f) | (msb << 7);
+  }
+  return (0);
+}
+
+int
+MQTT::Client::dispatch(uint8_t cmd, uint16_t length)
+{
+  uint16_t id = 0;
+  int res;
+
+  switch (cmd & MESSAGE_TYPE_MASK) {
+  case PUBLISH:
+    break;
+  case PUBACK:
+  case PUBREC:
+  case PUBCOMP:
+    // Match acknowledgement with message in flight
+    if (length != sizeof(id)) return (-1);
+    res = read(&id, sizeof(id));
+    if (res != sizeof(id)) return (-2);
+    for (uint8_t i = 0; i < INFLIGHT_MAX; i++) {
+      inflight_t* msg = &m_msg[i];
+      if (msg->id != id) continue;
+      // Received (assured delivery part 1); release. Repeat if duplicate
+      if (cmd == PUBREC) {
+	if (msg->cmd == PUBREC) {
+	  msg->cmd = PUBCOMP;
+	  msg->retry = 0;
+	  msg->start = Watchdog::millis();
+	}
+	return (acknowledge(PUBREL, id));
+      }
+      // Acknowledged or completed (assured delivery part 3)
+      if (msg->cmd != cmd) return (-3);
+      msg->id = 0;
+      m_inflight -= 1;
+      on_delivery(ntoh(id), 0);
+      return (0);
+    }
+    return (0);
+  case (PUBREL & MESSAGE_TYPE_MASK):
+    // Release incoming assured delivery message (part 2); complete
+    if (length != sizeof(id)) return (-1);
+    res = read(&id, sizeof(id));
+    if (res != sizeof(id)) return (-2);
+    for (uint8_t i = 0; i < INFLIGHT_MAX; i++)
+      if (m_rel[i] == id) m_rel[i] = 0;
+    return (acknowledge(PUBCOMP, id));
+  default:
+    // Skip unexpected message
+    while (length > 0) {
+      uint8_t buf[16];
+      size_t size = (length > sizeof(buf) ? sizeof(buf) : length);
+      res = read(buf, size);
+      if (res <= 0) return (-2);
+      length -= res;
+    }
+    return (-1);
+  }
+
+  // Match topic incrementally with subscription filters. Keep topic
+  // for the default publish handler when it fits in buffer
+  uint8_t qos = ((cmd & MESSAGE_QOS_MASK) >> MESSAGE_QOS_POS);
+  uint8_t buf[PAYLOAD_MAX + 1];
+  char topic[TOPIC_MAX + 1];
+  Subscriber* sub;
+  for (sub = m_subscriber; sub != NULL; sub = sub->m_next) sub->reset();
+  uint16_t count;
+  res = read(&count, sizeof(count));
+  if (res != sizeof(count)) return (-2);
+  count = ntoh((int16_t) count);
+  for (uint16_t n = 0; n < count; n += res) {
+    size_t size = count - n;
+    if (size > PAYLOAD_MAX) size = PAYLOAD_MAX;
+    res = read(buf, size);
+    if (res <= 0) return (-2);
+    for (uint8_t i = 0; i < res; i++) {
+      for (sub = m_subscriber; sub != NULL; sub = sub->m_next)
+	sub->match(buf[i]);
+      if (n + i < TOPIC_MAX) topic[n + i] = buf[i];
+    }
+  }
+  topic[count < TOPIC_MAX ? count : TOPIC_MAX] = 0;
+  length -= count + sizeof(count);
+
+  // Read message identity (for higher quality of service)
+  if (qos != FIRE_AND_FORGET) {
+    res = read(&id, sizeof(id));
+    if (res != sizeof(id)) return (-2);
+    length -= sizeof(id);
+  }
 
-  // Check acknowledged and assured delivery
+  // Write response message. Assured delivery messages are delivered
+  // once; duplicates are only acknowledged until released
+  bool deliver = true;
   switch (qos) {
   case FIRE_AND_FORGET:
-    return (0);
+    break;
   case ACKNOWLEDGED_DELIVERY:
-    res = read(&response, sizeof(response));
-    if (res != sizeof(response)) return (-2);
-    if ((response.cmd != PUBACK)
-	|| (response.length != sizeof(response.id))
-	|| (response.id != id)) return (-3);
-    return (0);
+    res = acknowledge(PUBACK, id);
+    if (res < 0) return (-3);
+    break;
   case ASSURED_DELIVERY:
-    res = read(&response, sizeof(response));
-    if (res != sizeof(response)) return (-2);
-    if ((response.cmd != PUBREC)
-	|| (response.length != sizeof(response.id))
-	|| (response.id != id)) return (-3);
-    response.cmd = PUBREL;
-    write(&response, sizeof(response));
-    res = flush();
-    if (res < 0) return (-1);
-    res = read(&response, sizeof(response));
-    if (res != sizeof(response)) return (-2);
-    if ((response.cmd != PUBCOMP)
-	|| (response.length != sizeof(response.id))
-	|| (response.id != id)) return (-4);
-    return (0);
+    uint8_t i;
+    for (i = 0; i < INFLIGHT_MAX; i++)
+      if (m_rel[i] == id) break;
+    if (i < INFLIGHT_MAX) {
+      deliver = false;
+    }
+    else {
+      for (i = 0; i < INFLIGHT_MAX; i++)
+	if (m_rel[i] == 0) break;
+      // No room for release; skip message and wait for retransmission
+      if (i == INFLIGHT_MAX) {
+	deliver = false;
+	break;
+      }
+      m_rel[i] = id;
+    }
+    res = acknowledge(PUBREC, id);
+    if (res < 0) return (-4);
+    break;
+  default:
+    return (-1);
+  }
+
+  // Start delivery to matching subscribers. Default handler is used
+  // when no subscriber matched and the message fits in buffer
+  bool matched = false;
+  if (deliver) {
+    for (sub = m_subscriber; sub != NULL; sub = sub->m_next) {
+      if (!sub->is_match()) continue;
+      sub->on_publish_begin(topic, length);
+      matched = true;
+    }
+  }
+  bool fits = !matched && deliver
+    && (count <= TOPIC_MAX) && (length <= PAYLOAD_MAX);
+
+  // Stream the payload to subscribers in buffer sized fragments
+  for (uint16_t n = 0; n < length; n += res) {
+    size_t size = length - n;
+    if (size > PAYLOAD_MAX) size = PAYLOAD_MAX;
+    uint8_t* bp = (fits ? buf + n : buf);
+    res = read(bp, fits ? length - n : size);
+    if (res <= 0) return (-2);
+    if (!matched) continue;
+    for (sub = m_subscriber; sub != NULL; sub = sub->m_next)
+      if (sub->is_match()) sub->on_publish_data(bp, res);
+  }
+
+  // Complete delivery
+  if (matched) {
+    for (sub = m_subscriber; sub != NULL; sub = sub->m_next)
+      if (sub->is_match()) sub->on_publish_end();
+  }
+  else if (fits) {
+    buf[length] = 0;
+    on_publish(topic, buf, length);
+  }
+  return (0);
+}
+
+void
+MQTT::Client::attach(Subscriber* sub)
+{
+  if (sub->m_next != NULL) return;
+  for (Subscriber* sp = m_subscriber; sp != NULL; sp = sp->m_next)
+    if (sp == sub) return;
+  sub->m_next = m_subscriber;
+  m_subscriber = sub;
+}
+
+void
+MQTT::Client::detach(Subscriber* sub)
+{
+  Subscriber** sp = &m_subscriber;
+  while (*sp != NULL) {
+    if (*sp == sub) {
+      *sp = sub->m_next;
+      sub->m_next = NULL;
+      return;
+    }
+    sp = &(*sp)->m_next;
+  }
+}
+
+int
+MQTT::Client::subscribe(Subscriber* sub, QoS_t qos)
+{
+  attach(sub);
+  int res = subscribe((str_P) sub->m_filter, qos);
+  if (res < 0) detach(sub);
+  return (res);
+}
+
+int
+MQTT::Client::unsubscribe(Subscriber* sub)
+{
+  detach(sub);
+  return (unsubscribe((str_P) sub->m_filter));
+}
+
+void
+MQTT::Client::Subscriber::match(char c)
+{
+  if (m_state != MATCHING) return;
+  char f = pgm_read_byte(m_filter + m_pos);
+
+  // Multi-level wildcard; matches the remaining topic
+  if (f == '#') {
+    m_state = MATCHED;
+    return;
   }
-  return (-1);
+
+  // Single-level wildcard; matches until level separator
+  if (f == '+') {
+    if (c != '/') return;
+    f = pgm_read_byte(m_filter + ++m_pos);
+  }
+  if (f == c)
+    m_pos += 1;
+  else
+    m_state = FAILED;
+}
+
+bool
+MQTT::Client::Subscriber::is_match() const
+{
+  if (m_state == MATCHED) return (true);
+  if (m_state == FAILED) return (false);
+
+  // End of topic; remaining filter must be empty, single-level
+  // wildcard or parent level multi-level wildcard
+  const char* fp = m_filter + m_pos;
+  char f = pgm_read_byte(fp);
+  if (f == 0) return (true);
+  if (f == '+') return (pgm_read_byte(fp + 1) == 0);
+  if (f == '#') return (true);
+  return ((f == '/') && (pgm_read_byte(fp + 1) == '#'));
 }
 
 int
 MQTT::Client::subscribe(str_P topic, QoS_t qos)
 {
   // Calculate length of variable payload; id, topic, qos
-  size_t length = sizeof(uint16_t);
+  uint16_t length = sizeof(uint16_t);
   length += strlen_P(topic) + sizeof(uint16_t) + sizeof(uint8_t);
   uint16_t id = hton((int16_t) m_mid++);
   if (m_mid == 0) m_mid = 1;
@@ -269,18 +576,23 @@ MQTT::Client::subscribe(str_P topic, QoS_t qos)
   puts(topic);
   write(&qos, sizeof(uint8_t));
   int res = flush();
+  if (res < 0) return (-1);
 
-  // Wait for response; SUBACK or timeout
+  // Wait for response; SUBACK or timeout. Handle other messages
+  uint8_t cmd;
+  while (1) {
+    res = read(cmd, length, 3000L);
+    if (res < 0) return (-2);
+    if (cmd == SUBACK) break;
+    dispatch(cmd, length);
+  }
   struct {
-    uint8_t cmd;
-    uint8_t length;
     uint16_t id;
     uint8_t qos;
   } response;
   res = read(&response, sizeof(response));
   if (res != sizeof(response)) return (-2);
-  if ((response.cmd != SUBACK)
-      || (response.length != 3)
+  if ((length != 3)
       || (response.id != id)
       || (response.qos != qos)) return (-3);
   return (0);
@@ -290,7 +602,7 @@ int
 MQTT::Client::unsubscribe(str_P topic)
 {
   // Calculate length of variable payload
-  size_t length = sizeof(uint16_t);
+  uint16_t length = sizeof(uint16_t);
   length += strlen_P(topic) + sizeof(uint16_t);
   uint16_t id = hton((int16_t) m_mid++);
   if (m_mid == 0) m_mid = 1;
@@ -301,105 +613,40 @@ MQTT::Client::unsubscribe(str_P topic)
   int res = flush();
   if (res < 0) return (-1);
 
-  // Wait for response; UNSUBACK or timeout
-  struct {
-    uint8_t cmd;
-    uint8_t length;
-    uint16_t id;
-  } response;
+  // Wait for response; UNSUBACK or timeout. Handle other messages
+  uint8_t cmd;
+  while (1) {
+    res = read(cmd, length, 3000L);
+    if (res < 0) return (-2);
+    if (cmd == UNSUBACK) break;
+    dispatch(cmd, length);
+  }
+  uint16_t response;
   res = read(&response, sizeof(response));
   if (res != sizeof(response)) return (-2);
-  if ((response.cmd != UNSUBACK)
-      || (response.length != 2)
-      || (response.id != id)) return (-3);
+  if ((length != 2) || (response != id)) return (-3);
   return (0);
 }
 
 int
 MQTT::Client::service(uint32_t ms)
 {
-  struct {
-    uint8_t cmd;
-    uint8_t length;
-  } request;
-
-  // Read request (publish). Check for timeout
-  int res = read(&request, sizeof(request), ms);
-  if (res != sizeof(request)) return (res);
-  uint16_t length = request.length;
-  if (request.length > 128) {
-    uint8_t msb;
-    res = read(&msb, sizeof(msb));
-    length |= (msb << 7);
-  }
-
-  // Check that it is a publish
-  if ((request.cmd & MESSAGE_TYPE_MASK) != PUBLISH) return (-1);
-  uint8_t qos = ((request.cmd & MESSAGE_QOS_MASK) >> MESSAGE_QOS_POS);
-
-  // Read topic length and string
-  uint16_t count;
-  res = read(&count, sizeof(count));
-  if (res != sizeof(count)) return (-2);
-  count = ntoh((int16_t) count);
-  char topic[count + 1];
-  res = read(topic, count);
-  if (res != (int) count) return (-2);
-  topic[count] = 0;
-  length -= count + sizeof(count);
-
-  // Read message identity (for higher quality of service)
-  uint16_t id = 0;
-  if (qos != FIRE_AND_FORGET) {
-    res = read(&id, sizeof(id));
-    if (res != sizeof(id)) return (-2);
-    length -= sizeof(id);
-  }
-
-  // Read payload and call on_publish handler
-  uint8_t payload[length + 1];
-  res = read(payload, length);
-  if (res != (int) length) return (-2);
-  payload[length] = 0;
-
-  // Write response message(s)
-  struct {
-    uint8_t cmd;
-    uint8_t length;
-    uint16_t id;
-  } response;
-  response.length = sizeof(response.id);
-  response.id = id;
+  // Read next message. Retransmit messages in flight while waiting
+  uint32_t start = Watchdog::millis();
+  uint16_t length;
+  uint8_t cmd;
+  int res;
+  do {
+    retransmit();
+    uint32_t period = ms;
+    if ((m_inflight != 0) && ((period == 0L) || (period > RETRY_TIMEOUT)))
+      period = RETRY_TIMEOUT;
+    res = read(cmd, length, period);
+  } while ((res == -2) && ((ms == 0L) || (Watchdog::since(start) < ms)));
+  if (res < 0) return (res);
 
-  switch (qos) {
-  case FIRE_AND_FORGET:
-    on_publish(topic, payload, length);
-    return (0);
-  case ACKNOWLEDGED_DELIVERY:
-    response.cmd = PUBACK;
-    res = write(&response, sizeof(response));
-    res = flush();
-    if (res < 0) return (-3);
-    on_publish(topic, payload, length);
-    return (0);
-  case ASSURED_DELIVERY:
-    response.cmd = PUBREC;
-    res = write(&response, sizeof(response));
-    res = flush();
-    if (res < 0) return (-4);
-    res = read(&response, sizeof(response));
-    if (res != sizeof(response)) return (-2);
-    if ((response.cmd != PUBREL)
-	|| (response.length != sizeof(response.id))
-	|| (response.id != id)) return (-5);
-    response.cmd = PUBCOMP;
-    write(&response, sizeof(response));
-    res = flush();
-    if (res < 0) return (-6);
-    on_publish(topic, payload, length);
-    return (0);
-  }
-  return (-1);
+  // Handle publish, acknowledgement or release
+  return (dispatch(cmd, length));
 }
 
 void
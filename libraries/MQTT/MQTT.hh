@@ -24,9 +24,36 @@
 #include "Cosa/Types.h"
 #include "Cosa/Socket.hh"
 
+#ifndef COSA_MQTT_INFLIGHT_MAX
+#define COSA_MQTT_INFLIGHT_MAX 4
+#endif
+
+#ifndef COSA_MQTT_TOPIC_MAX
+#define COSA_MQTT_TOPIC_MAX 32
+#endif
+
+#ifndef COSA_MQTT_PAYLOAD_MAX
+#define COSA_MQTT_PAYLOAD_MAX 64
+#endif
+
 /**
  * MQTT V3.1 Protocol client implementation.
  *
+ * Publish with acknowledged or assured delivery is asynchronous. The
+ * message is recorded in an in-flight table and publish returns
+ * directly. Acknowledgements (PUBACK, PUBREC, PUBCOMP) are matched on
+ * message identity, in any order, when the client is serviced, and
+ * unacknowledged messages are retransmitted after RETRY_TIMEOUT. The
+ * number of messages in flight is limited by the window size
+ * (Default and max COSA_MQTT_INFLIGHT_MAX).
+ *
+ * Incoming publish messages are streamed through a fixed size buffer
+ * (COSA_MQTT_PAYLOAD_MAX) to the subscribers with a matching topic
+ * filter (MQTT::Client::Subscriber). The topic is matched
+ * incrementally so peak memory usage does not depend on the message
+ * size. Messages that no subscriber matched are passed to
+ * on_publish() if topic and payload fit in the buffers.
+ *
  * @section Reference
  * 1. MQTT V3.1 Protocol Specification,
  *    Copyright (c) 1999-2010, Eurotech, IBM.
@@ -48,13 +75,119 @@ public:
    */
   class Client {
   public:
+    /**
+     * MQTT subscriber; receive publish messages with topic matching
+     * the subscription filter as a stream of payload fragments. The
+     * filter may contain single-level (+) and multi-level (#)
+     * wildcards.
+     */
+    class Subscriber {
+    public:
+      /**
+       * Construct subscriber with given topic filter.
+       * @param[in] filter topic filter (program memory string).
+       */
+      Subscriber(str_P filter) :
+	m_next(NULL),
+	m_filter((const char*) filter),
+	m_pos(0),
+	m_state(MATCHING)
+      {}
+
+      /**
+       * @override MQTT::Client::Subscriber
+       * Called on start of matching publish message with topic and
+       * payload length. The topic is truncated to TOPIC_MAX characters.
+       * @param[in] topic string.
+       * @param[in] length number of bytes in payload.
+       */
+      virtual void on_publish_begin(const char* topic, size_t length)
+      {
+	UNUSED(topic);
+	UNUSED(length);
+      }
+
+      /**
+       * @override MQTT::Client::Subscriber
+       * Called with each payload fragment (max PAYLOAD_MAX bytes).
+       * @param[in] buf buffer with payload fragment.
+       * @param[in] size number of bytes in buffer.
+       */
+      virtual void on_publish_data(const void* buf, size_t size) = 0;
+
+      /**
+       * @override MQTT::Client::Subscriber
+       * Called on end of matching publish message.
+       */
+      virtual void on_publish_end() {}
+
+    protected:
+      /** Topic matching state. */
+      enum {
+	MATCHING,		//!< Topic matching filter so far.
+	MATCHED,		//!< Topic matched (multi-level wildcard).
+	FAILED			//!< Topic does not match filter.
+      } __attribute__((packed));
+
+      Subscriber* m_next;	//!< Next subscriber in list.
+      const char* m_filter;	//!< Topic filter (program memory).
+      uint8_t m_pos;		//!< Current position in filter.
+      uint8_t m_state;		//!< Topic matching state.
+
+      /**
+       * Reset topic matching state.
+       */
+      void reset()
+      {
+	m_pos = 0;
+	m_state = MATCHING;
+      }
+
+      /**
+       * Match next topic character with filter.
+       * @param[in] c topic character.
+       */
+      void match(char c);
+
+      /**
+       * Return true(1) if the topic matched the filter otherwise
+       * false(0). Should be called after the full topic is matched.
+       * @return bool.
+       */
+      bool is_match() const;
+
+      friend class Client;
+    };
+
     /**
      * Default constructor; initiate client state.
      */
     Client() :
       m_sock(NULL),
-      m_mid(1)
-    {}
+      m_mid(1),
+      m_published(0),
+      m_window(INFLIGHT_MAX),
+      m_inflight(0),
+      m_subscriber(NULL)
+    {
+      memset(m_msg, 0, sizeof(m_msg));
+      memset(m_rel, 0, sizeof(m_rel));
+    }
+
+    /** Max number of messages in flight (window size). */
+    static const uint8_t INFLIGHT_MAX = COSA_MQTT_INFLIGHT_MAX;
+
+    /** Retransmission timeout period (milli-seconds). */
+    static const uint16_t RETRY_TIMEOUT = 3000;
+
+    /** Max number of retransmissions before the message is dropped. */
+    static const uint8_t RETRY_MAX = 3;
+
+    /** Max length of topic passed to on_publish handlers. */
+    static const size_t TOPIC_MAX = COSA_MQTT_TOPIC_MAX;
+
+    /** Size of payload buffer; max payload fragment size. */
+    static const size_t PAYLOAD_MAX = COSA_MQTT_PAYLOAD_MAX;
 
     /**
      * Default destructor.
@@ -118,10 +251,46 @@ public:
      */
     int disconnect();
 
+    /**
+     * Set window size; max number of messages in flight. The value
+     * is limited to INFLIGHT_MAX.
+     * @param[in] size window size.
+     */
+    void set_window(uint8_t size)
+    {
+      if (size == 0) size = 1;
+      if (size > INFLIGHT_MAX) size = INFLIGHT_MAX;
+      m_window = size;
+    }
+
+    /**
+     * Get number of messages in flight; waiting for acknowledgement.
+     * @return number of messages.
+     */
+    uint8_t inflight() const
+    {
+      return (m_inflight);
+    }
+
+    /**
+     * Get message identity of latest publish with acknowledged or
+     * assured delivery. Used to match on_delivery() calls. Subscribe
+     * and unsubscribe requests do not change the value.
+     * @return message identity or zero if no publish.
+     */
+    uint16_t get_mid() const
+    {
+      return (m_published);
+    }
+
     /**
      * Publish the value in buffer to the given topic with the given
      * QoS and retain flag. Returns zero if successful otherwise
-     * negative error code.
+     * negative error code. Acknowledged and assured delivery
+     * messages are put in flight and the buffer must be kept valid
+     * until delivered (on_delivery()) as it is used for
+     * retransmission. If the window is full the client is serviced
+     * until a slot is free or RETRY_TIMEOUT.
      * @param[in] topic string (program memory).
      * @param[in] buf buffer pointer (data or program memory).
      * @param[in] count number of bytes in buffer.
@@ -189,9 +358,42 @@ public:
     int unsubscribe(str_P topic);
 
     /**
-     * Service the MQTT client. Check for publish messages. Decode and
-     * calls virtual member function on_publish(). Returns zero if
-     * successful otherwise negative error code.
+     * Attach given subscriber and subscribe to its topic filter with
+     * requested quality of service. Returns zero if successful
+     * otherwise negative error code.
+     * @param[in] sub subscriber.
+     * @param[in] qos requested quality of service.
+     * @return zero if successful otherwise negative error code.
+     */
+    int subscribe(Subscriber* sub, QoS_t qos = FIRE_AND_FORGET);
+
+    /**
+     * Detach given subscriber and unsubscribe its topic filter.
+     * Returns zero if successful otherwise negative error code.
+     * @param[in] sub subscriber.
+     * @return zero if successful otherwise negative error code.
+     */
+    int unsubscribe(Subscriber* sub);
+
+    /**
+     * Attach given subscriber for local delivery of publish messages
+     * matching the subscriber topic filter (no subscribe request).
+     * @param[in] sub subscriber.
+     */
+    void attach(Subscriber* sub);
+
+    /**
+     * Detach given subscriber.
+     * @param[in] sub subscriber.
+     */
+    void detach(Subscriber* sub);
+
+    /**
+     * Service the MQTT client. Retransmit timed out messages in
+     * flight. Check for incoming messages; publish and
+     * acknowledgements. Decode and calls virtual member function
+     * on_publish() or on_delivery(). Returns zero if successful
+     * otherwise negative error code.
      * @param[in] ms timeout period, milli-seconds (Default BLOCK).
      * @return zero if successful otherwise negative error code.
      */
@@ -199,7 +401,24 @@ public:
 
     /**
      * @override MQTT::Client
-     * Called by service when received a publish message.
+     * Called by service when a message in flight has been delivered
+     * (res zero) or dropped after RETRY_MAX retransmissions (res
+     * negative error code).
+     * @param[in] mid message identity.
+     * @param[in] res zero or negative error code.
+     */
+    virtual void on_delivery(uint16_t mid, int res)
+    {
+      UNUSED(mid);
+      UNUSED(res);
+    }
+
+    /**
+     * @override MQTT::Client
+     * Called by service when received a publish message that did not
+     * match any subscriber and where the topic and payload fit in
+     * the buffers (TOPIC_MAX and PAYLOAD_MAX). The payload is null
+     * terminated.
      * @param[in] topic string.
      * @param[in] buf buffer with topic value.
      * @param[in] count number of bytes in buffer.
@@ -208,12 +427,45 @@ public:
     virtual void on_publish(char* topic, void* buf, size_t count);
 
   protected:
+    /** Message in flight; waiting for acknowledgement. */
+    struct inflight_t {
+      uint16_t id;		//!< Message identity (network order), zero if free.
+      uint8_t cmd;		//!< Expected acknowledgement.
+      uint8_t flags;		//!< Publish flags; qos, retain, progmem.
+      uint8_t retry;		//!< Number of retransmissions.
+      uint32_t start;		//!< Time of latest transmission.
+      str_P topic;		//!< Topic (program memory).
+      const void* buf;		//!< Payload buffer.
+      size_t count;		//!< Payload size.
+    };
+
+    /** Publish flag; payload buffer in program memory. */
+    static const uint8_t PROGMEM_FLAG = 0x80;
+
     /** Connection-oriented socket. */
     Socket* m_sock;
 
     /** Message sequence number (1..UINT16_MAX). */
     uint16_t m_mid;
 
+    /** Message identity of latest publish in flight. */
+    uint16_t m_published;
+
+    /** Window size; max number of messages in flight. */
+    uint8_t m_window;
+
+    /** Number of messages in flight. */
+    uint8_t m_inflight;
+
+    /** Outgoing messages in flight. */
+    inflight_t m_msg[INFLIGHT_MAX];
+
+    /** Incoming assured delivery messages waiting for release. */
+    uint16_t m_rel[INFLIGHT_MAX];
+
+    /** List of subscribers. */
+    Subscriber* m_subscriber;
+
     // Support member functions
     int write(uint8_t cmd, uint16_t length, uint16_t id = 0);
     int write(const void* buf, size_t count);
@@ -221,6 +473,52 @@ public:
     int puts(str_P s);
     int read(void* buf, size_t count, uint32_t ms = 3000L);
     int flush();
+
+    /**
+     * Read message fixed header; command and remaining length. Wait
+     * at most given time period. Returns zero if successful
+     * otherwise negative error code.
+     * @param[out] cmd message command and flags.
+     * @param[out] length remaining length.
+     * @param[in] ms timeout period, milli-seconds.
+     * @return zero if successful otherwise negative error code.
+     */
+    int read(uint8_t& cmd, uint16_t& length, uint32_t ms);
+
+    /**
+     * Handle incoming message with given command and remaining
+     * length; publish, acknowledgement or release. Returns zero if
+     * successful otherwise negative error code.
+     * @param[in] cmd message command and flags.
+     * @param[in] length remaining length.
+     * @return zero if successful otherwise negative error code.
+     */
+    int dispatch(uint8_t cmd, uint16_t length);
+
+    /**
+     * Write acknowledgement message with given command and message
+     * identity (network order) and flush. Returns zero if successful
+     * otherwise negative error code.
+     * @param[in] cmd acknowledgement command.
+     * @param[in] id message identity.
+     * @return zero if successful otherwise negative error code.
+     */
+    int acknowledge(uint8_t cmd, uint16_t id);
+
+    /**
+     * Write publish message for given in-flight message. Sets the
+     * duplicate flag if retransmission. Returns zero if successful
+     * otherwise negative error code.
+     * @param[in] msg message in flight.
+     * @return zero if successful otherwise negative error code.
+     */
+    int transmit(inflight_t* msg);
+
+    /**
+     * Retransmit messages in flight that have timed out. Drop
+     * messages after RETRY_MAX retransmissions.
+     */
+    void retransmit();
   };
 protected:
   /** Message format: Fixed header message type and flags (pp. 4-7). */
@@ -53,8 +53,16 @@
 class MQTTClient : public MQTT::Client {
 public:
   virtual void on_publish(char* topic, void* buf, size_t count);
+  virtual void on_delivery(uint16_t mid, int res);
 };
 
+void
+MQTTClient::on_delivery(uint16_t mid, int res)
+{
+  trace << PSTR("on_delivery::mid = ") << mid
+	<< PSTR(", res = ") << res << endl;
+}
+
 void
 MQTTClient::on_publish(char* topic, void* buf, size_t count)
 {
@@ -67,6 +75,26 @@ MQTTClient::on_publish(char* topic, void* buf, size_t count)
   publish(PSTR("public/cosa/a/e"), buf, count);
 }
 
+// Streaming subscriber; trace topic and payload fragments
+class TraceSubscriber : public MQTT::Client::Subscriber {
+public:
+  TraceSubscriber(str_P filter) : MQTT::Client::Subscriber(filter) {}
+  virtual void on_publish_begin(const char* topic, size_t length)
+  {
+    trace << PSTR("on_publish_begin::topic = ") << topic
+	  << PSTR(", length = ") << length << endl;
+  }
+  virtual void on_publish_data(const void* buf, size_t size)
+  {
+    trace.get_device()->write(buf, size);
+  }
+  virtual void on_publish_end()
+  {
+    trace << endl << PSTR("on_publish_end") << endl;
+  }
+};
+TraceSubscriber subscriber(PSTR("public/cosa/b/#"));
+
 // MQTT client name
 const char CLIENT[] __PROGMEM = "CosaMQTTclient";
 MQTTClient client;
@@ -92,29 +120,35 @@ void setup()
   // Publish data with the different quality of service levels
   TRACE(client.publish_P(PSTR("public/cosa/client"), CLIENT, sizeof(CLIENT)));
 
-  uint8_t buf[16];
-  memset(buf, 'a', sizeof(buf));
-  TRACE(client.publish(PSTR("public/cosa/a/a"), buf, sizeof(buf)));
+  // Buffers for messages in flight must be valid until delivered
+  static uint8_t buf[3][16];
+  memset(buf[0], 'a', sizeof(buf[0]));
+  TRACE(client.publish(PSTR("public/cosa/a/a"), buf[0], sizeof(buf[0])));
 
-  memset(buf, 'b', sizeof(buf));
-  TRACE(client.publish(PSTR("public/cosa/a/b"), buf, sizeof(buf),
+  memset(buf[1], 'b', sizeof(buf[1]));
+  TRACE(client.publish(PSTR("public/cosa/a/b"), buf[1], sizeof(buf[1]),
 		       MQTT::ACKNOWLEDGED_DELIVERY, false));
 
-  memset(buf, 'c', sizeof(buf));
-  TRACE(client.publish(PSTR("public/cosa/a/c"), buf, sizeof(buf),
+  memset(buf[2], 'c', sizeof(buf[2]));
+  TRACE(client.publish(PSTR("public/cosa/a/c"), buf[2], sizeof(buf[2]),
 		       MQTT::ASSURED_DELIVERY, false));
+
+  // Wait for the messages in flight to be acknowledged
+  while (client.inflight() != 0) TRACE(client.service(1000L));
 }
 
 void loop()
 {
-  // Subscribe to a topic
+  // Subscribe to a topic and a topic filter with streaming subscriber
   TRACE(client.subscribe(PSTR("public/cosa/a/d")));
+  TRACE(client.subscribe(&subscriber));
 
   // Service incoming publish messages. Wait max 10 seconds per message
   for (uint8_t i = 0; i < 6; i++) TRACE(client.service(10000L));
 
   // Unsubscribe and disconnect
   TRACE(client.unsubscribe(PSTR("public/cosa/a/d")));
+  TRACE(client.unsubscribe(&subscriber));
   TRACE(client.disconnect());
 
   // And terminate
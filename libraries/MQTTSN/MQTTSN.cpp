@@ -0,0 +1,408 @@
+/**
+ * @file MQTTSN.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "MQTTSN.hh"
+#include "Cosa/RTC.hh"
+
+int
+MQTTSN::Client::send(uint8_t type, const iovec_t* vec)
+{
+  // Construct message; header and parameters
+  uint8_t msg[MSG_MAX];
+  header_t* header = (header_t*) msg;
+  size_t len = sizeof(header_t);
+  for (const iovec_t* vp = vec; vp->buf != NULL; vp++) {
+    if (len + vp->size > MSG_MAX) return (EMSGSIZE);
+    memcpy(msg + len, vp->buf, vp->size);
+    len += vp->size;
+  }
+  header->length = len;
+  header->type = type;
+  return (m_dev->send(m_gateway, PORT, msg, len));
+}
+
+int
+MQTTSN::Client::recv(uint8_t* msg, uint32_t ms)
+{
+  // Receive message from gateway; ignore other messages
+  uint32_t start = RTC::millis();
+  while (1) {
+    uint8_t src;
+    uint8_t port;
+    int res = m_dev->recv(src, port, msg, MSG_MAX, ms);
+    if (res < 0) return (res);
+    if ((src == m_gateway) && (port == PORT)
+	&& (res >= (int) sizeof(header_t))
+	&& (msg[0] == res))
+      return (res);
+    if ((ms != 0L) && (RTC::since(start) >= ms)) return (ETIME);
+  }
+}
+
+int
+MQTTSN::Client::request(uint8_t type, const iovec_t* vec,
+			uint8_t ack, uint16_t mid, uint8_t pos,
+			uint8_t* msg)
+{
+  // Send request and wait for acknowledgement. Retransmit on timeout
+  for (uint8_t retry = 0; retry <= RETRY_MAX; retry++) {
+    int res = send(type, vec);
+    if (res < 0) return (res);
+    uint32_t start = RTC::millis();
+    while (RTC::since(start) < RETRY_TIMEOUT) {
+      res = recv(msg, RETRY_TIMEOUT);
+      if (res < 0) break;
+      header_t* header = (header_t*) msg;
+      if ((header->type == ack)
+	  && ((mid == 0)
+	      || ((res >= pos + 2) && (memcmp(msg + pos, &mid, 2) == 0))))
+	return (res);
+      dispatch(msg, res);
+    }
+
+    // Mark publish and subscribe retransmission as duplicate
+    if ((type == PUBLISH) || (type == SUBSCRIBE))
+      *((uint8_t*) vec->buf) |= DUP;
+  }
+  return (ETIME);
+}
+
+void
+MQTTSN::Client::dispatch(uint8_t* msg, size_t len)
+{
+  header_t* header = (header_t*) msg;
+  uint16_t topic;
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+
+  switch (header->type) {
+  case PUBLISH:
+    {
+      // Publish from gateway; flags, topic, message identity and data
+      if (len < 7) return;
+      uint8_t flags = msg[2];
+      memcpy(&topic, msg + 3, sizeof(topic));
+      if ((flags & QOS_MASK) == ACKNOWLEDGED_DELIVERY) {
+	uint8_t code = ACCEPTED;
+	iovec_arg(vp, &topic, sizeof(topic));
+	iovec_arg(vp, msg + 5, sizeof(uint16_t));
+	iovec_arg(vp, &code, sizeof(code));
+	iovec_end(vp);
+	send(PUBACK, vec);
+      }
+      on_publish(ntoh(topic), (TopicType_t) (flags & TOPIC_TYPE_MASK),
+		 msg + 7, len - 7);
+    }
+    break;
+  case REGISTER:
+    {
+      // Register topic identity from gateway; topic, message identity
+      // and topic name
+      if (len < 6) return;
+      uint8_t code = ACCEPTED;
+      memcpy(&topic, msg + 2, sizeof(topic));
+      iovec_arg(vp, &topic, sizeof(topic));
+      iovec_arg(vp, msg + 4, sizeof(uint16_t));
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(REGACK, vec);
+      char name[MSG_MAX];
+      memcpy(name, msg + 6, len - 6);
+      name[len - 6] = 0;
+      on_register(ntoh(topic), name);
+    }
+    break;
+  case PINGREQ:
+    iovec_end(vp);
+    send(PINGRESP, vec);
+    break;
+  case DISCONNECT:
+    m_state = DISCONNECTED_STATE;
+    break;
+  default:
+    break;
+  }
+}
+
+int
+MQTTSN::Client::connect(str_P client, uint16_t duration, bool clean)
+{
+  // Send connect request; flags, protocol, duration and client
+  char id[MSG_MAX];
+  size_t len = strlen_P(client);
+  if (len + 6 > MSG_MAX) return (EMSGSIZE);
+  strcpy_P(id, client);
+  uint8_t param[2];
+  param[0] = (clean ? CLEAN_SESSION : 0);
+  param[1] = PROTOCOL_ID;
+  duration = hton((int16_t) duration);
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+  iovec_arg(vp, param, sizeof(param));
+  iovec_arg(vp, &duration, sizeof(duration));
+  iovec_arg(vp, id, len);
+  iovec_end(vp);
+
+  // Wait for connect acknowledgement and check return code
+  uint8_t msg[MSG_MAX];
+  int res = request(CONNECT, vec, CONNACK, 0, 0, msg);
+  if (res < 0) return (res);
+  if (res != 3) return (EPROTO);
+  if (msg[2] != ACCEPTED) return (-msg[2]);
+  m_client = client;
+  m_state = ACTIVE_STATE;
+  return (0);
+}
+
+int
+MQTTSN::Client::disconnect()
+{
+  iovec_t vec[1];
+  iovec_t* vp = vec;
+  iovec_end(vp);
+  uint8_t msg[MSG_MAX];
+  int res = request(DISCONNECT, vec, DISCONNECT, 0, 0, msg);
+  m_state = DISCONNECTED_STATE;
+  return (res < 0 ? res : 0);
+}
+
+int
+MQTTSN::Client::register_topic(str_P topic, uint16_t& id)
+{
+  // Send register request; topic(0), message identity and topic name
+  char name[MSG_MAX];
+  size_t len = strlen_P(topic);
+  if (len + 6 > MSG_MAX) return (EMSGSIZE);
+  strcpy_P(name, topic);
+  uint16_t tid = 0;
+  uint16_t mid = next_mid();
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &tid, sizeof(tid));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, name, len);
+  iovec_end(vp);
+
+  // Wait for register acknowledgement; topic, message identity and code
+  uint8_t msg[MSG_MAX];
+  int res = request(REGISTER, vec, REGACK, mid, 4, msg);
+  if (res < 0) return (res);
+  if (res != 7) return (EPROTO);
+  if (msg[6] != ACCEPTED) return (-msg[6]);
+  memcpy(&tid, msg + 2, sizeof(tid));
+  id = ntoh(tid);
+  return (0);
+}
+
+int
+MQTTSN::Client::publish(uint16_t topic, TopicType_t type,
+			const void* buf, size_t count,
+			QoS_t qos, bool retain)
+{
+  // Send publish; flags, topic, message identity and data
+  uint8_t flags = qos | type;
+  if (retain) flags |= RETAIN;
+  uint16_t mid = (qos == FIRE_AND_FORGET ? 0 : next_mid());
+  topic = hton((int16_t) topic);
+  iovec_t vec[5];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &flags, sizeof(flags));
+  iovec_arg(vp, &topic, sizeof(topic));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, buf, count);
+  iovec_end(vp);
+  if (qos == FIRE_AND_FORGET) {
+    int res = send(PUBLISH, vec);
+    return (res < 0 ? res : 0);
+  }
+
+  // Wait for publish acknowledgement; topic, message identity and code
+  uint8_t msg[MSG_MAX];
+  int res = request(PUBLISH, vec, PUBACK, mid, 4, msg);
+  if (res < 0) return (res);
+  if (res != 7) return (EPROTO);
+  if (msg[6] != ACCEPTED) return (-msg[6]);
+  return (0);
+}
+
+int
+MQTTSN::Client::subscribe(str_P topic, uint16_t& id, QoS_t qos)
+{
+  // Send subscribe request; flags, message identity and topic name
+  char name[MSG_MAX];
+  size_t len = strlen_P(topic);
+  if (len + 5 > MSG_MAX) return (EMSGSIZE);
+  strcpy_P(name, topic);
+  uint8_t flags = qos | NORMAL_TOPIC;
+  uint16_t mid = next_mid();
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &flags, sizeof(flags));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, name, len);
+  iovec_end(vp);
+
+  // Wait for acknowledgement; flags, topic, message identity and code
+  uint8_t msg[MSG_MAX];
+  int res = request(SUBSCRIBE, vec, SUBACK, mid, 5, msg);
+  if (res < 0) return (res);
+  if (res != 8) return (EPROTO);
+  if (msg[7] != ACCEPTED) return (-msg[7]);
+  uint16_t tid;
+  memcpy(&tid, msg + 3, sizeof(tid));
+  id = ntoh(tid);
+  return (0);
+}
+
+int
+MQTTSN::Client::subscribe(uint16_t topic, TopicType_t type, QoS_t qos)
+{
+  // Send subscribe request; flags, message identity and topic identity
+  uint8_t flags = qos | type;
+  uint16_t mid = next_mid();
+  topic = hton((int16_t) topic);
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &flags, sizeof(flags));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, &topic, sizeof(topic));
+  iovec_end(vp);
+
+  // Wait for acknowledgement; flags, topic, message identity and code
+  uint8_t msg[MSG_MAX];
+  int res = request(SUBSCRIBE, vec, SUBACK, mid, 5, msg);
+  if (res < 0) return (res);
+  if (res != 8) return (EPROTO);
+  if (msg[7] != ACCEPTED) return (-msg[7]);
+  return (0);
+}
+
+int
+MQTTSN::Client::unsubscribe(uint16_t topic, TopicType_t type)
+{
+  // Send unsubscribe request; flags, message identity and topic identity
+  uint8_t flags = type;
+  uint16_t mid = next_mid();
+  topic = hton((int16_t) topic);
+  iovec_t vec[4];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &flags, sizeof(flags));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, &topic, sizeof(topic));
+  iovec_end(vp);
+
+  // Wait for acknowledgement; message identity
+  uint8_t msg[MSG_MAX];
+  int res = request(UNSUBSCRIBE, vec, UNSUBACK, mid, 2, msg);
+  return (res < 0 ? res : 0);
+}
+
+int
+MQTTSN::Client::ping()
+{
+  iovec_t vec[1];
+  iovec_t* vp = vec;
+  iovec_end(vp);
+  uint8_t msg[MSG_MAX];
+  int res = request(PINGREQ, vec, PINGRESP, 0, 0, msg);
+  return (res < 0 ? res : 0);
+}
+
+int
+MQTTSN::Client::asleep(uint16_t duration)
+{
+  // Send disconnect with sleep duration and wait for acknowledgement
+  if (m_state == DISCONNECTED_STATE) return (ENOTCONN);
+  duration = hton((int16_t) duration);
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &duration, sizeof(duration));
+  iovec_end(vp);
+  uint8_t msg[MSG_MAX];
+  int res = request(DISCONNECT, vec, DISCONNECT, 0, 0, msg);
+  if (res < 0) return (res);
+
+  // Power down the radio
+  m_state = ASLEEP_STATE;
+  m_dev->powerdown();
+  return (0);
+}
+
+int
+MQTTSN::Client::awake()
+{
+  // Power up the radio and send ping request with client identifier
+  if (m_state != ASLEEP_STATE) return (EPERM);
+  m_dev->powerup();
+  m_state = AWAKE_STATE;
+  char id[MSG_MAX];
+  strcpy_P(id, m_client);
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, id, strlen(id));
+  iovec_end(vp);
+  int res = send(PINGREQ, vec);
+
+  // Receive buffered messages until ping response
+  if (res >= 0) {
+    uint8_t msg[MSG_MAX];
+    res = 0;
+    while (1) {
+      int len = recv(msg, RETRY_TIMEOUT);
+      if (len < 0) {
+	res = len;
+	break;
+      }
+      if (msg[1] == PINGRESP) break;
+      if (msg[1] == PUBLISH) res += 1;
+      dispatch(msg, len);
+    }
+  }
+
+  // Return to sleep state and power down radio
+  if (m_state == AWAKE_STATE) m_state = ASLEEP_STATE;
+  m_dev->powerdown();
+  return (res);
+}
+
+int
+MQTTSN::Client::sleep(uint16_t s)
+{
+  // Enter sleep state; gateway keep alive timeout is twice the period
+  int res;
+  if (m_state == ACTIVE_STATE) {
+    res = asleep(s * 2);
+    if (res < 0) return (res);
+  }
+
+  // Low power sleep with radio powered down and check for messages
+  ::sleep(s);
+  return (awake());
+}
+
+int
+MQTTSN::Client::service(uint32_t ms)
+{
+  uint8_t msg[MSG_MAX];
+  int res = recv(msg, ms);
+  if (res < 0) return (res);
+  dispatch(msg, res);
+  return (0);
+}
@@ -0,0 +1,377 @@
+/**
+ * @file MQTTSN.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_MQTTSN_HH
+#define COSA_MQTTSN_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+
+/**
+ * MQTT-SN V1.2 Protocol client for wireless sensor nodes. Messages
+ * are sent with the Cosa Wireless interface to a gateway node that
+ * bridges to an MQTT server (see MQTTSNGateway). Topics are
+ * identified with 16-bit topic identities; predefined, registered
+ * or two character short topic names. Supports quality of service
+ * level 0 and 1, and sleeping clients; messages for a sleeping
+ * client are buffered by the gateway and delivered when the client
+ * wakes up.
+ *
+ * @section Limitations
+ * Gateway address is given; no gateway discovery (ADVERTISE,
+ * SEARCHGW and GWINFO), no will topic/message and no QoS level 2.
+ *
+ * @section References
+ * 1. MQTT For Sensor Networks (MQTT-SN) Protocol Specification,
+ *    Version 1.2, Nov. 14, 2013, A. Stanford-Clark and H.L. Truong,
+ *    IBM.
+ */
+class MQTTSN {
+public:
+  /** Wireless port (message type) for MQTT-SN messages. */
+  static const uint8_t PORT = 0x60;
+
+  /** Max size of message (including header). */
+  static const size_t MSG_MAX = 30;
+
+  /** Quality of service levels on publish (flags, pp. 11). */
+  enum QoS_t {
+    FIRE_AND_FORGET = 0x00,	//!< At most once; Fire and forget.
+    ACKNOWLEDGED_DELIVERY = 0x20 //!< At least once; Acknowledged delivery.
+  } __attribute__((packed));
+
+  /** Topic identity type (flags, pp. 11). */
+  enum TopicType_t {
+    NORMAL_TOPIC = 0x00,	//!< Registered topic identity.
+    PREDEFINED_TOPIC = 0x01,	//!< Predefined topic identity.
+    SHORT_TOPIC = 0x02		//!< Short topic name (two characters).
+  } __attribute__((packed));
+
+  /** Return codes (pp. 11). */
+  enum {
+    ACCEPTED = 0x00,		//!< Accepted.
+    REJECTED_CONGESTION = 0x01,	//!< Rejected; congestion.
+    REJECTED_INVALID_TOPIC = 0x02, //!< Rejected; invalid topic identity.
+    REJECTED_NOT_SUPPORTED = 0x03 //!< Rejected; not supported.
+  } __attribute__((packed));
+
+  /**
+   * Return short topic identity for given two character topic name.
+   * @param[in] c0 first character.
+   * @param[in] c1 second character.
+   * @return topic identity.
+   */
+  static uint16_t short_topic(char c0, char c1)
+  {
+    return ((((uint8_t) c0) << 8) | ((uint8_t) c1));
+  }
+
+  /**
+   * MQTT-SN client; wireless sensor node access to MQTT server
+   * through gateway.
+   */
+  class Client {
+  public:
+    /**
+     * Construct MQTT-SN client with given wireless device driver and
+     * gateway device address.
+     * @param[in] dev wireless device driver.
+     * @param[in] gateway device address.
+     */
+    Client(Wireless::Driver* dev, uint8_t gateway) :
+      m_dev(dev),
+      m_gateway(gateway),
+      m_client(NULL),
+      m_mid(1),
+      m_state(DISCONNECTED_STATE)
+    {}
+
+    /**
+     * Connect to gateway with given client identifier and keep alive
+     * duration in seconds. Returns zero if successful otherwise
+     * negative error code.
+     * @param[in] client identifier (program memory string).
+     * @param[in] duration keep alive (Default 600 seconds).
+     * @param[in] clean session flag (Default true).
+     * @return zero if successful otherwise negative error code.
+     */
+    int connect(str_P client, uint16_t duration = 600, bool clean = true);
+
+    /**
+     * Disconnect from gateway. Returns zero if successful otherwise
+     * negative error code.
+     * @return zero if successful otherwise negative error code.
+     */
+    int disconnect();
+
+    /**
+     * Register given topic name and return topic identity. Returns
+     * zero if successful otherwise negative error code.
+     * @param[in] topic name (program memory string).
+     * @param[out] id topic identity.
+     * @return zero if successful otherwise negative error code.
+     */
+    int register_topic(str_P topic, uint16_t& id);
+
+    /**
+     * Publish the value in buffer to the given topic with the given
+     * topic type, QoS and retain flag. Returns zero if successful
+     * otherwise negative error code.
+     * @param[in] topic identity.
+     * @param[in] type topic identity type.
+     * @param[in] buf buffer pointer.
+     * @param[in] count number of bytes in buffer.
+     * @param[in] qos quality of service (Default FIRE_AND_FORGET).
+     * @param[in] retain require server to maintain value (Default false).
+     * @return zero if successful otherwise negative error code.
+     */
+    int publish(uint16_t topic, TopicType_t type,
+		const void* buf, size_t count,
+		QoS_t qos = FIRE_AND_FORGET,
+		bool retain = false);
+
+    /**
+     * Subscribe to given topic name. Returns zero if successful
+     * otherwise negative error code. The topic identity is returned
+     * (for non-wildcard topic names).
+     * @param[in] topic name (program memory string).
+     * @param[out] id topic identity.
+     * @param[in] qos requested quality of service.
+     * @return zero if successful otherwise negative error code.
+     */
+    int subscribe(str_P topic, uint16_t& id, QoS_t qos = FIRE_AND_FORGET);
+
+    /**
+     * Subscribe to given predefined or short topic identity. Returns
+     * zero if successful otherwise negative error code.
+     * @param[in] topic identity.
+     * @param[in] type topic identity type.
+     * @param[in] qos requested quality of service.
+     * @return zero if successful otherwise negative error code.
+     */
+    int subscribe(uint16_t topic, TopicType_t type,
+		  QoS_t qos = FIRE_AND_FORGET);
+
+    /**
+     * Unsubscribe to given predefined or short topic identity. Returns
+     * zero if successful otherwise negative error code.
+     * @param[in] topic identity.
+     * @param[in] type topic identity type.
+     * @return zero if successful otherwise negative error code.
+     */
+    int unsubscribe(uint16_t topic, TopicType_t type);
+
+    /**
+     * Send keep alive ping and wait for response. Returns zero if
+     * successful otherwise negative error code.
+     * @return zero if successful otherwise negative error code.
+     */
+    int ping();
+
+    /**
+     * Enter sleep state with given sleep duration (seconds). The
+     * gateway will buffer messages for the client. The radio is
+     * powered down. Returns zero if successful otherwise negative
+     * error code.
+     * @param[in] duration sleep duration in seconds.
+     * @return zero if successful otherwise negative error code.
+     */
+    int asleep(uint16_t duration);
+
+    /**
+     * Wake up from sleep state; power up radio and receive buffered
+     * messages from the gateway. The client returns to sleep state
+     * and the radio is powered down. Returns number of received
+     * messages or negative error code.
+     * @return number of messages or negative error code.
+     */
+    int awake();
+
+    /**
+     * Sleep given number of seconds in low power mode with radio
+     * powered down. Wake up and receive buffered messages. Returns
+     * number of received messages or negative error code.
+     * @param[in] s seconds.
+     * @return number of messages or negative error code.
+     */
+    int sleep(uint16_t s);
+
+    /**
+     * Service the MQTT-SN client. Check for incoming messages; publish
+     * and register. Decode and calls virtual member function
+     * on_publish(). Returns zero if successful otherwise negative
+     * error code.
+     * @param[in] ms timeout period, milli-seconds (Default BLOCK).
+     * @return zero if successful otherwise negative error code.
+     */
+    int service(uint32_t ms = 0L);
+
+    /**
+     * @override MQTTSN::Client
+     * Called by service when received a publish message.
+     * @param[in] topic identity.
+     * @param[in] type topic identity type.
+     * @param[in] buf buffer with topic value.
+     * @param[in] count number of bytes in buffer.
+     */
+    virtual void on_publish(uint16_t topic, TopicType_t type,
+			    void* buf, size_t count)
+    {
+      UNUSED(topic);
+      UNUSED(type);
+      UNUSED(buf);
+      UNUSED(count);
+    }
+
+    /**
+     * @override MQTTSN::Client
+     * Called by service when the gateway registers a topic identity
+     * (wildcard subscriptions).
+     * @param[in] topic identity.
+     * @param[in] name topic name (null terminated).
+     */
+    virtual void on_register(uint16_t topic, char* name)
+    {
+      UNUSED(topic);
+      UNUSED(name);
+    }
+
+  protected:
+    /** Retransmission timeout period (milli-seconds). */
+    static const uint16_t RETRY_TIMEOUT = 500;
+
+    /** Max number of retransmissions. */
+    static const uint8_t RETRY_MAX = 3;
+
+    /** Client states (pp. 25). */
+    enum {
+      DISCONNECTED_STATE,
+      ACTIVE_STATE,
+      ASLEEP_STATE,
+      AWAKE_STATE
+    } __attribute__((packed));
+
+    Wireless::Driver* m_dev;	//!< Wireless device driver.
+    uint8_t m_gateway;		//!< Gateway device address.
+    str_P m_client;		//!< Client identifier.
+    uint16_t m_mid;		//!< Next message identity.
+    uint8_t m_state;		//!< Client state.
+
+    /**
+     * Return next message identity (network order).
+     * @return message identity.
+     */
+    uint16_t next_mid()
+    {
+      uint16_t mid = hton((int16_t) m_mid++);
+      if (m_mid == 0) m_mid = 1;
+      return (mid);
+    }
+
+    /**
+     * Send message with given type and parameters in given io vector
+     * to gateway. Returns number of bytes sent or negative error code.
+     * @param[in] type message type.
+     * @param[in] vec null terminated io vector.
+     * @return number of bytes or negative error code.
+     */
+    int send(uint8_t type, const iovec_t* vec);
+
+    /**
+     * Receive message from gateway into given buffer (MSG_MAX). Wait
+     * at most given time period. Returns message length or negative
+     * error code.
+     * @param[in] msg message buffer.
+     * @param[in] ms timeout period.
+     * @return message length or negative error code.
+     */
+    int recv(uint8_t* msg, uint32_t ms);
+
+    /**
+     * Send request message with given type and parameters and wait
+     * for acknowledgement with given type and message identity at
+     * given offset. Retransmit with duplicate flag on timeout.
+     * Returns length of acknowledgement message in given buffer or
+     * negative error code.
+     * @param[in] type request message type.
+     * @param[in] vec null terminated io vector.
+     * @param[in] ack acknowledgement message type.
+     * @param[in] mid message identity (network order, zero for none).
+     * @param[in] pos position of message identity in acknowledgement.
+     * @param[in] msg buffer for acknowledgement (MSG_MAX).
+     * @return message length or negative error code.
+     */
+    int request(uint8_t type, const iovec_t* vec,
+		uint8_t ack, uint16_t mid, uint8_t pos,
+		uint8_t* msg);
+
+    /**
+     * Handle incoming message in given buffer with given length;
+     * publish, register, ping request or disconnect.
+     * @param[in] msg message buffer.
+     * @param[in] len message length.
+     */
+    void dispatch(uint8_t* msg, size_t len);
+  };
+
+  class Gateway;
+
+protected:
+  /** Message types (pp. 9). */
+  enum {
+    ADVERTISE = 0x00,		//!< Gateway advertise.
+    SEARCHGW = 0x01,		//!< Search gateway.
+    GWINFO = 0x02,		//!< Gateway information.
+    CONNECT = 0x04,		//!< Client request to connect.
+      CONNACK = 0x05,		//!< Connect acknowledgement.
+    REGISTER = 0x0a,		//!< Register topic name.
+      REGACK = 0x0b,		//!< Register acknowledgement.
+    PUBLISH = 0x0c,		//!< Publish message.
+      PUBACK = 0x0d,		//!< Publish acknowledgement.
+    SUBSCRIBE = 0x12,		//!< Subscribe request.
+      SUBACK = 0x13,		//!< Subscribe acknowledgement.
+    UNSUBSCRIBE = 0x14,		//!< Unsubscribe request.
+      UNSUBACK = 0x15,		//!< Unsubscribe acknowledgement.
+    PINGREQ = 0x16,		//!< Ping request.
+      PINGRESP = 0x17,		//!< Ping response.
+    DISCONNECT = 0x18		//!< Disconnect (and sleep).
+  } __attribute__((packed));
+
+  /** Message flags (pp. 11). */
+  enum {
+    DUP = 0x80,			//!< Retransmission.
+    QOS_MASK = 0x60,		//!< Quality of service (bit mask).
+    RETAIN = 0x10,		//!< Server should hold on to the message.
+    WILL = 0x08,		//!< Will topic/message.
+    CLEAN_SESSION = 0x04,	//!< Clean session.
+    TOPIC_TYPE_MASK = 0x03	//!< Topic identity type (bit mask).
+  } __attribute__((packed));
+
+  /** Protocol identity (pp. 11). */
+  static const uint8_t PROTOCOL_ID = 0x01;
+
+  /** Message header; length and type. */
+  struct header_t {
+    uint8_t length;		//!< Message length (including header).
+    uint8_t type;		//!< Message type.
+  };
+};
+
+#endif
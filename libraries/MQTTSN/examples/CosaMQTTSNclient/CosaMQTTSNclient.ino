@@ -0,0 +1,101 @@
+/**
+ * @file CosaMQTTSNclient.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * MQTT-SN client example; connect to gateway (CosaMQTTSNgateway),
+ * register topic, subscribe to short topic and publish with
+ * acknowledged delivery. The radio is powered down between
+ * messages; the gateway buffers messages to the sleeping client.
+ *
+ * @section Circuit
+ * See Wireless drivers for circuit connections.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <MQTTSN.h>
+
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// Configuration; network, device and gateway addresses
+#define NETWORK 0xC05A
+#define DEVICE 0x31
+#define GATEWAY 0x01
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+
+// MQTT-SN client; trace incoming publish messages
+class MQTTSNClient : public MQTTSN::Client {
+public:
+  MQTTSNClient(Wireless::Driver* dev, uint8_t gateway) :
+    MQTTSN::Client(dev, gateway)
+  {}
+  virtual void on_publish(uint16_t topic, MQTTSN::TopicType_t type,
+			  void* buf, size_t count)
+  {
+    trace << PSTR("on_publish::topic = ") << hex << topic
+	  << PSTR(", type = ") << type
+	  << PSTR(", count = ") << count << endl;
+    trace.print(buf, count, IOStream::hex);
+  }
+};
+
+// MQTT-SN client name
+const char CLIENT[] __PROGMEM = "CosaMQTTSNclient";
+MQTTSNClient client(&rf, GATEWAY);
+
+// Registered topic identity
+uint16_t topic;
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaMQTTSNclient: started"));
+  Watchdog::begin();
+  RTC::begin();
+  ASSERT(rf.begin());
+
+  // Connect to gateway, register topic and subscribe to short topic
+  ASSERT(!client.connect((str_P) CLIENT));
+  ASSERT(!client.register_topic(PSTR("public/cosa/sn/counter"), topic));
+  TRACE(client.subscribe(MQTTSN::short_topic('s', 'n'), MQTTSN::SHORT_TOPIC));
+  trace << PSTR("topic = ") << topic << endl;
+}
+
+void loop()
+{
+  // Publish the counter with acknowledged delivery
+  static uint16_t counter = 0;
+  TRACE(client.publish(topic, MQTTSN::NORMAL_TOPIC,
+		       &counter, sizeof(counter),
+		       MQTTSN::ACKNOWLEDGED_DELIVERY));
+  counter += 1;
+
+  // Sleep with radio powered down and receive buffered messages
+  TRACE(client.sleep(5));
+}
@@ -0,0 +1,354 @@
+/**
+ * @file MQTTSNGateway.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "MQTTSNGateway.hh"
+#include "Cosa/RTC.hh"
+
+uint8_t
+MQTTSN::Gateway::lookup(const char* name)
+{
+  for (uint8_t id = 1; id <= m_count; id++)
+    if (strcmp_P(name, topic(id)) == 0) return (id);
+  return (0);
+}
+
+uint8_t
+MQTTSN::Gateway::lookup(uint16_t id, uint8_t type)
+{
+  // Short topic names are two character names in the topic table
+  if (type == MQTTSN::SHORT_TOPIC) {
+    char name[3];
+    memcpy(name, &id, sizeof(id));
+    name[2] = 0;
+    return (lookup(name));
+  }
+
+  // Predefined and registered topic identities are table index plus one
+  id = ntoh((int16_t) id);
+  if ((id == 0) || (id > m_count)) return (0);
+  return (id);
+}
+
+MQTTSN::Gateway::client_t*
+MQTTSN::Gateway::client(uint8_t addr, bool create)
+{
+  client_t* free = NULL;
+  for (uint8_t i = 0; i < CLIENT_MAX; i++) {
+    client_t* cp = &m_client[i];
+    if (cp->state == FREE_STATE) {
+      if (free == NULL) free = cp;
+    }
+    else if (cp->addr == addr) return (cp);
+  }
+  if (!create || free == NULL) return (NULL);
+  memset(free, 0, sizeof(client_t));
+  free->addr = addr;
+  return (free);
+}
+
+int
+MQTTSN::Gateway::send(uint8_t dest, uint8_t type, const iovec_t* vec)
+{
+  // Construct message; header and parameters
+  uint8_t msg[MQTTSN::MSG_MAX];
+  MQTTSN::header_t* header = (MQTTSN::header_t*) msg;
+  size_t len = sizeof(MQTTSN::header_t);
+  for (const iovec_t* vp = vec; vp->buf != NULL; vp++) {
+    if (len + vp->size > MQTTSN::MSG_MAX) return (EMSGSIZE);
+    memcpy(msg + len, vp->buf, vp->size);
+    len += vp->size;
+  }
+  header->length = len;
+  header->type = type;
+  return (m_dev->send(dest, MQTTSN::PORT, msg, len));
+}
+
+int
+MQTTSN::Gateway::forward(uint8_t dest, uint8_t id, const void* buf, size_t count)
+{
+  // Publish to client; flags, topic, message identity and data
+  uint8_t flags = MQTTSN::FIRE_AND_FORGET | MQTTSN::PREDEFINED_TOPIC;
+  uint16_t topic = hton((int16_t) id);
+  uint16_t mid = 0;
+  iovec_t vec[5];
+  iovec_t* vp = vec;
+  iovec_arg(vp, &flags, sizeof(flags));
+  iovec_arg(vp, &topic, sizeof(topic));
+  iovec_arg(vp, &mid, sizeof(mid));
+  iovec_arg(vp, buf, count);
+  iovec_end(vp);
+  return (send(dest, MQTTSN::PUBLISH, vec));
+}
+
+void
+MQTTSN::Gateway::flush(uint8_t addr, bool deliver)
+{
+  for (uint8_t i = 0; i < PENDING_MAX; i++) {
+    pending_t* pp = &m_pending[i];
+    if (pp->addr != addr) continue;
+    if (deliver) forward(addr, pp->topic, pp->data, pp->count);
+    pp->addr = 0;
+  }
+}
+
+void
+MQTTSN::Gateway::release(uint32_t topics)
+{
+  // Remove topics still subscribed by any client
+  for (uint8_t i = 0; i < CLIENT_MAX; i++)
+    if (m_client[i].state != FREE_STATE)
+      topics &= ~m_client[i].subscriptions;
+  topics &= m_subscriptions;
+  if (topics == 0) return;
+
+  // Unsubscribe the remaining topics on the server
+  for (uint8_t id = 1; id <= m_count; id++) {
+    uint32_t mask = (1UL << (id - 1));
+    if ((topics & mask) == 0) continue;
+    MQTT::Client::unsubscribe(topic(id));
+    m_subscriptions &= ~mask;
+  }
+}
+
+void
+MQTTSN::Gateway::dispatch(uint8_t src, uint8_t* msg, size_t len)
+{
+  MQTTSN::header_t* header = (MQTTSN::header_t*) msg;
+  client_t* cp = client(src, header->type == MQTTSN::CONNECT);
+  uint16_t tid;
+  uint8_t id;
+  iovec_t vec[5];
+  iovec_t* vp = vec;
+
+  // Connect is required before any other request
+  if (cp == NULL) {
+    if (header->type == MQTTSN::CONNECT) {
+      uint8_t code = MQTTSN::REJECTED_CONGESTION;
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(src, MQTTSN::CONNACK, vec);
+    }
+    else if (header->type != MQTTSN::DISCONNECT) {
+      iovec_end(vp);
+      send(src, MQTTSN::DISCONNECT, vec);
+    }
+    return;
+  }
+  cp->timestamp = RTC::millis();
+
+  switch (header->type) {
+  case MQTTSN::CONNECT:
+    {
+      // Connect; flags, protocol, duration and client identifier
+      if (len < 6) return;
+      uint8_t code = MQTTSN::ACCEPTED;
+      if (msg[3] != MQTTSN::PROTOCOL_ID) code = MQTTSN::REJECTED_NOT_SUPPORTED;
+      if (msg[2] & MQTTSN::CLEAN_SESSION) {
+	uint32_t topics = cp->subscriptions;
+	cp->subscriptions = 0;
+	release(topics);
+      }
+      memcpy(&tid, msg + 4, sizeof(tid));
+      cp->duration = ntoh((int16_t) tid);
+      cp->state = (code == MQTTSN::ACCEPTED ? ACTIVE_STATE : FREE_STATE);
+      flush(src, code == MQTTSN::ACCEPTED);
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(src, MQTTSN::CONNACK, vec);
+    }
+    break;
+  case MQTTSN::REGISTER:
+    {
+      // Register topic name; topic(0), message identity and topic name
+      if (len < 7) return;
+      char name[MQTTSN::MSG_MAX];
+      memcpy(name, msg + 6, len - 6);
+      name[len - 6] = 0;
+      id = lookup(name);
+      uint8_t code = (id ? MQTTSN::ACCEPTED : MQTTSN::REJECTED_INVALID_TOPIC);
+      tid = hton((int16_t) id);
+      iovec_arg(vp, &tid, sizeof(tid));
+      iovec_arg(vp, msg + 4, sizeof(uint16_t));
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(src, MQTTSN::REGACK, vec);
+    }
+    break;
+  case MQTTSN::PUBLISH:
+    {
+      // Publish; flags, topic, message identity and data. Forward to
+      // server and acknowledge on behalf of the server
+      if (len < 7) return;
+      uint8_t flags = msg[2];
+      memcpy(&tid, msg + 3, sizeof(tid));
+      id = lookup(tid, flags & MQTTSN::TOPIC_TYPE_MASK);
+      uint8_t code = MQTTSN::REJECTED_INVALID_TOPIC;
+      if (id != 0) {
+	int res = MQTT::Client::publish(topic(id), msg + 7, len - 7,
+					MQTT::FIRE_AND_FORGET,
+					(flags & MQTTSN::RETAIN) != 0);
+	code = (res < 0 ? MQTTSN::REJECTED_CONGESTION : MQTTSN::ACCEPTED);
+      }
+      if ((flags & MQTTSN::QOS_MASK) != MQTTSN::ACKNOWLEDGED_DELIVERY) return;
+      iovec_arg(vp, &tid, sizeof(tid));
+      iovec_arg(vp, msg + 5, sizeof(uint16_t));
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(src, MQTTSN::PUBACK, vec);
+    }
+    break;
+  case MQTTSN::SUBSCRIBE:
+  case MQTTSN::UNSUBSCRIBE:
+    {
+      // Subscribe/unsubscribe; flags, message identity and topic name
+      // or topic identity
+      if (len < 7) return;
+      uint8_t flags = msg[2];
+      uint8_t type = flags & MQTTSN::TOPIC_TYPE_MASK;
+      if (type == MQTTSN::NORMAL_TOPIC) {
+	char name[MQTTSN::MSG_MAX];
+	memcpy(name, msg + 5, len - 5);
+	name[len - 5] = 0;
+	id = lookup(name);
+      }
+      else {
+	memcpy(&tid, msg + 5, sizeof(tid));
+	id = lookup(tid, type);
+      }
+      uint32_t mask = (id ? (1UL << (id - 1)) : 0);
+
+      // Unsubscribe; update client and server subscriptions
+      if (header->type == MQTTSN::UNSUBSCRIBE) {
+	cp->subscriptions &= ~mask;
+	release(mask);
+	iovec_arg(vp, msg + 3, sizeof(uint16_t));
+	iovec_end(vp);
+	send(src, MQTTSN::UNSUBACK, vec);
+	return;
+      }
+
+      // Subscribe on server if first client subscription
+      uint8_t code = MQTTSN::REJECTED_INVALID_TOPIC;
+      if (id != 0) {
+	code = MQTTSN::ACCEPTED;
+	if ((m_subscriptions & mask) == 0) {
+	  if (MQTT::Client::subscribe(topic(id)) == 0)
+	    m_subscriptions |= mask;
+	  else
+	    code = MQTTSN::REJECTED_CONGESTION;
+	}
+	if (code == MQTTSN::ACCEPTED) cp->subscriptions |= mask;
+      }
+      flags &= MQTTSN::QOS_MASK;
+      tid = hton((int16_t) id);
+      iovec_arg(vp, &flags, sizeof(flags));
+      iovec_arg(vp, &tid, sizeof(tid));
+      iovec_arg(vp, msg + 3, sizeof(uint16_t));
+      iovec_arg(vp, &code, sizeof(code));
+      iovec_end(vp);
+      send(src, MQTTSN::SUBACK, vec);
+    }
+    break;
+  case MQTTSN::PINGREQ:
+    // Ping request; deliver buffered messages to awake client
+    flush(src);
+    iovec_end(vp);
+    send(src, MQTTSN::PINGRESP, vec);
+    break;
+  case MQTTSN::DISCONNECT:
+    // Disconnect with sleep duration or release client
+    if (len >= 4) {
+      memcpy(&tid, msg + 2, sizeof(tid));
+      cp->duration = ntoh((int16_t) tid);
+      cp->state = ASLEEP_STATE;
+    }
+    else {
+      uint32_t topics = cp->subscriptions;
+      cp->state = FREE_STATE;
+      flush(src, false);
+      release(topics);
+    }
+    iovec_end(vp);
+    send(src, MQTTSN::DISCONNECT, vec);
+    break;
+  default:
+    break;
+  }
+}
+
+void
+MQTTSN::Gateway::on_publish(char* name, void* buf, size_t count)
+{
+  uint8_t id = lookup(name);
+  if (id == 0) return;
+  uint32_t mask = (1UL << (id - 1));
+  if (count > PENDING_DATA_MAX) count = PENDING_DATA_MAX;
+
+  // Forward to active subscribers and buffer for sleeping subscribers
+  for (uint8_t i = 0; i < CLIENT_MAX; i++) {
+    client_t* cp = &m_client[i];
+    if ((cp->state == FREE_STATE) || ((cp->subscriptions & mask) == 0))
+      continue;
+    if (cp->state == ACTIVE_STATE) {
+      forward(cp->addr, id, buf, count);
+      continue;
+    }
+    for (uint8_t j = 0; j < PENDING_MAX; j++) {
+      pending_t* pp = &m_pending[j];
+      if (pp->addr != 0) continue;
+      pp->addr = cp->addr;
+      pp->topic = id;
+      pp->count = count;
+      memcpy(pp->data, buf, count);
+      break;
+    }
+  }
+}
+
+int
+MQTTSN::Gateway::run(uint32_t ms)
+{
+  // Receive and handle message from wireless client
+  uint8_t msg[MQTTSN::MSG_MAX];
+  uint8_t src;
+  uint8_t port;
+  int res = m_dev->recv(src, port, msg, sizeof(msg), ms);
+  if ((res >= (int) sizeof(MQTTSN::header_t))
+      && (port == MQTTSN::PORT)
+      && (msg[0] == res))
+    dispatch(src, msg, res);
+
+  // Service the server connection; publish messages to forward. The
+  // read timeout(-2) is returned when there is no message
+  res = MQTT::Client::service(1L);
+  if ((res == -2) || (res == ETIME)) res = 0;
+
+  // Remove clients not heard from within 1.5 keep alive periods
+  for (uint8_t i = 0; i < CLIENT_MAX; i++) {
+    client_t* cp = &m_client[i];
+    if ((cp->state == FREE_STATE) || (cp->duration == 0)) continue;
+    if (RTC::since(cp->timestamp) < cp->duration * 1500UL) continue;
+    uint32_t topics = cp->subscriptions;
+    cp->state = FREE_STATE;
+    flush(cp->addr, false);
+    release(topics);
+  }
+  return (res < 0 ? res : 0);
+}
@@ -0,0 +1,224 @@
+/**
+ * @file MQTTSNGateway.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_MQTTSNGATEWAY_HH
+#define COSA_MQTTSNGATEWAY_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+#include <MQTT.h>
+#include <MQTTSN.h>
+
+#ifndef COSA_MQTTSN_CLIENT_MAX
+#define COSA_MQTTSN_CLIENT_MAX 8
+#endif
+
+#ifndef COSA_MQTTSN_PENDING_MAX
+#define COSA_MQTTSN_PENDING_MAX 4
+#endif
+
+/**
+ * MQTT-SN transparent gateway; bridge between MQTT-SN clients on a
+ * wireless network and an MQTT server. The gateway is an MQTT client
+ * and forwards publish messages from the wireless clients to the
+ * server, and publish messages from the server to the subscribing
+ * wireless clients. Topic names are given as a table in program
+ * memory; the topic identity is the table index plus one. Clients
+ * may use predefined topic identities, register topic names or use
+ * short topic names (two character topic names in the table).
+ *
+ * Publish messages for sleeping clients are buffered (max
+ * COSA_MQTTSN_PENDING_MAX) and delivered when the client sends a
+ * ping request. Clients that have not been heard from within one
+ * and a half keep alive period are removed.
+ *
+ * @section Limitations
+ * Messages are forwarded to the server with QoS level 0; radio
+ * clients are acknowledged by the gateway. No wildcard topic
+ * subscriptions, and max 32 topics.
+ */
+class MQTTSN::Gateway : public MQTT::Client {
+public:
+  /** Max number of connected wireless clients. */
+  static const uint8_t CLIENT_MAX = COSA_MQTTSN_CLIENT_MAX;
+
+  /** Max number of buffered messages for sleeping clients. */
+  static const uint8_t PENDING_MAX = COSA_MQTTSN_PENDING_MAX;
+
+  /** Max number of topics in table. */
+  static const uint8_t TOPICS_MAX = 32;
+
+  /**
+   * Construct MQTT-SN gateway with given wireless device driver and
+   * topic name table (program memory).
+   * @param[in] dev wireless device driver.
+   * @param[in] topics topic name table (program memory).
+   * @param[in] count number of topics in table (max TOPICS_MAX).
+   */
+  Gateway(Wireless::Driver* dev, const char* const* topics, uint8_t count) :
+    MQTT::Client(),
+    m_dev(dev),
+    m_topics(topics),
+    m_count(count < TOPICS_MAX ? count : TOPICS_MAX),
+    m_subscriptions(0)
+  {
+    memset(m_client, 0, sizeof(m_client));
+    memset(m_pending, 0, sizeof(m_pending));
+  }
+
+  /**
+   * Run the gateway; receive and handle messages from wireless
+   * clients, service the MQTT client and remove expired
+   * clients. Wait at most given time period for a wireless
+   * message. Returns zero if successful otherwise negative error
+   * code.
+   * @param[in] ms timeout period, milli-seconds (Default 100 ms).
+   * @return zero if successful otherwise negative error code.
+   */
+  int run(uint32_t ms = 100L);
+
+  /**
+   * @override MQTT::Client
+   * Called by service when received a publish message from the
+   * server. Forward to subscribing wireless clients.
+   * @param[in] topic string.
+   * @param[in] buf buffer with topic value.
+   * @param[in] count number of bytes in buffer.
+   */
+  virtual void on_publish(char* topic, void* buf, size_t count);
+
+protected:
+  /** Wireless client state. */
+  enum {
+    FREE_STATE,
+    ACTIVE_STATE,
+    ASLEEP_STATE
+  } __attribute__((packed));
+
+  /** Wireless client; address, state, keep alive and subscriptions. */
+  struct client_t {
+    uint8_t addr;		//!< Device address.
+    uint8_t state;		//!< Client state.
+    uint16_t duration;		//!< Keep alive/sleep duration (seconds).
+    uint32_t timestamp;		//!< Last message received (milli-seconds).
+    uint32_t subscriptions;	//!< Topic subscription bit-set.
+  };
+
+  /** Payload size of buffered publish message. */
+  static const size_t PENDING_DATA_MAX = MQTTSN::MSG_MAX - 7;
+
+  /** Buffered publish message for sleeping client. */
+  struct pending_t {
+    uint8_t addr;		//!< Device address, zero if free.
+    uint8_t topic;		//!< Topic identity.
+    uint8_t count;		//!< Payload size.
+    uint8_t data[PENDING_DATA_MAX]; //!< Payload.
+  };
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  const char* const* m_topics;	//!< Topic name table (program memory).
+  uint8_t m_count;		//!< Number of topics.
+  uint32_t m_subscriptions;	//!< Server subscription bit-set.
+  client_t m_client[CLIENT_MAX]; //!< Wireless clients.
+  pending_t m_pending[PENDING_MAX]; //!< Buffered messages.
+
+  /**
+   * Return topic name for given topic identity (program memory).
+   * @param[in] id topic identity (1..count).
+   * @return topic name.
+   */
+  str_P topic(uint8_t id)
+  {
+    return ((str_P) pgm_read_word(&m_topics[id - 1]));
+  }
+
+  /**
+   * Lookup topic identity for given topic name. Returns topic
+   * identity or zero if not found.
+   * @param[in] name topic name.
+   * @return topic identity or zero.
+   */
+  uint8_t lookup(const char* name);
+
+  /**
+   * Map given topic identity of given type to topic table identity.
+   * Returns topic identity or zero if not found.
+   * @param[in] id topic identity (network order).
+   * @param[in] type topic identity type.
+   * @return topic identity or zero.
+   */
+  uint8_t lookup(uint16_t id, uint8_t type);
+
+  /**
+   * Lookup client with given device address. Allocate client entry
+   * if the given flag is set. Returns pointer to client or NULL.
+   * @param[in] addr device address.
+   * @param[in] create allocate if not found.
+   * @return client pointer or NULL.
+   */
+  client_t* client(uint8_t addr, bool create);
+
+  /**
+   * Send message with given type and parameters in given io vector
+   * to given client. Returns number of bytes sent or negative error
+   * code.
+   * @param[in] dest client device address.
+   * @param[in] type message type.
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes or negative error code.
+   */
+  int send(uint8_t dest, uint8_t type, const iovec_t* vec);
+
+  /**
+   * Send publish message with given topic and payload to given
+   * client. Returns number of bytes sent or negative error code.
+   * @param[in] dest client device address.
+   * @param[in] id topic identity.
+   * @param[in] buf payload.
+   * @param[in] count number of bytes in payload.
+   * @return number of bytes or negative error code.
+   */
+  int forward(uint8_t dest, uint8_t id, const void* buf, size_t count);
+
+  /**
+   * Send buffered messages to given client and release the buffers.
+   * @param[in] addr client device address.
+   * @param[in] deliver flag; false to drop the messages.
+   */
+  void flush(uint8_t addr, bool deliver = true);
+
+  /**
+   * Unsubscribe server topics in given topic bit-set that are no
+   * longer subscribed by any client.
+   * @param[in] topics topic bit-set.
+   */
+  void release(uint32_t topics);
+
+  /**
+   * Handle message in given buffer with given length from given
+   * client device address.
+   * @param[in] src client device address.
+   * @param[in] msg message buffer.
+   * @param[in] len message length.
+   */
+  void dispatch(uint8_t src, uint8_t* msg, size_t len);
+};
+
+#endif
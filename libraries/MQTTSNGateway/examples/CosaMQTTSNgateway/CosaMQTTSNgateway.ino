@@ -0,0 +1,98 @@
+/**
+ * @file CosaMQTTSNgateway.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * MQTT-SN gateway example; bridge between MQTT-SN wireless clients
+ * (CosaMQTTSNclient) and an MQTT server. The topic table defines the
+ * topic identities; index plus one.
+ *
+ * @section Circuit
+ * This sketch is designed for the Ethernet Shield and a wireless
+ * module. See Wireless drivers for circuit connections. The W5100
+ * and the wireless module must use different chip select pins.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <DHCP.h>
+#include <DNS.h>
+#include <W5100.h>
+#include <MQTT.h>
+#include <MQTTSN.h>
+#include <MQTTSNGateway.h>
+
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// Network configuration
+#define SERVER "test.mosquitto.org"
+
+// Configuration; wireless network and gateway address
+#define NETWORK 0xC05A
+#define DEVICE 0x01
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE, Board::D9, Board::D8, Board::EXT1);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+
+// Topic table; predefined topic identities 1..3
+const char TOPIC1[] __PROGMEM = "public/cosa/sn/counter";
+const char TOPIC2[] __PROGMEM = "public/cosa/sn/status";
+const char TOPIC3[] __PROGMEM = "sn";
+const char* const TOPICS[] __PROGMEM = {
+  TOPIC1,
+  TOPIC2,
+  TOPIC3
+};
+
+// MQTT-SN gateway name and MQTT client
+const char CLIENT[] __PROGMEM = "CosaMQTTSNgateway";
+MQTTSN::Gateway gateway(&rf, TOPICS, membersof(TOPICS));
+
+// W5100 Ethernet Controller with MAC-address
+const uint8_t mac[6] __PROGMEM = { 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed };
+W5100 ethernet(mac);
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaMQTTSNgateway: started"));
+  Watchdog::begin();
+  RTC::begin();
+  ASSERT(rf.begin());
+
+  // Start ethernet controller and request network address for hostname
+  ASSERT(ethernet.begin_P(CLIENT));
+
+  // Start MQTT client with socket and connect to server
+  ASSERT(gateway.begin(ethernet.socket(Socket::TCP)));
+  ASSERT(!gateway.connect(SERVER, CLIENT));
+}
+
+void loop()
+{
+  int res = gateway.run();
+  if (res < 0) trace << PSTR("run:res = ") << res << endl;
+}
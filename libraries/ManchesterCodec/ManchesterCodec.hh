@@ -29,12 +29,18 @@
  */
 class ManchesterCodec : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 8;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0x5d55;
+
   /**
    * Construct Manchester Phase codec with given bits per symbol,
    * start symbol, and preamble size.
    */
   ManchesterCodec() :
-    VWI::Codec(8, 0x5d55, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
@@ -65,7 +71,15 @@ public:
    * @param[in] symbol to decode.
    * @return 4-bit data.
    */
-  virtual uint8_t decode4(uint8_t symbol);
+  virtual uint8_t decode4(uint8_t symbol)
+  {
+    uint8_t res = 0;
+    if (symbol & 1) res |= 1;
+    if (symbol & 4) res |= 2;
+    if (symbol & 16) res |= 4;
+    if (symbol & 64) res |= 8;
+    return (res);
+  }
 
 private:
   /** Symbol mapping table: 4 to 8 bits */
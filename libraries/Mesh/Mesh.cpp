@@ -0,0 +1,413 @@
+/**
+ * @file Mesh.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Mesh.hh"
+#include "Cosa/RTC.hh"
+
+Mesh::Mesh(Wireless::Driver* dev, size_t payload_max) :
+  Wireless::Driver(dev->get_network_address(), dev->get_device_address()),
+  m_dev(dev),
+  m_payload_max(payload_max < PAYLOAD_MAX ? payload_max : PAYLOAD_MAX),
+  m_seq(0),
+  m_beacon_ix(0),
+  m_beacon(0L),
+  m_seen_ix(0),
+  m_forwarded(0),
+  m_drops(0),
+  m_duplicates(0)
+{
+  // Routes should be refreshed within a full rotation of the route
+  // table in beacons, and two beacon periods
+  uint8_t per_beacon = (m_payload_max - 1) / sizeof(entry_t);
+  uint8_t beacons = (ROUTE_MAX + per_beacon - 1) / per_beacon;
+  m_route_timeout = ((beacons + 2) * (uint32_t) BEACON_PERIOD) / 256;
+  memset(m_neighbor, 0, sizeof(m_neighbor));
+  memset(m_route, 0, sizeof(m_route));
+  memset(m_seen, 0, sizeof(m_seen));
+}
+
+uint8_t
+Mesh::get_next_hop(uint8_t dest)
+{
+  route_t* route = lookup(dest);
+  if ((route == NULL)
+      || (route->metric >= METRIC_MAX)
+      || ((uint16_t) (ticks() - route->stamp) > m_route_timeout))
+    return (BROADCAST);
+  return (route->next);
+}
+
+uint8_t
+Mesh::get_metric(uint8_t dest)
+{
+  if (get_next_hop(dest) == BROADCAST) return (METRIC_MAX);
+  return (lookup(dest)->metric);
+}
+
+bool
+Mesh::begin(const void* config)
+{
+  if (!m_dev->begin(config)) return (false);
+  m_beacon = RTC::millis();
+  run();
+  return (true);
+}
+
+int
+Mesh::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  // Build message with header and payload from io vector
+  if (UNLIKELY(vec == NULL)) return (EINVAL);
+  size_t len = iovec_size(vec);
+  if (UNLIKELY(len > m_payload_max - sizeof(header_t))) return (EMSGSIZE);
+  uint8_t frame[PAYLOAD_MAX];
+  header_t* header = (header_t*) frame;
+  header->dest = dest;
+  header->src = m_addr.device;
+  header->port = port;
+  header->seq = ++m_seq;
+  header->ttl = TTL_MAX;
+  uint8_t* dp = frame + sizeof(header_t);
+  for (const iovec_t* vp = vec; vp->buf != NULL; vp++) {
+    memcpy(dp, vp->buf, vp->size);
+    dp += vp->size;
+  }
+
+  // Suppress the flooded message when it returns
+  is_duplicate(header->src, header->seq);
+  int res = forward(frame, len + sizeof(header_t));
+  return (res < 0 ? res : (int) len);
+}
+
+int
+Mesh::send(uint8_t dest, uint8_t port, const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (send(dest, port, vec));
+}
+
+int
+Mesh::recv(uint8_t& src, uint8_t& port, void* buf, size_t len, uint32_t ms)
+{
+  uint8_t frame[PAYLOAD_MAX];
+  uint32_t start = RTC::millis();
+  while (1) {
+    // Send beacon if needed and wait at most until the next beacon
+    run();
+    uint32_t now = RTC::millis();
+    uint32_t timeout = m_beacon - now;
+    if (ms != 0) {
+      uint32_t elapsed = now - start;
+      if (elapsed >= ms) return (ETIME);
+      if (ms - elapsed < timeout) timeout = ms - elapsed;
+    }
+    if (timeout == 0) timeout = 1;
+
+    // Receive next frame. Pass through messages on other ports
+    int res = m_dev->recv(src, port, frame, sizeof(frame), timeout);
+    if (res == ETIME) continue;
+    if (res < 0) return (res);
+    if (port == BEACON_PORT) {
+      on_beacon(src, frame, res);
+      continue;
+    }
+    if (port != DATA_PORT) {
+      if ((size_t) res > len) return (EMSGSIZE);
+      m_dest = m_dev->is_broadcast() ? BROADCAST : m_addr.device;
+      memcpy(buf, frame, res);
+      return (res);
+    }
+
+    // Routed message; refresh neighbor and check for duplicate
+    if ((size_t) res < sizeof(header_t)) continue;
+    header_t* header = (header_t*) frame;
+    neighbor_t* nb = neighbor(src, false);
+    if (nb != NULL) nb->stamp = ticks();
+    if (is_duplicate(header->src, header->seq)) {
+      m_duplicates += 1;
+      continue;
+    }
+
+    // Forward messages to other devices and flood broadcasts
+    bool local = (header->dest == m_addr.device);
+    bool flood = (header->dest == BROADCAST);
+    if (!local) {
+      if (header->ttl > 1) {
+	header->ttl -= 1;
+	if (forward(frame, res) < 0)
+	  m_drops += 1;
+	else
+	  m_forwarded += 1;
+      }
+      else if (!flood) m_drops += 1;
+      if (!flood) continue;
+    }
+
+    // Deliver the message
+    size_t count = res - sizeof(header_t);
+    if (count > len) return (EMSGSIZE);
+    src = header->src;
+    port = header->port;
+    m_dest = header->dest;
+    memcpy(buf, frame + sizeof(header_t), count);
+    return (count);
+  }
+}
+
+uint16_t
+Mesh::ticks()
+{
+  return (RTC::millis() >> 8);
+}
+
+Mesh::neighbor_t*
+Mesh::neighbor(uint8_t addr, bool create)
+{
+  neighbor_t* entry = NULL;
+  for (uint8_t i = 0; i < NEIGHBOR_MAX; i++) {
+    neighbor_t* nb = &m_neighbor[i];
+    if (nb->addr == addr) return (nb);
+    if (!create) continue;
+    // Select free entry or the neighbor with the worst link
+    if ((entry == NULL) || (nb->addr == 0)
+	|| ((entry->addr != 0) && (cost(nb) > cost(entry))))
+      entry = nb;
+  }
+  if (entry == NULL) return (NULL);
+  entry->addr = addr;
+  entry->quality = 255;
+  entry->rssi = 0;
+  entry->lqi = 0;
+  entry->stamp = ticks();
+  return (entry);
+}
+
+uint8_t
+Mesh::cost(const neighbor_t* nb)
+{
+  // Link cost from delivery ratio (1..8) and input power level. The
+  // input power level is zero if not supported by the device
+  uint8_t res = 1 + ((255 - nb->quality) >> 5);
+  if (nb->rssi < -85) res += 2;
+  else if (nb->rssi < -75) res += 1;
+  return (res);
+}
+
+Mesh::route_t*
+Mesh::lookup(uint8_t dest)
+{
+  for (uint8_t i = 0; i < ROUTE_MAX; i++)
+    if (m_route[i].dest == dest) return (&m_route[i]);
+  return (NULL);
+}
+
+void
+Mesh::update(uint8_t dest, uint8_t next, uint8_t metric)
+{
+  if ((dest == BROADCAST) || (dest == m_addr.device)) return;
+  if (metric > METRIC_MAX) metric = METRIC_MAX;
+  uint16_t now = ticks();
+
+  // Update existing route from the next hop, or replace with better
+  route_t* route = lookup(dest);
+  if (route != NULL) {
+    bool expired = (uint16_t) (now - route->stamp) > m_route_timeout;
+    if (route->next == next) {
+      route->metric = metric;
+      if (metric < METRIC_MAX) route->stamp = now;
+    }
+    else if ((metric < route->metric) || (expired && metric < METRIC_MAX)) {
+      route->next = next;
+      route->metric = metric;
+      route->stamp = now;
+    }
+    return;
+  }
+  if (metric >= METRIC_MAX) return;
+
+  // Allocate free entry or replace a worse route
+  for (uint8_t i = 0; i < ROUTE_MAX; i++) {
+    route_t* entry = &m_route[i];
+    if (entry->dest == 0) {
+      route = entry;
+      break;
+    }
+    if (entry->metric > metric
+	&& (route == NULL || entry->metric > route->metric))
+      route = entry;
+  }
+  if (route == NULL) return;
+  route->dest = dest;
+  route->next = next;
+  route->metric = metric;
+  route->stamp = now;
+}
+
+void
+Mesh::expire()
+{
+  uint16_t now = ticks();
+
+  // Remove neighbors not heard from and poison routes through them
+  for (uint8_t i = 0; i < NEIGHBOR_MAX; i++) {
+    neighbor_t* nb = &m_neighbor[i];
+    if (nb->addr == 0) continue;
+    if ((uint16_t) (now - nb->stamp) <= NEIGHBOR_TIMEOUT) continue;
+    for (uint8_t j = 0; j < ROUTE_MAX; j++) {
+      route_t* route = &m_route[j];
+      if ((route->dest != 0) && (route->next == nb->addr))
+	route->metric = METRIC_MAX;
+    }
+    nb->addr = 0;
+  }
+
+  // Remove routes that have been unreachable or not refreshed
+  for (uint8_t i = 0; i < ROUTE_MAX; i++) {
+    route_t* route = &m_route[i];
+    if (route->dest == 0) continue;
+    if ((uint16_t) (now - route->stamp) <= m_route_timeout) continue;
+    if (route->metric < METRIC_MAX) {
+      route->metric = METRIC_MAX;
+      route->stamp = now;
+    }
+    else route->dest = 0;
+  }
+}
+
+void
+Mesh::beacon()
+{
+  // Beacon sequence number followed by route entries. Rotate through
+  // the route table when it does not fit
+  uint8_t frame[PAYLOAD_MAX];
+  entry_t* entry = (entry_t*) (frame + 1);
+  uint8_t max = (m_payload_max - 1) / sizeof(entry_t);
+  uint8_t count = 0;
+  frame[0] = m_seq;
+  for (uint8_t n = 0; (n < ROUTE_MAX) && (count < max); n++) {
+    route_t* route = &m_route[m_beacon_ix];
+    if (++m_beacon_ix == ROUTE_MAX) m_beacon_ix = 0;
+    if (route->dest == 0) continue;
+    entry->dest = route->dest;
+    entry->next = route->next;
+    entry->metric = route->metric;
+    entry++;
+    count++;
+  }
+  m_dev->broadcast(BEACON_PORT, frame, 1 + count * sizeof(entry_t));
+}
+
+void
+Mesh::run()
+{
+  if ((int32_t) (RTC::millis() - m_beacon) < 0) return;
+  m_beacon = RTC::millis() + BEACON_PERIOD - (RTC::micros() & JITTER_MASK);
+  expire();
+  beacon();
+}
+
+void
+Mesh::on_beacon(uint8_t src, const uint8_t* buf, size_t len)
+{
+  // Update neighbor link state and route to the neighbor
+  if (len < 1) return;
+  neighbor_t* nb = neighbor(src, true);
+  if (nb == NULL) return;
+  int rssi = m_dev->get_input_power_level();
+  nb->rssi = rssi < -128 ? -128 : (rssi > 127 ? 127 : rssi);
+  nb->lqi = m_dev->get_link_quality_indicator();
+  nb->stamp = ticks();
+  uint8_t link = cost(nb);
+  update(src, src, link);
+
+  // Update routes through the neighbor. Poison routes that the
+  // neighbor has through this device
+  const entry_t* entry = (const entry_t*) (buf + 1);
+  uint8_t count = (len - 1) / sizeof(entry_t);
+  for (uint8_t i = 0; i < count; i++, entry++) {
+    if (entry->next == m_addr.device)
+      update(entry->dest, src, METRIC_MAX);
+    else
+      update(entry->dest, src, entry->metric + link);
+  }
+}
+
+bool
+Mesh::is_duplicate(uint8_t src, uint8_t seq)
+{
+  for (uint8_t i = 0; i < DUPLICATE_MAX; i++)
+    if ((m_seen[i].src == src) && (m_seen[i].seq == seq)) return (true);
+  m_seen[m_seen_ix].src = src;
+  m_seen[m_seen_ix].seq = seq;
+  if (++m_seen_ix == DUPLICATE_MAX) m_seen_ix = 0;
+  return (false);
+}
+
+int
+Mesh::forward(uint8_t* frame, size_t len)
+{
+  // Flood broadcast. Send to next hop or directly if no route
+  header_t* header = (header_t*) frame;
+  if (header->dest == BROADCAST)
+    return (m_dev->broadcast(DATA_PORT, frame, len));
+  uint8_t next = get_next_hop(header->dest);
+  if (next == BROADCAST) next = header->dest;
+  int res = m_dev->send(next, DATA_PORT, frame, len);
+
+  // Update delivery ratio of the link (exponential moving average)
+  neighbor_t* nb = neighbor(next, false);
+  if (nb != NULL) {
+    if (res < 0)
+      nb->quality -= nb->quality >> 2;
+    else
+      nb->quality += (255 - nb->quality) >> 3;
+    update(next, next, cost(nb));
+  }
+  return (res);
+}
+
+IOStream& operator<<(IOStream& outs, Mesh& mesh)
+{
+  uint16_t now = Mesh::ticks();
+  for (uint8_t i = 0; i < Mesh::NEIGHBOR_MAX; i++) {
+    Mesh::neighbor_t* nb = &mesh.m_neighbor[i];
+    if (nb->addr == 0) continue;
+    outs << PSTR("neighbor=") << hex << nb->addr
+	 << PSTR(",quality=") << nb->quality
+	 << PSTR(",rssi=") << nb->rssi
+	 << PSTR(",lqi=") << nb->lqi
+	 << PSTR(",cost=") << Mesh::cost(nb)
+	 << PSTR(",age=") << (uint16_t) (now - nb->stamp)
+	 << endl;
+  }
+  for (uint8_t i = 0; i < Mesh::ROUTE_MAX; i++) {
+    Mesh::route_t* route = &mesh.m_route[i];
+    if (route->dest == 0) continue;
+    outs << PSTR("route=") << hex << route->dest
+	 << PSTR(",next=") << hex << route->next
+	 << PSTR(",metric=") << route->metric
+	 << PSTR(",age=") << (uint16_t) (now - route->stamp)
+	 << endl;
+  }
+  return (outs);
+}
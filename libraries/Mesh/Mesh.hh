@@ -0,0 +1,422 @@
+/**
+ * @file Mesh.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_MESH_HH
+#define COSA_MESH_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/IOStream.hh"
+#include "Cosa/Wireless.hh"
+
+#ifndef COSA_MESH_ROUTE_MAX
+#define COSA_MESH_ROUTE_MAX 16
+#endif
+
+#ifndef COSA_MESH_NEIGHBOR_MAX
+#define COSA_MESH_NEIGHBOR_MAX 8
+#endif
+
+#ifndef COSA_MESH_DUPLICATE_MAX
+#define COSA_MESH_DUPLICATE_MAX 8
+#endif
+
+/**
+ * Multi-hop mesh routing over a Wireless device driver. The Mesh is
+ * itself a Wireless device driver; messages are addressed to the
+ * final destination device and forwarded hop by hop. Nodes
+ * periodically broadcast beacons with their route table (distance
+ * vector). The route metric is the sum of the link costs. The link
+ * cost is calculated from the input power level of received frames
+ * and the delivery ratio of unicast frames (failed sends due to
+ * missing link layer acknowledgement). Routes learned from a
+ * neighbor that routes back through this node are poisoned (split
+ * horizon with poisoned reverse). Flooded broadcasts and link layer
+ * retransmissions are suppressed with a cache of recent message
+ * source and sequence numbers.
+ *
+ * Beacons, forwarding and route maintenance are handled by recv(),
+ * which should be called regularly on all nodes, also on nodes that
+ * only send.
+ *
+ * @section Limitations
+ * The route table size (COSA_MESH_ROUTE_MAX) limits the number of
+ * reachable destinations; beacons rotate through the table when it
+ * does not fit a single frame. Both ends must use the same payload
+ * size.
+ */
+class Mesh : public Wireless::Driver {
+public:
+  /** Max number of routes. */
+  static const uint8_t ROUTE_MAX = COSA_MESH_ROUTE_MAX;
+
+  /** Max number of neighbors. */
+  static const uint8_t NEIGHBOR_MAX = COSA_MESH_NEIGHBOR_MAX;
+
+  /** Max number of messages in duplicate cache. */
+  static const uint8_t DUPLICATE_MAX = COSA_MESH_DUPLICATE_MAX;
+
+  /** Max size of device payload (frame buffer size). */
+  static const size_t PAYLOAD_MAX = 64;
+
+  /** System port for beacons. */
+  static const uint8_t BEACON_PORT = 0xf2;
+
+  /** System port for routed messages. */
+  static const uint8_t DATA_PORT = 0xf3;
+
+  /** Route metric for unreachable destination. */
+  static const uint8_t METRIC_MAX = 32;
+
+  /** Max number of hops. */
+  static const uint8_t TTL_MAX = 8;
+
+  /** Beacon period (milli-seconds). */
+  static const uint16_t BEACON_PERIOD = 4000;
+
+  /**
+   * Construct mesh router for given wireless device driver with
+   * given device payload size. The network and device address is
+   * taken from the device driver.
+   * @param[in] dev wireless device driver.
+   * @param[in] payload_max device payload size (max PAYLOAD_MAX).
+   */
+  Mesh(Wireless::Driver* dev, size_t payload_max);
+
+  /**
+   * Return next hop device address for given destination or
+   * BROADCAST(0) if there is no route.
+   * @param[in] dest destination device address.
+   * @return device address.
+   */
+  uint8_t get_next_hop(uint8_t dest);
+
+  /**
+   * Return route metric for given destination; METRIC_MAX if there
+   * is no route.
+   * @param[in] dest destination device address.
+   * @return metric.
+   */
+  uint8_t get_metric(uint8_t dest);
+
+  /**
+   * Return number of forwarded messages.
+   * @return count.
+   */
+  uint16_t get_forwarded() const
+  {
+    return (m_forwarded);
+  }
+
+  /**
+   * Return number of dropped messages; failed to forward or max
+   * number of hops.
+   * @return count.
+   */
+  uint16_t get_drops() const
+  {
+    return (m_drops);
+  }
+
+  /**
+   * Return number of suppressed duplicate messages.
+   * @return count.
+   */
+  uint16_t get_duplicates() const
+  {
+    return (m_duplicates);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Start the device driver and send the first beacon. Return
+   * true(1) if successful otherwise false(0).
+   * @param[in] config configuration vector (default NULL)
+   * @return bool.
+   */
+  virtual bool begin(const void* config = NULL);
+
+  /**
+   * @override Wireless::Driver
+   * Shutdown the device driver. Return true(1) if successful
+   * otherwise false(0).
+   * @return bool.
+   */
+  virtual bool end()
+  {
+    return (m_dev->end());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power up mode.
+   */
+  virtual void powerup()
+  {
+    m_dev->powerup();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power down mode.
+   */
+  virtual void powerdown()
+  {
+    m_dev->powerdown();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if a message is available otherwise false(0).
+   * @return bool.
+   */
+  virtual bool available()
+  {
+    return (m_dev->available());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given null terminated io vector to given
+   * destination device. The message is sent to the next hop on the
+   * route to the destination, or directly if there is no route.
+   * Broadcast messages are flooded. Returns number of bytes sent or
+   * negative error code.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given buffer, with given number of bytes. See
+   * send() with io vector above.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * @override Wireless::Driver
+   * Receive message and store into given buffer with given maximum
+   * length. Beacons are handled, messages to other devices are
+   * forwarded and beacons are sent while waiting. The source (origin)
+   * network address is returned in the parameter src. Returns the
+   * number of received bytes or negative error code.
+   * @param[out] src source network address.
+   * @param[out] port device port (or message type).
+   * @param[in] buf buffer to store incoming message.
+   * @param[in] len maximum number of bytes to receive.
+   * @param[in] ms maximum time out period (Default blocking(0L)).
+   * @return number of bytes received or negative error code.
+   */
+  virtual int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		   uint32_t ms = 0L);
+
+  /**
+   * @override Wireless::Driver
+   * Set output power level in dBm.
+   * @param[in] dBm.
+   */
+  virtual void set_output_power_level(int8_t dBm)
+  {
+    m_dev->set_output_power_level(dBm);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return estimated input power level (dBm) of latest frame.
+   */
+  virtual int get_input_power_level()
+  {
+    return (m_dev->get_input_power_level());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return link quality indicator of latest frame.
+   */
+  virtual int get_link_quality_indicator()
+  {
+    return (m_dev->get_link_quality_indicator());
+  }
+
+  friend IOStream& operator<<(IOStream& outs, Mesh& mesh);
+
+protected:
+  /** Routed message header. */
+  struct header_t {
+    uint8_t dest;		//!< Destination device address.
+    uint8_t src;		//!< Source device address.
+    uint8_t port;		//!< Message port.
+    uint8_t seq;		//!< Source sequence number.
+    uint8_t ttl;		//!< Remaining number of hops.
+  };
+
+  /** Beacon route entry. */
+  struct entry_t {
+    uint8_t dest;		//!< Destination device address.
+    uint8_t next;		//!< Next hop device address.
+    uint8_t metric;		//!< Route metric.
+  };
+
+  /** Neighbor; link quality and last heard. */
+  struct neighbor_t {
+    uint8_t addr;		//!< Device address, zero if free.
+    uint8_t quality;		//!< Delivery ratio (0..255).
+    int8_t rssi;		//!< Input power level (dBm).
+    int8_t lqi;			//!< Link quality indicator.
+    uint16_t stamp;		//!< Last heard (ticks).
+  };
+
+  /** Route; next hop and metric. */
+  struct route_t {
+    uint8_t dest;		//!< Destination device address, zero if free.
+    uint8_t next;		//!< Next hop device address.
+    uint8_t metric;		//!< Route metric.
+    uint16_t stamp;		//!< Last updated (ticks).
+  };
+
+  /** Recent message; source and sequence number. */
+  struct seen_t {
+    uint8_t src;		//!< Source device address.
+    uint8_t seq;		//!< Sequence number.
+  };
+
+  /** Beacon period jitter mask (milli-seconds). */
+  static const uint16_t JITTER_MASK = 0xff;
+
+  /** Neighbor timeout (ticks). */
+  static const uint16_t NEIGHBOR_TIMEOUT = (3 * BEACON_PERIOD) / 256;
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  uint8_t m_payload_max;	//!< Device payload size.
+  uint8_t m_seq;		//!< Message sequence number.
+  uint8_t m_beacon_ix;		//!< Next route table index in beacon.
+  uint16_t m_route_timeout;	//!< Route timeout (ticks).
+  uint32_t m_beacon;		//!< Next beacon time (milli-seconds).
+  neighbor_t m_neighbor[NEIGHBOR_MAX]; //!< Neighbor table.
+  route_t m_route[ROUTE_MAX];	//!< Route table.
+  seen_t m_seen[DUPLICATE_MAX];	//!< Duplicate cache.
+  uint8_t m_seen_ix;		//!< Next duplicate cache index.
+  uint16_t m_forwarded;		//!< Number of forwarded messages.
+  uint16_t m_drops;		//!< Number of dropped messages.
+  uint16_t m_duplicates;	//!< Number of duplicate messages.
+
+  /**
+   * Return current time in ticks (256 milli-seconds).
+   * @return ticks.
+   */
+  static uint16_t ticks();
+
+  /**
+   * Lookup neighbor with given device address. Allocate neighbor
+   * entry if the given flag is set. Returns pointer to neighbor or
+   * NULL.
+   * @param[in] addr device address.
+   * @param[in] create allocate if not found.
+   * @return neighbor pointer or NULL.
+   */
+  neighbor_t* neighbor(uint8_t addr, bool create);
+
+  /**
+   * Return link cost for given neighbor.
+   * @param[in] nb neighbor.
+   * @return link cost.
+   */
+  static uint8_t cost(const neighbor_t* nb);
+
+  /**
+   * Lookup route for given destination. Returns pointer to route or
+   * NULL.
+   * @param[in] dest destination device address.
+   * @return route pointer or NULL.
+   */
+  route_t* lookup(uint8_t dest);
+
+  /**
+   * Update route to given destination with given next hop and
+   * metric. Better routes replace the current route, and the current
+   * next hop may change the metric.
+   * @param[in] dest destination device address.
+   * @param[in] next next hop device address.
+   * @param[in] metric route metric.
+   */
+  void update(uint8_t dest, uint8_t next, uint8_t metric);
+
+  /**
+   * Remove expired neighbors and invalidate routes through them.
+   * Remove expired unreachable routes.
+   */
+  void expire();
+
+  /**
+   * Send beacon with next part of the route table.
+   */
+  void beacon();
+
+  /**
+   * Send beacon and route maintenance when the beacon period has
+   * elapsed.
+   */
+  void run();
+
+  /**
+   * Handle beacon from given neighbor.
+   * @param[in] src neighbor device address.
+   * @param[in] buf beacon entries.
+   * @param[in] len beacon length.
+   */
+  void on_beacon(uint8_t src, const uint8_t* buf, size_t len);
+
+  /**
+   * Check given message source and sequence number against the
+   * duplicate cache. Returns true(1) if seen otherwise false(0) and
+   * the message is added to the cache.
+   * @param[in] src source device address.
+   * @param[in] seq sequence number.
+   * @return bool.
+   */
+  bool is_duplicate(uint8_t src, uint8_t seq);
+
+  /**
+   * Send given frame with header to the next hop on the route to
+   * the destination. Update link quality. Returns number of bytes
+   * sent or negative error code.
+   * @param[in] frame message header and payload.
+   * @param[in] len frame length.
+   * @return number of bytes sent or negative error code.
+   */
+  int forward(uint8_t* frame, size_t len);
+};
+
+/**
+ * Print neighbor and route table to given output stream.
+ * @param[in] outs output stream.
+ * @param[in] mesh router.
+ * @return output stream.
+ */
+IOStream& operator<<(IOStream& outs, Mesh& mesh);
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * @file CosaMesh.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa Mesh demo; mesh node that sends a message to the sink node
+ * (SINK) every few seconds and routes messages for other nodes. The
+ * sink prints received messages. Use CosaWirelessRelay as router.
+ *
+ * @section Circuit
+ * See Wireless drivers for circuit connections.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <Mesh.h>
+
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+
+// Configuration; network and device addresses. Sink or node
+#define NETWORK 0xC05A
+#define SINK 0x01
+#define DEVICE 0x20
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+
+// Mesh router; device payload size should be the same on all nodes
+#define PAYLOAD 30
+Mesh mesh(&rf, PAYLOAD);
+
+// Message from node; sequence number and time stamp
+struct msg_t {
+  uint16_t nr;
+  uint32_t timestamp;
+};
+static const uint8_t MSG_TYPE = 0x03;
+static const uint32_t PERIOD = 5000L;
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaMesh: started"));
+  Watchdog::begin();
+  RTC::begin();
+  ASSERT(mesh.begin());
+}
+
+void loop()
+{
+  static uint32_t start = 0L;
+  static msg_t msg = { 0, 0L };
+
+  // Receive and forward messages until time to send
+  uint8_t buf[Mesh::PAYLOAD_MAX];
+  uint8_t src;
+  uint8_t port;
+  uint32_t elapsed = RTC::since(start);
+  uint32_t timeout = elapsed < PERIOD ? PERIOD - elapsed : 1L;
+  int count = mesh.recv(src, port, buf, sizeof(buf), timeout);
+  if (count > 0 && DEVICE == SINK) {
+    trace << PSTR("src=") << hex << src
+	  << PSTR(",port=") << hex << port
+	  << PSTR(",len=") << count
+	  << endl;
+  }
+  if (DEVICE == SINK || RTC::since(start) < PERIOD) return;
+
+  // Send message to the sink
+  start = RTC::millis();
+  msg.nr += 1;
+  msg.timestamp = start;
+  int res = mesh.send(SINK, MSG_TYPE, &msg, sizeof(msg));
+  trace << PSTR("nr=") << msg.nr
+	<< PSTR(",next=") << hex << mesh.get_next_hop(SINK)
+	<< PSTR(",metric=") << mesh.get_metric(SINK)
+	<< PSTR(",res=") << res
+	<< endl;
+}
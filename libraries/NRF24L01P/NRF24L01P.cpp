@@ -25,6 +25,14 @@
 #include "Cosa/RTC.hh"
 #include <util/delay.h>
 
+void
+NRF24L01P::IRQPin::on_interrupt(uint16_t arg)
+{
+  UNUSED(arg);
+  if (m_nrf == NULL) return;
+  m_nrf->m_irq_flag = true;
+}
+
 NRF24L01P::NRF24L01P(uint16_t net, uint8_t dev,
 		     Board::DigitalPin csn,
 		     Board::DigitalPin ce,
@@ -35,6 +43,9 @@ NRF24L01P::NRF24L01P(uint16_t net, uint8_t dev,
   m_irq(irq, ExternalInterrupt::ON_FALLING_MODE, this),
   m_status(0),
   m_state(POWER_DOWN_STATE),
+  m_irq_flag(false),
+  m_tx_dest(-1),
+  m_pending(0),
   m_trans(0),
   m_retrans(0),
   m_drops(0)
@@ -131,6 +142,12 @@ NRF24L01P::set_receiver_mode()
   // Check already in receive mode
   if (m_state == RX_STATE) return;
 
+  // Complete pending messages and disable auto-acknowledge pipe(0)
+  if (m_state == TX_STATE) {
+    flush();
+    write(EN_RXADDR, (_BV(ERX_P2) | _BV(ERX_P1)));
+  }
+
   // Configure primary receiver mode
   write(CONFIG, (_BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP) | _BV(PRIM_RX)));
   m_ce.set();
@@ -141,14 +158,30 @@ NRF24L01P::set_receiver_mode()
 void
 NRF24L01P::set_transmit_mode(uint8_t dest)
 {
-  // Setup primary transmit address
-  addr_t tx_addr(m_addr.network, dest);
-  write(TX_ADDR, &tx_addr, sizeof(tx_addr));
+  // Setup primary transmit address and auto-acknowledge pipe(0)
+  // address when the destination changes
+  bool enable = (m_state != TX_STATE);
+  if (dest != m_tx_dest) {
+    flush();
+    addr_t tx_addr(m_addr.network, dest);
+    write(TX_ADDR, &tx_addr, sizeof(tx_addr));
+    if (dest != BROADCAST) write(RX_ADDR_P0, &tx_addr, sizeof(tx_addr));
+    m_tx_dest = dest;
+    enable = true;
+  }
+
+  // Check for auto-acknowledge pipe(0) enable
+  if (enable) {
+    if (dest != BROADCAST)
+      write(EN_RXADDR, (_BV(ERX_P2) | _BV(ERX_P1) | _BV(ERX_P0)));
+    else
+      write(EN_RXADDR, (_BV(ERX_P2) | _BV(ERX_P1)));
+  }
 
-  // Trigger the transmitter mode
+  // Trigger the transmitter mode; receiver interrupt masked
   if (m_state != TX_STATE) {
     m_ce.clear();
-    write(CONFIG, (_BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP)));
+    write(CONFIG, (_BV(MASK_RX_DR) | _BV(EN_CRC) | _BV(CRCO) | _BV(PWR_UP)));
     m_ce.set();
   }
 
@@ -168,6 +201,7 @@ NRF24L01P::standby()
 void
 NRF24L01P::powerdown()
 {
+  flush();
   delay(32);
   m_ce.clear();
   write(CONFIG, (_BV(EN_CRC) | _BV(CRCO)));
@@ -198,6 +232,8 @@ NRF24L01P::begin(const void* config)
   write(EN_AA, (_BV(ENAA_P1) | _BV(ENAA_P0)));
 
   // Ready to go
+  m_tx_dest = -1;
+  m_pending = 0;
   powerup();
   spi.attach(this);
   m_irq.enable();
@@ -205,7 +241,48 @@ NRF24L01P::begin(const void* config)
 }
 
 int
-NRF24L01P::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+NRF24L01P::await()
+{
+  // Wait for transmitter interrupt; poll if not signaled
+  uint32_t start = RTC::millis();
+  while (!m_irq_flag && (RTC::since(start) < POLL_MS)) yield();
+  m_irq_flag = false;
+  read_status();
+  int res = 0;
+
+  // Check for delivered message and update retransmission counter
+  if (m_status.tx_ds) {
+    write(STATUS, _BV(TX_DS));
+    m_retrans += read_observe_tx().arc_cnt;
+    if (m_pending > 0) m_pending -= 1;
+  }
+
+  // Check for failed message; remaining messages are dropped
+  if (m_status.max_rt) {
+    write(STATUS, _BV(MAX_RT));
+    write(FLUSH_TX);
+    m_retrans += read_observe_tx().arc_cnt;
+    m_drops += (m_pending > 0 ? m_pending : 1);
+    m_pending = 0;
+    res = EIO;
+  }
+
+  // All messages are completed when the transmit fifo is empty
+  if ((m_pending > 0) && read_fifo_status().tx_empty) m_pending = 0;
+  return (res);
+}
+
+int
+NRF24L01P::flush()
+{
+  int res = 0;
+  while (m_pending > 0)
+    if (await() < 0) res = EIO;
+  return (res);
+}
+
+int
+NRF24L01P::post(uint8_t dest, uint8_t port, const iovec_t* vec)
 {
   // Sanity check the payload size
   if (vec == NULL) return (EINVAL);
@@ -215,8 +292,13 @@ NRF24L01P::send(uint8_t dest, uint8_t port, const iovec_t* vec)
   // Setting transmit destination
   set_transmit_mode(dest);
 
+  // Wait for room in the transmit fifo
+  if (m_pending > 0) {
+    read_status();
+    while (m_status.tx_full) await();
+  }
+
   // Write source address and payload to the transmit fifo
-  // Fix: Allow larger payload(30*3) with fragmentation
   spi.acquire(this);
     spi.begin();
       uint8_t command = ((dest != BROADCAST)
@@ -228,39 +310,29 @@ NRF24L01P::send(uint8_t dest, uint8_t port, const iovec_t* vec)
       spi.write(vec);
     spi.end();
   spi.release();
+  m_pending += 1;
   m_trans += 1;
+  return (len);
+}
 
-  // Check for auto-acknowledge pipe(0), and address setup and enable
-  if (dest != BROADCAST) {
-    addr_t tx_addr(m_addr.network, dest);
-    write(RX_ADDR_P0, &tx_addr, sizeof(tx_addr));
-    write(EN_RXADDR, (_BV(ERX_P2) | _BV(ERX_P1) | _BV(ERX_P0)));
-  }
-
-  // Wait for transmission
-  do {
-    yield();
-    read_status();
-  } while (!m_status.tx_ds && !m_status.max_rt);
-  bool data_sent = m_status.tx_ds;
-
-  // Check for auto-acknowledge pipe(0) disable
-  if (dest != BROADCAST) {
-    write(EN_RXADDR, (_BV(ERX_P2) | _BV(ERX_P1)));
-  }
-
-  // Reset status bits and read retransmission counter and update
-  write(STATUS, _BV(MAX_RT) | _BV(TX_DS));
-  observe_tx_t observe = read_observe_tx();
-  m_retrans += observe.arc_cnt;
-
-  // Check that the message was delivered
-  if (data_sent) return (len);
+int
+NRF24L01P::post(uint8_t dest, uint8_t port, const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (post(dest, port, vec));
+}
 
-  // Failed to delivery
-  write(FLUSH_TX);
-  m_drops += 1;
-  return (EIO);
+int
+NRF24L01P::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  // Post the message and wait for delivery
+  int res = post(dest, port, vec);
+  if (res < 0) return (res);
+  if (flush() < 0) return (EIO);
+  return (res);
 }
 
 int
@@ -49,6 +49,15 @@
  *                       +------------+
  * @endcode
  *
+ * @section Transmit
+ * Messages may be posted to the transmit fifo (max three messages)
+ * and are then transmitted back-to-back by the device. The
+ * transmitter completion (TX_DS/MAX_RT) is signaled on the interrupt
+ * pin. The transmit and acknowledge addresses are only written when
+ * the destination changes. Pending messages are completed before
+ * changing destination, receive mode or power down. The send()
+ * member function posts the message and waits for completion.
+ *
  * @section References
  * 1. nRF24L01+ Product Specification (Rev. 1.0)
  * http://www.nordicsemi.com/kor/nordic/download_resource/8765/2/17776224
@@ -167,6 +176,48 @@ public:
    */
   virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
 
+  /**
+   * Post message in given null terminated io vector to the transmit
+   * fifo. Wait for room in the fifo if full. Does not wait for the
+   * message to be delivered. Returns number of bytes posted or
+   * negative error code.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes posted or negative error code.
+   */
+  int post(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * Post message in given buffer, with given number of bytes, to the
+   * transmit fifo. Wait for room in the fifo if full. Does not wait
+   * for the message to be delivered. Returns number of bytes posted
+   * or negative error code.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes posted or negative error code.
+   */
+  int post(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * Wait for posted messages to be transmitted. Returns zero if all
+   * messages were delivered otherwise negative error code(EIO). Failed
+   * messages are counted as dropped.
+   * @return zero or negative error code.
+   */
+  int flush();
+
+  /**
+   * Return number of posted messages waiting for completion.
+   * @return pending count.
+   */
+  uint8_t get_pending() const
+  {
+    return (m_pending);
+  }
+
   /**
    * @override Wireless::Device
    * Receive message and store into given buffer with given maximum
@@ -602,7 +653,13 @@ protected:
   } __attribute__((packed));
 
   /**
-   * Handler for interrupt pin.
+   * Transmitter completion poll period (milli-seconds). Used when
+   * the interrupt pin is not connected.
+   */
+  static const uint16_t POLL_MS = 2;
+
+  /**
+   * Handler for interrupt pin. Signal transmitter completion.
    */
   class IRQPin : public ExternalInterrupt {
   public:
@@ -612,6 +669,14 @@ protected:
       ExternalInterrupt(pin, mode),
       m_nrf(nrf)
     {}
+
+    /**
+     * @override Interrupt::Handler
+     * Signal device interrupt; transmitter completion.
+     * @param[in] arg argument from interrupt service routine.
+     */
+    virtual void on_interrupt(uint16_t arg = 0);
+
     friend class NRF24L01P;
   private:
     NRF24L01P* m_nrf;		//!< Device driver.
@@ -621,6 +686,9 @@ protected:
   IRQPin m_irq;			//!< Chip interrupt pin and handler.
   status_t m_status;		//!< Latest status.
   State m_state;		//!< Transceiver state.
+  volatile bool m_irq_flag;	//!< Interrupt signaled.
+  int16_t m_tx_dest;		//!< Transmit address device, -1 if not set.
+  uint8_t m_pending;		//!< Posted messages in transmit fifo.
 
   uint16_t m_trans;		//!< Send count.
   uint16_t m_retrans;		//!< Retransmittion count.
@@ -652,11 +720,21 @@ protected:
   }
 
   /**
-   * Set transmit mode and given destination device address.
+   * Set transmit mode and given destination device address. The
+   * address registers are only written if the destination changes;
+   * pending messages are completed first.
    * @param[n] dest destination device address.
    */
   void set_transmit_mode(uint8_t dest);
 
+  /**
+   * Wait for transmitter completion interrupt (or poll period) and
+   * handle delivered and failed messages. Returns zero or negative
+   * error code(EIO) if a message failed.
+   * @return zero or negative error code.
+   */
+  int await();
+
   /**
    * Set receive mode.
    */
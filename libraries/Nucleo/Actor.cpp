@@ -34,43 +34,97 @@ Actor::send(uint8_t port, const void* buf, size_t size)
   sender->m_size = size;
   sender->m_buf = buf;
 
-  // And queue in sending. Resume receiver or next thread
-  Thread* thread = (m_receiving ? this : (Thread*) sender->get_succ());
-  m_sending.attach(sender);
-  sender->resume(thread);
+  // Make a waiting receiver ready and queue in sending
+  notify();
+  sender->enqueue(&m_sending);
   return (size);
 }
 
+int
+Actor::post(uint8_t port, const void* buf, size_t size)
+{
+  if (UNLIKELY(m_mailbox == NULL)) return (EINVAL);
+  int res = m_mailbox->post(port, buf, size);
+  if (res >= 0) notify();
+  return (res);
+}
+
+void
+Actor::commit(void* buf, uint8_t port, size_t size)
+{
+  m_mailbox->commit(buf, port, size);
+  notify();
+}
+
 int
 Actor::recv(Actor*& sender, uint8_t& port, void* buf, size_t size)
 {
   // Do not allow receive of other actor queue
   if (s_running != this) return (EINVAL);
 
-  // Check if receiver needs to wait for sending actor
-  uint8_t key = lock();
-  if (m_sending.is_empty()) {
-    m_receiving = true;
-    Thread* thread = (Thread*) get_succ();
-    detach();
-    unlock(key);
-    resume(thread);
-    key = lock();
+  // Wait for a posted message or sending actor
+  suspend(true);
+
+  // Posted messages are received first
+  size_t count;
+  const void* msg = NULL;
+  if (m_mailbox != NULL) msg = m_mailbox->borrow(port, count);
+  if (msg != NULL) {
+    sender = NULL;
+    if (size < count) {
+      m_mailbox->drop();
+      return (EMSGSIZE);
+    }
+    memcpy(buf, msg, count);
+    m_mailbox->release();
+    return (count);
   }
 
   // Copy sender message parameters
-  int res = -2;
+  uint8_t key = lock();
+  int res = EMSGSIZE;
   sender = (Actor*) m_sending.get_succ();
   port = sender->m_port;
   if (size >= sender->m_size) {
     memcpy(buf, sender->m_buf, sender->m_size);
     res = sender->m_size;
   }
-  m_receiving = false;
 
   // Reschedule the sender
-  get_succ()->attach(sender);
+  ready(sender);
   unlock(key);
   return (res);
 }
 
+const void*
+Actor::borrow(uint8_t& port, size_t& size)
+{
+  if (s_running != this || m_mailbox == NULL) return (NULL);
+  suspend(false);
+  return (m_mailbox->borrow(port, size));
+}
+
+void
+Actor::suspend(bool with_sending)
+{
+  uint8_t key = lock();
+  while ((m_mailbox == NULL || m_mailbox->is_empty())
+	 && (!with_sending || m_sending.is_empty())) {
+    m_receiving = true;
+    unready();
+    m_state = WAITING;
+    unlock(key);
+    schedule();
+    key = lock();
+  }
+  m_receiving = false;
+  unlock(key);
+}
+
+void
+Actor::notify()
+{
+  synchronized {
+    if (m_receiving && (m_state != READY)) ready(this);
+  }
+}
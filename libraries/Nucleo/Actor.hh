@@ -22,26 +22,43 @@
 #define COSA_NUCLEO_ACTOR_HH
 
 #include "Thread.hh"
+#include "Mailbox.hh"
 
 namespace Nucleo {
 
 /**
- * The Cosa Nucleo Actor; message passing supported thread.
+ * The Cosa Nucleo Actor; message passing supported thread. Messages
+ * are sent synchronously (rendezvous); the sender waits until the
+ * message has been received. An actor may also have a mailbox for
+ * asynchronous messages that are posted without waiting, also from
+ * interrupt and event handlers.
  */
 class Actor : public Thread {
 public:
   /**
-   * Construct actor and initiate internals.
+   * Construct actor and initiate internals. The actor may have a
+   * mailbox for posted messages.
+   * @param[in] mailbox for posted messages (default NULL).
    */
-  Actor() :
+  Actor(Mailbox* mailbox = NULL) :
     Thread(),
     m_receiving(false),
     m_sending(),
     m_port(0),
     m_size(0),
-    m_buf(NULL)
+    m_buf(NULL),
+    m_mailbox(mailbox)
   {}
 
+  /**
+   * Return actor mailbox or NULL.
+   * @return mailbox.
+   */
+  Mailbox* get_mailbox() const
+  {
+    return (m_mailbox);
+  }
+
   /**
    * Send message in given buffer and with given size to actor. Given port
    * may be used as message identity. Returns size or negative error code.
@@ -53,10 +70,48 @@ public:
    */
   int send(uint8_t port, const void* buf = NULL, size_t size = 0);
 
+  /**
+   * Post message in given buffer and with given size to the actor
+   * mailbox. The message is copied and the sender continues. May be
+   * called from interrupt and event handlers. A waiting receiver is
+   * resumed on the next preemption point. Returns size or negative
+   * error code; EINVAL if the actor has no mailbox, EMSGSIZE if the
+   * message is larger than the slot size, ENOSPC if the mailbox is
+   * full.
+   * @param[in] port or message identity.
+   * @param[in] buf pointer to buffer (default NULL).
+   * @param[in] size of message (default 0).
+   * @return size or negative error code.
+   */
+  int post(uint8_t port, const void* buf = NULL, size_t size = 0);
+
+  /**
+   * Allocate a mailbox slot for a zero-copy message. Returns pointer
+   * to slot message buffer or NULL if the actor has no mailbox or
+   * the mailbox is full. The message is posted with commit().
+   * @return pointer to slot message buffer or NULL.
+   */
+  void* alloc()
+  {
+    return (m_mailbox != NULL ? m_mailbox->alloc() : NULL);
+  }
+
+  /**
+   * Commit allocated mailbox slot with given port and message size.
+   * A waiting receiver is resumed on the next preemption point.
+   * @param[in] buf slot message buffer (from alloc).
+   * @param[in] port or message identity.
+   * @param[in] size of message.
+   */
+  void commit(void* buf, uint8_t port, size_t size);
+
   /**
    * Receive message to given buffer and with given max size to
    * actor. Returns sender, port and size or negative error code.
-   * Sending actor is rescheduled.
+   * Posted messages are received first and the sender is NULL.
+   * Sending actor is rescheduled. Returns EMSGSIZE if the buffer is
+   * too small; a posted message is dropped (Mailbox::get_drops()).
+   * Use borrow() to receive posted messages of any size.
    * @param[in,out] sender actor.
    * @param[in,out] port or message identity.
    * @param[in] buf pointer to buffer (default NULL).
@@ -65,12 +120,44 @@ public:
    */
   int recv(Actor*& sender, uint8_t& port, void* buf = NULL, size_t size = 0);
 
+  /**
+   * Wait for a posted message and borrow the mailbox slot (zero-copy).
+   * Returns pointer to slot message buffer, port and size or NULL if
+   * the actor has no mailbox or is not running. The slot should be
+   * released when the message has been handled.
+   * @param[out] port or message identity.
+   * @param[out] size of message.
+   * @return pointer to slot message buffer or NULL.
+   */
+  const void* borrow(uint8_t& port, size_t& size);
+
+  /**
+   * Release the borrowed mailbox slot.
+   */
+  void release()
+  {
+    if (m_mailbox != NULL) m_mailbox->release();
+  }
+
 protected:
   volatile bool m_receiving;
   Head m_sending;
   uint8_t m_port;
   size_t m_size;
   const void* m_buf;
+  Mailbox* m_mailbox;
+
+  /**
+   * Suspend the actor until a message is posted or, if with_sending
+   * is true, a sender is waiting.
+   * @param[in] with_sending wait also for sender.
+   */
+  void suspend(bool with_sending);
+
+  /**
+   * Make the actor ready if waiting for messages.
+   */
+  void notify();
 };
 
 };
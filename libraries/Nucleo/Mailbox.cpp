@@ -0,0 +1,90 @@
+/**
+ * @file Nucleo/Mailbox.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "Mailbox.hh"
+
+using namespace Nucleo;
+
+Mailbox::Mailbox(void* buf, uint8_t slot_size, uint8_t slot_max) :
+  m_buffer((uint8_t*) buf),
+  m_slot_size(slot_size),
+  m_slot_max(slot_max),
+  m_put(0),
+  m_get(0),
+  m_overruns(0),
+  m_drops(0)
+{
+  for (uint8_t ix = 0; ix < slot_max; ix++) slot(ix)->state = FREE;
+}
+
+void*
+Mailbox::alloc()
+{
+  slot_t* sp;
+  synchronized {
+    sp = slot(m_put);
+    if (sp->state != FREE) {
+      m_overruns += 1;
+      synchronized_return (NULL);
+    }
+    sp->state = RESERVED;
+    if (++m_put == m_slot_max) m_put = 0;
+  }
+  return (sp->buf);
+}
+
+void
+Mailbox::commit(void* buf, uint8_t port, uint8_t size)
+{
+  slot_t* sp = (slot_t*) (((uint8_t*) buf) - SLOT_HEADER);
+  sp->port = port;
+  sp->size = size;
+  sp->state = READY;
+}
+
+int
+Mailbox::post(uint8_t port, const void* buf, size_t size)
+{
+  if (UNLIKELY(size > m_slot_size)) return (EMSGSIZE);
+  void* dest = alloc();
+  if (UNLIKELY(dest == NULL)) return (ENOSPC);
+  memcpy(dest, buf, size);
+  commit(dest, port, size);
+  return (size);
+}
+
+const void*
+Mailbox::borrow(uint8_t& port, size_t& size)
+{
+  slot_t* sp = slot(m_get);
+  if (sp->state != READY) return (NULL);
+  port = sp->port;
+  size = sp->size;
+  return (sp->buf);
+}
+
+void
+Mailbox::release()
+{
+  slot_t* sp = slot(m_get);
+  if (sp->state != READY) return;
+  if (++m_get == m_slot_max) m_get = 0;
+  sp->state = FREE;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file Nucleo/Mailbox.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_NUCLEO_MAILBOX_HH
+#define COSA_NUCLEO_MAILBOX_HH
+
+#include "Cosa/Types.h"
+
+namespace Nucleo {
+
+/**
+ * The Cosa Nucleo Mailbox; bounded ring of fixed size message slots
+ * for asynchronous message passing to an Actor. Messages are posted
+ * without blocking, also from interrupt and event handlers, and
+ * received in order. Slots may be borrowed for zero-copy messages;
+ * a producer allocates a slot, writes the message and commits it,
+ * and the receiver borrows the message slot and releases it when
+ * done.
+ */
+class Mailbox {
+public:
+  /**
+   * Construct mailbox with given slot buffer, slot payload size and
+   * number of slots. The buffer size should be at least
+   * slot_max * (SLOT_HEADER + slot_size). See MailboxBuffer.
+   * @param[in] buf slot buffer.
+   * @param[in] slot_size max message size.
+   * @param[in] slot_max number of slots.
+   */
+  Mailbox(void* buf, uint8_t slot_size, uint8_t slot_max);
+
+  /** Size of slot header; state, port and message size. */
+  static const uint8_t SLOT_HEADER = 3;
+
+  /**
+   * Return max message size.
+   * @return bytes.
+   */
+  uint8_t get_slot_size() const
+  {
+    return (m_slot_size);
+  }
+
+  /**
+   * Return number of messages dropped as all slots were in use.
+   * @return count.
+   */
+  uint16_t get_overruns() const
+  {
+    uint16_t res;
+    synchronized res = m_overruns;
+    return (res);
+  }
+
+  /**
+   * Return number of messages dropped by the receiver as they were
+   * larger than the receive buffer.
+   * @return count.
+   */
+  uint16_t get_drops() const
+  {
+    return (m_drops);
+  }
+
+  /**
+   * Return true if the first message is not available (empty or
+   * not yet committed) otherwise false.
+   * @return bool.
+   */
+  bool is_empty() const
+  {
+    return (slot(m_get)->state != READY);
+  }
+
+  /**
+   * Allocate next free slot. Returns pointer to slot message buffer
+   * or NULL if all slots are in use. The message should be written
+   * to the buffer and committed. Interrupt safe.
+   * @return pointer to slot message buffer or NULL.
+   */
+  void* alloc();
+
+  /**
+   * Commit allocated slot with given port and message size. Interrupt
+   * safe.
+   * @param[in] buf slot message buffer (from alloc).
+   * @param[in] port or message identity.
+   * @param[in] size of message.
+   */
+  void commit(void* buf, uint8_t port, uint8_t size);
+
+  /**
+   * Post message with given port, buffer and size; allocate slot,
+   * copy message and commit. Interrupt safe. Returns size or negative
+   * error code; EMSGSIZE if the message is larger than the slot size,
+   * ENOSPC if all slots are in use.
+   * @param[in] port or message identity.
+   * @param[in] buf pointer to buffer.
+   * @param[in] size of message.
+   * @return size or negative error code.
+   */
+  int post(uint8_t port, const void* buf, size_t size);
+
+  /**
+   * Borrow first message slot. Returns pointer to slot message
+   * buffer, port and message size, or NULL if empty. The slot should
+   * be released when the message has been handled.
+   * @param[out] port or message identity.
+   * @param[out] size of message.
+   * @return pointer to slot message buffer or NULL.
+   */
+  const void* borrow(uint8_t& port, size_t& size);
+
+  /**
+   * Release first message slot.
+   */
+  void release();
+
+  /**
+   * Release first message slot and count the message as dropped.
+   */
+  void drop()
+  {
+    release();
+    m_drops += 1;
+  }
+
+protected:
+  /** Slot states. */
+  enum State {
+    FREE,			//!< Slot is free.
+    RESERVED,			//!< Allocated by producer.
+    READY			//!< Committed message.
+  } __attribute__((packed));
+
+  /** Slot header. */
+  struct slot_t {
+    volatile State state;	//!< Slot state.
+    uint8_t port;		//!< Message port.
+    uint8_t size;		//!< Message size.
+    uint8_t buf[];		//!< Message buffer.
+  };
+
+  /** Slot buffer. */
+  uint8_t* m_buffer;
+
+  /** Max message size. */
+  const uint8_t m_slot_size;
+
+  /** Number of slots. */
+  const uint8_t m_slot_max;
+
+  /** Index of next slot to allocate. */
+  volatile uint8_t m_put;
+
+  /** Index of first message slot. */
+  volatile uint8_t m_get;
+
+  /** Number of dropped messages. */
+  volatile uint16_t m_overruns;
+
+  /** Number of messages dropped by the receiver. */
+  uint16_t m_drops;
+
+  /**
+   * Return slot with given index.
+   * @param[in] ix slot index.
+   * @return slot.
+   */
+  slot_t* slot(uint8_t ix) const
+  {
+    return ((slot_t*) (m_buffer + ix * (SLOT_HEADER + m_slot_size)));
+  }
+};
+
+/**
+ * Mailbox with static slot buffer.
+ * @param[in] SLOT_SIZE max message size.
+ * @param[in] SLOT_MAX number of slots.
+ */
+template<uint8_t SLOT_SIZE, uint8_t SLOT_MAX>
+class MailboxBuffer : public Mailbox {
+public:
+  /**
+   * Construct mailbox with static slot buffer.
+   */
+  MailboxBuffer() : Mailbox(m_slots, SLOT_SIZE, SLOT_MAX) {}
+
+private:
+  uint8_t m_slots[SLOT_MAX * (SLOT_HEADER + SLOT_SIZE)];
+};
+
+};
+#endif
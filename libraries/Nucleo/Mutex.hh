@@ -27,7 +27,9 @@ namespace Nucleo {
 
 /**
  * The Cosa Nucleo Mutex; mutual exclusion block. Used as a local variable
- * in a function block to wait and signal a semaphore.
+ * in a function block to acquire and release a semaphore. The running
+ * thread inherits the priority of higher priority threads that wait
+ * for the semaphore until the end of the block.
  */
 class Mutex {
 public:
@@ -39,15 +41,15 @@ public:
   Mutex(Semaphore* sem) :
     m_sem(sem)
   {
-    m_sem->wait();
+    m_sem->acquire();
   }
 
   /**
-   * End of mutual exclusion block. Will signal semaphore.
+   * End of mutual exclusion block. Will release semaphore.
    */
   ~Mutex()
   {
-    m_sem->signal();
+    m_sem->release();
   }
 
 private:
@@ -22,6 +22,7 @@
 #define COSA_NUCLEO_H
 
 #include "Actor.hh"
+#include "Mailbox.hh"
 #include "Mutex.hh"
 #include "Semaphore.hh"
 #include "Thread.hh"
@@ -28,6 +28,8 @@ Semaphore::wait(uint8_t count)
 {
   uint8_t key = lock();
   while (count > m_count) {
+    // Priority inheritance; the owner runs at least at this priority
+    if (m_owner != NULL) m_owner->inherit(Thread::s_running->m_priority);
     unlock(key);
     Thread::s_running->enqueue(&m_queue);
     key = lock();
@@ -44,3 +46,23 @@ Semaphore::signal(uint8_t count, bool flag)
   }
   Thread::s_running->dequeue(&m_queue, flag);
 }
+
+void
+Semaphore::acquire()
+{
+  wait();
+  m_owner = Thread::s_running;
+  m_owner->m_mutexes += 1;
+}
+
+void
+Semaphore::release()
+{
+  // Restore the base priority when the last mutex is released; the
+  // inherited priority is kept while other mutexes are held
+  Thread* owner = Thread::s_running;
+  m_owner = NULL;
+  if (owner->m_mutexes > 0) owner->m_mutexes -= 1;
+  if (owner->m_mutexes == 0) owner->change(owner->m_base);
+  signal();
+}
@@ -26,8 +26,13 @@
 
 namespace Nucleo {
 
+class Thread;
+
 /**
  * The Cosa Nucleo Semaphore; counting synchronization primitive.
+ * Waiting threads are queued in priority order. When used as a mutex
+ * (acquire/release) the owner inherits the priority of higher
+ * priority threads that wait for the semaphore.
  */
 class Semaphore {
 public:
@@ -35,11 +40,12 @@ public:
    * Construct and initiate semaphore with given counter.
    * @param[in] count initial semaphore value (Default mutex, 1).
    */
-  Semaphore(uint8_t count = 1) : m_queue(), m_count(count) {}
+  Semaphore(uint8_t count = 1) : m_queue(), m_count(count), m_owner(NULL) {}
 
   /**
    * Wait for required count. Threads are queued until count is
-   * available.
+   * available. The owner of the semaphore, if any, inherits the
+   * priority of the running thread while it waits.
    * @param[in] count requested count (Default mutex, 1).
    */
   void wait(uint8_t count = 1);
@@ -52,12 +58,29 @@ public:
    */
   void signal(uint8_t count = 1, bool flag = true);
 
+  /**
+   * Wait for the semaphore as a mutex. The running thread becomes
+   * the owner of the semaphore.
+   */
+  void acquire();
+
+  /**
+   * Release the semaphore as a mutex. The owner priority is restored
+   * to its base priority when it holds no other mutex, and the
+   * highest priority waiting thread is resumed. With nested mutexes
+   * the inherited priority is kept until the last is released.
+   */
+  void release();
+
 private:
   /** Queue for waiting threads. */
   Head m_queue;
 
   /** Current count. */
   volatile uint8_t m_count;
+
+  /** Owner thread when acquired as a mutex. */
+  Thread* m_owner;
 };
 
 };
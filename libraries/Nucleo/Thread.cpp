@@ -20,7 +20,7 @@
 
 #include "Thread.hh"
 #include "Cosa/Watchdog.hh"
-#include "Cosa/Power.hh"
+#include "Cosa/RTC.hh"
 #include <alloca.h>
 
 static void thread_delay(uint32_t ms)
@@ -40,26 +40,61 @@ static void thread_sleep(uint16_t s)
 
 using namespace Nucleo;
 
-Head Thread::s_delayed;
-Thread Thread::s_main;
+Head Thread::s_ready[PRIORITY_MAX];
+volatile uint8_t Thread::s_bitmap = 0;
+Thread* Thread::s_delayed[DELAYED_MAX];
+uint8_t Thread::s_delays = 0;
+Thread Thread::s_main(IDLE_PRIORITY);
 Thread* Thread::s_running = &s_main;
 size_t Thread::s_top = MAIN_STACK_MAX;
 
+#if COSA_NUCLEO_STATISTICS
+Thread* Thread::s_overflow = NULL;
+uint32_t Thread::s_switched = 0L;
+#endif
+
+/**
+ * Return true if the first time stamp is before the second. Handles
+ * wrap-around of the millisecond clock.
+ * @param[in] first time stamp.
+ * @param[in] second time stamp.
+ * @return bool.
+ */
+static inline bool
+is_before(uint32_t first, uint32_t second)
+{
+  return ((int32_t) (first - second) < 0);
+}
+
 void
-Thread::init(void* stack)
+Thread::init(void* stack, size_t size)
 {
+#if COSA_NUCLEO_STATISTICS
+  // Paint the stack below the current frame
+  uint8_t* bottom = ((uint8_t*) stack) - size;
+  uint8_t* top = ((uint8_t*) &bottom) - 32;
+  for (uint8_t* sp = bottom; sp < top; sp++) *sp = STACK_PAINT;
+  m_stack = bottom;
+  m_size = size;
+  m_runtime = 0L;
+  m_next = s_main.m_next;
+  s_main.m_next = this;
+#else
   UNUSED(stack);
-  s_main.attach(this);
+  UNUSED(size);
+#endif
+  ready(this);
   if (setjmp(m_context)) while (1) run();
 }
 
 void
 Thread::begin(Thread* thread, size_t size)
 {
+  if (s_main.m_state != READY) ready(&s_main);
   if (thread != NULL) {
     void* stack = alloca(s_top);
     s_top += size;
-    thread->init(stack);
+    thread->init(stack, size);
   }
   else {
     ::delay = thread_delay;
@@ -72,20 +107,10 @@ Thread::begin(Thread* thread, size_t size)
 void
 Thread::run()
 {
-  Thread* thread;
   while (1) {
-    if (!s_delayed.is_empty()) {
-      uint32_t now = Watchdog::millis();
-      while ((thread = (Thread*) s_delayed.get_succ()) != (Thread*) &s_delayed) {
-	if (thread->m_expires > now) break;
-	this->attach(thread);
-      }
-    }
-    thread = (Thread*) get_succ();
-    if (thread != this)
-      resume(thread);
-    else
-      Power::sleep();
+    yield();
+    if ((s_bitmap == _BV(IDLE_PRIORITY)) && (get_succ() == get_pred()))
+      idle();
   }
 }
 
@@ -93,16 +118,149 @@ void
 Thread::resume(Thread* thread)
 {
   if (setjmp(m_context)) return;
+#if COSA_NUCLEO_STATISTICS
+  uint32_t now = RTC::micros();
+  m_runtime += now - s_switched;
+  s_switched = now;
+  if ((s_overflow == NULL) && is_overflow()) s_overflow = this;
+#endif
   s_running = thread;
   longjmp(thread->m_context, 1);
 }
 
+void
+Thread::yield()
+{
+  wakeup();
+  if (m_state == READY) s_ready[m_priority].attach(this);
+  schedule();
+}
+
+void
+Thread::set_priority(uint8_t priority)
+{
+  if (priority >= PRIORITY_MAX) priority = PRIORITY_MAX - 1;
+  m_base = priority;
+  change(priority);
+  if (s_bitmap == 0) return;
+  if (select()->m_priority > s_running->m_priority) s_running->schedule();
+}
+
+Thread*
+Thread::select()
+{
+  // Find most significant bit in ready bitmap; binary search
+  uint8_t bits = s_bitmap;
+  uint8_t priority = 0;
+  if (bits & 0xf0) {
+    priority = 4;
+    bits >>= 4;
+  }
+  if (bits & 0x0c) {
+    priority += 2;
+    bits >>= 2;
+  }
+  if (bits & 0x02) priority += 1;
+  return ((Thread*) s_ready[priority].get_succ());
+}
+
+void
+Thread::ready(Thread* thread, bool first)
+{
+  Head* queue = &s_ready[thread->m_priority];
+  synchronized {
+    if (first)
+      queue->get_succ()->attach(thread);
+    else
+      queue->attach(thread);
+    s_bitmap |= _BV(thread->m_priority);
+    thread->m_state = READY;
+  }
+}
+
+void
+Thread::unready()
+{
+  synchronized {
+    detach();
+    if (s_ready[m_priority].is_empty()) s_bitmap &= ~_BV(m_priority);
+  }
+}
+
+void
+Thread::wakeup()
+{
+  if (s_delays == 0) return;
+  uint32_t now = Watchdog::millis();
+  while (s_delays != 0 && !is_before(now, s_delayed[0]->m_expires)) {
+    // Remove first thread and sift down the last thread
+    Thread* thread = s_delayed[0];
+    Thread* last = s_delayed[--s_delays];
+    uint8_t i = 0;
+    uint8_t child;
+    while ((child = 2 * i + 1) < s_delays) {
+      if ((child + 1 < s_delays)
+	  && is_before(s_delayed[child + 1]->m_expires,
+		       s_delayed[child]->m_expires))
+	child += 1;
+      if (!is_before(s_delayed[child]->m_expires, last->m_expires)) break;
+      s_delayed[i] = s_delayed[child];
+      i = child;
+    }
+    s_delayed[i] = last;
+    ready(thread);
+  }
+}
+
+void
+Thread::idle()
+{
+  uint32_t ms = UINT32_MAX;
+  if (s_delays != 0) {
+    int32_t diff = s_delayed[0]->m_expires - Watchdog::millis();
+    if (diff <= 0) return;
+    ms = diff;
+  }
+  Watchdog::idle(ms);
+}
+
+void
+Thread::schedule()
+{
+  while (s_bitmap == 0) {
+    idle();
+    wakeup();
+  }
+  Thread* thread = select();
+  if (thread != this) resume(thread);
+}
+
+void
+Thread::change(uint8_t priority)
+{
+  if (priority == m_priority) return;
+  if (m_state == READY) {
+    unready();
+    m_priority = priority;
+    ready(this);
+  }
+  else {
+    m_priority = priority;
+  }
+}
+
 void
 Thread::enqueue(Head* queue)
 {
-  Thread* thread = (Thread*) get_succ();
-  queue->attach(this);
-  resume(thread);
+  unready();
+  m_state = WAITING;
+
+  // Insert after threads with the same or higher priority
+  Linkage* link = queue->get_succ();
+  while (link != queue && ((Thread*) link)->m_priority >= m_priority)
+    link = link->get_succ();
+  link->attach(this);
+  schedule();
 }
 
 void
@@ -110,25 +268,35 @@ Thread::dequeue(Head* queue, bool flag)
 {
   if (queue->is_empty()) return;
   Thread* thread = (Thread*) queue->get_succ();
-  if (flag) {
-    attach(thread);
+  bool first = flag && (thread->m_priority == m_priority);
+  ready(thread, first);
+  if (first || (flag && (thread->m_priority > m_priority)))
     resume(thread);
-  }
-  else {
-    get_succ()->attach(thread);
-  }
 }
 
 void
 Thread::delay(uint32_t ms)
 {
   m_expires = Watchdog::millis() + ms;
-  Thread* thread = (Thread*) s_delayed.get_succ();
-  while (thread != (Thread*) &s_delayed) {
-    if (thread->m_expires > m_expires) break;
-    thread = (Thread*) thread->get_succ();
+
+  // Busy-wait if the delayed queue is full
+  if (s_delays == DELAYED_MAX) {
+    while (is_before(Watchdog::millis(), m_expires)) yield();
+    return;
   }
-  enqueue((Head*) thread);
+
+  // Insert into the delayed queue; sift up
+  unready();
+  m_state = DELAYED;
+  uint8_t i = s_delays++;
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (!is_before(m_expires, s_delayed[parent]->m_expires)) break;
+    s_delayed[i] = s_delayed[parent];
+    i = parent;
+  }
+  s_delayed[i] = this;
+  schedule();
 }
 
 void
@@ -137,4 +305,36 @@ Thread::await(volatile uint8_t* ptr, uint8_t bit)
   while ((*ptr & _BV(bit)) == 0) yield();
 }
 
+#if COSA_NUCLEO_STATISTICS
+size_t
+Thread::get_stack_max() const
+{
+  if (m_stack == NULL) return (0);
+  const uint8_t* sp = m_stack;
+  const uint8_t* top = m_stack + m_size;
+  while ((sp < top) && (*sp == STACK_PAINT)) sp++;
+  return (top - sp);
+}
 
+void
+Thread::print(IOStream& outs)
+{
+  uint32_t total = 0L;
+  for (Thread* thread = &s_main; thread != NULL; thread = thread->m_next)
+    total += thread->m_runtime;
+  uint32_t percent = (total / 100) + 1;
+  outs << PSTR("thread prio state stack max runtime") << endl;
+  for (Thread* thread = &s_main; thread != NULL; thread = thread->m_next) {
+    outs << (void*) thread << ' '
+	 << thread->m_priority << ' '
+	 << (thread->m_state == READY ? 'R' :
+	     thread->m_state == WAITING ? 'W' : 'D') << ' '
+	 << thread->m_size << ' '
+	 << thread->get_stack_max()
+	 << (thread->is_overflow() ? '!' : ' ')
+	 << thread->m_runtime << PSTR(" us (")
+	 << (uint16_t) (thread->m_runtime / percent) << PSTR("%)")
+	 << endl;
+  }
+}
+#endif
@@ -23,15 +23,73 @@
 
 #include "Cosa/Types.h"
 #include "Cosa/Linkage.hh"
+#include "Cosa/IOStream.hh"
 #include <setjmp.h>
 
+/**
+ * Number of thread priority levels (max 8). Each level has a ready
+ * queue and a bit in the ready bitmap.
+ */
+#ifndef COSA_NUCLEO_PRIORITY_MAX
+#define COSA_NUCLEO_PRIORITY_MAX 8
+#endif
+
+/**
+ * Max number of delayed threads. Threads that delay when the
+ * delayed queue is full will busy-wait (yield) instead.
+ */
+#ifndef COSA_NUCLEO_DELAYED_MAX
+#define COSA_NUCLEO_DELAYED_MAX 8
+#endif
+
+/**
+ * Thread statistics; stack painting, stack overflow detection and
+ * run-time accounting. Requires RTC::begin() for the run-time. Adds
+ * context switch overhead and per thread state. Default disabled;
+ * enable with build flag -DCOSA_NUCLEO_STATISTICS=1 for the sketch
+ * and library (see CosaNucleoShell/Makefile).
+ */
+#ifndef COSA_NUCLEO_STATISTICS
+#define COSA_NUCLEO_STATISTICS 0
+#endif
+
 namespace Nucleo {
 
 /**
- * The Cosa Nucleo Thread; run-to-completion multi-tasking.
+ * The Cosa Nucleo Thread; run-to-completion multi-tasking with fixed
+ * priority scheduling. The highest priority ready thread is selected
+ * in constant time with a ready bitmap. Threads with the same
+ * priority are scheduled round-robin. A higher priority thread that
+ * becomes ready will run at the next preemption point; yield, delay,
+ * semaphore wait and signal.
  */
 class Thread : protected Link {
 public:
+  /** Number of priority levels. */
+  static const uint8_t PRIORITY_MAX = COSA_NUCLEO_PRIORITY_MAX;
+  static_assert((PRIORITY_MAX > 0) && (PRIORITY_MAX <= 8),
+		"Nucleo: the ready bitmap has 8 priority levels");
+
+  /** Priority of the main (idle) thread. */
+  static const uint8_t IDLE_PRIORITY = 0;
+
+  /** Default thread priority. */
+  static const uint8_t DEFAULT_PRIORITY = 1;
+
+  /**
+   * Construct thread with given priority (0..PRIORITY_MAX-1, higher
+   * value is higher priority).
+   * @param[in] priority of thread (Default DEFAULT_PRIORITY).
+   */
+  Thread(uint8_t priority = DEFAULT_PRIORITY) :
+    Link(),
+    m_expires(0),
+    m_priority(priority),
+    m_base(priority),
+    m_mutexes(0),
+    m_state(WAITING)
+  {}
+
   /**
    * Return running thread.
    * @return thread.
@@ -71,12 +129,81 @@ public:
    * Yield control to the next thread in the thread queue. Preserve
    * stack and machine state and later continue after this function.
    */
-  void yield()
-    __attribute__((always_inline))
+  void yield();
+
+  /**
+   * Return thread priority. This is the inherited priority while
+   * the thread owns a mutex that a higher priority thread waits for.
+   * @return priority.
+   */
+  uint8_t get_priority() const
+  {
+    return (m_priority);
+  }
+
+  /**
+   * Set thread priority. The running thread yields if a thread with
+   * higher priority is ready.
+   * @param[in] priority of thread (0..PRIORITY_MAX-1).
+   */
+  void set_priority(uint8_t priority);
+
+#if COSA_NUCLEO_STATISTICS
+  /**
+   * Return size of thread stack. Zero for the main thread.
+   * @return bytes.
+   */
+  size_t get_stack_size() const
+  {
+    return (m_size);
+  }
+
+  /**
+   * Return max stack usage (high-water mark). The stack is painted
+   * when the thread is initiated and the max usage is the size of the
+   * stack that is no longer painted. Zero for the main thread.
+   * @return bytes.
+   */
+  size_t get_stack_max() const;
+
+  /**
+   * Return true if the thread has overflowed its stack; the bottom of
+   * the stack is no longer painted. Checked on each context switch.
+   * @return bool.
+   */
+  bool is_overflow() const
+  {
+    return ((m_stack != NULL) && (*m_stack != STACK_PAINT));
+  }
+
+  /**
+   * Return accumulated run-time for the thread. The run-time of the
+   * main thread includes idle (sleep) time.
+   * @return micro-seconds.
+   */
+  uint32_t get_runtime() const
   {
-    resume((Thread*) get_succ());
+    return (m_runtime);
   }
 
+  /**
+   * Return first thread that was detected to have overflowed its
+   * stack or NULL.
+   * @return thread or NULL.
+   */
+  static Thread* get_overflow()
+  {
+    return (s_overflow);
+  }
+
+  /**
+   * Print thread table with priority, state, stack size, max stack
+   * usage and run-time to the given output stream.
+   * @param[in] outs output stream.
+   */
+  static void print(IOStream& outs);
+#endif
+
   /**
    * Delay at least the given time period in milli-seconds. The resolution
    * is determined by the Watchdog clock and has a minimum resolution of
@@ -97,10 +224,29 @@ protected:
   /** Size of main thread stack. */
   static const size_t MAIN_STACK_MAX = 64;
 
-  /** Queue for delayed threads. */
-  static Head s_delayed;
+  /** Max number of delayed threads. */
+  static const uint8_t DELAYED_MAX = COSA_NUCLEO_DELAYED_MAX;
+
+  /** Thread states. */
+  enum State {
+    READY,			//!< In ready queue (or running).
+    WAITING,			//!< In semaphore or actor queue.
+    DELAYED			//!< In delayed queue.
+  } __attribute__((packed));
+
+  /** Ready queue per priority level. */
+  static Head s_ready[PRIORITY_MAX];
+
+  /** Ready bitmap; bit is set when ready queue is not empty. */
+  static volatile uint8_t s_bitmap;
 
-  /** Main thread and thread queue head. */
+  /** Delayed threads; binary heap ordered by expire time. */
+  static Thread* s_delayed[DELAYED_MAX];
+
+  /** Number of delayed threads. */
+  static uint8_t s_delays;
+
+  /** Main thread. */
   static Thread s_main;
 
   /** Running thread. */
@@ -115,22 +261,114 @@ protected:
   /** Delay time expires; should not run for more than 2**32 seconds. */
   uint32_t m_expires;
 
+  /** Current priority; inherited or base. */
+  uint8_t m_priority;
+
+  /** Base priority. */
+  uint8_t m_base;
+
+  /** Number of semaphores held as mutex. */
+  uint8_t m_mutexes;
+
+  /** Thread state. */
+  volatile State m_state;
+
+#if COSA_NUCLEO_STATISTICS
+  /** Stack paint pattern. */
+  static const uint8_t STACK_PAINT = 0xa5;
+
+  /** First thread detected with stack overflow. */
+  static Thread* s_overflow;
+
+  /** Time of latest context switch (us). */
+  static uint32_t s_switched;
+
+  /** Next thread in thread list; main thread is first. */
+  Thread* m_next;
+
+  /** Bottom of stack. */
+  uint8_t* m_stack;
+
+  /** Size of stack. */
+  size_t m_size;
+
+  /** Accumulated run-time (us). */
+  uint32_t m_runtime;
+#endif
+
+  /**
+   * Return highest priority ready thread. Constant time lookup in
+   * the ready bitmap.
+   * @return thread.
+   */
+  static Thread* select();
+
+  /**
+   * Add given thread to the ready queue of its priority. Thread is
+   * added last or first in the queue.
+   * @param[in] thread to make ready.
+   * @param[in] first in queue (Default false).
+   */
+  static void ready(Thread* thread, bool first = false);
+
+  /**
+   * Move expired delayed threads to the ready queues.
+   */
+  static void wakeup();
+
+  /**
+   * Tickless idle until the first delayed thread expires or an
+   * interrupt (see Watchdog::idle()).
+   */
+  static void idle();
+
+  /**
+   * Remove thread from its ready queue.
+   */
+  void unready();
+
+  /**
+   * Resume the highest priority ready thread. Idle while there are
+   * no ready threads.
+   */
+  void schedule();
+
+  /**
+   * Change current priority and move the thread to the ready queue
+   * of the new priority.
+   * @param[in] priority new priority.
+   */
+  void change(uint8_t priority);
+
+  /**
+   * Inherit given priority if higher than the current priority.
+   * @param[in] priority to inherit.
+   */
+  void inherit(uint8_t priority)
+  {
+    if (priority > m_priority) change(priority);
+  }
+
   /**
    * Initiate thread with initial call to member function run().
-   * Stack frame is allocated by begin().
+   * Stack frame is allocated by begin(). The stack is painted when
+   * statistics are enabled.
    * @param[in] stack top pointer.
+   * @param[in] size of stack.
    */
-  void init(void* stack);
+  void init(void* stack, size_t size);
 
   /**
-   * Enqueue running thread to given queue and yield.
+   * Enqueue running thread to given queue in priority order and
+   * yield.
    * @param[in] queue to transfer to.
    */
   void enqueue(Head* queue);
 
   /**
-   * If given queue is not empty dequeue first thread and resume
-   * direct if flag is true otherwise on yield.
+   * If given queue is not empty dequeue first thread and make it
+   * ready. If flag is true and the thread has the same or higher
+   * priority it is resumed direct otherwise on yield.
    * @param[in] queue to transfer from.
    * @param[in] flag resume direct otherwise on yield (Default true).
    */
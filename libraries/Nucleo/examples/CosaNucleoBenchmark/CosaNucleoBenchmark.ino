@@ -17,9 +17,14 @@
  *
  * @section Description
  * Cosa Nucleo benchmarks;
- * 1) Thread context switches, measured with yield
+ * 1) Thread context switches, measured with yield to a thread with
+ * the same priority
  * 2) Thread context switches, measured with resume(this)
- * 3) Semaphore signal-wait, measured between two threads
+ * 3) Semaphore signal-wait, measured between two threads; the waiting
+ * thread has higher priority and is resumed on signal
+ * 4) Worst-case wakeup latency; time from signal to the higher
+ * priority thread running while a compute thread with the same
+ * priority as the signalling thread is ready
  *
  * @section Circuit
  * This example requires no special circuit. Uses serial output,
@@ -37,6 +42,13 @@
 
 Nucleo::Semaphore sem(0);
 
+// Time stamp of latest signal and worst-case wakeup latency (us)
+uint32_t stamp = 0L;
+uint32_t latency = 0L;
+
+// Compute thread load enable
+volatile bool computing = false;
+
 class Producer : public Nucleo::Thread {
 public:
   virtual void run();
@@ -49,7 +61,7 @@ Producer::run()
 
   while (1) {
     // Measure 1,000 yield will give 2,000 context switches
-    // as the main (background) thread will be run
+    // as the compute thread has the same priority
     MEASURE("thread yield: ", 1000) {
       yield();
     }
@@ -64,12 +76,24 @@ Producer::run()
       sem.signal();
     }
 
+    // Measure worst-case wakeup latency of the consumer
+    latency = 0L;
+    computing = true;
+    for (uint16_t i = 0; i < 1000; i++) {
+      stamp = RTC::micros();
+      sem.signal();
+      yield();
+    }
+    computing = false;
+    trace << PSTR("wakeup latency: ") << latency << PSTR(" us (max)") << endl;
+
     ASSERT(true == false);
   }
 }
 
 class Consumer : public Nucleo::Thread {
 public:
+  Consumer() : Thread(DEFAULT_PRIORITY + 1) {}
   virtual void run();
 };
 
@@ -77,11 +101,32 @@ void
 Consumer::run()
 {
   trace << PSTR("Thread::Consumer: started") << endl;
-  while (1) sem.wait();
+  while (1) {
+    sem.wait();
+    uint32_t us = RTC::micros() - stamp;
+    if (us > latency) latency = us;
+  }
+}
+
+class Compute : public Nucleo::Thread {
+public:
+  virtual void run();
+};
+
+void
+Compute::run()
+{
+  trace << PSTR("Thread::Compute: started") << endl;
+  while (1) {
+    // Compute for a while before yield when enabled
+    if (computing) DELAY(100);
+    yield();
+  }
 }
 
 Producer producer;
 Consumer consumer;
+Compute compute;
 
 void setup()
 {
@@ -90,6 +135,7 @@ void setup()
   Watchdog::begin();
   RTC::begin();
   Nucleo::Thread::begin(&consumer, 64);
+  Nucleo::Thread::begin(&compute, 64);
   Nucleo::Thread::begin(&producer, 64);
   Nucleo::Thread::begin();
 }
@@ -0,0 +1,144 @@
+/**
+ * @file CosaNucleoMailbox.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Demonstration of Cosa Nucleo Actor mailboxes; a pipeline of
+ * actors with asynchronous messages. The watchdog interrupt handler
+ * posts samples to the filter actor mailbox. The filter calculates
+ * the average of a block of samples and posts the result to the
+ * logger with a zero-copy mailbox slot. The logger borrows the
+ * message slot, prints the result and releases the slot.
+ *
+ * @section Circuit
+ * This example requires no special circuit. Uses serial output,
+ * internal timer for RTC and watchdog.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <Nucleo.h>
+
+#include "Cosa/RTC.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+// Message ports
+static const uint8_t SAMPLE = 1;
+static const uint8_t RESULT = 2;
+
+// Number of samples per result
+static const uint8_t BLOCK_MAX = 16;
+
+// Result message
+struct result_t {
+  uint32_t timestamp;
+  uint16_t average;
+  uint16_t min;
+  uint16_t max;
+  uint16_t overruns;
+};
+
+// Log results from the filter
+class Logger : public Nucleo::Actor {
+public:
+  Logger() : Actor(&m_mailbox) {}
+  virtual void run();
+private:
+  Nucleo::MailboxBuffer<sizeof(result_t), 2> m_mailbox;
+};
+
+void
+Logger::run()
+{
+  uint8_t port;
+  size_t size;
+  const result_t* result = (const result_t*) borrow(port, size);
+  trace << result->timestamp
+	<< PSTR(":Logger:average=") << result->average
+	<< PSTR(",min=") << result->min
+	<< PSTR(",max=") << result->max
+	<< PSTR(",overruns=") << result->overruns
+	<< endl;
+  release();
+}
+
+// Filter samples from the interrupt handler and post result to logger
+class Filter : public Nucleo::Actor {
+public:
+  Filter(Actor* logger) : Actor(&m_mailbox), m_logger(logger) {}
+  virtual void run();
+private:
+  Nucleo::MailboxBuffer<sizeof(uint16_t), 8> m_mailbox;
+  Actor* m_logger;
+};
+
+void
+Filter::run()
+{
+  uint32_t sum = 0;
+  uint16_t min = UINT16_MAX;
+  uint16_t max = 0;
+  for (uint8_t i = 0; i < BLOCK_MAX; i++) {
+    Actor* sender;
+    uint8_t port;
+    uint16_t sample;
+    recv(sender, port, &sample, sizeof(sample));
+    sum += sample;
+    if (sample < min) min = sample;
+    if (sample > max) max = sample;
+  }
+  result_t* result = (result_t*) m_logger->alloc();
+  if (result == NULL) return;
+  result->timestamp = Watchdog::millis();
+  result->average = sum / BLOCK_MAX;
+  result->min = min;
+  result->max = max;
+  result->overruns = m_mailbox.get_overruns();
+  m_logger->commit(result, RESULT, sizeof(result_t));
+}
+
+Logger logger;
+Filter filter(&logger);
+
+// Watchdog interrupt handler; post sample to the filter
+void sample(void* env)
+{
+  uint16_t value = RTC::micros() & 0x3ff;
+  ((Nucleo::Actor*) env)->post(SAMPLE, &value, sizeof(value));
+}
+
+void setup()
+{
+  // Start serial as trace iostream
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaNucleoMailbox: started"));
+
+  // Start real-time clock and watchdog with sample interrupt handler
+  RTC::begin();
+  Watchdog::begin(16, sample, &filter);
+
+  // Start the actors
+  Nucleo::Thread::begin(&logger, 128);
+  Nucleo::Thread::begin(&filter, 128);
+}
+
+void loop()
+{
+  // Run actors
+  Nucleo::Thread::begin();
+}
@@ -0,0 +1,137 @@
+/**
+ * @file CosaNucleoShell.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Demonstration of Cosa Nucleo Thread statistics; stack high-water
+ * mark, stack overflow detection and run-time per thread. The shell
+ * runs in a thread together with two worker threads with different
+ * stack usage and load. Use the command "threads" to display the
+ * thread table and adjust the stack sizes. Requires the build flag
+ * -DCOSA_NUCLEO_STATISTICS=1; see Makefile.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <Nucleo.h>
+#include "Cosa/RTC.hh"
+#include "Cosa/Shell.hh"
+#include "Cosa/Memory.h"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+
+#if !COSA_NUCLEO_STATISTICS
+#error "CosaNucleoShell: requires build flag -DCOSA_NUCLEO_STATISTICS=1"
+#endif
+
+IOStream ios(&uart);
+extern Shell shell;
+
+SHELL_ACTION(help, "", "list command help")
+(int argc, char* argv[])
+{
+  UNUSED(argv);
+  if (argc != 1)
+    return (Shell::ILLEGAL_COMMAND);
+  return (shell.help(ios));
+}
+
+SHELL_ACTION(memory, "", "display amount of free memory")
+(int argc, char* argv[])
+{
+  UNUSED(argv);
+  if (argc != 1)
+    return (Shell::ILLEGAL_COMMAND);
+  ios << free_memory() << PSTR(" bytes") << endl;
+  return (0);
+}
+
+SHELL_ACTION(threads, "", "display thread stack usage and run-time")
+(int argc, char* argv[])
+{
+  UNUSED(argv);
+  if (argc != 1)
+    return (Shell::ILLEGAL_COMMAND);
+  Nucleo::Thread::print(ios);
+  Nucleo::Thread* thread = Nucleo::Thread::get_overflow();
+  if (thread != NULL)
+    ios << PSTR("stack overflow: ") << (void*) thread << endl;
+  return (0);
+}
+
+SHELL_BEGIN(command_tab)
+  SHELL_COMMAND(help, Shell::GUEST)
+  SHELL_COMMAND(memory, Shell::GUEST)
+  SHELL_COMMAND(threads, Shell::GUEST)
+SHELL_END
+
+Shell shell(membersof(command_tab), command_tab);
+
+class Console : public Nucleo::Thread {
+public:
+  virtual void run()
+  {
+    shell.run(ios);
+    delay(16);
+  }
+};
+
+class Worker : public Nucleo::Thread {
+public:
+  // Construct worker with given recursion depth, load and period
+  Worker(uint8_t depth, uint16_t us, uint16_t ms) :
+    Thread(),
+    m_depth(depth),
+    m_us(us),
+    m_ms(ms)
+  {}
+
+  virtual void run()
+  {
+    work(m_depth);
+    delay(m_ms);
+  }
+
+private:
+  uint8_t m_depth;
+  uint16_t m_us;
+  uint16_t m_ms;
+
+  // Use stack and processor for given depth
+  void work(uint8_t depth) __attribute__((noinline))
+  {
+    volatile uint8_t buf[8];
+    buf[0] = depth;
+    if (depth > 0) work(depth - 1);
+    DELAY(m_us);
+    UNUSED(buf);
+  }
+};
+
+Console console;
+Worker light(2, 10, 100);
+Worker heavy(6, 500, 32);
+
+void setup()
+{
+  uart.begin(57600);
+  Watchdog::begin();
+  RTC::begin();
+  Nucleo::Thread::begin(&console, 192);
+  Nucleo::Thread::begin(&light, 96);
+  Nucleo::Thread::begin(&heavy, 128);
+  Nucleo::Thread::begin();
+}
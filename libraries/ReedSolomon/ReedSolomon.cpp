@@ -0,0 +1,337 @@
+/**
+ * @file ReedSolomon.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "ReedSolomon.hh"
+
+// Galois field GF(2^8) exponent table; alpha = 2, polynomial 0x11d.
+// Duplicated so that the sum of two logarithms may be used as index
+const uint8_t ReedSolomon::gf_exp[] __PROGMEM = {
+  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8,
+  0xcd, 0x87, 0x13, 0x26, 0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9,
+  0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0, 0x9d, 0x27, 0x4e, 0x9c,
+  0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee, 0xc1, 0x9f, 0x23,
+  0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d, 0xba, 0x69, 0xd2,
+  0xb9, 0x6f, 0xde, 0xa1, 0x5f, 0xbe, 0x61, 0xc2, 0x99, 0x2f, 0x5e, 0xbc,
+  0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0, 0xfd, 0xe7, 0xd3, 0xbb,
+  0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b, 0xb6, 0x71, 0xe2,
+  0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d, 0x1a, 0x34, 0x68,
+  0xd0, 0xbd, 0x67, 0xce, 0x81, 0x1f, 0x3e, 0x7c, 0xf8, 0xed, 0xc7, 0x93,
+  0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc, 0x85, 0x17, 0x2e, 0x5c,
+  0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84, 0x15, 0x2a, 0x54,
+  0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49, 0x92, 0x39, 0x72,
+  0xe4, 0xd5, 0xb7, 0x73, 0xe6, 0xd1, 0xbf, 0x63, 0xc6, 0x91, 0x3f, 0x7e,
+  0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff, 0xe3, 0xdb, 0xab, 0x4b,
+  0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5, 0x57, 0xae, 0x41,
+  0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c, 0x38, 0x70, 0xe0,
+  0xdd, 0xa7, 0x53, 0xa6, 0x51, 0xa2, 0x59, 0xb2, 0x79, 0xf2, 0xf9, 0xef,
+  0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09, 0x12, 0x24, 0x48, 0x90,
+  0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb, 0x8b, 0x0b, 0x16,
+  0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b, 0x36, 0x6c, 0xd8,
+  0xad, 0x47, 0x8e, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d,
+  0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26, 0x4c, 0x98, 0x2d, 0x5a, 0xb4,
+  0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0, 0x9d,
+  0x27, 0x4e, 0x9c, 0x25, 0x4a, 0x94, 0x35, 0x6a, 0xd4, 0xb5, 0x77, 0xee,
+  0xc1, 0x9f, 0x23, 0x46, 0x8c, 0x05, 0x0a, 0x14, 0x28, 0x50, 0xa0, 0x5d,
+  0xba, 0x69, 0xd2, 0xb9, 0x6f, 0xde, 0xa1, 0x5f, 0xbe, 0x61, 0xc2, 0x99,
+  0x2f, 0x5e, 0xbc, 0x65, 0xca, 0x89, 0x0f, 0x1e, 0x3c, 0x78, 0xf0, 0xfd,
+  0xe7, 0xd3, 0xbb, 0x6b, 0xd6, 0xb1, 0x7f, 0xfe, 0xe1, 0xdf, 0xa3, 0x5b,
+  0xb6, 0x71, 0xe2, 0xd9, 0xaf, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0d,
+  0x1a, 0x34, 0x68, 0xd0, 0xbd, 0x67, 0xce, 0x81, 0x1f, 0x3e, 0x7c, 0xf8,
+  0xed, 0xc7, 0x93, 0x3b, 0x76, 0xec, 0xc5, 0x97, 0x33, 0x66, 0xcc, 0x85,
+  0x17, 0x2e, 0x5c, 0xb8, 0x6d, 0xda, 0xa9, 0x4f, 0x9e, 0x21, 0x42, 0x84,
+  0x15, 0x2a, 0x54, 0xa8, 0x4d, 0x9a, 0x29, 0x52, 0xa4, 0x55, 0xaa, 0x49,
+  0x92, 0x39, 0x72, 0xe4, 0xd5, 0xb7, 0x73, 0xe6, 0xd1, 0xbf, 0x63, 0xc6,
+  0x91, 0x3f, 0x7e, 0xfc, 0xe5, 0xd7, 0xb3, 0x7b, 0xf6, 0xf1, 0xff, 0xe3,
+  0xdb, 0xab, 0x4b, 0x96, 0x31, 0x62, 0xc4, 0x95, 0x37, 0x6e, 0xdc, 0xa5,
+  0x57, 0xae, 0x41, 0x82, 0x19, 0x32, 0x64, 0xc8, 0x8d, 0x07, 0x0e, 0x1c,
+  0x38, 0x70, 0xe0, 0xdd, 0xa7, 0x53, 0xa6, 0x51, 0xa2, 0x59, 0xb2, 0x79,
+  0xf2, 0xf9, 0xef, 0xc3, 0x9b, 0x2b, 0x56, 0xac, 0x45, 0x8a, 0x09, 0x12,
+  0x24, 0x48, 0x90, 0x3d, 0x7a, 0xf4, 0xf5, 0xf7, 0xf3, 0xfb, 0xeb, 0xcb,
+  0x8b, 0x0b, 0x16, 0x2c, 0x58, 0xb0, 0x7d, 0xfa, 0xe9, 0xcf, 0x83, 0x1b,
+  0x36, 0x6c, 0xd8, 0xad, 0x47, 0x8e
+};
+
+// Galois field GF(2^8) logarithm table; log(0) is undefined
+const uint8_t ReedSolomon::gf_log[] __PROGMEM = {
+  0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x03, 0xdf, 0x33, 0xee,
+  0x1b, 0x68, 0xc7, 0x4b, 0x04, 0x64, 0xe0, 0x0e, 0x34, 0x8d, 0xef, 0x81,
+  0x1c, 0xc1, 0x69, 0xf8, 0xc8, 0x08, 0x4c, 0x71, 0x05, 0x8a, 0x65, 0x2f,
+  0xe1, 0x24, 0x0f, 0x21, 0x35, 0x93, 0x8e, 0xda, 0xf0, 0x12, 0x82, 0x45,
+  0x1d, 0xb5, 0xc2, 0x7d, 0x6a, 0x27, 0xf9, 0xb9, 0xc9, 0x9a, 0x09, 0x78,
+  0x4d, 0xe4, 0x72, 0xa6, 0x06, 0xbf, 0x8b, 0x62, 0x66, 0xdd, 0x30, 0xfd,
+  0xe2, 0x98, 0x25, 0xb3, 0x10, 0x91, 0x22, 0x88, 0x36, 0xd0, 0x94, 0xce,
+  0x8f, 0x96, 0xdb, 0xbd, 0xf1, 0xd2, 0x13, 0x5c, 0x83, 0x38, 0x46, 0x40,
+  0x1e, 0x42, 0xb6, 0xa3, 0xc3, 0x48, 0x7e, 0x6e, 0x6b, 0x3a, 0x28, 0x54,
+  0xfa, 0x85, 0xba, 0x3d, 0xca, 0x5e, 0x9b, 0x9f, 0x0a, 0x15, 0x79, 0x2b,
+  0x4e, 0xd4, 0xe5, 0xac, 0x73, 0xf3, 0xa7, 0x57, 0x07, 0x70, 0xc0, 0xf7,
+  0x8c, 0x80, 0x63, 0x0d, 0x67, 0x4a, 0xde, 0xed, 0x31, 0xc5, 0xfe, 0x18,
+  0xe3, 0xa5, 0x99, 0x77, 0x26, 0xb8, 0xb4, 0x7c, 0x11, 0x44, 0x92, 0xd9,
+  0x23, 0x20, 0x89, 0x2e, 0x37, 0x3f, 0xd1, 0x5b, 0x95, 0xbc, 0xcf, 0xcd,
+  0x90, 0x87, 0x97, 0xb2, 0xdc, 0xfc, 0xbe, 0x61, 0xf2, 0x56, 0xd3, 0xab,
+  0x14, 0x2a, 0x5d, 0x9e, 0x84, 0x3c, 0x39, 0x53, 0x47, 0x6d, 0x41, 0xa2,
+  0x1f, 0x2d, 0x43, 0xd8, 0xb7, 0x7b, 0xa4, 0x76, 0xc4, 0x17, 0x49, 0xec,
+  0x7f, 0x0c, 0x6f, 0xf6, 0x6c, 0xa1, 0x3b, 0x52, 0x29, 0x9d, 0x55, 0xaa,
+  0xfb, 0x60, 0x86, 0xb1, 0xbb, 0xcc, 0x3e, 0x5a, 0xcb, 0x59, 0x5f, 0xb0,
+  0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
+  0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea,
+  0xa8, 0x50, 0x58, 0xaf
+};
+
+uint8_t
+ReedSolomon::mul(uint8_t x, uint8_t y)
+{
+  if (x == 0 || y == 0) return (0);
+  uint16_t n = pgm_read_byte(&gf_log[x]) + pgm_read_byte(&gf_log[y]);
+  return (pgm_read_byte(&gf_exp[n]));
+}
+
+uint8_t
+ReedSolomon::div(uint8_t x, uint8_t y)
+{
+  if (x == 0) return (0);
+  uint16_t n = pgm_read_byte(&gf_log[x]) + 255 - pgm_read_byte(&gf_log[y]);
+  return (pgm_read_byte(&gf_exp[n]));
+}
+
+uint8_t
+ReedSolomon::alpha(uint8_t n)
+{
+  return (pgm_read_byte(&gf_exp[n]));
+}
+
+ReedSolomon::ReedSolomon(uint8_t parity) :
+  m_parity(parity & ~1),
+  m_corrected(0)
+{
+  if (m_parity < 2) m_parity = 2;
+  if (m_parity > PARITY_MAX) m_parity = PARITY_MAX;
+
+  // Generator polynomial; product of (x - alpha^i), i = 0..parity-1
+  memset(m_generator, 0, sizeof(m_generator));
+  m_generator[0] = 1;
+  for (uint8_t i = 0; i < m_parity; i++) {
+    uint8_t root = alpha(i);
+    for (uint8_t j = i + 1; j > 0; j--)
+      m_generator[j] ^= mul(m_generator[j - 1], root);
+  }
+}
+
+int
+ReedSolomon::encode(uint8_t* buf, size_t len)
+{
+  if (len + m_parity > CODE_MAX) return (EMSGSIZE);
+
+  // Systematic encoding; the parity is the remainder of the message
+  // divided by the generator polynomial (linear feedback shift
+  // register)
+  uint8_t* parity = buf + len;
+  memset(parity, 0, m_parity);
+  for (size_t i = 0; i < len; i++) {
+    uint8_t feedback = buf[i] ^ parity[0];
+    for (uint8_t j = 1; j < m_parity; j++)
+      parity[j - 1] = parity[j] ^ mul(feedback, m_generator[j]);
+    parity[m_parity - 1] = mul(feedback, m_generator[m_parity]);
+  }
+  return (len + m_parity);
+}
+
+bool
+ReedSolomon::syndromes(const uint8_t* buf, size_t len, uint8_t* syndrome)
+{
+  // Evaluate the code word polynomial at the roots of the generator
+  bool res = false;
+  for (uint8_t i = 0; i < m_parity; i++) {
+    uint8_t root = alpha(i);
+    uint8_t s = 0;
+    for (size_t j = 0; j < len; j++)
+      s = mul(s, root) ^ buf[j];
+    syndrome[i] = s;
+    if (s != 0) res = true;
+  }
+  return (res);
+}
+
+int
+ReedSolomon::decode(uint8_t* buf, size_t len)
+{
+  m_corrected = 0;
+  if (len <= m_parity || len > CODE_MAX) return (EMSGSIZE);
+
+  // Check for errors
+  uint8_t syndrome[PARITY_MAX];
+  if (!syndromes(buf, len, syndrome)) return (len - m_parity);
+
+  // Berlekamp-Massey; error locator polynomial (lowest degree first)
+  uint8_t locator[PARITY_MAX + 1];
+  uint8_t prev[PARITY_MAX + 1];
+  uint8_t temp[PARITY_MAX + 1];
+  memset(locator, 0, sizeof(locator));
+  memset(prev, 0, sizeof(prev));
+  locator[0] = 1;
+  prev[0] = 1;
+  uint8_t errors = 0;
+  uint8_t shift = 1;
+  uint8_t scale = 1;
+  for (uint8_t r = 0; r < m_parity; r++) {
+    uint8_t delta = syndrome[r];
+    for (uint8_t i = 1; i <= errors; i++)
+      delta ^= mul(locator[i], syndrome[r - i]);
+    if (delta == 0) {
+      shift += 1;
+      continue;
+    }
+    uint8_t coeff = div(delta, scale);
+    memcpy(temp, locator, sizeof(temp));
+    for (uint8_t i = shift; i <= m_parity; i++)
+      locator[i] ^= mul(coeff, prev[i - shift]);
+    if (2 * errors <= r) {
+      errors = r + 1 - errors;
+      memcpy(prev, temp, sizeof(prev));
+      scale = delta;
+      shift = 1;
+    }
+    else shift += 1;
+  }
+  if (2 * errors > m_parity) return (EBADMSG);
+
+  // Error evaluator polynomial; syndrome times locator, modulo x^parity
+  uint8_t evaluator[PARITY_MAX];
+  for (uint8_t i = 0; i < m_parity; i++) {
+    uint8_t e = 0;
+    for (uint8_t j = 0; j <= i && j <= errors; j++)
+      e ^= mul(locator[j], syndrome[i - j]);
+    evaluator[i] = e;
+  }
+
+  // Chien search; the error locations are the inverse roots of the
+  // locator. Correct with the Forney algorithm
+  uint8_t found = 0;
+  for (size_t pos = 0; pos < len; pos++) {
+    // Evaluate at the inverse of alpha^power; the power is the
+    // position from the end of the code word
+    uint8_t power = len - 1 - pos;
+    uint8_t x = alpha(power);
+    uint8_t xinv = alpha((255 - power) % 255);
+    uint8_t lambda = 0;
+    uint8_t derivative = 0;
+    uint8_t omega = 0;
+    uint8_t xn = 1;
+    for (uint8_t i = 0; i <= errors; i++) {
+      lambda ^= mul(locator[i], xn);
+      if (i & 1) derivative ^= mul(locator[i], mul(xn, x));
+      xn = mul(xn, xinv);
+    }
+    if (lambda != 0) continue;
+    xn = 1;
+    for (uint8_t i = 0; i < m_parity; i++) {
+      omega ^= mul(evaluator[i], xn);
+      xn = mul(xn, xinv);
+    }
+    if (derivative == 0) return (EBADMSG);
+    buf[pos] ^= mul(x, div(omega, derivative));
+    found += 1;
+  }
+  if (found != errors) return (EBADMSG);
+  m_corrected = found;
+  return (len - m_parity);
+}
+
+ReedSolomon::Driver::Driver(Wireless::Driver* dev, uint8_t parity) :
+  Wireless::Driver(dev->get_network_address(), dev->get_device_address()),
+  m_dev(dev),
+  m_codec(parity),
+  m_corrected(0),
+  m_drops(0)
+{
+}
+
+int
+ReedSolomon::Driver::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  if (vec == NULL) return (EINVAL);
+
+  // Gather the header and message, and append the parity
+  size_t len = iovec_size(vec);
+  if (sizeof(header_t) + len + m_codec.get_parity() > FRAME_MAX)
+    return (EMSGSIZE);
+  uint8_t frame[FRAME_MAX];
+  header_t* hp = (header_t*) frame;
+  hp->network = m_addr.network;
+  hp->dest = dest;
+  hp->src = m_addr.device;
+  hp->port = port;
+  uint8_t* dp = frame + sizeof(header_t);
+  for (const iovec_t* vp = vec; vp->buf != NULL; vp++) {
+    memcpy(dp, vp->buf, vp->size);
+    dp += vp->size;
+  }
+  int size = m_codec.encode(frame, sizeof(header_t) + len);
+  if (size < 0) return (size);
+
+  // Send the code word
+  int res = m_dev->send(dest, port, frame, size);
+  if (res < 0) return (res);
+  return (len);
+}
+
+int
+ReedSolomon::Driver::send(uint8_t dest, uint8_t port,
+			  const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (send(dest, port, vec));
+}
+
+int
+ReedSolomon::Driver::recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+			  uint32_t ms)
+{
+  // Receive the code word and correct errors
+  uint8_t frame[FRAME_MAX];
+  int res = m_dev->recv(src, port, frame, sizeof(frame), ms);
+  if (res < 0) return (res);
+  res = m_codec.decode(frame, res);
+  if (res < 0) {
+    m_drops += 1;
+    return (res);
+  }
+  m_corrected += m_codec.get_corrected();
+
+  // Check the corrected header address; source and port from header
+  header_t* hp = (header_t*) frame;
+  if ((res < (int) sizeof(header_t))
+      || (hp->network != m_addr.network)
+      || ((hp->dest != BROADCAST) && (hp->dest != m_addr.device))) {
+    m_drops += 1;
+    return (EBADMSG);
+  }
+  m_dest = hp->dest;
+  src = hp->src;
+  port = hp->port;
+
+  // Copy the corrected message
+  res -= sizeof(header_t);
+  if ((size_t) res > len) return (EMSGSIZE);
+  memcpy(buf, frame + sizeof(header_t), res);
+  return (res);
+}
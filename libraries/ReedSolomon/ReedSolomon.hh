@@ -0,0 +1,340 @@
+/**
+ * @file ReedSolomon.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_REED_SOLOMON_HH
+#define COSA_REED_SOLOMON_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+
+#ifndef COSA_REED_SOLOMON_PARITY_MAX
+#define COSA_REED_SOLOMON_PARITY_MAX 16
+#endif
+
+#ifndef COSA_REED_SOLOMON_FRAME_MAX
+#define COSA_REED_SOLOMON_FRAME_MAX 64
+#endif
+
+/**
+ * Reed-Solomon forward error correction block codec over GF(2^8)
+ * (polynomial 0x11d). A message of at most 255 - parity bytes is
+ * encoded by appending the given number of parity bytes. The
+ * decoder corrects up to parity/2 erroneous bytes anywhere in the
+ * code word. A burst of bit errors is corrected if it is within
+ * parity/2 bytes; e.g. 8 parity bytes corrects bursts of up to 25
+ * bits. The Galois field tables (768 bytes) are in program memory.
+ *
+ * @section References
+ * 1. Reed-Solomon codes for coders,
+ * http://en.wikiversity.org/wiki/Reed%E2%80%93Solomon_codes_for_coders
+ */
+class ReedSolomon {
+public:
+  /** Max number of parity bytes. */
+  static const uint8_t PARITY_MAX = COSA_REED_SOLOMON_PARITY_MAX;
+  static_assert(PARITY_MAX >= 2 && PARITY_MAX <= 32,
+		"PARITY_MAX should be 2..32");
+
+  /** Max number of bytes in a code word (message and parity). */
+  static const uint8_t CODE_MAX = 255;
+
+  /**
+   * Construct Reed-Solomon codec with given number of parity bytes
+   * (2..PARITY_MAX, even). The generator polynomial is calculated.
+   * @param[in] parity number of parity bytes (default 8).
+   */
+  ReedSolomon(uint8_t parity = 8);
+
+  /**
+   * Return number of parity bytes.
+   * @return bytes.
+   */
+  uint8_t get_parity() const
+  {
+    return (m_parity);
+  }
+
+  /**
+   * Return number of corrected bytes in the latest decoded code word.
+   * @return bytes.
+   */
+  uint8_t get_corrected() const
+  {
+    return (m_corrected);
+  }
+
+  /**
+   * Encode message in given buffer with given length. Parity bytes
+   * are appended; the buffer should have room for the message and
+   * the parity. Returns the code word length or negative error code;
+   * EMSGSIZE if the code word would exceed CODE_MAX.
+   * @param[in,out] buf message buffer.
+   * @param[in] len number of bytes in message.
+   * @return code word length or negative error code.
+   */
+  int encode(uint8_t* buf, size_t len);
+
+  /**
+   * Decode code word in given buffer with given length. Erroneous
+   * bytes are corrected in place. Returns the message length or
+   * negative error code; EMSGSIZE if the code word length is
+   * illegal, EBADMSG if there are too many errors to correct.
+   * @param[in,out] buf code word buffer.
+   * @param[in] len number of bytes in code word.
+   * @return message length or negative error code.
+   */
+  int decode(uint8_t* buf, size_t len);
+
+  /**
+   * Return product of given Galois field elements.
+   * @param[in] x element.
+   * @param[in] y element.
+   * @return element.
+   */
+  static uint8_t mul(uint8_t x, uint8_t y);
+
+  /**
+   * Return quotient of given Galois field elements. The divisor
+   * must be non-zero.
+   * @param[in] x dividend element.
+   * @param[in] y divisor element.
+   * @return element.
+   */
+  static uint8_t div(uint8_t x, uint8_t y);
+
+  /**
+   * Return alpha (generator element) to the given power (0..254).
+   * @param[in] n power.
+   * @return element.
+   */
+  static uint8_t alpha(uint8_t n);
+
+  /**
+   * Wireless device driver with Reed-Solomon forward error correction
+   * of the payload and address. Messages are encoded with a copy of
+   * the frame header (network, destination, source and port) and
+   * sent with the parity bytes over the given wireless device
+   * driver. Received messages are corrected and messages with too
+   * many errors, or a corrected header with another address, are
+   * dropped (EBADMSG). The source and port are taken from the
+   * corrected header; errors in the device frame header are not
+   * passed on. The payload is reduced with the number of parity
+   * bytes and the header size. The error correction complements the
+   * device check sum; the device should pass corrupt frames (e.g.
+   * VWI::set_crc_check).
+   */
+  class Driver;
+
+protected:
+  /** Number of parity bytes. */
+  uint8_t m_parity;
+
+  /** Number of corrected bytes in latest decoded code word. */
+  uint8_t m_corrected;
+
+  /** Generator polynomial; highest degree first, monic. */
+  uint8_t m_generator[PARITY_MAX + 1];
+
+  /** Galois field exponent table; alpha^n, n = 0..509. */
+  static const uint8_t gf_exp[] PROGMEM;
+
+  /** Galois field logarithm table; log(x), x = 1..255. */
+  static const uint8_t gf_log[] PROGMEM;
+
+  /**
+   * Calculate syndromes of given code word and store in given
+   * vector. Returns true(1) if there are errors otherwise false(0).
+   * @param[in] buf code word buffer.
+   * @param[in] len number of bytes in code word.
+   * @param[out] syndrome vector (m_parity elements).
+   * @return bool.
+   */
+  bool syndromes(const uint8_t* buf, size_t len, uint8_t* syndrome);
+};
+
+class ReedSolomon::Driver : public Wireless::Driver {
+public:
+  /** Max frame size (message and parity). */
+  static const uint8_t FRAME_MAX = COSA_REED_SOLOMON_FRAME_MAX;
+
+  /**
+   * Construct Reed-Solomon forward error correction for given
+   * wireless device driver and number of parity bytes. The network
+   * and device address is taken from the device driver.
+   * @param[in] dev wireless device driver.
+   * @param[in] parity number of parity bytes (default 8).
+   */
+  Driver(Wireless::Driver* dev, uint8_t parity = 8);
+
+  /**
+   * Return number of corrected bytes.
+   * @return bytes.
+   */
+  uint16_t get_corrected() const
+  {
+    return (m_corrected);
+  }
+
+  /**
+   * Return number of dropped messages; too many errors to correct.
+   * @return count.
+   */
+  uint16_t get_drops() const
+  {
+    return (m_drops);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Start the device driver. Return true(1) if successful otherwise
+   * false(0).
+   * @param[in] config configuration vector (default NULL)
+   * @return bool.
+   */
+  virtual bool begin(const void* config = NULL)
+  {
+    return (m_dev->begin(config));
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Shutdown the device driver. Return true(1) if successful
+   * otherwise false(0).
+   * @return bool.
+   */
+  virtual bool end()
+  {
+    return (m_dev->end());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power up mode.
+   */
+  virtual void powerup()
+  {
+    m_dev->powerup();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set device in power down mode.
+   */
+  virtual void powerdown()
+  {
+    m_dev->powerdown();
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if a message is available otherwise false(0).
+   * @return bool.
+   */
+  virtual bool available()
+  {
+    return (m_dev->available());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Encode and send message in given null terminated io vector.
+   * Returns number of bytes sent or negative error code; EMSGSIZE if
+   * the header, message and parity exceeds FRAME_MAX.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * @override Wireless::Driver
+   * Encode and send message in given buffer, with given number of
+   * bytes. See send() with io vector above.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * @override Wireless::Driver
+   * Receive and correct message and store into given buffer with
+   * given maximum length. Returns the number of received bytes or
+   * negative error code; EBADMSG if the message could not be
+   * corrected or the corrected header address does not match.
+   * @param[out] src source network address.
+   * @param[out] port device port (or message type).
+   * @param[in] buf buffer to store incoming message.
+   * @param[in] len maximum number of bytes to receive.
+   * @param[in] ms maximum time out period (Default blocking(0L)).
+   * @return number of bytes received or negative error code.
+   */
+  virtual int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		   uint32_t ms = 0L);
+
+  /**
+   * @override Wireless::Driver
+   * Set output power level in dBm.
+   * @param[in] dBm.
+   */
+  virtual void set_output_power_level(int8_t dBm)
+  {
+    m_dev->set_output_power_level(dBm);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return estimated input power level (dBm).
+   */
+  virtual int get_input_power_level()
+  {
+    return (m_dev->get_input_power_level());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return link quality indicator.
+   */
+  virtual int get_link_quality_indicator()
+  {
+    return (m_dev->get_link_quality_indicator());
+  }
+
+protected:
+  /**
+   * Frame header; copy of the device frame header in the code word.
+   */
+  struct header_t {
+    int16_t network;		//!< Network address.
+    uint8_t dest;		//!< Destination device address.
+    uint8_t src;		//!< Source device address.
+    uint8_t port;		//!< Port or message type.
+  };
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  ReedSolomon m_codec;		//!< Reed-Solomon codec.
+  uint16_t m_corrected;		//!< Number of corrected bytes.
+  uint16_t m_drops;		//!< Number of dropped messages.
+};
+
+#endif
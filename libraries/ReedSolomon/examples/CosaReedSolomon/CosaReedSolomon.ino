@@ -0,0 +1,182 @@
+/**
+ * @file CosaReedSolomon.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa Reed-Solomon demo; compare frame success rate of Reed-Solomon
+ * and the Hamming codecs on a simulated channel with burst errors.
+ * The channel is a two state (Gilbert-Elliott) model; in the burst
+ * state bits are flipped with probability 1/2. Frames of PAYLOAD
+ * bytes are encoded, passed through the channel and decoded. A frame
+ * is successful if the decoded payload is equal to the sent payload.
+ *
+ * @section Circuit
+ * This example requires no special circuit. Uses serial output.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <ReedSolomon.h>
+#include <VWI.h>
+#include <HammingCodec_7_4.h>
+#include <HammingCodec_8_4.h>
+
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+
+// Frame payload size and number of frames per measurement
+#define PAYLOAD 30
+#define FRAMES 200
+
+// Burst start and end probability per bit (per mille)
+#define BURST_START 1
+#define BURST_END 100
+
+// Codecs
+ReedSolomon rs(8);
+HammingCodec_7_4 hamming_7_4;
+HammingCodec_8_4 hamming_8_4;
+
+// Channel state
+static bool burst = false;
+
+/**
+ * Pass given symbol with given number of bits through the channel.
+ * Return the received symbol.
+ * @param[in] symbol to send.
+ * @param[in] count number of bits.
+ * @return received symbol.
+ */
+static uint8_t
+channel(uint8_t symbol, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; i++) {
+    if (burst)
+      burst = ((rand() % 1000) >= BURST_END);
+    else
+      burst = ((rand() % 1000) < BURST_START);
+    if (burst && (rand() & 1)) symbol ^= _BV(i);
+  }
+  return (symbol);
+}
+
+/**
+ * Send frame with given payload uncoded. Return true(1) if received
+ * correctly otherwise false(0).
+ * @param[in] payload frame payload.
+ * @return bool.
+ */
+static bool
+uncoded(const uint8_t* payload)
+{
+  for (uint8_t i = 0; i < PAYLOAD; i++)
+    if (channel(payload[i], CHARBITS) != payload[i]) return (false);
+  return (true);
+}
+
+/**
+ * Send frame with given payload with given Hamming codec. Return
+ * true(1) if received correctly otherwise false(0).
+ * @param[in] codec symbol codec.
+ * @param[in] payload frame payload.
+ * @return bool.
+ */
+static bool
+hamming(VWI::Codec& codec, const uint8_t* payload)
+{
+  bool res = true;
+  for (uint8_t i = 0; i < PAYLOAD; i++) {
+    uint8_t data = payload[i];
+    uint8_t high = channel(codec.encode4(data >> 4), codec.BITS_PER_SYMBOL);
+    uint8_t low = channel(codec.encode4(data), codec.BITS_PER_SYMBOL);
+    if (((codec.decode4(high) << 4) | codec.decode4(low)) != data) res = false;
+  }
+  return (res);
+}
+
+/**
+ * Send frame with given payload with Reed-Solomon codec. Return
+ * true(1) if received correctly otherwise false(0).
+ * @param[in] payload frame payload.
+ * @return bool.
+ */
+static bool
+reed_solomon(const uint8_t* payload)
+{
+  uint8_t frame[PAYLOAD + ReedSolomon::PARITY_MAX];
+  memcpy(frame, payload, PAYLOAD);
+  int len = rs.encode(frame, PAYLOAD);
+  for (int i = 0; i < len; i++) frame[i] = channel(frame[i], CHARBITS);
+  if (rs.decode(frame, len) != PAYLOAD) return (false);
+  return (memcmp(frame, payload, PAYLOAD) == 0);
+}
+
+/**
+ * Print measurement result; frame success rate and bits per frame.
+ * @param[in] name codec name in program memory.
+ * @param[in] success number of successful frames.
+ * @param[in] bits number of bits per frame.
+ */
+static void
+report(str_P name, uint16_t success, uint16_t bits)
+{
+  trace << name
+	<< PSTR(": success=") << (success * 100L) / FRAMES
+	<< PSTR("%, bits=") << bits
+	<< endl;
+}
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaReedSolomon: started"));
+  Watchdog::begin();
+  RTC::begin();
+}
+
+void loop()
+{
+  uint16_t success[4] = { 0, 0, 0, 0 };
+  uint32_t start = RTC::millis();
+  for (uint16_t n = 0; n < FRAMES; n++) {
+    uint8_t payload[PAYLOAD];
+    for (uint8_t i = 0; i < PAYLOAD; i++) payload[i] = rand();
+    burst = false;
+    if (uncoded(payload)) success[0] += 1;
+    burst = false;
+    if (hamming(hamming_7_4, payload)) success[1] += 1;
+    burst = false;
+    if (hamming(hamming_8_4, payload)) success[2] += 1;
+    burst = false;
+    if (reed_solomon(payload)) success[3] += 1;
+  }
+  uint32_t ms = RTC::since(start);
+
+  // Print the frame success rates and number of bits per frame
+  trace << PSTR("frames=") << FRAMES
+	<< PSTR(", burst=") << BURST_START << '/' << BURST_END
+	<< PSTR(", ms=") << ms
+	<< endl;
+  report(PSTR("uncoded"), success[0], PAYLOAD * CHARBITS);
+  report(PSTR("Hamming(7,4)"), success[1], PAYLOAD * 2 * 7);
+  report(PSTR("Hamming(8,4)"), success[2], PAYLOAD * 2 * 8);
+  report(PSTR("Reed-Solomon(8)"), success[3],
+	 (PAYLOAD + rs.get_parity()) * CHARBITS);
+  trace << endl;
+  sleep(5);
+}
@@ -258,6 +258,9 @@ bool
 SNMP::VALUE::encode(SYNTAX syn)
 {
   if ((syn == SYNTAX_NULL)
+      || (syn == SYNTAX_NO_SUCH_OBJECT)
+      || (syn == SYNTAX_NO_SUCH_INSTANCE)
+      || (syn == SYNTAX_END_OF_MIB_VIEW)
       || (syn == SYNTAX_OPAQUE)) {
     length = 0;
     syntax = syn;
@@ -273,25 +276,42 @@ SNMP::read_byte(uint8_t& value)
 }
 
 bool
-SNMP::read_tag(uint8_t expect, uint8_t& length)
+SNMP::read_length(uint16_t& length)
 {
+  // Short form (0..127) or long form with one or two length bytes
   uint8_t buf[2];
-  if (read(buf, sizeof(buf)) != sizeof(buf)) return (false);
-  length = buf[1];
-  return (buf[0] == expect);
+  if (!read_byte(buf[0])) return (false);
+  if ((buf[0] & 0x80) == 0) {
+    length = buf[0];
+    return (true);
+  }
+  uint8_t count = buf[0] & 0x7f;
+  if ((count == 0) || (count > sizeof(buf))) return (false);
+  if (read(buf, count) != count) return (false);
+  length = (count == 1) ? buf[0] : ((buf[0] << 8) | buf[1]);
+  return (true);
+}
+
+bool
+SNMP::read_tag(uint8_t expect, uint16_t& length)
+{
+  uint8_t tag;
+  if (!read_byte(tag)) return (false);
+  if (!read_length(length)) return (false);
+  return (tag == expect);
 }
 
 bool
 SNMP::decode_null()
 {
-  uint8_t length;
+  uint16_t length;
   return (read_tag(SYNTAX_NULL, length) && (length == 0));
 }
 
 bool
 SNMP::decode_integer(int32_t& value)
 {
-  uint8_t length;
+  uint16_t length;
   value = 0L;
   if (!read_tag(SYNTAX_INT, length)) return (false);
   if (length > sizeof(value)) return (false);
@@ -304,7 +324,7 @@ SNMP::decode_integer(int32_t& value)
 bool
 SNMP::decode_string(char* buf, size_t count)
 {
-  uint8_t length;
+  uint16_t length;
   if (!read_tag(SYNTAX_OCTETS, length)) return (false);
   if (length > count - 1) return (false);
   if (read(buf, length) != length) return (false);
@@ -313,7 +333,7 @@ SNMP::decode_string(char* buf, size_t count)
 }
 
 bool
-SNMP::decode_sequence(uint8_t& length)
+SNMP::decode_sequence(uint16_t& length)
 {
   return (read_tag(SYNTAX_SEQUENCE, length));
 }
@@ -321,11 +341,30 @@ SNMP::decode_sequence(uint8_t& length)
 bool
 SNMP::decode_oid(OID& oid)
 {
-  if (!read_tag(SYNTAX_OID, oid.length)) return (false);
-  if (oid.length > OID::NAME_MAX) return (false);
+  uint16_t length;
+  if (!read_tag(SYNTAX_OID, length)) return (false);
+  if (length > OID::NAME_MAX) return (false);
+  oid.length = length;
   return (read(oid.name, oid.length) == oid.length);
 }
 
+bool
+SNMP::encode_tag(uint8_t tag, uint16_t length)
+{
+  uint8_t header[4];
+  uint8_t size = 0;
+  header[size++] = tag;
+  if (length >= 0x100) {
+    header[size++] = 0x82;
+    header[size++] = length >> 8;
+  }
+  else if (length >= 0x80) {
+    header[size++] = 0x81;
+  }
+  header[size++] = length;
+  return (write(header, size) == size);
+}
+
 bool
 SNMP::encode_null()
 {
@@ -352,10 +391,9 @@ SNMP::encode_string(const char* buf)
 }
 
 bool
-SNMP::encode_sequence(int32_t count)
+SNMP::encode_sequence(uint16_t length)
 {
-  uint8_t header[] = { SYNTAX_SEQUENCE, (uint8_t) count };
-  return (write(header, sizeof(header)) == sizeof(header));
+  return (encode_tag(SYNTAX_SEQUENCE, length));
 }
 
 bool
@@ -367,10 +405,9 @@ SNMP::encode_oid(OID& oid)
 }
 
 bool
-SNMP::encode_pdu(uint8_t type, uint8_t size)
+SNMP::encode_pdu(uint8_t type, uint16_t size)
 {
-  return ((write(&type, sizeof(type)) == sizeof(type))
-	  && (write(&size, sizeof(size)) == sizeof(size)));
+  return (encode_tag(type, size));
 }
 
 bool
@@ -403,22 +440,127 @@ int
 SNMP::request(PDU& pdu, uint32_t ms)
 {
   // Attempt to receive a request within given time limit
-  int res = recv(pdu, ms);
+  OID oid[VARBIND_MAX];
+  int res = recv(pdu, oid, ms);
   if (res < 0) return (res);
 
-  // Match with MIB handlers
-  if (!m_sys->is_request(pdu) && !m_mib->is_request(pdu))
-    pdu.error_status = NO_SUCH_NAME;
+  // Set request is handled once by the MIB handlers
+  if ((pdu.type == PDU_SET) && (pdu.error_status == NO_ERROR)) {
+    if (!lookup(pdu, PDU_SET)) pdu.error_status = NO_SUCH_NAME;
+    if (pdu.error_status != NO_ERROR) pdu.error_index = 1;
+  }
+
+  // Send the response values
+  return (send(pdu, oid, res));
+}
+
+bool
+SNMP::lookup(PDU& pdu, uint8_t type)
+{
+  pdu.type = type;
+  return (m_sys->is_request(pdu) || m_mib->is_request(pdu));
+}
+
+int
+SNMP::encode_varbind(PDU& pdu, bool encode)
+{
+  uint16_t size = sizeof_tlv(pdu.oid.length) + sizeof_tlv(pdu.value.length);
+  if (encode) {
+    if (!encode_sequence(size)) return (EIO);
+    if (!encode_oid(pdu.oid)) return (EIO);
+    if (!encode_value(pdu.value)) return (EIO);
+  }
+  return (sizeof_tlv(size));
+}
 
-  // Send the response value
-  return (send(pdu));
+int
+SNMP::get_next(PDU& pdu, OID& oid, bool encode)
+{
+  pdu.oid = oid;
+  pdu.value.encode(SYNTAX_NULL);
+  if (lookup(pdu, PDU_GET_NEXT) && (pdu.error_status == NO_ERROR)) {
+    oid = pdu.oid;
+  }
+  else {
+    pdu.error_status = NO_ERROR;
+    pdu.oid = oid;
+    pdu.value.encode(SYNTAX_END_OF_MIB_VIEW);
+  }
+  return (encode_varbind(pdu, encode));
 }
 
 int
-SNMP::recv(PDU& pdu, uint32_t ms)
+SNMP::process(PDU& pdu, OID* oid, uint8_t count, uint8_t type, bool encode)
 {
-  uint8_t length;
+  uint16_t length = 0;
+  bool echo = (pdu.error_status != NO_ERROR);
+  int res;
+
+  for (uint8_t i = 0; i < count; i++) {
+    pdu.oid = oid[i];
+    pdu.value.encode(SYNTAX_NULL);
+
+    // Lookup value; stop on the first failed variable binding
+    if (!echo
+	&& (!lookup(pdu, type) || (pdu.error_status != NO_ERROR))) {
+      if (pdu.error_status == NO_ERROR) pdu.error_status = NO_SUCH_NAME;
+      pdu.error_index = i + 1;
+      return (EINVAL);
+    }
+    res = encode_varbind(pdu, encode);
+    if (res < 0) return (res);
+    length += res;
+  }
+  return (length);
+}
+
+int
+SNMP::process_bulk(PDU& pdu, OID* oid, uint8_t count,
+		   uint8_t non_repeaters, uint16_t& repetitions,
+		   uint16_t max, bool encode)
+{
+  OID next[VARBIND_MAX];
+  uint16_t length = 0;
+  uint16_t rows = 0;
+  int res;
+
+  // Non-repeaters; single get next value
+  if (non_repeaters > count) non_repeaters = count;
+  for (uint8_t i = 0; i < non_repeaters; i++) {
+    next[i] = oid[i];
+    res = get_next(pdu, next[i], encode);
+    if (res < 0) return (res);
+    length += res;
+  }
+
+  // Repeaters; rows of get next values until max-repetitions, end of
+  // mib view for all repeaters, or the row does not fit
+  for (uint8_t i = non_repeaters; i < count; i++) next[i] = oid[i];
+  while ((rows < repetitions) && (non_repeaters < count)) {
+    uint16_t size = 0;
+    bool more = false;
+    for (uint8_t i = non_repeaters; i < count; i++) {
+      res = get_next(pdu, next[i], encode);
+      if (res < 0) return (res);
+      size += res;
+      if (pdu.value.syntax != SYNTAX_END_OF_MIB_VIEW) more = true;
+    }
+    if (!encode && (length + size > max)) break;
+    length += size;
+    rows += 1;
+    if (!more) break;
+  }
+  repetitions = rows;
+  return (length);
+}
+
+int
+SNMP::recv(PDU& pdu, OID* oid, uint32_t ms)
+{
+  uint16_t length;
+  uint16_t size;
   uint32_t start;
+  uint8_t count = 0;
   uint8_t tag;
   int res;
   int err = -1;
@@ -432,28 +574,61 @@ SNMP::recv(PDU& pdu, uint32_t ms)
 
   // Decode the packet and extract elements
   if (tag != SYNTAX_SEQUENCE) goto error;
-  if (!read_byte(length)) goto error;
+  if (!read_length(length)) goto error;
   if (!decode_integer(pdu.version)) goto error;
   if (!decode_string(pdu.community, PDU::COMMUNITY_MAX)) goto error;
   if (!read_byte(pdu.type)) goto error;
-  if (!read_byte(length)) goto error;
+  if (!read_length(length)) goto error;
   if (!decode_integer(pdu.request_id)) goto error;
   if (!decode_integer(pdu.error_status)) goto error;
   if (!decode_integer(pdu.error_index)) goto error;
   if (!decode_sequence(length)) goto error;
-  if (!decode_sequence(length)) goto error;
-  if (!decode_oid(pdu.oid)) goto error;
 
-  // Check for value to be set (otherwise null)
-  if (pdu.type == SNMP::PDU_SET) {
-    length = length - (sizeof(pdu.oid.length) + pdu.oid.length + 1);
-    if (length > sizeof(pdu.value)) goto error;
-    if (read(&pdu.value, length) != length) goto error;
+  // Decode the variable bindings; object identity and value
+  pdu.overflow = false;
+  while (length > 0) {
+    if (count == VARBIND_MAX) {
+      pdu.overflow = true;
+      if (pdu.type != SNMP::PDU_GET_BULK) {
+	pdu.error_status = TOO_BIG;
+	pdu.error_index = 0;
+      }
+      break;
+    }
+    if (!decode_sequence(size)) goto error;
+    if (sizeof_tlv(size) > length) goto error;
+    length -= sizeof_tlv(size);
+    if (!decode_oid(oid[count])) goto error;
+    if (sizeof_tlv(oid[count].length) > size) goto error;
+    size -= sizeof_tlv(oid[count].length);
+
+    // Check for value to be set (otherwise null and skipped)
+    if ((pdu.type == SNMP::PDU_SET) && (count == 0)) {
+      if (size > sizeof(pdu.value)) goto error;
+      if (read(&pdu.value, size) != size) goto error;
+    }
+    else {
+      while (size > 0) {
+	uint8_t buf[16];
+	uint8_t n = (size < sizeof(buf) ? size : sizeof(buf));
+	if (read(buf, n) != n) goto error;
+	size -= n;
+      }
+    }
+    count += 1;
   }
-  else {
-    pdu.value.encode(SYNTAX_NULL);
+  if (count == 0) goto error;
+
+  // Only a single variable binding may be set; reject the request
+  if ((pdu.type == SNMP::PDU_SET)
+      && (count > 1)
+      && (pdu.error_status == NO_ERROR)) {
+    pdu.error_status = GEN_ERR;
+    pdu.error_index = 2;
   }
-  err = 0;
+  pdu.oid = oid[0];
+  if (pdu.type != SNMP::PDU_SET) pdu.value.encode(SYNTAX_NULL);
+  err = count;
 
   // Flush any remaining data (could be a sequence of OID:VALUE, ignored)
  error:
@@ -463,41 +638,83 @@ SNMP::recv(PDU& pdu, uint32_t ms)
 }
 
 int
-SNMP::send(PDU& pdu)
+SNMP::send(PDU& pdu, OID* oid, uint8_t count)
 {
-  uint8_t packet_size;
-  uint8_t pdu_size;
-  int32_t varbind_list_size;
-  int32_t varbind_size;
+  uint8_t type = pdu.type;
+  uint8_t non_repeaters = 0;
+  uint16_t repetitions = 0;
+  uint16_t community_size;
+  uint16_t varbind_list_size;
+  uint16_t pdu_size;
+  uint16_t packet_size;
+  uint16_t max;
+  int res;
 
-  // Set default values
-  pdu.type = SNMP::PDU_RESPONSE;
-  if (pdu.value.length == 0 || pdu.error_status != NO_ERROR) {
-    pdu.value.encode(SYNTAX_NULL);
+  // Max size of variable binding list; message size less header with
+  // max length fields
+  community_size = sizeof_tlv(strlen(pdu.community));
+  max = MESSAGE_MAX
+    - (4 + sizeof_tlv(sizeof(int32_t)) + community_size
+       + 4 + (3*sizeof_tlv(sizeof(int32_t))) + 4);
+
+  // Calculate size of variable binding list
+  if ((type == SNMP::PDU_GET_BULK) && pdu.overflow) {
+    pdu.error_status = TOO_BIG;
+    pdu.error_index = 0;
+    count = 0;
+    res = 0;
+  }
+  else if (type == SNMP::PDU_GET_BULK) {
+    if (pdu.error_status > 0)
+      non_repeaters = (pdu.error_status < count ? pdu.error_status : count);
+    if (pdu.error_index > 0)
+      repetitions = (pdu.error_index < 0xffff ? pdu.error_index : 0xffff);
+    pdu.error_status = NO_ERROR;
+    pdu.error_index = 0;
+    res = process_bulk(pdu, oid, count, non_repeaters, repetitions, max, false);
   }
+  else if ((type == SNMP::PDU_SET) && (pdu.error_status == NO_ERROR)) {
+    res = encode_varbind(pdu, false);
+  }
+  else {
+    res = process(pdu, oid, count, type, false);
+    if ((res < 0) && (pdu.error_status != NO_ERROR))
+      res = process(pdu, oid, count, type, false);
+    if (res > (int) max) {
+      pdu.error_status = TOO_BIG;
+      pdu.error_index = 0;
+      count = 0;
+      res = 0;
+    }
+  }
+  if (res < 0) return (res);
 
   // Calculate size of packet sections
-  varbind_size = (pdu.value.length + 2) + (pdu.oid.length + 2);
-  varbind_list_size = (varbind_size + 2);
-  pdu_size = ((varbind_list_size) + 2) + (3*(sizeof(int32_t) + 2));
-  packet_size = (pdu_size + 2) + (strlen(pdu.community) + 2) + (sizeof(int32_t) + 2);
+  varbind_list_size = res;
+  pdu_size = (3*sizeof_tlv(sizeof(int32_t))) + sizeof_tlv(varbind_list_size);
+  packet_size = sizeof_tlv(sizeof(int32_t)) + community_size + sizeof_tlv(pdu_size);
 
   // Create the datagram with all encoded elements
   if (m_sock->datagram(pdu.dest, pdu.port) < 0) goto error;
   if (!encode_sequence(packet_size)) goto error;
   if (!encode_integer(pdu.version)) goto error;
   if (!encode_string(pdu.community)) goto error;
-  if (!encode_pdu(pdu.type, pdu_size)) goto error;
+  if (!encode_pdu(SNMP::PDU_RESPONSE, pdu_size)) goto error;
   if (!encode_integer(pdu.request_id)) goto error;
   if (!encode_integer(pdu.error_status)) goto error;
   if (!encode_integer(pdu.error_index)) goto error;
   if (!encode_sequence(varbind_list_size)) goto error;
-  if (!encode_sequence(varbind_size)) goto error;
-  if (!encode_oid(pdu.oid)) goto error;
-  if (!encode_value(pdu.value)) goto error;
+
+  // Encode the variable bindings directly into the datagram
+  if (type == SNMP::PDU_GET_BULK)
+    process_bulk(pdu, oid, count, non_repeaters, repetitions, max, true);
+  else if ((type == SNMP::PDU_SET) && (pdu.error_status == NO_ERROR))
+    encode_varbind(pdu, true);
+  else
+    process(pdu, oid, count, type, true);
 
  error:
   // Send the datagram
+  pdu.type = SNMP::PDU_RESPONSE;
   return (m_sock->flush());
 }
-
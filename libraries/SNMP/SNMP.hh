@@ -25,6 +25,25 @@
 #include "Cosa/Socket.hh"
 #include "Cosa/IOStream.hh"
 
+#ifndef COSA_SNMP_VARBIND_MAX
+#define COSA_SNMP_VARBIND_MAX 4
+#endif
+
+#ifndef COSA_SNMP_MESSAGE_MAX
+#define COSA_SNMP_MESSAGE_MAX 484
+#endif
+
+/**
+ * SNMP V1/V2c Agent. Handles GET, GET_NEXT, GET_BULK and SET
+ * requests. GET, GET_NEXT and GET_BULK requests may contain several
+ * variable bindings (max COSA_SNMP_VARBIND_MAX); the response values
+ * are packed into a single response message (max
+ * COSA_SNMP_MESSAGE_MAX). The response is encoded directly into the
+ * socket transmit buffer. The MIB handlers are called twice per
+ * variable binding; first to calculate the message size and then
+ * to encode the message. The value size must not change between
+ * the calls. SET requests are limited to a single variable binding.
+ */
 class SNMP {
 public:
   /** ASN.1 Basic Encoding Rules (BER) Tags. */
@@ -43,7 +62,8 @@ public:
     PDU_GET_NEXT = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 1,
     PDU_RESPONSE = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 2,
     PDU_SET = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 3,
-    PDU_TRAP = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 4
+    PDU_TRAP = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 4,
+    PDU_GET_BULK = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_CONSTRUCTOR | 5
   } __attribute__((packed));
 
   /** SNMP Trap Tags. */
@@ -75,6 +95,9 @@ public:
     SYNTAX_NSAPADDR = ASN_BER_BASE_APPLICATION | ASN_BER_BASE_PRIMITIVE | 5,
     SYNTAX_COUNTER64 = ASN_BER_BASE_APPLICATION | ASN_BER_BASE_PRIMITIVE | 6,
     SYNTAX_UINT32 = ASN_BER_BASE_APPLICATION | ASN_BER_BASE_PRIMITIVE | 7,
+    SYNTAX_NO_SUCH_OBJECT = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_PRIMITIVE | 0,
+    SYNTAX_NO_SUCH_INSTANCE = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_PRIMITIVE | 1,
+    SYNTAX_END_OF_MIB_VIEW = ASN_BER_BASE_CONTEXT | ASN_BER_BASE_PRIMITIVE | 2
   } __attribute__((packed));
 
   /** Error codes (PDU::error_status). */
@@ -118,7 +141,12 @@ public:
     bool encode(SYNTAX syn);
   };
 
-  /** SNMP Protocol Data Unit (PDU). */
+  /**
+   * SNMP Protocol Data Unit (PDU). For PDU_GET_BULK requests the
+   * error status and index fields hold the non-repeaters and
+   * max-repetitions parameters. The overflow flag is set when the
+   * request contains more than VARBIND_MAX variable bindings.
+   */
   struct PDU {
     static const uint8_t COMMUNITY_MAX = 16;
     uint8_t dest[INET::IP_MAX];
@@ -129,6 +157,7 @@ public:
     int32_t request_id;
     int32_t error_status;
     int32_t error_index;
+    bool overflow;
     OID oid;
     VALUE value;
   };
@@ -224,6 +253,12 @@ public:
   /** The SNMP Agent standard port. */
   static const uint16_t PORT = 161;
 
+  /** Max number of variable bindings in request. */
+  static const uint8_t VARBIND_MAX = COSA_SNMP_VARBIND_MAX;
+
+  /** Max size of response message. */
+  static const uint16_t MESSAGE_MAX = COSA_SNMP_MESSAGE_MAX;
+
   /**
    * Start SNMP agent with the given socket (UDP::PORT). Returns true
    * if successful otherwise false.
@@ -253,39 +288,142 @@ public:
 protected:
   /**
    * Receive SNMP protocol data unit (PDU) request within given time
-   * limit in milli-seconds. Returns zero and data in given PDU
-   * otherwise a negative error code.
+   * limit in milli-seconds. Returns number of variable bindings, the
+   * object identities in given array and data in given PDU,
+   * otherwise a negative error code. The PDU overflow flag is set if
+   * the request contains more than VARBIND_MAX variable bindings and
+   * the error status is set to TOO_BIG (not for GET_BULK requests as
+   * the field holds the non-repeaters parameter). A PDU_SET request
+   * with more than one variable binding is rejected with error status
+   * GEN_ERR (index 2); only the first value is decoded.
    * @param[in,out] pdu protocol unit.
+   * @param[out] oid object identity array (VARBIND_MAX).
    * @param[in] ms time-out period in milli-seconds (Default BLOCK).
-   * @return zero if successful otherwise a negative error code.
+   * @return number of variable bindings or negative error code.
    */
-  int recv(PDU& pdu, uint32_t ms = 0L);
+  int recv(PDU& pdu, OID* oid, uint32_t ms = 0L);
 
   /**
-   * Send SNMP protocol data unit (PDU) response. Application should
-   * fill in error status and index, and value for PDU_GET on matching
-   * OID. For PDU_SET the OID should be matched and the application
-   * should set error status if READ_ONLY.
+   * Send SNMP protocol data unit (PDU) response with variable
+   * bindings for the given request object identities. The MIB
+   * handlers are called to size and then encode the variable
+   * bindings. For PDU_SET the single variable binding in the PDU is
+   * returned. On error the request variable bindings are echoed with
+   * null values.
    * @param[in] pdu protocol unit.
+   * @param[in] oid request object identity array.
+   * @param[in] count number of request object identities.
    * @return zero if successful otherwise a negative error code.
    */
-  int send(PDU& pdu);
+  int send(PDU& pdu, OID* oid, uint8_t count);
+
+  /**
+   * Process the variable bindings of a GET or GET_NEXT request with
+   * given object identities and request type. Encode the response
+   * variable bindings if the encode flag is set, otherwise only
+   * calculate size. If the PDU error status is set the request
+   * object identities are returned with null values. Returns size of
+   * variable binding list, or negative error code and error status
+   * and index in PDU.
+   * @param[in,out] pdu protocol unit.
+   * @param[in] oid request object identity array.
+   * @param[in] count number of request object identities.
+   * @param[in] type request type.
+   * @param[in] encode flag.
+   * @return size of variable binding list or negative error code.
+   */
+  int process(PDU& pdu, OID* oid, uint8_t count, uint8_t type, bool encode);
+
+  /**
+   * Process the variable bindings of a GET_BULK request with given
+   * object identities, non-repeaters and max-repetitions. Encode the
+   * response variable bindings if the encode flag is set, otherwise
+   * only calculate size and limit the number of repetitions to the
+   * given max size. The number of repetitions is returned. Returns
+   * size of variable binding list or negative error code.
+   * @param[in,out] pdu protocol unit.
+   * @param[in] oid request object identity array.
+   * @param[in] count number of request object identities.
+   * @param[in] non_repeaters number of non-repeaters.
+   * @param[in,out] repetitions max-repetitions.
+   * @param[in] max max size of variable binding list.
+   * @param[in] encode flag.
+   * @return size of variable binding list or negative error code.
+   */
+  int process_bulk(PDU& pdu, OID* oid, uint8_t count,
+		   uint8_t non_repeaters, uint16_t& repetitions,
+		   uint16_t max, bool encode);
+
+  /**
+   * Lookup next object identity and value after the given object
+   * identity. The value is SYNTAX_END_OF_MIB_VIEW if there is no
+   * next object identity. The given object identity is updated.
+   * Returns size of variable binding or negative error code. The
+   * variable binding is encoded if the encode flag is set.
+   * @param[in,out] pdu protocol unit.
+   * @param[in,out] oid object identity.
+   * @param[in] encode flag.
+   * @return size or negative error code.
+   */
+  int get_next(PDU& pdu, OID& oid, bool encode);
+
+  /**
+   * Lookup object identity and value in PDU with MIB handlers for
+   * given request type. Returns true if found otherwise false.
+   * @param[in,out] pdu protocol unit.
+   * @param[in] type request type.
+   * @return bool
+   */
+  bool lookup(PDU& pdu, uint8_t type);
+
+  /**
+   * Return size of variable binding with object identity and value
+   * in given PDU. Encode the variable binding if the encode flag is
+   * set. Returns size or negative error code.
+   * @param[in] pdu protocol unit.
+   * @param[in] encode flag.
+   * @return size or negative error code.
+   */
+  int encode_varbind(PDU& pdu, bool encode);
+
+  /**
+   * Return number of bytes to encode given length in BER.
+   * @param[in] length.
+   * @return number of bytes.
+   */
+  static uint8_t sizeof_length(uint16_t length)
+  {
+    return (length < 0x80 ? 1 : (length < 0x100 ? 2 : 3));
+  }
+
+  /**
+   * Return number of bytes to encode tag, length and value with
+   * given length in BER.
+   * @param[in] length.
+   * @return number of bytes.
+   */
+  static uint16_t sizeof_tlv(uint16_t length)
+  {
+    return (1 + sizeof_length(length) + length);
+  }
 
   bool read_byte(uint8_t& value);
-  bool read_tag(uint8_t expect, uint8_t& length);
+  bool read_length(uint16_t& length);
+  bool read_tag(uint8_t expect, uint16_t& length);
 
   bool decode_null();
   bool decode_integer(int32_t& res);
   bool decode_string(char* buf, size_t count);
-  bool decode_sequence(uint8_t& length);
+  bool decode_sequence(uint16_t& length);
   bool decode_oid(OID& oid);
 
+  bool encode_tag(uint8_t tag, uint16_t length);
   bool encode_null();
   bool encode_integer(int32_t res);
   bool encode_string(const char* buf);
-  bool encode_sequence(int32_t count);
+  bool encode_sequence(uint16_t length);
   bool encode_oid(OID& oid);
-  bool encode_pdu(uint8_t type, uint8_t size);
+  bool encode_pdu(uint8_t type, uint16_t size);
   bool encode_value(VALUE& value);
 
   int available()
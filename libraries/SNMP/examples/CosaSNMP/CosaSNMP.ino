@@ -17,7 +17,8 @@
  *
  * @section Description
  * W5100 Ethernet Controller device driver example code; SNMP agent
- * with support for GET/GETNEXT/SET for MIB-2 SYSTEM and Arduino MIB.
+ * with support for GET/GETNEXT/GETBULK/SET for MIB-2 SYSTEM and
+ * Arduino MIB.
  *
  * @section Circuit
  * This sketch is designed for the Ethernet Shield.
@@ -40,6 +41,10 @@
  *   snmpget -v1 -c public {W5100_IP} 1.3.6.1.4.1.36582.1.0
  * 3. Walk all available OID tree
  *   snmpwalk -v1 -c public {W5100_IP} 1
+ * 4. Access several values in a single request
+ *   snmpget -v1 -c public {W5100_IP} 1.3.6.1.2.1.1.1.0 1.3.6.1.2.1.1.3.0
+ * 5. Walk all available OID tree with bulk requests
+ *   snmpbulkwalk -v2c -c public -Cr10 {W5100_IP} 1
  *
  * This file is part of the Arduino Che Cosa project.
  */
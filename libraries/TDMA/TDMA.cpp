@@ -0,0 +1,317 @@
+/**
+ * @file TDMA.cpp
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include "TDMA.hh"
+#include "Cosa/RTC.hh"
+
+TDMA::TDMA(Wireless::Driver* dev, uint8_t coordinator) :
+  Wireless::Driver(dev->get_network_address(), dev->get_device_address()),
+  m_dev(dev),
+  m_coordinator(coordinator),
+  m_slot(0),
+  m_powered(false),
+  m_powerup(0L),
+  m_radio_on(0L),
+  m_missed(0),
+  m_frame(0),
+  m_start(0L),
+  m_synced(false),
+  m_local(0L),
+  m_remote(0L),
+  m_drift(0L)
+{
+  memset(m_owner, 0, sizeof(m_owner));
+  memset(m_heard, 0, sizeof(m_heard));
+}
+
+bool
+TDMA::begin(const void* config)
+{
+  if (!m_dev->begin(config)) return (false);
+  m_powered = true;
+  m_powerup = RTC::millis();
+  if (is_coordinator()) {
+    m_owner[0] = m_addr.device;
+    m_start = RTC::millis() - FRAME_MS;
+    beacon();
+  }
+  else radio_off();
+  return (true);
+}
+
+int
+TDMA::send(uint8_t dest, uint8_t port, const iovec_t* vec)
+{
+  // The coordinator sends directly
+  if (is_coordinator()) {
+    radio_on();
+    return (m_dev->send(dest, port, vec));
+  }
+
+  // Synchronize with the beacon and join if the slot is not assigned
+  // to this device. The slot may be used from the next frame
+  int res = ETIME;
+  for (uint8_t retry = 0; retry < RETRY_MAX; retry++) {
+    beacon_t beacon;
+    if (!sync(beacon)) {
+      res = ETIME;
+      continue;
+    }
+    if ((m_slot == 0) || (beacon.owner[m_slot] != m_addr.device)) {
+      m_slot = 0;
+      res = ENXIO;
+      join(m_remote);
+      continue;
+    }
+
+    // Power down until just before the slot and transmit
+    uint32_t start = local(m_remote + m_slot * SLOT_MS);
+    radio_off();
+    sleep_until(start - GUARD_MS);
+    radio_on();
+    sleep_until(start);
+    res = m_dev->send(dest, port, vec);
+    break;
+  }
+  radio_off();
+  return (res);
+}
+
+int
+TDMA::send(uint8_t dest, uint8_t port, const void* buf, size_t len)
+{
+  iovec_t vec[2];
+  iovec_t* vp = vec;
+  iovec_arg(vp, buf, len);
+  iovec_end(vp);
+  return (send(dest, port, vec));
+}
+
+int
+TDMA::recv(uint8_t& src, uint8_t& port, void* buf, size_t len, uint32_t ms)
+{
+  // Nodes listen continuously
+  if (!is_coordinator()) {
+    radio_on();
+    return (m_dev->recv(src, port, buf, len, ms));
+  }
+
+  uint32_t start = RTC::millis();
+  while (1) {
+    // Send beacon on frame start and check timeout
+    beacon();
+    uint32_t now = RTC::millis();
+    if ((ms != 0) && (now - start >= ms)) return (ETIME);
+
+    // Calculate current slot and end of slot or timeout
+    uint8_t slot = (now - m_start) / SLOT_MS;
+    uint32_t end = m_start + (slot + 1) * SLOT_MS;
+    if ((ms != 0) && ((int32_t) (end - (start + ms)) > 0)) end = start + ms;
+
+    // Power down in the beacon slot and free slots; wake up just
+    // before the next slot
+    if ((slot == 0) || ((slot != JOIN_SLOT) && (m_owner[slot] == 0))) {
+      if ((int32_t) (end - GUARD_MS - now) > 0) {
+	radio_off();
+	sleep_until(end - GUARD_MS);
+	continue;
+      }
+    }
+
+    // Listen until end of slot. Handle join requests
+    radio_on();
+    uint32_t timeout = end - now;
+    if (timeout == 0) timeout = 1;
+    int res = m_dev->recv(src, port, buf, len, timeout);
+    if (res == ETIME) continue;
+    if (res < 0) return (res);
+    if (port == JOIN_PORT) {
+      assign(src);
+      continue;
+    }
+
+    // Refresh the slot owner
+    for (uint8_t i = 1; i < JOIN_SLOT; i++) {
+      if (m_owner[i] != src) continue;
+      m_heard[i] = m_frame;
+      break;
+    }
+    return (res);
+  }
+}
+
+void
+TDMA::radio_on()
+{
+  if (m_powered) return;
+  m_dev->powerup();
+  m_powered = true;
+  m_powerup = RTC::millis();
+}
+
+void
+TDMA::radio_off()
+{
+  if (!m_powered) return;
+  m_dev->powerdown();
+  m_powered = false;
+  m_radio_on += RTC::since(m_powerup);
+}
+
+void
+TDMA::sleep_until(uint32_t ms)
+{
+  int32_t delta = ms - RTC::millis();
+  if (delta > 0) delay(delta);
+}
+
+uint32_t
+TDMA::local(uint32_t remote)
+{
+  int32_t delta = remote - m_remote;
+  return (m_local + delta + (((delta >> 4) * m_drift) >> 12));
+}
+
+bool
+TDMA::sync(beacon_t& beacon)
+{
+  // Wake up just before the next expected beacon. Widen the receive
+  // window with the time since the latest beacon (1 ms per second).
+  // Listen for two frames if not synchronized
+  uint32_t timeout = 2 * FRAME_MS;
+  if (m_synced) {
+    uint32_t elapsed = RTC::millis() + GUARD_MS - m_local;
+    uint32_t remote = m_remote + (elapsed / FRAME_MS + 1) * FRAME_MS;
+    uint32_t margin = GUARD_MS + ((remote - m_remote) >> 10);
+    uint32_t expected = local(remote);
+    radio_off();
+    sleep_until(expected - margin);
+    timeout = 2 * margin;
+  }
+  radio_on();
+
+  // Wait for beacon from the coordinator
+  uint32_t start = RTC::millis();
+  uint32_t elapsed;
+  while ((elapsed = RTC::since(start)) < timeout) {
+    uint8_t src;
+    uint8_t port;
+    int res = m_dev->recv(src, port, &beacon, sizeof(beacon), timeout - elapsed);
+    if ((res != sizeof(beacon))
+	|| (port != BEACON_PORT)
+	|| (src != m_coordinator))
+      continue;
+
+    // Estimate clock drift from the interval since the latest beacon
+    // and smooth (Q16, 1/4 weight)
+    uint32_t now = RTC::millis();
+    int32_t remote = beacon.timestamp - m_remote;
+    if (m_synced && (remote >= FRAME_MS)) {
+      int32_t diff = (int32_t) (now - m_local) - remote;
+      if ((diff > -1024) && (diff < 1024)) {
+	int32_t drift = (diff << 16) / remote;
+	m_drift += (drift - m_drift) >> 2;
+      }
+    }
+    m_local = now;
+    m_remote = beacon.timestamp;
+    m_synced = true;
+    return (true);
+  }
+
+  // Missed the beacon; listen continuously next time
+  m_missed += 1;
+  m_synced = false;
+  return (false);
+}
+
+bool
+TDMA::join(uint32_t frame)
+{
+  // Send join request in the contention slot with random backoff
+  uint32_t start = local(frame + JOIN_SLOT * SLOT_MS);
+  radio_off();
+  sleep_until(start - GUARD_MS);
+  radio_on();
+  sleep_until(start + (RTC::micros() % (SLOT_MS / 2)));
+  uint8_t slot = 0;
+  m_dev->send(m_coordinator, JOIN_PORT, &slot, sizeof(slot));
+
+  // Wait for the slot assignment until the end of the slot
+  uint32_t end = start + SLOT_MS;
+  int32_t timeout;
+  while ((timeout = end - RTC::millis()) > 0) {
+    uint8_t src;
+    uint8_t port;
+    int res = m_dev->recv(src, port, &slot, sizeof(slot), timeout);
+    if ((res != sizeof(slot))
+	|| (port != JOIN_PORT)
+	|| (src != m_coordinator)
+	|| (slot == 0)
+	|| (slot >= JOIN_SLOT))
+      continue;
+    m_slot = slot;
+    break;
+  }
+  radio_off();
+  return (m_slot != 0);
+}
+
+void
+TDMA::beacon()
+{
+  // Check for start of a new frame. Restart if behind
+  uint32_t now = RTC::millis();
+  if (now - m_start < FRAME_MS) return;
+  m_start += FRAME_MS;
+  if (now - m_start >= FRAME_MS) m_start = now;
+  m_frame += 1;
+
+  // Broadcast coordinator clock and slot owners
+  beacon_t beacon;
+  beacon.timestamp = m_start;
+  memcpy(beacon.owner, m_owner, sizeof(m_owner));
+  radio_on();
+  m_dev->broadcast(BEACON_PORT, &beacon, sizeof(beacon));
+}
+
+void
+TDMA::assign(uint8_t src)
+{
+  // Reuse current assignment, allocate free slot or replace the least
+  // recently heard node
+  uint8_t slot = 0;
+  for (uint8_t i = 1; (i < JOIN_SLOT) && (slot == 0); i++)
+    if (m_owner[i] == src) slot = i;
+  for (uint8_t i = 1; (i < JOIN_SLOT) && (slot == 0); i++)
+    if (m_owner[i] == 0) slot = i;
+  if (slot == 0) {
+    uint16_t oldest = 0;
+    for (uint8_t i = 1; i < JOIN_SLOT; i++) {
+      uint16_t age = m_frame - m_heard[i];
+      if (age < oldest) continue;
+      oldest = age;
+      slot = i;
+    }
+  }
+  m_owner[slot] = src;
+  m_heard[slot] = m_frame;
+  m_dev->send(src, JOIN_PORT, &slot, sizeof(slot));
+}
@@ -0,0 +1,331 @@
+/**
+ * @file TDMA.hh
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#ifndef COSA_TDMA_HH
+#define COSA_TDMA_HH
+
+#include "Cosa/Types.h"
+#include "Cosa/Wireless.hh"
+
+#ifndef COSA_TDMA_SLOT_MAX
+#define COSA_TDMA_SLOT_MAX 16
+#endif
+
+#ifndef COSA_TDMA_SLOT_MS
+#define COSA_TDMA_SLOT_MS 20
+#endif
+
+/**
+ * Time-slotted medium access (TDMA) for battery powered nodes over a
+ * Wireless device driver. The coordinator (gateway) broadcasts a
+ * beacon at the start of each frame. A frame is divided into
+ * SLOT_MAX slots; slot zero is the beacon slot, the last slot is the
+ * contention slot for join requests, and the other slots are
+ * assigned to nodes. The beacon contains the coordinator clock and
+ * the slot owner table.
+ *
+ * A node joins in the contention slot and is assigned a slot. When
+ * sending, the node powers up the radio just before the expected
+ * beacon, synchronizes, powers down, and powers up again just before
+ * its slot to transmit. Between beacons the node predicts the
+ * coordinator clock from the beacon timestamps; the clock drift is
+ * estimated from consecutive beacons. If the beacon is missed the
+ * node listens until a beacon is received. If the beacon table shows
+ * that the slot has been reassigned the node joins again.
+ *
+ * The coordinator only listens in assigned slots and the contention
+ * slot; the radio is powered down in free slots. When all slots are
+ * assigned, the least recently heard node is replaced.
+ *
+ * @section Limitations
+ * Node to coordinator traffic is scheduled. Coordinator to node
+ * messages are sent directly and only received by a node listening
+ * in recv(). Max one message per node and frame.
+ */
+class TDMA : public Wireless::Driver {
+public:
+  /** Number of slots per frame. */
+  static const uint8_t SLOT_MAX = COSA_TDMA_SLOT_MAX;
+  static_assert(SLOT_MAX >= 3 && SLOT_MAX <= 24,
+		"SLOT_MAX should be 3..24");
+
+  /** Slot length (milli-seconds). */
+  static const uint16_t SLOT_MS = COSA_TDMA_SLOT_MS;
+
+  /** Frame length (milli-seconds). */
+  static const uint16_t FRAME_MS = SLOT_MAX * SLOT_MS;
+
+  /** Guard time; radio powerup before slot (milli-seconds). */
+  static const uint16_t GUARD_MS = 4;
+
+  /** Max number of frames to wait for slot when sending. */
+  static const uint8_t RETRY_MAX = 4;
+
+  /** Contention slot; join requests. */
+  static const uint8_t JOIN_SLOT = SLOT_MAX - 1;
+
+  /** System port for beacons. */
+  static const uint8_t BEACON_PORT = 0xf4;
+
+  /** System port for join request and reply. */
+  static const uint8_t JOIN_PORT = 0xf5;
+
+  /**
+   * Construct TDMA medium access for given wireless device driver
+   * and coordinator device address. The device is the coordinator
+   * if the device address is the coordinator address. The network
+   * and device address is taken from the device driver.
+   * @param[in] dev wireless device driver.
+   * @param[in] coordinator coordinator device address.
+   */
+  TDMA(Wireless::Driver* dev, uint8_t coordinator);
+
+  /**
+   * Return true(1) if this device is the coordinator otherwise
+   * false(0).
+   * @return bool.
+   */
+  bool is_coordinator() const
+  {
+    return (m_addr.device == m_coordinator);
+  }
+
+  /**
+   * Return assigned slot or zero if not joined.
+   * @return slot.
+   */
+  uint8_t get_slot() const
+  {
+    return (m_slot);
+  }
+
+  /**
+   * Return estimated clock drift relative to the coordinator (parts
+   * per million).
+   * @return ppm.
+   */
+  int16_t get_drift() const
+  {
+    return ((m_drift * 15625L) >> 10);
+  }
+
+  /**
+   * Return radio on time (milli-seconds).
+   * @return milli-seconds.
+   */
+  uint32_t get_radio_on() const
+  {
+    return (m_radio_on);
+  }
+
+  /**
+   * Return number of missed beacons.
+   * @return count.
+   */
+  uint16_t get_missed() const
+  {
+    return (m_missed);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Start the device driver. The coordinator sends the first beacon;
+   * nodes power down the radio until sending. Return true(1) if
+   * successful otherwise false(0).
+   * @param[in] config configuration vector (default NULL)
+   * @return bool.
+   */
+  virtual bool begin(const void* config = NULL);
+
+  /**
+   * @override Wireless::Driver
+   * Shutdown the device driver. Return true(1) if successful
+   * otherwise false(0).
+   * @return bool.
+   */
+  virtual bool end()
+  {
+    return (m_dev->end());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given null terminated io vector. A node waits
+   * for the beacon, joins if needed and transmits in the assigned
+   * slot. The radio is powered down between. The coordinator sends
+   * directly. Returns number of bytes sent or negative error code;
+   * ETIME if no beacon was received, ENXIO if no slot was assigned.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] vec null terminated io vector.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const iovec_t* vec);
+
+  /**
+   * @override Wireless::Driver
+   * Send message in given buffer, with given number of bytes. See
+   * send() with io vector above.
+   * @param[in] dest destination network address.
+   * @param[in] port device port (or message type).
+   * @param[in] buf buffer to transmit.
+   * @param[in] len number of bytes in buffer.
+   * @return number of bytes send or negative error code.
+   */
+  virtual int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
+
+  /**
+   * @override Wireless::Driver
+   * Receive message and store into given buffer with given maximum
+   * length. The coordinator sends beacons, handles join requests and
+   * listens only in assigned slots while waiting. A node listens
+   * continuously. Returns the number of received bytes or negative
+   * error code.
+   * @param[out] src source network address.
+   * @param[out] port device port (or message type).
+   * @param[in] buf buffer to store incoming message.
+   * @param[in] len maximum number of bytes to receive.
+   * @param[in] ms maximum time out period (Default blocking(0L)).
+   * @return number of bytes received or negative error code.
+   */
+  virtual int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
+		   uint32_t ms = 0L);
+
+  /**
+   * @override Wireless::Driver
+   * Return true(1) if the latest received message was a broadcast
+   * otherwise false(0).
+   */
+  virtual bool is_broadcast()
+  {
+    return (m_dev->is_broadcast());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Set output power level in dBm.
+   * @param[in] dBm.
+   */
+  virtual void set_output_power_level(int8_t dBm)
+  {
+    m_dev->set_output_power_level(dBm);
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return estimated input power level (dBm).
+   */
+  virtual int get_input_power_level()
+  {
+    return (m_dev->get_input_power_level());
+  }
+
+  /**
+   * @override Wireless::Driver
+   * Return link quality indicator.
+   */
+  virtual int get_link_quality_indicator()
+  {
+    return (m_dev->get_link_quality_indicator());
+  }
+
+protected:
+  /** Beacon; coordinator clock at frame start and slot owners. */
+  struct beacon_t {
+    uint32_t timestamp;		//!< Coordinator clock (milli-seconds).
+    uint8_t owner[SLOT_MAX];	//!< Slot owner device address.
+  };
+
+  Wireless::Driver* m_dev;	//!< Wireless device driver.
+  uint8_t m_coordinator;	//!< Coordinator device address.
+  uint8_t m_slot;		//!< Assigned slot, zero if none.
+  bool m_powered;		//!< Radio power state.
+  uint32_t m_powerup;		//!< Radio power up time (milli-seconds).
+  uint32_t m_radio_on;		//!< Accumulated radio on time.
+  uint16_t m_missed;		//!< Number of missed beacons.
+
+  // Coordinator state
+  uint8_t m_owner[SLOT_MAX];	//!< Slot owner device address.
+  uint16_t m_heard[SLOT_MAX];	//!< Slot owner last heard (frames).
+  uint16_t m_frame;		//!< Frame counter.
+  uint32_t m_start;		//!< Current frame start (milli-seconds).
+
+  // Node synchronization state
+  bool m_synced;		//!< Coordinator clock synchronized.
+  uint32_t m_local;		//!< Local clock at latest beacon.
+  uint32_t m_remote;		//!< Coordinator clock at latest beacon.
+  int32_t m_drift;		//!< Clock drift (local/remote - 1, Q16).
+
+  /**
+   * Power up radio and account radio on time.
+   */
+  void radio_on();
+
+  /**
+   * Power down radio and account radio on time.
+   */
+  void radio_off();
+
+  /**
+   * Wait until given local time. Low power sleep with delay().
+   * @param[in] ms local clock (milli-seconds).
+   */
+  static void sleep_until(uint32_t ms);
+
+  /**
+   * Return local clock for given coordinator clock, with drift
+   * correction.
+   * @param[in] remote coordinator clock (milli-seconds).
+   * @return local clock (milli-seconds).
+   */
+  uint32_t local(uint32_t remote);
+
+  /**
+   * Node; receive beacon and synchronize clock. Wake up just before
+   * the expected beacon if synchronized otherwise listen for at most
+   * two frames. Return true(1) if the beacon was received otherwise
+   * false(0).
+   * @param[out] beacon received beacon.
+   * @return bool.
+   */
+  bool sync(beacon_t& beacon);
+
+  /**
+   * Node; send join request in the contention slot of the frame
+   * starting at given coordinator clock and wait for the reply.
+   * Return true(1) if a slot was assigned otherwise false(0).
+   * @param[in] frame coordinator clock at frame start.
+   * @return bool.
+   */
+  bool join(uint32_t frame);
+
+  /**
+   * Coordinator; send beacon when a new frame starts.
+   */
+  void beacon();
+
+  /**
+   * Coordinator; assign slot to given device and send join reply.
+   * @param[in] src device address.
+   */
+  void assign(uint8_t src);
+};
+
+#endif
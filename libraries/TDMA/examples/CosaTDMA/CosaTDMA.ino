@@ -0,0 +1,104 @@
+/**
+ * @file CosaTDMA.ino
+ * @version 1.0
+ *
+ * @section License
+ * Copyright (C) 2015, Mikael Patel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * @section Description
+ * Cosa TDMA demo; the coordinator (DEVICE == COORDINATOR) sends
+ * beacons and prints received readings. Nodes send a reading every
+ * few seconds in their assigned slot and print the radio on time,
+ * clock drift and missed beacons.
+ *
+ * @section Circuit
+ * See Wireless drivers for circuit connections.
+ *
+ * This file is part of the Arduino Che Cosa project.
+ */
+
+#include <TDMA.h>
+
+#include "Cosa/AnalogPin.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/IOStream/Driver/UART.hh"
+#include "Cosa/Watchdog.hh"
+#include "Cosa/RTC.hh"
+
+// Configuration; network and device addresses. Coordinator or node
+#define NETWORK 0xC05A
+#define COORDINATOR 0x01
+#define DEVICE 0x30
+
+// Select Wireless device driver
+// #include <CC1101.h>
+// CC1101 rf(NETWORK, DEVICE);
+
+#include <NRF24L01P.h>
+NRF24L01P rf(NETWORK, DEVICE);
+
+// #include <RFM69.h>
+// RFM69 rf(NETWORK, DEVICE);
+
+TDMA mac(&rf, COORDINATOR);
+
+// Reading from node; sequence number and bandgap voltage
+struct reading_t {
+  uint16_t nr;
+  uint16_t vcc;
+};
+static const uint8_t READING_TYPE = 0x04;
+
+void setup()
+{
+  uart.begin(9600);
+  trace.begin(&uart, PSTR("CosaTDMA: started"));
+  Watchdog::begin();
+  RTC::begin();
+  ASSERT(mac.begin());
+}
+
+void loop()
+{
+  if (mac.is_coordinator()) {
+    // Receive readings; beacons are sent while waiting
+    reading_t reading;
+    uint8_t src;
+    uint8_t port;
+    int res = mac.recv(src, port, &reading, sizeof(reading), 10000L);
+    if (res == sizeof(reading) && port == READING_TYPE) {
+      trace << PSTR("src=") << hex << src
+	    << PSTR(",nr=") << reading.nr
+	    << PSTR(",vcc=") << reading.vcc
+	    << endl;
+    }
+    else if (res == ETIME) {
+      trace << PSTR("radio_on=") << mac.get_radio_on() << endl;
+    }
+  }
+  else {
+    // Send reading in the assigned slot and sleep
+    static reading_t reading = { 0, 0 };
+    reading.nr += 1;
+    reading.vcc = AnalogPin::bandgap();
+    int res = mac.send(COORDINATOR, READING_TYPE, &reading, sizeof(reading));
+    trace << PSTR("nr=") << reading.nr
+	  << PSTR(",res=") << res
+	  << PSTR(",slot=") << mac.get_slot()
+	  << PSTR(",radio_on=") << mac.get_radio_on()
+	  << PSTR(",drift=") << mac.get_drift()
+	  << PSTR(",missed=") << mac.get_missed()
+	  << endl;
+    sleep(5);
+  }
+}
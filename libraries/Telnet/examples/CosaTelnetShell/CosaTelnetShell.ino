@@ -31,6 +31,9 @@
  * (D2)-----[ ]-------56-|IRQ         |
  *                       +------------+
  * @endcode
+ * The interrupt pin (D2) requires the IRQ jumper on the Ethernet
+ * Shield. Socket events are then serviced on interrupt instead of
+ * polling the socket registers.
  *
  * This file is part of the Arduino Che Cosa project.
  */
@@ -84,6 +87,12 @@ TelnetShell server(shell, ios);
 static const uint8_t mac[6] __PROGMEM = { 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed };
 W5100 ethernet(mac);
 
+// W5100 interrupt pin; socket events (IRQ jumper on Ethernet Shield)
+#define USE_ETHERNET_IRQ
+#if defined(USE_ETHERNET_IRQ)
+W5100::IRQPin irq(&ethernet, Board::EXT0);
+#endif
+
 void setup()
 {
   // Initiate timers
@@ -27,30 +27,87 @@ Controller controller;
 void
 Controller::run()
 {
-  while (m_cnt != 0) {
-    Capsule* capsule;
+  Capsule* capsule;
+  do {
     synchronized {
-      capsule = m_queue[m_get++];
-      if (UNLIKELY(m_get == QUEUE_MAX)) m_get = 0;
-      m_cnt -= 1;
-      capsule->is_scheduled = false;
+      // Start the next wave with the capsules scheduled again
+      if (m_queue == NULL) {
+	m_wave += 1;
+	m_queue = m_later;
+	m_later = NULL;
+      }
+      capsule = m_queue;
+      if (capsule != NULL) {
+	m_queue = capsule->m_next;
+	capsule->is_scheduled = false;
+	capsule->m_wave = m_wave;
+      }
+      m_running = capsule;
     }
-    capsule->behavior();
-  }
+    if (capsule != NULL) capsule->behavior();
+  } while (capsule != NULL);
 }
 
 int
-Controller::schedule(Capsule* capsule)
+Controller::propagate(Capsule* const* capsules)
+{
+  if (UNLIKELY(capsules == NULL)) return (0);
+
+  // Rank after the running capsule; not when called from an interrupt
+  // service routine (interrupts disabled)
+  Capsule* source = NULL;
+  if (SREG & _BV(SREG_I)) source = m_running;
+  Capsule* capsule;
+  while((capsule = (Capsule*) pgm_read_word(capsules++)) != NULL)
+    schedule(capsule, source);
+  return (0);
+}
+
+int
+Controller::schedule(Capsule* capsule, Capsule* source)
 {
-  if (UNLIKELY(m_cnt == QUEUE_MAX)) return (ENOMEM);
   synchronized {
-    if (capsule->is_scheduled) synchronized_return (0);
+    // Rank after the source capsule; connector from running capsule
+    bool rank = ((source != NULL)
+		 && (capsule->m_rank <= source->m_rank)
+		 && (source->m_rank != RANK_MAX));
+    if (capsule->is_scheduled) {
+      if (!rank) synchronized_return (0);
+      if (!remove(&m_queue, capsule)) remove(&m_later, capsule);
+    }
+    if (rank) capsule->m_rank = source->m_rank + 1;
+
+    // Run in the next wave if already run in this wave
+    if (capsule->m_wave == m_wave)
+      insert(&m_later, capsule);
+    else
+      insert(&m_queue, capsule);
     capsule->is_scheduled = true;
-    m_queue[m_put++] = capsule;
-    if (UNLIKELY(m_put == QUEUE_MAX)) m_put = 0;
-    m_cnt += 1;
   }
   return (1);
 }
 
+void
+Controller::insert(Capsule** queue, Capsule* capsule)
+{
+  uint8_t rank = capsule->m_rank;
+  while ((*queue != NULL) && ((*queue)->m_rank <= rank))
+    queue = &(*queue)->m_next;
+  capsule->m_next = *queue;
+  *queue = capsule;
+}
+
+bool
+Controller::remove(Capsule** queue, Capsule* capsule)
+{
+  while (*queue != NULL) {
+    if (*queue == capsule) {
+      *queue = capsule->m_next;
+      return (true);
+    }
+    queue = &(*queue)->m_next;
+  }
+  return (false);
+}
+
 };
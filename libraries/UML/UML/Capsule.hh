@@ -50,9 +50,22 @@ public:
    * Construct Capsule and initiate state.
    */
   Capsule() :
-    is_scheduled(false)
+    is_scheduled(false),
+    m_rank(0),
+    m_wave(0),
+    m_next(NULL)
   {}
 
+  /**
+   * Get rank of the capsule in the connector graph; greater than the
+   * rank of the capsules that schedule it.
+   * @return rank.
+   */
+  uint8_t get_rank() const
+  {
+    return (m_rank);
+  }
+
   /**
    * @override UML::Capsule
    * The capsule behavior is run when any of the connectors it
@@ -63,6 +76,9 @@ public:
 
 protected:
   bool is_scheduled;		//!< Capsule run-time state.
+  uint8_t m_rank;		//!< Rank in connector graph.
+  uint8_t m_wave;		//!< Last propagation wave run.
+  Capsule* m_next;		//!< Next capsule in run-time queue.
   friend class Controller;	//!< Controller can read state.
 };
 
@@ -77,7 +77,7 @@ public:
       if (ON_CHANGE && (m_value == value)) synchronized_return (value);
       m_value = value;
     }
-    controller.schedule(m_listeners);
+    controller.propagate(m_listeners);
     return (value);
   }
 
@@ -29,6 +29,17 @@ namespace UML {
  * The Controller class is responsible for the scheduling and
  * execution of capsule behavior. When a connector is updated the
  * capsules listening for change with be scheduled.
+ *
+ * Capsules are run in propagation waves. In a wave the scheduled
+ * capsules are run in rank order and each capsule at most once. A
+ * capsule that is scheduled by a running capsule through a connector
+ * (propagate()) is ranked after the running capsule. Scheduling from
+ * interrupt service routines does not change the ranks. The ranks are the order of the
+ * connector graph after the first wave, and a capsule that listens
+ * to several paths from the same source is run after all of them
+ * (glitch-free). A capsule that is scheduled again after it has run
+ * in the wave is run in the next wave. Capsules in feedback loops
+ * reach the max rank and are run in scheduling order.
  */
 class Controller {
 public:
@@ -36,13 +47,15 @@ public:
    * Construct Controller. Initiate capsule run-queue.
    */
   Controller() :
-    m_put(0),
-    m_get(0),
-    m_cnt(0)
+    m_queue(NULL),
+    m_later(NULL),
+    m_running(NULL),
+    m_wave(1)
   {}
 
   /**
-   * Execute behavior for all queued capsules.
+   * Execute behavior for all queued capsules; propagation waves until
+   * no capsules are scheduled.
    */
   void run();
 
@@ -63,21 +76,62 @@ public:
   }
 
   /**
-   * Schedule given capsule. Append to controller capsule queue if
-   * not already in the queue. Returns one if scheduled, zero if
-   * already scheduled or negative error code. Can be called from
-   * interrupt service routine.
-   * @param[in] capsule pointer to capsule to append.
-   * @return zero, one or negative error code.
+   * Schedule given capsule. Insert in rank order in the controller
+   * capsule queue if not already in the queue. Returns one if
+   * scheduled, zero if already scheduled. Can be called from interrupt
+   * service routine.
+   * @param[in] capsule pointer to capsule to insert.
+   * @return zero or one.
    */
-  int schedule(Capsule* capsule);
+  int schedule(Capsule* capsule)
+  {
+    return (schedule(capsule, NULL));
+  }
+
+  /**
+   * Schedule all capsules in given NULL terminated vector of connector
+   * listeners. When called from the behavior of the running capsule
+   * the listeners are ranked after the running capsule. Can be called
+   * from interrupt service routine; the listeners are then scheduled
+   * without ranking.
+   * @param[in] capsules null terminated vector of capsule references.
+   * @return zero or negative error code.
+   */
+  int propagate(Capsule* const* capsules);
 
 protected:
-  static const uint8_t QUEUE_MAX = 32; //!< Default run-time queue size.
-  Capsule* m_queue[QUEUE_MAX];	      //!< Run-time queue.
-  uint8_t m_put;		      //!< Index of queue head.
-  uint8_t m_get;		      //!< Index of queue tail.
-  uint8_t m_cnt;		      //!< Number of capsules in queue.
+  static const uint8_t RANK_MAX = 255; //!< Max capsule rank.
+  Capsule* m_queue;		      //!< Run-time queue (this wave).
+  Capsule* m_later;		      //!< Run-time queue (next wave).
+  Capsule* m_running;		      //!< Running capsule.
+  uint8_t m_wave;		      //!< Propagation wave number.
+
+  /**
+   * Schedule given capsule and rank after the given source capsule
+   * (or NULL for no ranking). Returns one if scheduled, zero if
+   * already scheduled.
+   * @param[in] capsule pointer to capsule to insert.
+   * @param[in] source capsule to rank after (or NULL).
+   * @return zero or one.
+   */
+  int schedule(Capsule* capsule, Capsule* source);
+
+  /**
+   * Insert capsule in given queue in rank order; after capsules with
+   * the same rank.
+   * @param[in] queue capsule queue.
+   * @param[in] capsule to insert.
+   */
+  static void insert(Capsule** queue, Capsule* capsule);
+
+  /**
+   * Remove capsule from given queue. Returns true if found otherwise
+   * false.
+   * @param[in] queue capsule queue.
+   * @param[in] capsule to remove.
+   * @return bool.
+   */
+  static bool remove(Capsule** queue, Capsule* capsule);
 };
 
 /**
@@ -74,7 +74,7 @@ public:
       if (m_current != 0) synchronized_return (m_current);
       m_current = m_count;
     }
-    controller.schedule(m_listeners);
+    controller.propagate(m_listeners);
     return (0);
   }
 
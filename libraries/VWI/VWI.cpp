@@ -87,76 +87,45 @@ VWI::Codec::Codec(uint8_t bits_per_symbol,
 }
 
 void
-VWI::Receiver::PLL()
+VWI::Receiver::start()
 {
-  // Integrate each sample
-  if (m_sample) m_integrator++;
-
-  if (m_sample != m_last_sample) {
-    // Transition, advance if ramp > TRANSITION otherwise retard
-    m_pll_ramp +=
-      ((m_pll_ramp < RAMP_TRANSITION) ? RAMP_INC_RETARD : RAMP_INC_ADVANCE);
-    m_last_sample = m_sample;
+  // Have start symbol; drop the message if all slots are in use
+  if ((uint8_t) (m_put - m_get) == SLOT_MAX) {
+    m_overruns += 1;
+    return;
   }
-  else {
-    // No transition: Advance ramp by standard INC (== MAX/BITS samples)
-    m_pll_ramp += RAMP_INC;
-  }
-  if (m_pll_ramp >= RAMP_MAX) {
-    // Add this to the MSB bit of rx_bits, LSB first. The last bits are kept
-    m_bits >>= 1;
-
-    // Check the integrator to see how many samples in this cycle were
-    // high. If < 5 out of 8, then its declared a 0 bit, else a 1;
-    if (m_integrator >= INTEGRATOR_THRESHOLD)
-      m_bits |= m_codec->BITS_MSB;
-
-    m_pll_ramp -= RAMP_MAX;
-
-    // Clear the integral for the next cycle
-    m_integrator = 0;
-
-    if (m_active) {
-      // We have the start symbol and now we are collecting message
-      // bits for two symbols before decoding to a byte
-      if (++m_bit_count >= (m_codec->BITS_PER_SYMBOL * 2)) {
-	uint8_t data = m_codec->decode8(m_bits);
-
-	// The first decoded byte is the byte count of the following
-	// message the count includes the byte count and the 2
-	// trailing FCS bytes.
-	if (m_length == 0) {
-	  // The first byte is the byte count. Check it for
-	  // sensibility. It cant be less than min, since it includes
-	  // the bytes count itself and the 2 byte FCS
-	  m_count = data;
-	  if (m_count < MESSAGE_MIN || m_count > MESSAGE_MAX) {
-	    // Stupid message length, drop the whole thing
-	    m_active = false;
-	    return;
-	  }
-	}
-	m_buffer[m_length++] = data;
-	if (m_length >= m_count) {
-	  // Got all the bytes now
-	  m_active = false;
-	  // Better come get it before the next one starts
-	  m_done = true;
-	}
-	m_bit_count = 0;
-      }
-    }
 
-    // Not in a message, see if we have a start symbol
-    else if (m_bits == m_codec->START_SYMBOL) {
-      // Have start symbol, start collecting message
-      m_active = true;
-      m_bit_count = 0;
-      m_length = 0;
-      // Too bad if you missed the last message
-      m_done = false;
+  // Start collecting message in the next free slot
+  m_buffer = m_slot[m_put & SLOT_MASK].buffer;
+  m_active = true;
+  m_bit_count = 0;
+  m_length = 0;
+}
+
+void
+VWI::Receiver::put(uint8_t data)
+{
+  // The first decoded byte is the byte count of the following
+  // message the count includes the byte count and the 2
+  // trailing FCS bytes.
+  if (m_length == 0) {
+    // The first byte is the byte count. Check it for
+    // sensibility. It cant be less than min, since it includes
+    // the bytes count itself and the 2 byte FCS
+    m_count = data;
+    if (m_count < MESSAGE_MIN || m_count > MESSAGE_MAX) {
+      // Stupid message length, drop the whole thing
+      m_active = false;
+      return;
     }
   }
+  m_buffer[m_length++] = data;
+  if (m_length >= m_count) {
+    // Got all the bytes now; commit the slot
+    m_active = false;
+    m_slot[m_put & SLOT_MASK].length = m_length;
+    m_put += 1;
+  }
 }
 
 int
@@ -166,31 +135,43 @@ VWI::Receiver::recv(uint8_t& src, uint8_t& port,
 {
   // Wait until a valid message is available or timeout
   uint32_t start = RTC::millis();
-  header_t* hp = (header_t*) (m_buffer + 1);
-  do {
-    while (!m_done && (ms == 0 || (RTC::since(start) < ms))) yield();
-    if (!m_done) return (ETIME);
-
-    // Check the crc and the network and device destination address
-    if (!is_valid_crc(m_buffer, m_length)
-	|| (hp->network != s_rf->m_addr.network)
-	|| ((hp->dest != BROADCAST) && (hp->dest != s_rf->m_addr.device))) {
-      m_done = false;
+  slot_t* sp;
+  header_t* hp;
+  while (1) {
+    while (!available() && (ms == 0 || (RTC::since(start) < ms))) yield();
+    if (!available()) return (ETIME);
+
+    // Check the crc and the network and device destination address.
+    // Release the slot if not valid or not for this device. Without
+    // crc check the header may be corrupt; the address is not checked
+    sp = &m_slot[m_get & SLOT_MASK];
+    hp = (header_t*) (sp->buffer + 1);
+    if (!is_valid_crc(sp->buffer, sp->length)) {
+      m_errors += 1;
+      if (m_crc_check) {
+	m_get += 1;
+	continue;
+      }
     }
-  } while (!m_done);
+    if (!m_crc_check) break;
+    if ((hp->network == s_rf->m_addr.network)
+	&& ((hp->dest == BROADCAST) || (hp->dest == s_rf->m_addr.device)))
+      break;
+    m_get += 1;
+  }
 
   // Sanity check message length
-  size_t rxlen = m_length - sizeof(header_t) - 3;
+  size_t rxlen = sp->length - sizeof(header_t) - 3;
   if (rxlen > len) return (EMSGSIZE);
 
   // Copy payload and source device address
-  memcpy(buf, m_buffer + sizeof(header_t) + 1, rxlen);
+  memcpy(buf, sp->buffer + sizeof(header_t) + 1, rxlen);
   s_rf->m_dest = hp->dest;
   src = hp->src;
   port = hp->port;
 
-  // OK, got that message thanks
-  m_done = false;
+  // OK, got that message thanks; release the slot
+  m_get += 1;
 
   // Return actual number of bytes received
   return (rxlen);
@@ -349,35 +330,24 @@ VWI::powerdown()
   TIMSK1 &= ~_BV(OCIE1A);
 }
 
-ISR(TIMER1_COMPA_vect)
+void
+VWI::on_interrupt()
 {
-  VWI::Transmitter* transmitter = &VWI::s_rf->m_tx;
-  VWI::Receiver* receiver = &VWI::s_rf->m_rx;
-
-  // Check if the receiver pin should be sampled
-  if (receiver->m_enabled && !transmitter->m_enabled)
-    receiver->m_sample = receiver->read();
-
-  // Do transmitter stuff first to reduce transmitter bit jitter due
-  // to variable receiver processing
-  if (transmitter->m_enabled && transmitter->m_sample++ == 0) {
-    // Send next bit. Symbols are sent LSB first. Finished sending the
-    // whole message? (after waiting one bit period since the last bit)
-    if (transmitter->m_index >= transmitter->m_length) {
-      transmitter->end();
-    }
-    else {
-      transmitter->write(transmitter->m_buffer[transmitter->m_index] &
-			 (1 << transmitter->m_bit++));
-      if (transmitter->m_bit >= transmitter->m_codec->BITS_PER_SYMBOL) {
-	transmitter->m_bit = 0;
-	transmitter->m_index++;
-      }
-    }
+  // Transmitter has priority; the receiver is not sampled while
+  // transmitting
+  if (m_tx.is_active()) {
+    m_tx.TX(m_tx.m_codec->BITS_PER_SYMBOL);
+    return;
   }
-  if (transmitter->m_sample >= VWI::SAMPLES_PER_BIT)
-    transmitter->m_sample = 0;
-  if (receiver->m_enabled && !transmitter->m_enabled)
-    receiver->PLL();
+  if (!m_rx.is_enabled()) return;
+  Codec* codec = m_rx.m_codec;
+  if (!m_rx.PLL(codec->BITS_PER_SYMBOL, codec->START_SYMBOL, codec->BITS_MSB))
+    return;
+  m_rx.put(codec->decode8(m_rx.get_bits()));
 }
 
+// Weak; may be replaced by a StaticVWI handler (STATIC_VWI_ISR)
+ISR(TIMER1_COMPA_vect, __attribute__((weak)))
+{
+  VWI::s_rf->on_interrupt();
+}
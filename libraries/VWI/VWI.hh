@@ -26,6 +26,18 @@
 #include "Cosa/OutputPin.hh"
 #include "Cosa/Wireless.hh"
 
+/**
+ * Number of receive slots (messages) in the receiver ring. Should be
+ * a power of 2.
+ */
+#ifndef COSA_VWI_SLOT_MAX
+#if defined(BOARD_ATTINY)
+#define COSA_VWI_SLOT_MAX 2
+#else
+#define COSA_VWI_SLOT_MAX 4
+#endif
+#endif
+
 /**
  * VWI is an Cosa library that provides features to send short
  * messages using inexpensive radio transmitters and receivers
@@ -57,6 +69,15 @@
  *                       +------------+       17.3 cm
  * @endcode
  *
+ * Received messages are stored in a ring of SLOT_MAX message slots
+ * by the receiver interrupt handler. Back-to-back messages are
+ * captured even if the application is slow to call recv(). Messages
+ * are dropped, and counted as overruns, when all slots are in use.
+ *
+ * The codec is called through virtual member functions by the
+ * interrupt handler. StaticVWI (below) binds the codec and the
+ * interrupt handler at compile time and reduces the handler cost.
+ *
  * @section Limitations
  * Cannot be used together with other classes that use Timer#1.
  */
@@ -252,7 +273,58 @@ public:
     return (m_rx.recv(src, port, buf, len, ms));
   }
 
-private:
+  /**
+   * Return number of messages dropped as all receive slots were in
+   * use (overrun).
+   * @return count.
+   */
+  uint16_t get_overruns() const
+  {
+    return (m_rx.get_overruns());
+  }
+
+  /**
+   * Return number of received messages with bad check sum.
+   * @return count.
+   */
+  uint16_t get_errors() const
+  {
+    return (m_rx.get_errors());
+  }
+
+  /**
+   * Enable or disable frame check sequence verification of received
+   * messages. Disable when the payload is protected by forward error
+   * correction (e.g. ReedSolomon::Driver); messages with bad check
+   * sum are then received (and counted as errors). The address is not
+   * checked as the header may be corrupt; the forward error correction
+   * layer must filter on the corrected address. Default enabled.
+   * @param[in] flag enable check.
+   */
+  void set_crc_check(bool flag)
+  {
+    m_rx.set_crc_check(flag);
+  }
+
+  /**
+   * Return true(1) if a message is being transmitted otherwise
+   * false(0).
+   * @return bool.
+   */
+  bool is_transmitting() const
+  {
+    return (m_tx.is_active());
+  }
+
+  /**
+   * Interrupt handler; transmit next bit or sample the receiver and
+   * run the Phase Locked Loop. Called at SAMPLES_PER_BIT times the
+   * bit rate. The codec is accessed through virtual member
+   * functions.
+   */
+  void on_interrupt();
+
+protected:
   /**
    * Frame header; Transmitted in little endian order; network LSB first.
    */
@@ -278,6 +350,14 @@ private:
   /** Number of samples per bit. */
   static const uint8_t SAMPLES_PER_BIT = 8;
 
+  /** Number of receive slots. */
+  static const uint8_t SLOT_MAX = COSA_VWI_SLOT_MAX;
+  static_assert(SLOT_MAX && ((SLOT_MAX & (SLOT_MAX - 1)) == 0),
+		"SLOT_MAX should be power of 2");
+
+  /** Receive slot index mask. */
+  static const uint8_t SLOT_MASK = SLOT_MAX - 1;
+
   /**
    * Internal Virtual Wire Receiver.
    */
@@ -290,7 +370,13 @@ private:
      */
     Receiver(Board::DigitalPin pin, Codec* codec) :
       InputPin(pin),
-      m_codec(codec)
+      m_codec(codec),
+      m_put(0),
+      m_get(0),
+      m_overruns(0),
+      m_errors(0),
+      m_crc_check(true),
+      m_buffer(NULL)
     {
     }
 
@@ -314,6 +400,16 @@ private:
       m_enabled = false;
     }
 
+    /**
+     * Return true(1) if the Phase Locked Loop is to run otherwise
+     * false(0).
+     * @return bool.
+     */
+    bool is_enabled() const
+    {
+      return (m_enabled);
+    }
+
     /**
      * Returns true if an unread message is available. May have a
      * bad check-sum.
@@ -321,14 +417,48 @@ private:
      */
     bool available() const
     {
-      return (m_done);
+      return (m_put != m_get);
+    }
+
+    /**
+     * Return number of messages dropped as all receive slots were
+     * in use.
+     * @return count.
+     */
+    uint16_t get_overruns() const
+    {
+      uint16_t res;
+      synchronized res = m_overruns;
+      return (res);
+    }
+
+    /**
+     * Return number of received messages with bad check sum.
+     * @return count.
+     */
+    uint16_t get_errors() const
+    {
+      return (m_errors);
+    }
+
+    /**
+     * Enable or disable frame check sequence verification.
+     * @param[in] flag enable check.
+     */
+    void set_crc_check(bool flag)
+    {
+      m_crc_check = flag;
     }
 
     /**
-     * If a message is available (good checksum or not), copies up to
-     * len bytes to the given buffer, buf. Returns number of bytes
-     * received/copied, zero(0) for timeout or negative error code;
-     * bad checksum(-1), and in enhanced mode did not match address(-2).
+     * Wait for a message with valid check sum and address, and copy
+     * up to len bytes to the given buffer, buf. Messages with bad
+     * check sum or address are dropped; not checked if the check sum
+     * check is disabled. The receive
+     * slot is released when the message has been copied. Returns
+     * number of bytes received/copied or negative error code; ETIME
+     * on timeout, EMSGSIZE if the buffer is too small (message is
+     * kept).
      * @param[out] src source network address.
      * @param[out] port device port (or message type).
      * @param[in] buf pointer to location to save the read data.
@@ -339,6 +469,79 @@ private:
     int recv(uint8_t& src, uint8_t& port, void* buf, size_t len,
 	     uint32_t ms = 0L);
 
+    /**
+     * Phase Locked Loop; Sample the receiver pin and synchronize with
+     * the transmitter so that bit transitions occur at about the time
+     * (m_pll_ramp) is 0, then the average is computed over each bit
+     * period to deduce the bit value. Returns true(1) when two
+     * symbols, with given number of bits, have been received and
+     * should be decoded and passed to put() otherwise false(0).
+     * Inlined in the interrupt handler so that the symbol definition
+     * may be constant.
+     * @param[in] bits_per_symbol number of bits per symbol.
+     * @param[in] start_symbol start symbol.
+     * @param[in] bits_msb received bits most significant bit.
+     * @return bool.
+     */
+    bool PLL(uint8_t bits_per_symbol, uint16_t start_symbol, uint16_t bits_msb)
+      __attribute__((always_inline))
+    {
+      // Integrate each sample
+      m_sample = read();
+      if (m_sample) m_integrator++;
+
+      if (m_sample != m_last_sample) {
+	// Transition, advance if ramp > TRANSITION otherwise retard
+	m_pll_ramp +=
+	  ((m_pll_ramp < RAMP_TRANSITION) ? RAMP_INC_RETARD : RAMP_INC_ADVANCE);
+	m_last_sample = m_sample;
+      }
+      else {
+	// No transition: Advance ramp by standard INC (== MAX/BITS samples)
+	m_pll_ramp += RAMP_INC;
+      }
+      if (m_pll_ramp < RAMP_MAX) return (false);
+
+      // Add this to the MSB bit of rx_bits, LSB first. The last bits
+      // are kept. Check the integrator to see how many samples in this
+      // cycle were high. If < 5 out of 8, then its declared a 0 bit,
+      // else a 1. Clear the integral for the next cycle
+      m_bits >>= 1;
+      if (m_integrator >= INTEGRATOR_THRESHOLD) m_bits |= bits_msb;
+      m_pll_ramp -= RAMP_MAX;
+      m_integrator = 0;
+
+      // We have the start symbol and now we are collecting message
+      // bits for two symbols before decoding to a byte
+      if (m_active) {
+	if (++m_bit_count < (bits_per_symbol * 2)) return (false);
+	m_bit_count = 0;
+	return (true);
+      }
+
+      // Not in a message, see if we have a start symbol
+      if (m_bits == start_symbol) start();
+      return (false);
+    }
+
+    /**
+     * Return the latest received bits; two symbols when PLL() returns
+     * true(1).
+     * @return bits.
+     */
+    uint16_t get_bits() const
+    {
+      return (m_bits);
+    }
+
+    /**
+     * Append given decoded byte to the current message. The first
+     * byte is the byte count. The receive slot is committed when the
+     * message is complete.
+     * @param[in] data decoded byte.
+     */
+    void put(uint8_t data);
+
   private:
     /** The size of the receiver ramp. Ramp wraps modulo this number. */
     static const uint8_t RAMP_MAX = 160;
@@ -367,7 +570,7 @@ private:
     /** Internal ramp adjustment parameter. */
     static const uint8_t RAMP_INC_ADVANCE = (RAMP_INC + RAMP_ADJUST);
 
-    /** Current receiver sample. */
+    /** Current receiver codec. */
     Codec* m_codec;
 
     /** Current receiver sample. */
@@ -395,8 +598,29 @@ private:
      */
     uint8_t m_active;
 
-    /** Flag to indicate that a new message is available. */
-    volatile bool m_done;
+    /** Receive slot; message length and buffer. */
+    struct slot_t {
+      uint8_t length;		//!< Number of bytes in buffer.
+      uint8_t buffer[MESSAGE_MAX]; //!< Message (incl. byte count and FCS).
+    };
+
+    /** Receive slot ring. */
+    slot_t m_slot[SLOT_MAX];
+
+    /** Number of received messages; put index (written by ISR). */
+    volatile uint8_t m_put;
+
+    /** Number of consumed messages; get index. */
+    volatile uint8_t m_get;
+
+    /** Number of messages dropped as all slots were in use. */
+    volatile uint16_t m_overruns;
+
+    /** Number of received messages with bad check sum. */
+    uint16_t m_errors;
+
+    /** Drop messages with bad check sum. */
+    bool m_crc_check;
 
     /** Flag to indicate the receiver PLL is to run. */
     uint8_t m_enabled;
@@ -407,24 +631,24 @@ private:
     /** How many bits of message we have received? Ranges from 0 to 12. */
     uint8_t m_bit_count;
 
-    /** The incoming message buffer. */
-    uint8_t m_buffer[MESSAGE_MAX];
+    /** The incoming message buffer; current put slot. */
+    uint8_t* m_buffer;
 
     /** The incoming message expected length. */
     uint8_t m_count;
 
     /** The incoming message buffer length received so far. */
-    volatile uint8_t m_length;
+    uint8_t m_length;
 
     /**
-     * Phase Locked Loop; Synchronizes with the transmitter so that
-     * bit transitions occur at about the time (m_pll_ramp) is 0, then
-     * the average is computed over each bit period to deduce the bit value.
+     * Start collecting a message in the next free receive slot, on
+     * start symbol. The message is dropped and counted if all slots
+     * are in use.
      */
-    void PLL();
+    void start();
 
-    /** Interrupt Service Routine. */
-    friend void TIMER1_COMPA_vect(void);
+    /** Allow access from interrupt handler. */
+    friend class VWI;
   };
 
   /**
@@ -502,6 +726,34 @@ private:
      */
     int send(uint8_t dest, uint8_t port, const void* buf, size_t len);
 
+    /**
+     * Transmit next bit of the current symbol, with given number of
+     * bits, once per SAMPLES_PER_BIT calls. Symbols are sent LSB
+     * first. Stop the transmitter when the whole message has been
+     * sent (after waiting one bit period since the last bit). Inlined
+     * in the interrupt handler so that the symbol definition may be
+     * constant.
+     * @param[in] bits_per_symbol number of bits per symbol.
+     */
+    void TX(uint8_t bits_per_symbol)
+      __attribute__((always_inline))
+    {
+      if (m_sample++ == 0) {
+	if (m_bit == 0) {
+	  if (m_index >= m_length) {
+	    end();
+	    return;
+	  }
+	  m_symbol = m_buffer[m_index++];
+	  m_bit = bits_per_symbol;
+	}
+	write(m_symbol & 1);
+	m_symbol >>= 1;
+	m_bit -= 1;
+      }
+      if (m_sample >= SAMPLES_PER_BIT) m_sample = 0;
+    }
+
   private:
     /** Max size of preamble and start symbol. Codec provides actual size. */
     static const uint8_t PREAMBLE_MAX = 8;
@@ -518,7 +770,10 @@ private:
     /** Index of the next symbol to send. Ranges from 0..length-1. */
     uint8_t m_index;
 
-    /** Bit number of next bit to send. */
+    /** Current symbol; remaining bits to send. */
+    uint8_t m_symbol;
+
+    /** Number of bits of current symbol left to send. */
     uint8_t m_bit;
 
     /** Sample number for the transmitter, 0..7 in one bit interval. */
@@ -527,14 +782,12 @@ private:
     /** Flag to indicated the transmitter is active. */
     volatile uint8_t m_enabled;
 
-    /** Interrupt Service Routine. */
-    friend void TIMER1_COMPA_vect(void);
-
     /** Allow access of codec. */
     friend class Codec;
-  };
 
-private:
+    /** Allow access from interrupt handler. */
+    friend class VWI;
+  };
   /** Self-reference for interrupt handler. */
   static VWI* s_rf;
 
@@ -550,4 +803,81 @@ private:
   /** Interrupt service routine. */
   friend void TIMER1_COMPA_vect(void);
 };
+
+/**
+ * Virtual Wire Interface with compile-time codec. The codec class
+ * should define the symbol size (BITS) and start symbol (START) as
+ * constants. The interrupt handler is specialized for the codec;
+ * symbol decoding is inlined (non-virtual) and the symbol definition
+ * is constant.
+ * @param[in] CODEC codec class (e.g. ManchesterCodec).
+ *
+ * The timer interrupt service routine in VWI.cpp is weak and calls
+ * the VWI handler. The sketch should replace it with the handler of
+ * the StaticVWI instance with STATIC_VWI_ISR().
+ *
+ * @section Usage
+ * @code
+ * ManchesterCodec codec;
+ * StaticVWI<ManchesterCodec> rf(NETWORK, DEVICE, SPEED, RX, TX, &codec);
+ * STATIC_VWI_ISR(rf);
+ * @endcode
+ */
+template<class CODEC>
+class StaticVWI : public VWI {
+public:
+  /**
+   * Construct Virtual Wire Interface with given network, device
+   * address and speed (bits per second). Attach Receiver to given rx
+   * pin and Transmitter to tx pin. Use the given Codec for coding and
+   * decoding messages.
+   */
+  StaticVWI(int16_t net, uint8_t dev,
+	    uint16_t speed,
+	    Board::DigitalPin rx,
+	    Board::DigitalPin tx,
+	    CODEC* codec) :
+    VWI(net, dev, speed, rx, tx, codec),
+    m_codec(codec)
+  {
+  }
+
+  /**
+   * Interrupt handler; transmit next bit or sample the receiver and
+   * run the Phase Locked Loop. The codec is bound at compile time.
+   * Called from the timer interrupt service routine defined with
+   * STATIC_VWI_ISR().
+   */
+  void on_interrupt()
+    __attribute__((always_inline))
+  {
+    if (m_tx.is_active()) {
+      m_tx.TX(CODEC::BITS);
+      return;
+    }
+    if (!m_rx.is_enabled()) return;
+    if (!m_rx.PLL(CODEC::BITS, CODEC::START, BITS_MSB)) return;
+    uint16_t bits = m_rx.get_bits();
+    m_rx.put((m_codec->CODEC::decode4(bits) << 4)
+	     | m_codec->CODEC::decode4(bits >> CODEC::BITS));
+  }
+
+protected:
+  /** Received bits most significant bit; two symbols. */
+  static const uint16_t BITS_MSB = (1 << (CODEC::BITS * 2 - 1));
+
+  /** Codec; non-virtual access. */
+  CODEC* m_codec;
+};
+
+/**
+ * Define the timer interrupt service routine for the given StaticVWI
+ * instance. Replaces the (weak) VWI interrupt service routine.
+ * @param[in] rf StaticVWI instance.
+ */
+#define STATIC_VWI_ISR(rf)				\
+  ISR(TIMER1_COMPA_vect)				\
+  {							\
+    rf.on_interrupt();					\
+  }
 #endif
@@ -35,14 +35,3 @@ const uint8_t VirtualWireCodec::preamble[] __PROGMEM = {
   0x2a, 0x2a, 0x2a, 0x2a, 0x2a, 0x2a, 0x38, 0x2c
 };
 
-uint8_t
-VirtualWireCodec::decode4(uint8_t symbol)
-{
-  symbol &= SYMBOL_MASK;
-  // FIX: Binary search for better speed
-  for (uint8_t i = 0; i < membersof(symbols); i++)
-    if (symbol == pgm_read_byte(&symbols[i]))
-      return (i);
-  return (0);
-}
-
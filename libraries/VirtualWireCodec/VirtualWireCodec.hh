@@ -30,12 +30,18 @@
  */
 class VirtualWireCodec : public VWI::Codec {
 public:
+  /** Bits per symbol; compile-time definition for StaticVWI. */
+  static const uint8_t BITS = 6;
+
+  /** Start symbol; compile-time definition for StaticVWI. */
+  static const uint16_t START = 0xb38;
+
   /**
    * Construct VirtualWire codec with given bits per symbol, start symbol,
    * and preamble size.
    */
   VirtualWireCodec() :
-    VWI::Codec(6, 0xb38, 8)
+    VWI::Codec(BITS, START, 8)
   {
   }
 
@@ -64,11 +70,19 @@ public:
    * Returns 4-bit data for given symbol.
    * @return 4-bit data.
    */
-  virtual uint8_t decode4(uint8_t symbol);
+  virtual uint8_t decode4(uint8_t symbol)
+  {
+    symbol &= ((1 << BITS) - 1);
+    // FIX: Binary search for better speed
+    for (uint8_t i = 0; i < membersof(symbols); i++)
+      if (symbol == pgm_read_byte(&symbols[i]))
+	return (i);
+    return (0);
+  }
 
 private:
   /** Symbol mapping table: 4 to 6 bits */
-  static const uint8_t symbols[] PROGMEM;
+  static const uint8_t symbols[16] PROGMEM;
 
   /** Message preamble with start symbol */
   static const uint8_t preamble[] PROGMEM;
@@ -35,7 +35,8 @@ W5100::W5100(const uint8_t* mac, Board::DigitalPin csn) :
   SPI::Driver(csn, SPI::ACTIVE_LOW, SPI::DIV2_CLOCK, 0, SPI::MSB_ORDER, NULL),
   m_creg((CommonRegister*) COMMON_REGISTER_BASE),
   m_local(Socket::DYNAMIC_PORT),
-  m_mac(mac)
+  m_mac(mac),
+  m_irq(NULL)
 {
   memset(m_dns, 0, sizeof(m_dns));
   if (mac == NULL) m_mac = MAC;
@@ -137,6 +138,20 @@ W5100::issue(uint16_t addr, uint8_t cmd)
   do DELAY(10); while (read(addr));
 }
 
+uint8_t
+W5100::Driver::dev_ir()
+{
+  m_ir |= m_dev->read(M_SREG(IR));
+  return (m_ir);
+}
+
+void
+W5100::Driver::dev_ir_clear(uint8_t mask)
+{
+  m_dev->write(M_SREG(IR), mask);
+  m_ir &= ~mask;
+}
+
 int
 W5100::Driver::dev_read(void* buf, size_t len)
 {
@@ -296,9 +311,9 @@ W5100::Driver::flush()
   m_dev->issue(M_SREG(CR), CR_SEND);
   uint8_t ir;
   do {
-    ir = m_dev->read(M_SREG(IR));
+    ir = dev_ir();
   } while ((ir & (IR_SEND_OK | IR_TIMEOUT)) == 0);
-  m_dev->write(M_SREG(IR), (IR_SEND_OK | IR_TIMEOUT));
+  dev_ir_clear(IR_SEND_OK | IR_TIMEOUT);
   dev_setup();
   if (ir & IR_TIMEOUT) return (ETIME);
   return (0);
@@ -350,7 +365,7 @@ W5100::Driver::close()
 
   // Issue close command and clear pending interrupts on socket
   m_dev->issue(M_SREG(CR), CR_CLOSE);
-  m_dev->write(M_SREG(IR), 0xff);
+  dev_ir_clear(0xff);
 
   // Mark socket as not in use
   m_proto = 0;
@@ -416,7 +431,7 @@ W5100::Driver::is_connected()
 {
   // Check that the socket is in TCP mode
   if (m_proto != TCP) return (EPROTO);
-  uint8_t ir = m_dev->read(M_SREG(IR));
+  uint8_t ir = dev_ir();
   if (ir & IR_TIMEOUT) return (ETIME);
   if ((ir & IR_CON) == 0) return (0);
   dev_setup();
@@ -457,7 +472,7 @@ W5100::Driver::recv(void* buf, size_t len)
   if (len == 0) return (0);
 
   // Check if data has been received
-  if ((m_dev->read(M_SREG(IR)) & IR_RECV) == 0) return (0);
+  if ((dev_ir() & IR_RECV) == 0) return (0);
   return(dev_read(buf, len));
 }
 
@@ -513,6 +528,13 @@ W5100::Driver::recv(void* buf, size_t len, uint8_t src[4], uint16_t& port)
   return (res);
 }
 
+bool
+W5100::Driver::set_event_handler(Event::Handler* handler)
+{
+  m_handler = handler;
+  return (m_dev->m_irq != NULL);
+}
+
 int
 W5100::Driver::write(const void* buf, size_t len, bool progmem)
 {
@@ -618,8 +640,12 @@ W5100::begin(uint8_t ip[4], uint8_t subnet[4], uint16_t timeout)
   // Set source network address, subnet mask and default gateway
   bind(ip, subnet);
 
-  // Attach interrupt handler
-  // spi.attach(this);
+  // Attach interrupt handler and enable socket interrupts
+  if (m_irq != NULL) {
+    write(M_CREG(IMR), (IMR_S3_INT | IMR_S2_INT | IMR_S1_INT | IMR_S0_INT));
+    spi.attach(this);
+    m_irq->enable();
+  }
 
   return (true);
 }
@@ -647,11 +673,65 @@ W5100::bind(uint8_t ip[4], uint8_t subnet[4], uint8_t gateway[4])
 bool
 W5100::end()
 {
-  // Close all sockets and mark as not initiated
+  // Disable interrupts, close all sockets and mark as not initiated
+  if (m_irq != NULL) {
+    m_irq->disable();
+    write(M_CREG(IMR), 0);
+  }
   for (uint8_t i = 0; i < SOCK_MAX; i++) m_sock[i].close();
   return (true);
 }
 
+void
+W5100::IRQPin::on_interrupt(uint16_t arg)
+{
+  UNUSED(arg);
+  if (m_dev == NULL) return;
+  Event::push(Event::SERVICE_REQUEST_TYPE, m_dev);
+}
+
+void
+W5100::service()
+{
+  // Event type for socket interrupt flags; SEND_OK, TIMEOUT, RECV,
+  // DISCON and CON (bit 4..0)
+  static const uint8_t EVENT_TYPE[] __PROGMEM = {
+    Event::CONNECT_TYPE,
+    Event::DISCONNECT_TYPE,
+    Event::RECEIVE_COMPLETED_TYPE,
+    Event::TIMEOUT_TYPE,
+    Event::SEND_COMPLETED_TYPE
+  };
+
+  // Service until the interrupt pin is released; all socket
+  // interrupt flags cleared. The flags are kept pending in the socket
+  // for the socket member functions
+  uint8_t ir;
+  while ((ir = read(M_CREG(IR)) & (IR_S3_INT | IR_S2_INT |
+				   IR_S1_INT | IR_S0_INT)) != 0) {
+    for (uint8_t i = 0; i < SOCK_MAX; i++, ir >>= 1) {
+      if ((ir & 1) == 0) continue;
+      Driver* sock = &m_sock[i];
+      uint8_t flags = read(uint16_t(&sock->m_sreg->IR));
+      write(uint16_t(&sock->m_sreg->IR), flags);
+      sock->m_ir |= flags;
+      if (sock->m_handler == NULL) continue;
+      for (uint8_t j = 0; j < membersof(EVENT_TYPE); j++) {
+	if ((flags & _BV(j)) == 0) continue;
+	uint8_t type = pgm_read_byte(&EVENT_TYPE[j]);
+	Event::push(type, sock->m_handler, sock);
+      }
+    }
+  }
+}
+
+void
+W5100::on_event(uint8_t type, uint16_t value)
+{
+  UNUSED(value);
+  if (type == Event::SERVICE_REQUEST_TYPE) service();
+}
+
 Socket*
 W5100::socket(Socket::Protocol proto, uint16_t port, uint8_t flag)
 {
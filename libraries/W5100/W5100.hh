@@ -26,6 +26,8 @@
 #if !defined(BOARD_ATTINY)
 #include "Cosa/SPI.hh"
 #include "Cosa/Socket.hh"
+#include "Cosa/Event.hh"
+#include "Cosa/ExternalInterrupt.hh"
 
 /**
  * Cosa WIZnet W5100 device driver class. Provides an implementation
@@ -36,6 +38,13 @@
  * controller may obtain a network address and information from a DHCP
  * server.
  *
+ * The device interrupt pin may be attached (W5100::IRQPin) to avoid
+ * polling the socket registers. Socket interrupts (CON, DISCON, RECV,
+ * SEND_OK and TIMEOUT) are then delivered as events to the socket
+ * event handler (Socket::set_event_handler()). Note that the
+ * interrupt pin on the Arduino Ethernet Shield requires a solder
+ * jumper.
+ *
  * @section Circuit
  * @code
  *                           W5100
@@ -54,7 +63,7 @@
  * 2. W3150A+/W5100 Errata Sheet 2.4, Oct. 28, 2013,
  * http://www.wiznet.co.kr/Admin_Root/UpLoad_Files/BoardFiles/3150Aplus_5100_errata_en_v2.4.pdf
  */
-class W5100 : private SPI::Driver {
+class W5100 : private SPI::Driver, public Event::Handler {
 public:
   /**
    * Common Registers (chap. 3.1, pp. 14), big-endian 16-bit values.
@@ -290,6 +299,19 @@ public:
      */
     void dev_setup();
 
+    /**
+     * Read socket interrupt register and merge with pending interrupt
+     * flags collected by the device interrupt service.
+     * @return interrupt flags.
+     */
+    uint8_t dev_ir();
+
+    /**
+     * Clear given socket interrupt flags in device and pending.
+     * @param[in] mask interrupt flags.
+     */
+    void dev_ir_clear(uint8_t mask);
+
     /** Pointer to socket registers; symbolic address calculation. */
     SocketRegister* m_sreg;
 
@@ -308,9 +330,15 @@ public:
     /** Pointer to socket receiver buffer. */
     uint16_t m_rx_buf;
 
+    /** Pending socket interrupt flags (when interrupt driven). */
+    uint8_t m_ir;
+
+    /** Socket event handler. */
+    Event::Handler* m_handler;
+
   public:
     /** Default constructor. */
-    Driver() : Socket() {}
+    Driver() : Socket(), m_ir(0), m_handler(NULL) {}
 
     /**
      * @override IOStream::Device
@@ -463,6 +491,15 @@ public:
     virtual int recv(void* buf, size_t len,
 		     uint8_t src[4], uint16_t& port);
 
+    /**
+     * @override Socket
+     * Set handler for socket interrupt events. Returns true(1) if the
+     * device interrupt pin is attached otherwise false(0).
+     * @param[in] handler event handler (NULL to detach).
+     * @return bool.
+     */
+    virtual bool set_event_handler(Event::Handler* handler);
+
   protected:
     /**
      * @override Socket
@@ -509,6 +546,39 @@ public:
 		     bool progmem);
   };
 
+  /**
+   * Handler for device interrupt pin. The interrupt is active low
+   * while any socket interrupt flag is set. The interrupt service
+   * pushes a service request event to the device driver which
+   * reads and clears the socket interrupt registers.
+   */
+  class IRQPin : public ExternalInterrupt {
+  public:
+    /**
+     * Construct interrupt pin handler for given W5100 device and
+     * external interrupt pin. Should be constructed before calling
+     * W5100::begin().
+     * @param[in] dev device driver.
+     * @param[in] pin external interrupt pin (Default EXT0).
+     */
+    IRQPin(W5100* dev, Board::ExternalInterruptPin pin = Board::EXT0) :
+      ExternalInterrupt(pin, ExternalInterrupt::ON_FALLING_MODE, true),
+      m_dev(dev)
+    {
+      dev->m_irq = this;
+    }
+
+    /**
+     * @override Interrupt::Handler
+     * Signal device driver that socket interrupt flags are pending.
+     * @param[in] arg (not used).
+     */
+    virtual void on_interrupt(uint16_t arg = 0);
+
+  private:
+    W5100* m_dev;		//!< Device driver.
+  };
+
   /** Default hardware network address. */
   static const uint8_t MAC[6] PROGMEM;
 
@@ -527,6 +597,12 @@ public:
   /** DNS server network address (provided by DHCP). */
   uint8_t m_dns[4];
 
+  /**
+   * Device interrupt pin handler (or NULL for polling). Not the SPI
+   * driver interrupt handler as that is enabled on each bus release.
+   */
+  IRQPin* m_irq;
+
   /** SPI Command codes. Format: [Command 8b] [Address 16b] [data 8b]. */
   enum {
     OP_WRITE = 0xf0,
@@ -653,6 +729,21 @@ public:
    * true if successful otherwise false.
    */
   bool end();
+
+  /**
+   * Service device interrupt; read and clear socket interrupt
+   * registers and push socket events to the socket event handlers.
+   * Called on interrupt pin service request event.
+   */
+  void service();
+
+  /**
+   * @override Event::Handler
+   * Handle service request event from interrupt pin.
+   * @param[in] type the type of event.
+   * @param[in] value the event value.
+   */
+  virtual void on_event(uint8_t type, uint16_t value);
 };
 
 #endif